@@ -0,0 +1,160 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "DeferredCommandRecorder.hpp"
+
+#include <algorithm>
+
+#include "DebugUtilities.hpp"
+#include "Timer.hpp"
+
+namespace Diligent
+{
+
+DeferredCommandRecorder::~DeferredCommandRecorder()
+{
+    Stop();
+}
+
+void DeferredCommandRecorder::Initialize(const std::vector<RefCntAutoPtr<IDeviceContext>>& DeferredContexts)
+{
+    Stop();
+
+    m_Contexts = DeferredContexts;
+    m_CommandLists.resize(m_Contexts.size());
+    m_ppCommandLists.resize(m_Contexts.size());
+    m_RecordTime.assign(m_Contexts.size(), 0);
+    m_Stop = false;
+    for (Uint32 ThreadId = 1; ThreadId < GetNumThreads(); ++ThreadId)
+        m_Workers.emplace_back(&DeferredCommandRecorder::WorkerThread, this, ThreadId);
+}
+
+void DeferredCommandRecorder::Stop()
+{
+    if (!m_Workers.empty())
+    {
+        {
+            std::lock_guard<std::mutex> Lock{m_Mtx};
+            m_Stop = true;
+        }
+        m_WorkCV.notify_all();
+        for (std::thread& Worker : m_Workers)
+            Worker.join();
+        m_Workers.clear();
+    }
+    m_Contexts.clear();
+    m_CommandLists.clear();
+    m_ppCommandLists.clear();
+    m_RecordTime.clear();
+    m_NumRecordedFrames = 0;
+}
+
+void DeferredCommandRecorder::Run(Uint32 NumThreads, const ThreadFunc& Func)
+{
+    NumThreads = std::min(NumThreads, static_cast<Uint32>(m_Workers.size()) + 1);
+    if (NumThreads <= 1)
+    {
+        Func(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> Lock{m_Mtx};
+        m_pJobFunc   = &Func;
+        m_JobThreads = NumThreads;
+        m_NumBusy    = NumThreads - 1;
+        ++m_JobId;
+    }
+    m_WorkCV.notify_all();
+
+    Func(0);
+
+    std::unique_lock<std::mutex> Lock{m_Mtx};
+    m_DoneCV.wait(Lock, [this] { return m_NumBusy == 0; });
+}
+
+void DeferredCommandRecorder::RecordAndExecute(IDeviceContext* pImmediateCtx, Uint32 NumThreads, const RecordFunc& Func)
+{
+    NumThreads = std::min(NumThreads, GetNumThreads());
+    if (NumThreads == 0)
+        return;
+
+    Run(NumThreads, [&](Uint32 ThreadId) {
+        Timer           RecordTimer;
+        IDeviceContext* pCtx = m_Contexts[ThreadId];
+        pCtx->Begin(0);
+        Func(ThreadId, pCtx);
+        pCtx->FinishCommandList(&m_CommandLists[ThreadId]);
+        m_RecordTime[ThreadId] += RecordTimer.GetElapsedTime();
+    });
+
+    for (Uint32 ThreadId = 0; ThreadId < NumThreads; ++ThreadId)
+        m_ppCommandLists[ThreadId] = m_CommandLists[ThreadId];
+    pImmediateCtx->ExecuteCommandLists(NumThreads, m_ppCommandLists.data());
+
+    // Dynamic allocations of a deferred context are released when the frame is finished
+    for (Uint32 ThreadId = 0; ThreadId < NumThreads; ++ThreadId)
+    {
+        m_CommandLists[ThreadId].Release();
+        m_Contexts[ThreadId]->FinishFrame();
+    }
+    ++m_NumRecordedFrames;
+}
+
+void DeferredCommandRecorder::ResetStats()
+{
+    std::fill(m_RecordTime.begin(), m_RecordTime.end(), 0.0);
+    m_NumRecordedFrames = 0;
+}
+
+void DeferredCommandRecorder::WorkerThread(Uint32 ThreadId)
+{
+    Uint32 LastJobId = 0;
+    while (true)
+    {
+        const ThreadFunc* pFunc = nullptr;
+        {
+            std::unique_lock<std::mutex> Lock{m_Mtx};
+            m_WorkCV.wait(Lock, [&] { return m_Stop || m_JobId != LastJobId; });
+            if (m_Stop)
+                return;
+            LastJobId = m_JobId;
+            if (ThreadId >= m_JobThreads)
+                continue;
+            pFunc = m_pJobFunc;
+        }
+
+        (*pFunc)(ThreadId);
+
+        {
+            std::lock_guard<std::mutex> Lock{m_Mtx};
+            --m_NumBusy;
+        }
+        m_DoneCV.notify_all();
+    }
+}
+
+} // namespace Diligent
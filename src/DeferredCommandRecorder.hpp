@@ -0,0 +1,95 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DeviceContext.h"
+#include "RefCntAutoPtr.hpp"
+
+namespace Diligent
+{
+
+// Records command lists on a pool of threads, one deferred context per thread, and executes
+// them on the immediate context in the order of the threads. The calling thread records with
+// the first context and a worker thread with each of the others.
+//
+// Deferred contexts do not know the states of the resources: the immediate context has to
+// transition them before the lists are executed, and the lists only verify the states.
+class DeferredCommandRecorder
+{
+public:
+    using ThreadFunc = std::function<void(Uint32 ThreadId)>;
+    using RecordFunc = std::function<void(Uint32 ThreadId, IDeviceContext* pCtx)>;
+
+    ~DeferredCommandRecorder();
+
+    void Initialize(const std::vector<RefCntAutoPtr<IDeviceContext>>& DeferredContexts);
+    void Stop();
+
+    // 0 if there are no deferred contexts
+    Uint32 GetNumThreads() const { return static_cast<Uint32>(m_Contexts.size()); }
+
+    // Runs Func(0) ... Func(NumThreads - 1) on the calling thread and the workers and returns
+    // when all of them are done. Runs Func(0) on the calling thread if there are no workers.
+    void Run(Uint32 NumThreads, const ThreadFunc& Func);
+
+    // Records one command list with each of the first NumThreads contexts in parallel and
+    // executes the lists on pImmediateCtx
+    void RecordAndExecute(IDeviceContext* pImmediateCtx, Uint32 NumThreads, const RecordFunc& Func);
+
+    // Recording time of a thread since the last call to ResetStats()
+    double GetRecordTime(Uint32 ThreadId) const { return m_RecordTime[ThreadId]; }
+    Uint32 GetNumRecordedFrames() const { return m_NumRecordedFrames; }
+    void   ResetStats();
+
+private:
+    void WorkerThread(Uint32 ThreadId);
+
+    std::vector<RefCntAutoPtr<IDeviceContext>> m_Contexts;
+    std::vector<RefCntAutoPtr<ICommandList>>   m_CommandLists;
+    std::vector<ICommandList*>                 m_ppCommandLists;
+    std::vector<double>                        m_RecordTime;
+    Uint32                                     m_NumRecordedFrames = 0;
+
+    // Worker pool
+    std::vector<std::thread> m_Workers;
+    std::mutex               m_Mtx;
+    std::condition_variable  m_WorkCV;
+    std::condition_variable  m_DoneCV;
+    bool                     m_Stop       = false;
+    Uint32                   m_JobId      = 0;
+    Uint32                   m_JobThreads = 0; // Threads that run the current job
+    Uint32                   m_NumBusy    = 0; // Workers that have not finished the current job
+    const ThreadFunc*        m_pJobFunc   = nullptr;
+};
+
+} // namespace Diligent
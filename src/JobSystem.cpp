@@ -0,0 +1,332 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <string>
+
+#include "DebugUtilities.hpp"
+#include "FileWrapper.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+// System and index of the worker thread that runs the calling code
+thread_local const JobSystem* t_pWorkerSystem = nullptr;
+thread_local Uint32           t_WorkerThread  = 0;
+
+} // namespace
+
+Uint32 JobGraph::AddTask(const char* Name, TaskFunc Func, std::initializer_list<Uint32> Dependencies)
+{
+    const Uint32 Index = GetNumTasks();
+
+    Task NewTask;
+    NewTask.Name            = Name;
+    NewTask.Func            = std::move(Func);
+    NewTask.NumDependencies = static_cast<Uint32>(Dependencies.size());
+    m_Tasks.emplace_back(std::move(NewTask));
+
+    for (Uint32 Dependency : Dependencies)
+    {
+        VERIFY(Dependency < Index, "Tasks may only depend on the tasks added before them");
+        m_Tasks[Dependency].Successors.push_back(Index);
+    }
+    return Index;
+}
+
+void JobGraph::Clear()
+{
+    m_Tasks.clear();
+}
+
+JobSystem::~JobSystem()
+{
+    Stop();
+}
+
+void JobSystem::Initialize(const CreateInfo& CI)
+{
+    Stop();
+
+    m_OwnerThread = std::this_thread::get_id();
+    m_Stop        = false;
+    m_NumQueued.store(0);
+    m_NumStolen.store(0);
+    m_Clock.Restart();
+
+    m_Queues.clear();
+    for (Uint32 i = 0; i <= CI.NumWorkerThreads; ++i)
+        m_Queues.emplace_back(std::make_unique<ThreadQueue>());
+    for (Uint32 i = 1; i <= CI.NumWorkerThreads; ++i)
+        m_Workers.emplace_back(&JobSystem::WorkerThread, this, i);
+}
+
+void JobSystem::Stop()
+{
+    if (!m_Workers.empty())
+    {
+        {
+            std::lock_guard<std::mutex> Lock{m_SleepMtx};
+            m_Stop = true;
+        }
+        m_WakeCV.notify_all();
+        for (std::thread& Worker : m_Workers)
+            Worker.join();
+        m_Workers.clear();
+    }
+    m_Queues.clear();
+}
+
+Uint32 JobSystem::GetThreadIndex() const
+{
+    if (t_pWorkerSystem == this)
+        return t_WorkerThread;
+    return std::this_thread::get_id() == m_OwnerThread ? 0 : ~0u;
+}
+
+void JobSystem::Run(JobGraph& Graph)
+{
+    VERIFY(GetThreadIndex() == 0, "Graphs may only be run by the thread that initialized the job system");
+
+    const Uint32 NumTasks = Graph.GetNumTasks();
+    if (NumTasks == 0)
+        return;
+
+    if (Graph.m_PendingCapacity < NumTasks)
+    {
+        Graph.m_NumPending.reset(new std::atomic<Uint32>[NumTasks]);
+        Graph.m_PendingCapacity = NumTasks;
+    }
+    for (Uint32 i = 0; i < NumTasks; ++i)
+        Graph.m_NumPending[i].store(Graph.m_Tasks[i].NumDependencies);
+    Graph.m_NumRemaining.store(NumTasks);
+
+    // The queue is taken from the back by its thread, so the roots are pushed in reverse to
+    // start them in the order they were added. Other threads steal the later ones.
+    for (Uint32 i = NumTasks; i-- > 0;)
+    {
+        if (Graph.m_Tasks[i].NumDependencies == 0)
+        {
+            Job RootJob;
+            RootJob.pGraph = &Graph;
+            RootJob.Task   = i;
+            Push(0, &RootJob, 1);
+        }
+    }
+
+    WaitFor(0, Graph.m_NumRemaining);
+}
+
+void JobSystem::ParallelFor(Uint32 Count, Uint32 BatchSize, const RangeFunc& Func)
+{
+    VERIFY_EXPR(BatchSize > 0);
+
+    // Small loops are not worth waking the workers
+    const Uint32 Thread = !m_Workers.empty() ? GetThreadIndex() : ~0u;
+    if (Thread == ~0u || Count <= BatchSize)
+    {
+        if (Count > 0)
+            Func(0, Count);
+        return;
+    }
+
+    const Uint32        NumBatches = (Count + BatchSize - 1) / BatchSize;
+    std::atomic<Uint32> NumPending{NumBatches};
+
+    // Pushed in reverse for the calling thread to run the first batches
+    std::vector<Job> Batches(NumBatches);
+    for (Uint32 Batch = 0; Batch < NumBatches; ++Batch)
+    {
+        Job& BatchJob        = Batches[NumBatches - 1 - Batch];
+        BatchJob.pRange      = &Func;
+        BatchJob.Begin       = Batch * BatchSize;
+        BatchJob.End         = std::min((Batch + 1) * BatchSize, Count);
+        BatchJob.pNumPending = &NumPending;
+    }
+    Push(Thread, Batches.data(), NumBatches);
+
+    WaitFor(Thread, NumPending);
+}
+
+void JobSystem::Push(Uint32 Thread, const Job* pJobs, Uint32 NumJobs)
+{
+    {
+        ThreadQueue&                Queue = *m_Queues[Thread];
+        std::lock_guard<std::mutex> Lock{Queue.Mtx};
+        Queue.Jobs.insert(Queue.Jobs.end(), pJobs, pJobs + NumJobs);
+    }
+    m_NumQueued.fetch_add(static_cast<int>(NumJobs));
+
+    if (!m_Workers.empty())
+    {
+        // Taking the lock makes sure that a worker that is about to sleep sees the new jobs
+        {
+            std::lock_guard<std::mutex> Lock{m_SleepMtx};
+        }
+        if (NumJobs > 1)
+            m_WakeCV.notify_all();
+        else
+            m_WakeCV.notify_one();
+    }
+}
+
+bool JobSystem::Pop(Uint32 Thread, Job& J)
+{
+    const Uint32 NumQueues = static_cast<Uint32>(m_Queues.size());
+    for (Uint32 i = 0; i < NumQueues; ++i)
+    {
+        ThreadQueue&                Queue = *m_Queues[(Thread + i) % NumQueues];
+        std::lock_guard<std::mutex> Lock{Queue.Mtx};
+        if (Queue.Jobs.empty())
+            continue;
+
+        // Own jobs are taken newest first while they are likely in the cache; stolen jobs
+        // are the oldest ones, which are usually the largest pieces of work left
+        if (i == 0)
+        {
+            J = Queue.Jobs.back();
+            Queue.Jobs.pop_back();
+        }
+        else
+        {
+            J = Queue.Jobs.front();
+            Queue.Jobs.pop_front();
+            m_NumStolen.fetch_add(1);
+        }
+        m_NumQueued.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::Execute(Uint32 Thread, const Job& J)
+{
+    if (J.pRange != nullptr)
+    {
+        (*J.pRange)(J.Begin, J.End);
+        // The loop may return as soon as the counter is 0, so the job must not be used after this
+        J.pNumPending->fetch_sub(1);
+        return;
+    }
+
+    JobGraph&       Graph = *J.pGraph;
+    JobGraph::Task& Task  = Graph.m_Tasks[J.Task];
+
+    Task.Timing.Thread = Thread;
+    Task.Timing.Start  = GetTime();
+    Task.Func();
+    Task.Timing.End = GetTime();
+
+    for (Uint32 Successor : Task.Successors)
+    {
+        if (Graph.m_NumPending[Successor].fetch_sub(1) == 1)
+        {
+            Job ReadyJob;
+            ReadyJob.pGraph = &Graph;
+            ReadyJob.Task   = Successor;
+            Push(Thread, &ReadyJob, 1);
+        }
+    }
+    Graph.m_NumRemaining.fetch_sub(1);
+}
+
+void JobSystem::WaitFor(Uint32 Thread, const std::atomic<Uint32>& Counter)
+{
+    while (Counter.load() != 0)
+    {
+        Job J;
+        if (Pop(Thread, J))
+            Execute(Thread, J);
+        else
+            std::this_thread::yield(); // The remaining jobs are running on other threads
+    }
+}
+
+void JobSystem::WorkerThread(Uint32 Thread)
+{
+    t_pWorkerSystem = this;
+    t_WorkerThread  = Thread;
+
+    while (true)
+    {
+        Job J;
+        if (Pop(Thread, J))
+        {
+            Execute(Thread, J);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> Lock{m_SleepMtx};
+        m_WakeCV.wait(Lock, [this] { return m_Stop || m_NumQueued.load() > 0; });
+        if (m_Stop)
+            return;
+    }
+}
+
+void JobTrace::AddFrame(const JobGraph& Graph)
+{
+    for (Uint32 i = 0; i < Graph.GetNumTasks(); ++i)
+    {
+        const JobGraph::TaskTiming& Timing = Graph.GetTaskTiming(i);
+
+        Event TaskEvent;
+        TaskEvent.Name   = Graph.GetTaskName(i);
+        TaskEvent.Thread = Timing.Thread;
+        TaskEvent.Start  = Timing.Start;
+        TaskEvent.End    = Timing.End;
+        m_Events.push_back(TaskEvent);
+    }
+    ++m_NumFrames;
+}
+
+bool JobTrace::Save(const char* Path) const
+{
+    // Complete events ("ph": "X") with the times in microseconds; every thread is a track
+    std::string Json = "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < m_Events.size(); ++i)
+    {
+        const Event& E = m_Events[i];
+        Json += "{\"name\":\"" + std::string{E.Name} + "\",\"ph\":\"X\",\"pid\":0,\"tid\":" + std::to_string(E.Thread) +
+            ",\"ts\":" + std::to_string(E.Start * 1e6) + ",\"dur\":" + std::to_string((E.End - E.Start) * 1e6) + "}";
+        Json += i + 1 < m_Events.size() ? ",\n" : "\n";
+    }
+    Json += "],\"displayTimeUnit\":\"ms\"}\n";
+
+    FileWrapper File{Path, EFileAccessMode::Overwrite};
+    if (!File || !File->Write(Json.data(), Json.size()))
+    {
+        LOG_WARNING_MESSAGE("Failed to write the job trace '", Path, "'");
+        return false;
+    }
+    return true;
+}
+
+} // namespace Diligent
@@ -0,0 +1,191 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BasicTypes.h"
+#include "Timer.hpp"
+
+namespace Diligent
+{
+
+class JobSystem;
+
+// Tasks of one frame and the tasks each of them waits for. The graph is run by JobSystem::Run(),
+// which records when and on which thread every task ran.
+class JobGraph
+{
+public:
+    using TaskFunc = std::function<void()>;
+
+    // Adds a task that starts once all of Dependencies are done and returns its index.
+    // Dependencies must be tasks added before.
+    Uint32 AddTask(const char* Name, TaskFunc Func, std::initializer_list<Uint32> Dependencies = {});
+    void   Clear();
+
+    struct TaskTiming
+    {
+        Uint32 Thread = 0; // 0 is the thread that called JobSystem::Run()
+        double Start  = 0; // Seconds on the clock of the job system
+        double End    = 0;
+    };
+
+    Uint32            GetNumTasks() const { return static_cast<Uint32>(m_Tasks.size()); }
+    const char*       GetTaskName(Uint32 Task) const { return m_Tasks[Task].Name; }
+    const TaskTiming& GetTaskTiming(Uint32 Task) const { return m_Tasks[Task].Timing; }
+
+private:
+    friend class JobSystem;
+
+    struct Task
+    {
+        const char*         Name = nullptr;
+        TaskFunc            Func;
+        std::vector<Uint32> Successors;
+        Uint32              NumDependencies = 0;
+        TaskTiming          Timing;
+    };
+    std::vector<Task> m_Tasks;
+
+    // Counters of the current run
+    std::unique_ptr<std::atomic<Uint32>[]> m_NumPending; // Dependencies that are not done by task
+    Uint32                                 m_PendingCapacity = 0;
+    std::atomic<Uint32>                    m_NumRemaining{0};
+};
+
+// Work-stealing scheduler. Every thread has a queue of jobs: a thread takes its newest job
+// first, and a thread with an empty queue steals the oldest job of another thread. Threads
+// that wait for a graph or a parallel loop run jobs until the ones they wait for are done,
+// so loops may be nested in tasks.
+//
+// The thread that called Initialize() is thread 0 and the only one that may run graphs.
+class JobSystem
+{
+public:
+    using RangeFunc = std::function<void(Uint32 Begin, Uint32 End)>;
+
+    struct CreateInfo
+    {
+        // Threads that help the calling thread; 0 runs everything on the calling thread
+        Uint32 NumWorkerThreads = 0;
+    };
+
+    ~JobSystem();
+
+    void Initialize(const CreateInfo& CI);
+    void Stop();
+
+    Uint32 GetNumThreads() const { return static_cast<Uint32>(m_Workers.size()) + 1; }
+
+    // Runs the tasks of the graph once their dependencies are done and returns when all of them are done
+    void Run(JobGraph& Graph);
+
+    // Splits [0, Count) into batches of BatchSize that run on all threads and returns when all
+    // of them are done. Threads that do not belong to the system run all batches themselves.
+    void ParallelFor(Uint32 Count, Uint32 BatchSize, const RangeFunc& Func);
+
+    // Time of the clock that the task timings are measured on
+    double GetTime() const { return m_Clock.GetElapsedTime(); }
+
+    // Jobs that were taken from the queue of another thread since the last call to ResetStats()
+    Uint64 GetNumStolenJobs() const { return m_NumStolen.load(); }
+    void   ResetStats() { m_NumStolen.store(0); }
+
+private:
+    struct Job
+    {
+        JobGraph* pGraph = nullptr; // Task of a graph,
+        Uint32    Task   = 0;
+
+        const RangeFunc*     pRange = nullptr; // or a batch of a loop
+        Uint32               Begin  = 0;
+        Uint32               End    = 0;
+        std::atomic<Uint32>* pNumPending = nullptr;
+    };
+
+    struct ThreadQueue
+    {
+        std::mutex      Mtx;
+        std::deque<Job> Jobs;
+    };
+
+    // Index of the calling thread, or ~0u if it does not belong to the system
+    Uint32 GetThreadIndex() const;
+
+    void Push(Uint32 Thread, const Job* pJobs, Uint32 NumJobs);
+    bool Pop(Uint32 Thread, Job& J);
+    void Execute(Uint32 Thread, const Job& J);
+    // Runs jobs until Counter is 0
+    void WaitFor(Uint32 Thread, const std::atomic<Uint32>& Counter);
+    void WorkerThread(Uint32 Thread);
+
+    std::vector<std::unique_ptr<ThreadQueue>> m_Queues; // By thread
+    std::vector<std::thread>                  m_Workers;
+    std::thread::id                           m_OwnerThread;
+    Timer                                     m_Clock;
+
+    // Sleeping workers are woken when jobs are queued
+    std::mutex              m_SleepMtx;
+    std::condition_variable m_WakeCV;
+    std::atomic<int>        m_NumQueued{0};
+    bool                    m_Stop = false;
+
+    std::atomic<Uint64> m_NumStolen{0};
+};
+
+// Task timings of consecutive runs of a graph, saved in the trace event format that
+// chrome://tracing and Perfetto open
+class JobTrace
+{
+public:
+    void AddFrame(const JobGraph& Graph);
+    bool Save(const char* Path) const;
+
+    Uint32 GetNumFrames() const { return m_NumFrames; }
+
+private:
+    struct Event
+    {
+        const char* Name   = nullptr;
+        Uint32      Thread = 0;
+        double      Start  = 0;
+        double      End    = 0;
+    };
+    std::vector<Event> m_Events;
+    Uint32             m_NumFrames = 0;
+};
+
+} // namespace Diligent
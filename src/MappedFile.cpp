@@ -0,0 +1,148 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MappedFile.hpp"
+
+#if PLATFORM_WIN32
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <Windows.h>
+#elif PLATFORM_LINUX || PLATFORM_MACOS || PLATFORM_IOS || PLATFORM_TVOS
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#    define MAPPED_FILE_POSIX 1
+#endif
+
+#include "FileWrapper.hpp"
+#include "DebugUtilities.hpp"
+
+namespace Diligent
+{
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const char* Path)
+{
+    Close();
+
+#if PLATFORM_WIN32
+    HANDLE hFile = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER FileSize{};
+        if (GetFileSizeEx(hFile, &FileSize) && FileSize.QuadPart > 0)
+        {
+            HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (hMapping != nullptr)
+            {
+                if (const void* pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0))
+                {
+                    m_hFile    = hFile;
+                    m_hMapping = hMapping;
+                    m_pData    = static_cast<const Uint8*>(pView);
+                    m_Size     = static_cast<size_t>(FileSize.QuadPart);
+                    return true;
+                }
+                CloseHandle(hMapping);
+            }
+        }
+        CloseHandle(hFile);
+    }
+#elif MAPPED_FILE_POSIX
+    int fd = open(Path, O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat st = {};
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* pView = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (pView != MAP_FAILED)
+            {
+                // The mapping keeps its own reference to the file
+                close(fd);
+                m_pData = static_cast<const Uint8*>(pView);
+                m_Size  = static_cast<size_t>(st.st_size);
+                return true;
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    return OpenFallback(Path);
+}
+
+bool MappedFile::OpenFallback(const char* Path)
+{
+    FileWrapper File{Path, EFileAccessMode::Read};
+    if (!File)
+        return false;
+
+    const size_t Size = File->GetSize();
+    if (Size == 0)
+        return false;
+
+    m_FallbackData.resize(Size);
+    if (!File->Read(m_FallbackData.data(), Size))
+    {
+        LOG_ERROR_MESSAGE("Failed to read file '", Path, "'");
+        m_FallbackData.clear();
+        return false;
+    }
+
+    m_pData = m_FallbackData.data();
+    m_Size  = Size;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_pData != nullptr && m_FallbackData.empty())
+    {
+#if PLATFORM_WIN32
+        UnmapViewOfFile(m_pData);
+        CloseHandle(static_cast<HANDLE>(m_hMapping));
+        CloseHandle(static_cast<HANDLE>(m_hFile));
+        m_hMapping = nullptr;
+        m_hFile    = nullptr;
+#elif MAPPED_FILE_POSIX
+        munmap(const_cast<Uint8*>(m_pData), m_Size);
+#endif
+    }
+
+    m_FallbackData.clear();
+    m_FallbackData.shrink_to_fit();
+    m_pData = nullptr;
+    m_Size  = 0;
+}
+
+} // namespace Diligent
@@ -0,0 +1,77 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "BasicTypes.h"
+
+namespace Diligent
+{
+
+// Read-only view of a file's content.
+// On desktop platforms the file is memory-mapped, so the content is paged in by the OS on demand
+// and no copy is made. On platforms where mapping is not available (e.g. Android assets),
+// the file is read into an internal buffer.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    // clang-format off
+    MappedFile           (const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile           (MappedFile&&)      = delete;
+    MappedFile& operator=(MappedFile&&)      = delete;
+    // clang-format on
+
+    bool Open(const char* Path);
+    void Close();
+
+    bool         IsOpen() const { return m_pData != nullptr; }
+    const Uint8* GetData() const { return m_pData; }
+    size_t       GetSize() const { return m_Size; }
+
+    // Returns true if the content is served from a mapping rather than a copy
+    bool IsMapped() const { return m_pData != nullptr && m_FallbackData.empty(); }
+
+private:
+    bool OpenFallback(const char* Path);
+
+    const Uint8* m_pData = nullptr;
+    size_t       m_Size  = 0;
+
+#if PLATFORM_WIN32
+    void* m_hFile    = nullptr;
+    void* m_hMapping = nullptr;
+#endif
+
+    std::vector<Uint8> m_FallbackData;
+};
+
+} // namespace Diligent
@@ -0,0 +1,113 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeChunk.hpp"
+
+#include <algorithm>
+
+#include "MazeWallMerger.hpp"
+
+namespace Diligent
+{
+
+void BuildMazeChunk(const MazeLevel& Level, const MazeGenerator* pGenerator, int ChunkSize, MazeChunk& Chunk)
+{
+    const float CellSize   = Level.GetCellSize();
+    const float WallHeight = Level.GetWallHeight();
+
+    const int2 Start{Chunk.Coord.x * ChunkSize, Chunk.Coord.y * ChunkSize};
+    Chunk.Boxes.clear();
+
+    // Cells of the chunk are either generated or read directly from the level
+    std::vector<Uint8> GeneratedCells;
+    const Uint8*       pCells = nullptr;
+    size_t             Stride = 0;
+    int2               Size;
+    int2               LockScope;
+    if (pGenerator != nullptr)
+    {
+        GeneratedCells.resize(static_cast<size_t>(ChunkSize) * static_cast<size_t>(ChunkSize));
+        pGenerator->GenerateChunk(Chunk.Coord, GeneratedCells.data());
+        pCells = GeneratedCells.data();
+        Stride = static_cast<size_t>(ChunkSize);
+        Size   = int2{ChunkSize, ChunkSize};
+        // Every generated chunk has its own key-door pairs
+        LockScope = Chunk.Coord;
+    }
+    else
+    {
+        Stride = static_cast<size_t>(Level.GetCols());
+        pCells = Level.GetCells() + static_cast<size_t>(Start.y) * Stride + static_cast<size_t>(Start.x);
+        Size   = int2{std::min(ChunkSize, Level.GetCols() - Start.x), std::min(ChunkSize, Level.GetRows() - Start.y)};
+    }
+
+    // Walls and doors. Rectangles are merged within the chunk only.
+    std::vector<MazeWallRect> Rects;
+    MergeMazeWalls(Level, pCells, Size, Stride, Start, Rects);
+
+    Chunk.Boxes.reserve(Rects.size());
+    for (const MazeWallRect& Rect : Rects)
+    {
+        const MazeBlockTypeDesc& Desc   = Level.GetBlockType(Rect.BlockType);
+        const float3             Corner = Level.GetCellCenter(Rect.x, Rect.z);
+
+        MazeChunkBox Box;
+        Box.HalfSize  = float3{CellSize * Rect.SizeX * 0.5f, WallHeight, CellSize * Rect.SizeZ * 0.5f};
+        Box.Center    = float3{Corner.x + (Rect.SizeX - 1) * 0.5f * CellSize, WallHeight - 0.2f, Corner.z + (Rect.SizeZ - 1) * 0.5f * CellSize};
+        Box.Cell      = PackMazeCoord(int2{Rect.x, Rect.z});
+        Box.LockScope = LockScope;
+        Box.Material  = Desc.Material;
+        Box.Kind      = Desc.Kind;
+        Box.BlockType = Rect.BlockType;
+        Chunk.Boxes.push_back(Box);
+    }
+    Chunk.NumWalls = static_cast<Uint32>(Chunk.Boxes.size());
+
+    // Keys float above the floor in the middle of their cell
+    constexpr float KeySize = 0.5f;
+    for (int z = 0; z < Size.y; ++z)
+    {
+        for (int x = 0; x < Size.x; ++x)
+        {
+            const Uint8              BlockType = pCells[static_cast<size_t>(z) * Stride + static_cast<size_t>(x)];
+            const MazeBlockTypeDesc& Desc      = Level.GetBlockType(BlockType);
+            if (Desc.Kind != MAZE_BLOCK_KIND_KEY)
+                continue;
+
+            MazeChunkBox Box;
+            Box.HalfSize  = float3{KeySize, KeySize, KeySize};
+            Box.Center    = Level.GetCellCenter(Start.x + x, Start.y + z) + float3{0, KeySize + 2.0f, 0};
+            Box.Cell      = PackMazeCoord(int2{Start.x + x, Start.y + z});
+            Box.LockScope = LockScope;
+            Box.Material  = Desc.Material;
+            Box.Kind      = Desc.Kind;
+            Box.BlockType = BlockType;
+            Chunk.Boxes.push_back(Box);
+        }
+    }
+}
+
+} // namespace Diligent
@@ -0,0 +1,73 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "MazeLevel.hpp"
+#include "MazeGenerator.hpp"
+
+namespace Diligent
+{
+
+// Packs cell or chunk coordinates into a single 64-bit key
+inline Uint64 PackMazeCoord(const int2& Coord)
+{
+    return (static_cast<Uint64>(static_cast<Uint32>(Coord.x)) << 32u) | static_cast<Uint32>(Coord.y);
+}
+
+inline int2 UnpackMazeCoord(Uint64 Key)
+{
+    return int2{static_cast<int>(static_cast<Uint32>(Key >> 32u)), static_cast<int>(static_cast<Uint32>(Key))};
+}
+
+// Axis-aligned box of a wall, door or key that belongs to a streamed chunk
+struct MazeChunkBox
+{
+    float3 Center;            // World-space center of the rendered box
+    float3 HalfSize;          // Half extents of the rendered box
+    Uint64 Cell      = 0;     // Packed coordinates of the first cell covered by the box, see PackMazeCoord()
+    int2   LockScope;         // Keys only open doors with the same lock scope
+    Uint16 Material  = 0;     // Material from the block type description
+    Uint8  Kind      = 0;     // MAZE_BLOCK_KIND
+    Uint8  BlockType = 0;
+};
+
+// Fixed-size square of maze cells built by the streamer
+struct MazeChunk
+{
+    int2 Coord;
+
+    // Walls and doors first, then keys
+    std::vector<MazeChunkBox> Boxes;
+    Uint32                    NumWalls = 0;
+};
+
+// Builds the boxes of the chunk from the level cells or, if pGenerator is not null, from generated cells
+void BuildMazeChunk(const MazeLevel& Level, const MazeGenerator* pGenerator, int ChunkSize, MazeChunk& Chunk);
+
+} // namespace Diligent
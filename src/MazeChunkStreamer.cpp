@@ -0,0 +1,267 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeChunkStreamer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "DebugUtilities.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+int FloorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+} // namespace
+
+MazeChunkStreamer::~MazeChunkStreamer()
+{
+    Stop();
+}
+
+void MazeChunkStreamer::Start(const CreateInfo& CI)
+{
+    VERIFY_EXPR(CI.pLevel != nullptr && CI.pLevel->IsLoaded());
+    VERIFY(CI.ChunkSize > 0 && CI.LoadRadius >= 0 && CI.LookAheadChunks >= 0 && CI.EvictRadius >= CI.LoadRadius + CI.LookAheadChunks,
+           "Invalid chunk streaming parameters");
+    VERIFY(CI.pGenerator == nullptr || CI.pGenerator->GetChunkSize() == CI.ChunkSize, "Generator chunk size must match the streamer chunk size");
+
+    Stop();
+
+    m_CI        = CI;
+    m_NumChunks = int2{(m_CI.pLevel->GetCols() + m_CI.ChunkSize - 1) / m_CI.ChunkSize,
+                       (m_CI.pLevel->GetRows() + m_CI.ChunkSize - 1) / m_CI.ChunkSize};
+    m_HasCenter = false;
+    m_Stop      = false;
+    for (Uint32 i = 0; i < std::max(m_CI.NumWorkerThreads, 1u); ++i)
+        m_Workers.emplace_back(&MazeChunkStreamer::WorkerThread, this);
+}
+
+void MazeChunkStreamer::Stop()
+{
+    if (!m_Workers.empty())
+    {
+        {
+            std::lock_guard<std::mutex> Lock{m_Mtx};
+            m_Stop = true;
+        }
+        m_WorkCV.notify_all();
+        for (std::thread& Worker : m_Workers)
+            Worker.join();
+        m_Workers.clear();
+    }
+
+    m_Queue.clear();
+    m_Built.clear();
+    m_NumBusy = 0;
+    m_Resident.clear();
+    m_Pending.clear();
+    m_HasCenter = false;
+}
+
+int2 MazeChunkStreamer::GetChunkAt(const float3& Pos) const
+{
+    const int2 Cell = m_CI.pLevel->GetCellAt(Pos);
+    return int2{FloorDiv(Cell.x, m_CI.ChunkSize), FloorDiv(Cell.y, m_CI.ChunkSize)};
+}
+
+bool MazeChunkStreamer::IsInRange(const int2& Coord, int Radius) const
+{
+    return std::abs(Coord.x - m_Center.x) <= Radius && std::abs(Coord.y - m_Center.y) <= Radius;
+}
+
+void MazeChunkStreamer::Update(const float3& Pos, std::vector<int2>& EvictedChunks)
+{
+    // Smoothed horizontal direction of travel
+    if (m_HasCenter)
+    {
+        const float3 Delta{Pos.x - m_LastPos.x, 0, Pos.z - m_LastPos.z};
+        const float  Dist = length(Delta);
+        if (Dist > 1e-4f)
+            m_TravelDir = m_TravelDir * 0.9f + Delta / Dist * 0.1f;
+    }
+    m_LastPos = Pos;
+
+    // Look ahead along the axes that make less than ~67 degrees with the direction of travel
+    const float TravelLen = length(m_TravelDir);
+    int2        AheadOffset;
+    if (TravelLen > 0.5f)
+    {
+        const float3 Dir = m_TravelDir / TravelLen;
+        AheadOffset.x    = Dir.x > 0.38f ? m_CI.LookAheadChunks : (Dir.x < -0.38f ? -m_CI.LookAheadChunks : 0);
+        AheadOffset.y    = Dir.z > 0.38f ? m_CI.LookAheadChunks : (Dir.z < -0.38f ? -m_CI.LookAheadChunks : 0);
+    }
+
+    const int2 Center = GetChunkAt(Pos);
+    if (m_HasCenter && Center == m_Center && AheadOffset == m_AheadOffset)
+        return;
+
+    m_Center      = Center;
+    m_AheadOffset = AheadOffset;
+    m_HasCenter   = true;
+
+    for (auto it = m_Resident.begin(); it != m_Resident.end();)
+    {
+        const int2 Coord = UnpackMazeCoord(*it);
+        if (!IsInRange(Coord, m_CI.EvictRadius))
+        {
+            EvictedChunks.push_back(Coord);
+            it = m_Resident.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    std::lock_guard<std::mutex> Lock{m_Mtx};
+
+    // Chunks queued for the previous position that have not been started yet are requeued
+    // below if they are still in range, so that the order reflects the new position.
+    for (const int2& Coord : m_Queue)
+        m_Pending.erase(PackMazeCoord(Coord));
+    m_Queue.clear();
+
+    // Chunks around the camera and around the look-ahead chunk
+    const int2 Ahead{Center.x + AheadOffset.x, Center.y + AheadOffset.y};
+    const int2 First{std::min(Center.x, Ahead.x) - m_CI.LoadRadius, std::min(Center.y, Ahead.y) - m_CI.LoadRadius};
+    const int2 Last{std::max(Center.x, Ahead.x) + m_CI.LoadRadius, std::max(Center.y, Ahead.y) + m_CI.LoadRadius};
+
+    std::vector<int2> Missing;
+    for (int z = First.y; z <= Last.y; ++z)
+    {
+        for (int x = First.x; x <= Last.x; ++x)
+        {
+            const bool NearCenter = std::abs(x - Center.x) <= m_CI.LoadRadius && std::abs(z - Center.y) <= m_CI.LoadRadius;
+            const bool NearAhead  = std::abs(x - Ahead.x) <= m_CI.LoadRadius && std::abs(z - Ahead.y) <= m_CI.LoadRadius;
+            if (!NearCenter && !NearAhead)
+                continue;
+
+            // Generated worlds are unbounded
+            if (m_CI.pGenerator == nullptr && (x < 0 || z < 0 || x >= m_NumChunks.x || z >= m_NumChunks.y))
+                continue;
+
+            const Uint64 Key = PackMazeCoord(int2{x, z});
+            if (m_Resident.count(Key) == 0 && m_Pending.count(Key) == 0)
+                Missing.emplace_back(x, z);
+        }
+    }
+
+    // Nearest chunks first, preferring the direction of travel
+    const float2 Focus{Center.x + AheadOffset.x * 0.5f, Center.y + AheadOffset.y * 0.5f};
+    const auto   FocusDist = [&Focus](const int2& c) {
+        const float2 d{static_cast<float>(c.x) - Focus.x, static_cast<float>(c.y) - Focus.y};
+        return d.x * d.x + d.y * d.y;
+    };
+    std::sort(Missing.begin(), Missing.end(), [&FocusDist](const int2& a, const int2& b) {
+        return FocusDist(a) < FocusDist(b);
+    });
+
+    for (const int2& Coord : Missing)
+    {
+        m_Pending.insert(PackMazeCoord(Coord));
+        m_Queue.push_back(Coord);
+    }
+
+    if (!m_Queue.empty())
+        m_WorkCV.notify_all();
+}
+
+bool MazeChunkStreamer::PopChunk(MazeChunk& Chunk)
+{
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> Lock{m_Mtx};
+            if (m_Built.empty())
+                return false;
+
+            Chunk = std::move(m_Built.front());
+            m_Built.pop_front();
+        }
+
+        const Uint64 Key = PackMazeCoord(Chunk.Coord);
+        m_Pending.erase(Key);
+
+        // The camera may have moved away while the chunk was being built
+        if (!IsInRange(Chunk.Coord, m_CI.EvictRadius))
+            continue;
+
+        m_Resident.insert(Key);
+        return true;
+    }
+}
+
+void MazeChunkStreamer::WaitIdle()
+{
+    std::unique_lock<std::mutex> Lock{m_Mtx};
+    m_IdleCV.wait(Lock, [this]() { return m_Queue.empty() && m_NumBusy == 0; });
+}
+
+void MazeChunkStreamer::WorkerThread()
+{
+    for (;;)
+    {
+        MazeChunk Chunk;
+        {
+            std::unique_lock<std::mutex> Lock{m_Mtx};
+            m_WorkCV.wait(Lock, [this]() { return m_Stop || !m_Queue.empty(); });
+            if (m_Stop)
+                return;
+
+            Chunk.Coord = m_Queue.front();
+            m_Queue.pop_front();
+            ++m_NumBusy;
+        }
+
+        BuildChunk(Chunk);
+
+        {
+            std::lock_guard<std::mutex> Lock{m_Mtx};
+            m_Built.push_back(std::move(Chunk));
+            --m_NumBusy;
+        }
+        m_IdleCV.notify_all();
+    }
+}
+
+void MazeChunkStreamer::BuildChunk(MazeChunk& Chunk) const
+{
+    // Baked chunks only need to be copied
+    if (m_CI.pGenerator == nullptr && m_CI.pCache != nullptr && m_CI.pCache->GetChunk(Chunk.Coord, Chunk))
+        return;
+
+    BuildMazeChunk(*m_CI.pLevel, m_CI.pGenerator, m_CI.ChunkSize, Chunk);
+}
+
+} // namespace Diligent
@@ -0,0 +1,136 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "MazeChunk.hpp"
+#include "MazeSceneCache.hpp"
+
+namespace Diligent
+{
+
+// Partitions the level into ChunkSize x ChunkSize chunks and builds the chunks around
+// the camera on background threads. Chunks farther than EvictRadius from the camera
+// chunk are reported for eviction so that the number of resident chunks never exceeds
+// GetMaxResidentChunks().
+//
+// When a generator is given, chunks are not read from the level but generated, and the
+// world is unbounded. In either case, chunks in the direction of travel are loaded first
+// and up to LookAheadChunks further than LoadRadius.
+class MazeChunkStreamer
+{
+public:
+    struct CreateInfo
+    {
+        // The level provides the cells, or only the block types if pGenerator is not null
+        const MazeLevel*     pLevel     = nullptr;
+        const MazeGenerator* pGenerator = nullptr;
+
+        // Baked chunks of the level; chunks that are not in the cache are built
+        const MazeSceneCache* pCache = nullptr;
+
+        // Chunk size in cells
+        int ChunkSize = 16;
+
+        // Chebyshev distances, in chunks, from the camera chunk.
+        // EvictRadius must not be less than LoadRadius + LookAheadChunks.
+        int LoadRadius      = 2;
+        int LookAheadChunks = 1;
+        int EvictRadius     = 3;
+
+        Uint32 NumWorkerThreads = 1;
+    };
+
+    MazeChunkStreamer() = default;
+    ~MazeChunkStreamer();
+
+    // clang-format off
+    MazeChunkStreamer           (const MazeChunkStreamer&) = delete;
+    MazeChunkStreamer& operator=(const MazeChunkStreamer&) = delete;
+    MazeChunkStreamer           (MazeChunkStreamer&&)      = delete;
+    MazeChunkStreamer& operator=(MazeChunkStreamer&&)      = delete;
+    // clang-format on
+
+    void Start(const CreateInfo& CI);
+    void Stop();
+
+    // Queues missing chunks around the position, nearest first, and returns
+    // resident chunks that went out of the eviction radius.
+    void Update(const float3& Pos, std::vector<int2>& EvictedChunks);
+
+    // Moves the next built chunk into Chunk and marks it resident.
+    // Returns false if no chunk is ready.
+    bool PopChunk(MazeChunk& Chunk);
+
+    // Blocks until all queued chunks have been built
+    void WaitIdle();
+
+    int2 GetChunkAt(const float3& Pos) const;
+
+    int    GetChunkSize() const { return m_CI.ChunkSize; }
+    Uint32 GetMaxResidentChunks() const { return static_cast<Uint32>((2 * m_CI.EvictRadius + 1) * (2 * m_CI.EvictRadius + 1)); }
+    // Every cell of a chunk produces at most one box
+    Uint32 GetMaxBoxesPerChunk() const { return static_cast<Uint32>(m_CI.ChunkSize * m_CI.ChunkSize); }
+    Uint32 GetNumResidentChunks() const { return static_cast<Uint32>(m_Resident.size()); }
+    Uint32 GetNumPendingChunks() const { return static_cast<Uint32>(m_Pending.size()); }
+
+private:
+    void WorkerThread();
+    void BuildChunk(MazeChunk& Chunk) const;
+
+    bool IsInRange(const int2& Coord, int Radius) const;
+
+    CreateInfo m_CI;
+    int2       m_NumChunks;
+
+    // Main thread only
+    int2                       m_Center;
+    int2                       m_AheadOffset; // Look-ahead offset in the direction of travel
+    bool                       m_HasCenter = false;
+    float3                     m_LastPos;
+    float3                     m_TravelDir;
+    std::unordered_set<Uint64> m_Resident; // Chunks returned by PopChunk()
+    std::unordered_set<Uint64> m_Pending;  // Chunks queued, being built or ready to be popped
+
+    // Shared with the worker threads
+    std::vector<std::thread> m_Workers;
+    std::mutex               m_Mtx;
+    std::condition_variable  m_WorkCV;
+    std::condition_variable  m_IdleCV;
+    std::deque<int2>         m_Queue;
+    std::deque<MazeChunk>    m_Built;
+    Uint32                   m_NumBusy = 0;
+    bool                     m_Stop    = false;
+};
+
+} // namespace Diligent
@@ -0,0 +1,213 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeCollisionGrid.hpp"
+
+#include <algorithm>
+#include <random>
+
+#include "DebugUtilities.hpp"
+#include "Timer.hpp"
+
+namespace Diligent
+{
+
+void MazeCollisionGrid::Initialize(float CellSize, Uint32 MaxBoxes)
+{
+    VERIFY_EXPR(CellSize > 0);
+    m_InvCellSize = 1.f / CellSize;
+    m_Boxes.clear();
+    m_Boxes.resize(MaxBoxes);
+    m_Cells.clear();
+    m_NumBoxes   = 0;
+    m_QueryStamp = 0;
+}
+
+void MazeCollisionGrid::Insert(Uint32 Id, const float3& Min, const float3& Max)
+{
+    VERIFY_EXPR(Id < m_Boxes.size());
+    BoxEntry& Box = m_Boxes[Id];
+    VERIFY(!Box.InGrid, "The box is already in the grid");
+
+    Box.MinCell = GetCellAt(Min.x, Min.z);
+    Box.MaxCell = GetCellAt(Max.x, Max.z);
+    Box.InGrid  = true;
+    Box.CellSlots.clear();
+    for (int z = Box.MinCell.y; z <= Box.MaxCell.y; ++z)
+    {
+        for (int x = Box.MinCell.x; x <= Box.MaxCell.x; ++x)
+        {
+            std::vector<Uint32>& CellBoxes = m_Cells[PackMazeCoord(int2{x, z})];
+            Box.CellSlots.push_back(static_cast<Uint32>(CellBoxes.size()));
+            CellBoxes.push_back(Id);
+        }
+    }
+    ++m_NumBoxes;
+}
+
+void MazeCollisionGrid::Remove(Uint32 Id)
+{
+    if (!Contains(Id))
+        return;
+
+    BoxEntry& Box  = m_Boxes[Id];
+    Uint32    Cell = 0;
+    for (int z = Box.MinCell.y; z <= Box.MaxCell.y; ++z)
+    {
+        for (int x = Box.MinCell.x; x <= Box.MaxCell.x; ++x, ++Cell)
+        {
+            auto it = m_Cells.find(PackMazeCoord(int2{x, z}));
+            VERIFY_EXPR(it != m_Cells.end());
+            std::vector<Uint32>& CellBoxes = it->second;
+
+            // Move the last box of the cell into the freed position and fix its back reference
+            const Uint32 Slot = Box.CellSlots[Cell];
+            const Uint32 Last = CellBoxes.back();
+            CellBoxes[Slot]   = Last;
+            CellBoxes.pop_back();
+            if (Last != Id)
+            {
+                BoxEntry& Moved = m_Boxes[Last];
+                const int Ind   = (z - Moved.MinCell.y) * (Moved.MaxCell.x - Moved.MinCell.x + 1) + (x - Moved.MinCell.x);
+                Moved.CellSlots[Ind] = Slot;
+            }
+
+            if (CellBoxes.empty())
+                m_Cells.erase(it);
+        }
+    }
+    VERIFY_EXPR(Cell == Box.CellSlots.size());
+
+    Box.InGrid = false;
+    Box.CellSlots.clear();
+    --m_NumBoxes;
+}
+
+void MazeCollisionGrid::ResetQueryStamps() const
+{
+    for (const BoxEntry& Box : m_Boxes)
+        Box.QueryStamp = 0;
+    m_QueryStamp = 1;
+}
+
+void MazeCollisionGrid::RunBenchmark(const MazeLevel& Level, int ChunkSize, Uint32 NumQueries)
+{
+    if (NumQueries == 0)
+        return;
+
+    struct WallBox
+    {
+        float3 Min;
+        float3 Max;
+    };
+
+    // Walls of the whole level, built the same way as by the streamer
+    std::vector<WallBox> LevelWalls;
+    {
+        const int2 NumChunks{(Level.GetCols() + ChunkSize - 1) / ChunkSize, (Level.GetRows() + ChunkSize - 1) / ChunkSize};
+        MazeChunk  Chunk;
+        for (int z = 0; z < NumChunks.y; ++z)
+        {
+            for (int x = 0; x < NumChunks.x; ++x)
+            {
+                Chunk.Coord = int2{x, z};
+                BuildMazeChunk(Level, nullptr, ChunkSize, Chunk);
+                for (Uint32 w = 0; w < Chunk.NumWalls; ++w)
+                {
+                    const MazeChunkBox& Box = Chunk.Boxes[w];
+                    LevelWalls.push_back({Box.Center - Box.HalfSize, Box.Center + Box.HalfSize});
+                }
+            }
+        }
+    }
+
+    const float2 LevelSize{Level.GetCols() * Level.GetCellSize(), Level.GetRows() * Level.GetCellSize()};
+    const float  QueryRadius = 0.5f;
+
+    // Returns the number of walls that overlap the query sphere
+    const auto TestWall = [QueryRadius](const WallBox& Wall, const float3& Pos) {
+        const float3 Closest{std::max(Wall.Min.x, std::min(Pos.x, Wall.Max.x)),
+                             std::max(Wall.Min.y, std::min(Pos.y, Wall.Max.y)),
+                             std::max(Wall.Min.z, std::min(Pos.z, Wall.Max.z))};
+        return length(Pos - Closest) < QueryRadius ? 1u : 0u;
+    };
+
+    std::string Report;
+    for (int Scale : {1, 10, 100})
+    {
+        // Tile copies of the level in a near-square arrangement
+        const int Cols = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(Scale))));
+        const int Rows = (Scale + Cols - 1) / Cols;
+
+        std::vector<WallBox> Walls;
+        Walls.reserve(LevelWalls.size() * Scale);
+        for (int t = 0; t < Scale; ++t)
+        {
+            const float3 Offset{(t % Cols) * LevelSize.x, 0, (t / Cols) * LevelSize.y};
+            for (const WallBox& Wall : LevelWalls)
+                Walls.push_back({Wall.Min + Offset, Wall.Max + Offset});
+        }
+
+        std::mt19937                          Rng{1234u};
+        std::uniform_real_distribution<float> RandX{-LevelSize.x * 0.5f, (Cols - 0.5f) * LevelSize.x};
+        std::uniform_real_distribution<float> RandZ{-LevelSize.y * 0.5f, (Rows - 0.5f) * LevelSize.y};
+        std::vector<float3>                   Queries(NumQueries);
+        for (float3& Pos : Queries)
+            Pos = float3{RandX(Rng), 1.5f, RandZ(Rng)};
+
+        Timer  LinearTimer;
+        Uint32 LinearHits = 0;
+        for (const float3& Pos : Queries)
+        {
+            for (const WallBox& Wall : Walls)
+                LinearHits += TestWall(Wall, Pos);
+        }
+        const double LinearTime = LinearTimer.GetElapsedTime();
+
+        Timer             BuildTimer;
+        MazeCollisionGrid Grid;
+        Grid.Initialize(Level.GetCellSize(), static_cast<Uint32>(Walls.size()));
+        for (size_t w = 0; w < Walls.size(); ++w)
+            Grid.Insert(static_cast<Uint32>(w), Walls[w].Min, Walls[w].Max);
+        const double BuildTime = BuildTimer.GetElapsedTime();
+
+        Timer  GridTimer;
+        Uint32 GridHits = 0;
+        for (const float3& Pos : Queries)
+            Grid.Query(Pos, QueryRadius, [&](Uint32 Id) { GridHits += TestWall(Walls[Id], Pos); });
+        const double GridTime = GridTimer.GetElapsedTime();
+
+        Report += "\n  " + std::to_string(Scale) + "x (" + std::to_string(Walls.size()) + " walls): linear " +
+            std::to_string(LinearTime * 1e9 / NumQueries) + " ns/query, grid " + std::to_string(GridTime * 1e9 / NumQueries) +
+            " ns/query (" + std::to_string(LinearTime / std::max(GridTime, 1e-9)) + "x), grid build " + std::to_string(BuildTime * 1000.0) + " ms";
+        if (LinearHits != GridHits)
+            LOG_ERROR_MESSAGE("Collision grid found ", GridHits, " hits while the linear scan found ", LinearHits);
+    }
+
+    LOG_INFO_MESSAGE("Collision benchmark: ", NumQueries, " sphere queries of radius ", QueryRadius, Report);
+}
+
+} // namespace Diligent
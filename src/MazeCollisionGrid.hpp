@@ -0,0 +1,124 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "MazeChunk.hpp"
+
+namespace Diligent
+{
+
+// Uniform grid over the XZ plane that accelerates collision queries against wall boxes.
+// The grid is sparse, so it also covers unbounded generated worlds. Every box is registered
+// in all cells it overlaps; a box covers a bounded number of cells, so adding and removing
+// a box does not depend on the number of boxes in the grid.
+//
+// Boxes are identified by the caller's dense ids in [0, MaxBoxes).
+class MazeCollisionGrid
+{
+public:
+    void Initialize(float CellSize, Uint32 MaxBoxes);
+
+    // Adds the box with the given XZ extents. The box must not be in the grid.
+    void Insert(Uint32 Id, const float3& Min, const float3& Max);
+
+    // Removes the box if it is in the grid
+    void Remove(Uint32 Id);
+
+    bool Contains(Uint32 Id) const { return Id < m_Boxes.size() && m_Boxes[Id].InGrid; }
+
+    Uint32 GetNumBoxes() const { return m_NumBoxes; }
+
+    // Calls Callback(Id) once for every box registered in the cells overlapped by the
+    // XZ square that bounds the sphere. The caller performs the exact test.
+    // Queries must not run concurrently.
+    template <typename CallbackType>
+    void Query(const float3& Center, float Radius, CallbackType&& Callback) const
+    {
+        const int2 Min = GetCellAt(Center.x - Radius, Center.z - Radius);
+        const int2 Max = GetCellAt(Center.x + Radius, Center.z + Radius);
+
+        // Boxes that span several query cells are reported once
+        if (++m_QueryStamp == 0)
+            ResetQueryStamps();
+        for (int z = Min.y; z <= Max.y; ++z)
+        {
+            for (int x = Min.x; x <= Max.x; ++x)
+            {
+                auto it = m_Cells.find(PackMazeCoord(int2{x, z}));
+                if (it == m_Cells.end())
+                    continue;
+
+                for (Uint32 Id : it->second)
+                {
+                    if (m_Boxes[Id].QueryStamp != m_QueryStamp)
+                    {
+                        m_Boxes[Id].QueryStamp = m_QueryStamp;
+                        Callback(Id);
+                    }
+                }
+            }
+        }
+    }
+
+    // Measures sphere queries against the walls of the level tiled 1x, 10x and 100x with
+    // the grid and with a linear scan over all walls, and logs the time per query.
+    static void RunBenchmark(const MazeLevel& Level, int ChunkSize, Uint32 NumQueries);
+
+private:
+    int2 GetCellAt(float x, float z) const
+    {
+        return int2{static_cast<int>(std::floor(x * m_InvCellSize)), static_cast<int>(std::floor(z * m_InvCellSize))};
+    }
+
+    void ResetQueryStamps() const;
+
+    struct BoxEntry
+    {
+        int2 MinCell;
+        int2 MaxCell;
+        bool InGrid = false;
+
+        // Position of the box in the list of every covered cell, row by row
+        std::vector<Uint32> CellSlots;
+
+        mutable Uint32 QueryStamp = 0;
+    };
+
+    float m_InvCellSize = 1.f;
+
+    std::vector<BoxEntry>                           m_Boxes;
+    std::unordered_map<Uint64, std::vector<Uint32>> m_Cells; // Packed cell -> ids of the boxes that overlap it
+    Uint32                                          m_NumBoxes = 0;
+
+    mutable Uint32 m_QueryStamp = 0;
+};
+
+} // namespace Diligent
@@ -0,0 +1,403 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeCollisionKernel.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+
+#if defined(__AVX__)
+#    include <immintrin.h>
+#    define MAZE_SIMD_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define MAZE_SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#    include <arm_neon.h>
+#    define MAZE_SIMD_NEON 1
+#endif
+
+#include "PlatformMisc.hpp"
+#include "DebugUtilities.hpp"
+#include "Timer.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+// Eight floats processed together, one per box of a batch
+#if MAZE_SIMD_AVX
+
+struct Float8
+{
+    __m256 v;
+
+    static Float8 Load(const float* p) { return {_mm256_loadu_ps(p)}; }
+    static Float8 Set(float f) { return {_mm256_set1_ps(f)}; }
+
+    friend Float8 operator+(const Float8& a, const Float8& b) { return {_mm256_add_ps(a.v, b.v)}; }
+    friend Float8 operator-(const Float8& a, const Float8& b) { return {_mm256_sub_ps(a.v, b.v)}; }
+    friend Float8 operator*(const Float8& a, const Float8& b) { return {_mm256_mul_ps(a.v, b.v)}; }
+    friend Float8 Max(const Float8& a, const Float8& b) { return {_mm256_max_ps(a.v, b.v)}; }
+
+    // Bit i is set if a[i] < b[i]
+    friend Uint32 LessMask(const Float8& a, const Float8& b) { return static_cast<Uint32>(_mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ))); }
+};
+
+#elif MAZE_SIMD_SSE2
+
+struct Float8
+{
+    __m128 lo, hi;
+
+    static Float8 Load(const float* p) { return {_mm_loadu_ps(p), _mm_loadu_ps(p + 4)}; }
+    static Float8 Set(float f) { return {_mm_set1_ps(f), _mm_set1_ps(f)}; }
+
+    friend Float8 operator+(const Float8& a, const Float8& b) { return {_mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi)}; }
+    friend Float8 operator-(const Float8& a, const Float8& b) { return {_mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi)}; }
+    friend Float8 operator*(const Float8& a, const Float8& b) { return {_mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi)}; }
+    friend Float8 Max(const Float8& a, const Float8& b) { return {_mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi)}; }
+
+    friend Uint32 LessMask(const Float8& a, const Float8& b)
+    {
+        return static_cast<Uint32>(_mm_movemask_ps(_mm_cmplt_ps(a.lo, b.lo))) |
+            (static_cast<Uint32>(_mm_movemask_ps(_mm_cmplt_ps(a.hi, b.hi))) << 4u);
+    }
+};
+
+#elif MAZE_SIMD_NEON
+
+struct Float8
+{
+    float32x4_t lo, hi;
+
+    static Float8 Load(const float* p) { return {vld1q_f32(p), vld1q_f32(p + 4)}; }
+    static Float8 Set(float f) { return {vdupq_n_f32(f), vdupq_n_f32(f)}; }
+
+    friend Float8 operator+(const Float8& a, const Float8& b) { return {vaddq_f32(a.lo, b.lo), vaddq_f32(a.hi, b.hi)}; }
+    friend Float8 operator-(const Float8& a, const Float8& b) { return {vsubq_f32(a.lo, b.lo), vsubq_f32(a.hi, b.hi)}; }
+    friend Float8 operator*(const Float8& a, const Float8& b) { return {vmulq_f32(a.lo, b.lo), vmulq_f32(a.hi, b.hi)}; }
+    friend Float8 Max(const Float8& a, const Float8& b) { return {vmaxq_f32(a.lo, b.lo), vmaxq_f32(a.hi, b.hi)}; }
+
+    friend Uint32 LessMask(const Float8& a, const Float8& b)
+    {
+        static const uint32_t Bits[4] = {1, 2, 4, 8};
+
+        const uint32x4_t BitsV = vld1q_u32(Bits);
+        const uint32x4_t Lo    = vandq_u32(vcltq_f32(a.lo, b.lo), BitsV);
+        const uint32x4_t Hi    = vandq_u32(vcltq_f32(a.hi, b.hi), BitsV);
+        const uint32x2_t LoSum = vadd_u32(vget_low_u32(Lo), vget_high_u32(Lo));
+        const uint32x2_t HiSum = vadd_u32(vget_low_u32(Hi), vget_high_u32(Hi));
+        return vget_lane_u32(vpadd_u32(LoSum, LoSum), 0) | (vget_lane_u32(vpadd_u32(HiSum, HiSum), 0) << 4u);
+    }
+};
+
+#else
+
+struct Float8
+{
+    float f[8];
+
+    static Float8 Load(const float* p)
+    {
+        Float8 r;
+        for (int i = 0; i < 8; ++i)
+            r.f[i] = p[i];
+        return r;
+    }
+    static Float8 Set(float v)
+    {
+        Float8 r;
+        for (int i = 0; i < 8; ++i)
+            r.f[i] = v;
+        return r;
+    }
+
+    template <typename OpType>
+    static Float8 Apply(const Float8& a, const Float8& b, OpType Op)
+    {
+        Float8 r;
+        for (int i = 0; i < 8; ++i)
+            r.f[i] = Op(a.f[i], b.f[i]);
+        return r;
+    }
+
+    friend Float8 operator+(const Float8& a, const Float8& b) { return Apply(a, b, [](float x, float y) { return x + y; }); }
+    friend Float8 operator-(const Float8& a, const Float8& b) { return Apply(a, b, [](float x, float y) { return x - y; }); }
+    friend Float8 operator*(const Float8& a, const Float8& b) { return Apply(a, b, [](float x, float y) { return x * y; }); }
+    friend Float8 Max(const Float8& a, const Float8& b) { return Apply(a, b, [](float x, float y) { return x > y ? x : y; }); }
+
+    friend Uint32 LessMask(const Float8& a, const Float8& b)
+    {
+        Uint32 Mask = 0;
+        for (int i = 0; i < 8; ++i)
+            Mask |= (a.f[i] < b.f[i] ? 1u : 0u) << i;
+        return Mask;
+    }
+};
+
+#endif
+
+static_assert(MazeBoxSoA::BatchSize == 8, "The kernel processes eight boxes at a time");
+
+// Squared distance from the point to the box. Empty boxes (Min = +inf, Max = -inf) are infinitely far.
+inline float SquaredDistanceToBox(float x, float y, float z, const MazeBoxSoA& Boxes, Uint32 i)
+{
+    const float dx = std::max(std::max(Boxes.GetMinX()[i] - x, x - Boxes.GetMaxX()[i]), 0.f);
+    const float dy = std::max(std::max(Boxes.GetMinY()[i] - y, y - Boxes.GetMaxY()[i]), 0.f);
+    const float dz = std::max(std::max(Boxes.GetMinZ()[i] - z, z - Boxes.GetMaxZ()[i]), 0.f);
+    return dx * dx + dy * dy + dz * dz;
+}
+
+} // namespace
+
+void MazeBoxSoA::Resize(Uint32 NumBoxes)
+{
+    const size_t Capacity = (static_cast<size_t>(NumBoxes) + BatchSize - 1) / BatchSize * BatchSize + BatchSize;
+    const float  Inf      = std::numeric_limits<float>::infinity();
+
+    // Entries past the old size are already empty
+    for (Uint32 i = NumBoxes; i < m_Size; ++i)
+        SetEmpty(i);
+    m_MinX.resize(Capacity, +Inf);
+    m_MinY.resize(Capacity, +Inf);
+    m_MinZ.resize(Capacity, +Inf);
+    m_MaxX.resize(Capacity, -Inf);
+    m_MaxY.resize(Capacity, -Inf);
+    m_MaxZ.resize(Capacity, -Inf);
+    m_Size = NumBoxes;
+}
+
+Uint32 MazeBoxSoA::Add(const float3& Min, const float3& Max)
+{
+    const Uint32 i = m_Size;
+    if (m_MinX.size() < static_cast<size_t>(i) + 1 + BatchSize)
+        Resize(std::max(i + 1, i * 2));
+    m_Size = i + 1;
+    Set(i, Min, Max);
+    return i;
+}
+
+void MazeBoxSoA::Set(Uint32 i, const float3& Min, const float3& Max)
+{
+    VERIFY_EXPR(i < m_Size);
+    m_MinX[i] = Min.x;
+    m_MinY[i] = Min.y;
+    m_MinZ[i] = Min.z;
+    m_MaxX[i] = Max.x;
+    m_MaxY[i] = Max.y;
+    m_MaxZ[i] = Max.z;
+}
+
+void MazeBoxSoA::SetEmpty(Uint32 i)
+{
+    const float Inf = std::numeric_limits<float>::infinity();
+    m_MinX[i] = m_MinY[i] = m_MinZ[i] = +Inf;
+    m_MaxX[i] = m_MaxY[i] = m_MaxZ[i] = -Inf;
+}
+
+void FindSphereBoxOverlaps(const MazeSphereSoA& Spheres, const MazeBoxSoA& Boxes, Uint32 FirstBox, Uint32 NumBoxes,
+                           std::vector<MazeSphereBoxOverlap>& Overlaps)
+{
+    VERIFY_EXPR(FirstBox + NumBoxes <= Boxes.GetSize());
+    const Uint32 NumSpheres = Spheres.GetSize();
+    const Float8 Zero       = Float8::Set(0.f);
+
+    for (Uint32 Batch = 0; Batch < NumBoxes; Batch += MazeBoxSoA::BatchSize)
+    {
+        const Uint32 First = FirstBox + Batch;
+
+        // Lanes past the end of the range may belong to other boxes and are masked out
+        const Uint32 NumLanes = std::min(NumBoxes - Batch, MazeBoxSoA::BatchSize);
+        const Uint32 LaneMask = (1u << NumLanes) - 1u;
+
+        const Float8 MinX = Float8::Load(Boxes.GetMinX() + First);
+        const Float8 MinY = Float8::Load(Boxes.GetMinY() + First);
+        const Float8 MinZ = Float8::Load(Boxes.GetMinZ() + First);
+        const Float8 MaxX = Float8::Load(Boxes.GetMaxX() + First);
+        const Float8 MaxY = Float8::Load(Boxes.GetMaxY() + First);
+        const Float8 MaxZ = Float8::Load(Boxes.GetMaxZ() + First);
+
+        // Masks of the boxes hit by each sphere; the pairs are emitted box by box afterwards
+        Uint32 HitMasks[64];
+        for (Uint32 SphereStart = 0; SphereStart < NumSpheres; SphereStart += 64)
+        {
+            const Uint32 SphereEnd = std::min(SphereStart + 64, NumSpheres);
+            Uint32       AnyHit    = 0;
+            for (Uint32 s = SphereStart; s < SphereEnd; ++s)
+            {
+                const Float8 x = Float8::Set(Spheres.X[s]);
+                const Float8 y = Float8::Set(Spheres.Y[s]);
+                const Float8 z = Float8::Set(Spheres.Z[s]);
+                const Float8 r = Float8::Set(Spheres.Radius[s]);
+
+                const Float8 dx = Max(Max(MinX - x, x - MaxX), Zero);
+                const Float8 dy = Max(Max(MinY - y, y - MaxY), Zero);
+                const Float8 dz = Max(Max(MinZ - z, z - MaxZ), Zero);
+
+                const Uint32 Mask = LessMask(dx * dx + dy * dy + dz * dz, r * r) & LaneMask;
+
+                HitMasks[s - SphereStart] = Mask;
+                AnyHit |= Mask;
+            }
+
+            while (AnyHit != 0)
+            {
+                const Uint32 Lane = PlatformMisc::GetLSB(AnyHit);
+                AnyHit &= AnyHit - 1;
+                for (Uint32 s = SphereStart; s < SphereEnd; ++s)
+                {
+                    if (HitMasks[s - SphereStart] & (1u << Lane))
+                        Overlaps.push_back({s, First + Lane});
+                }
+            }
+        }
+    }
+}
+
+void FindSphereBoxOverlapsScalar(const MazeSphereSoA& Spheres, const MazeBoxSoA& Boxes, Uint32 FirstBox, Uint32 NumBoxes,
+                                 std::vector<MazeSphereBoxOverlap>& Overlaps)
+{
+    VERIFY_EXPR(FirstBox + NumBoxes <= Boxes.GetSize());
+    for (Uint32 b = FirstBox; b < FirstBox + NumBoxes; ++b)
+    {
+        for (Uint32 s = 0; s < Spheres.GetSize(); ++s)
+        {
+            if (SquaredDistanceToBox(Spheres.X[s], Spheres.Y[s], Spheres.Z[s], Boxes, b) < Spheres.Radius[s] * Spheres.Radius[s])
+                Overlaps.push_back({s, b});
+        }
+    }
+}
+
+const char* GetSphereBoxKernelName()
+{
+#if MAZE_SIMD_AVX
+    return "AVX";
+#elif MAZE_SIMD_SSE2
+    return "SSE2";
+#elif MAZE_SIMD_NEON
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+void RunSphereBoxBenchmark(Uint32 NumBoxes)
+{
+    if (NumBoxes == 0)
+        return;
+
+    // Wall-like boxes scattered over a square area that is about as dense as the maze
+    std::mt19937                          Rng{4321u};
+    const float                           AreaSize = 2.f * std::sqrt(static_cast<float>(NumBoxes));
+    std::uniform_real_distribution<float> RandPos{0.f, AreaSize};
+    std::uniform_real_distribution<float> RandSize{0.5f, 8.f};
+
+    MazeBoxSoA Boxes;
+    for (Uint32 i = 0; i < NumBoxes; ++i)
+    {
+        const float3 Min{RandPos(Rng), 0.f, RandPos(Rng)};
+        const bool   AlongX = (Rng() & 1u) != 0;
+        Boxes.Add(Min, Min + float3{AlongX ? RandSize(Rng) : 1.f, 3.f, AlongX ? 1.f : RandSize(Rng)});
+    }
+    // Some removed boxes, like opened doors
+    for (Uint32 i = 0; i < NumBoxes; i += 17)
+        Boxes.SetEmpty(i);
+
+    std::string Report;
+    bool        Mismatch = false;
+    for (Uint32 NumSpheres : {1u, 64u})
+    {
+        MazeSphereSoA Spheres;
+        for (Uint32 s = 0; s < NumSpheres; ++s)
+            Spheres.Add(float3{RandPos(Rng), 1.5f, RandPos(Rng)}, 0.5f + 0.05f * static_cast<float>(s % 8));
+
+        std::vector<MazeSphereBoxOverlap> Simd, Scalar;
+
+        // Correctness: the same pairs must be found, up to rounding for spheres that touch a box.
+        // Unaligned ranges check the lane masking.
+        for (Uint32 First : {0u, 3u})
+        {
+            if (First >= NumBoxes)
+                continue;
+
+            Simd.clear();
+            Scalar.clear();
+            FindSphereBoxOverlaps(Spheres, Boxes, First, NumBoxes - First, Simd);
+            FindSphereBoxOverlapsScalar(Spheres, Boxes, First, NumBoxes - First, Scalar);
+
+            const auto Less = [](const MazeSphereBoxOverlap& a, const MazeSphereBoxOverlap& b) {
+                return a.Box != b.Box ? a.Box < b.Box : a.Sphere < b.Sphere;
+            };
+            std::sort(Simd.begin(), Simd.end(), Less);
+            std::sort(Scalar.begin(), Scalar.end(), Less);
+
+            std::vector<MazeSphereBoxOverlap> Diff;
+            std::set_symmetric_difference(Simd.begin(), Simd.end(), Scalar.begin(), Scalar.end(), std::back_inserter(Diff), Less);
+            for (const MazeSphereBoxOverlap& Pair : Diff)
+            {
+                const float r2 = Spheres.Radius[Pair.Sphere] * Spheres.Radius[Pair.Sphere];
+                const float d2 = SquaredDistanceToBox(Spheres.X[Pair.Sphere], Spheres.Y[Pair.Sphere], Spheres.Z[Pair.Sphere], Boxes, Pair.Box);
+                if (std::abs(d2 - r2) > r2 * 1e-5f)
+                    Mismatch = true;
+            }
+        }
+
+        // Every pass tests all boxes against all spheres
+        const Uint32 NumPasses = std::max(1u, (1u << 24u) / (NumBoxes * NumSpheres));
+
+        Timer SimdTimer;
+        for (Uint32 p = 0; p < NumPasses; ++p)
+        {
+            Simd.clear();
+            FindSphereBoxOverlaps(Spheres, Boxes, 0, NumBoxes, Simd);
+        }
+        const double SimdTime = SimdTimer.GetElapsedTime();
+
+        Timer ScalarTimer;
+        for (Uint32 p = 0; p < NumPasses; ++p)
+        {
+            Scalar.clear();
+            FindSphereBoxOverlapsScalar(Spheres, Boxes, 0, NumBoxes, Scalar);
+        }
+        const double ScalarTime = ScalarTimer.GetElapsedTime();
+
+        const double NumTests = static_cast<double>(NumPasses) * NumBoxes * NumSpheres;
+        Report += "\n  " + std::to_string(NumSpheres) + (NumSpheres == 1 ? " sphere:   " : " spheres:  ") +
+            "scalar " + std::to_string(ScalarTime * 1e9 / NumTests) + " ns/test, " + GetSphereBoxKernelName() + " " +
+            std::to_string(SimdTime * 1e9 / NumTests) + " ns/test (" + std::to_string(ScalarTime / std::max(SimdTime, 1e-9)) + "x), " +
+            std::to_string(Simd.size()) + " overlaps";
+    }
+
+    LOG_INFO_MESSAGE("Sphere-box kernel benchmark: ", NumBoxes, " boxes", Report);
+    if (Mismatch)
+        LOG_ERROR_MESSAGE("Sphere-box kernel results do not match the scalar implementation");
+}
+
+} // namespace Diligent
@@ -0,0 +1,124 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "BasicMath.hpp"
+
+namespace Diligent
+{
+
+// Axis-aligned boxes stored as separate coordinate arrays, so that the collision kernel
+// can load the same coordinate of BatchSize consecutive boxes at once. Unused entries are
+// empty boxes that never overlap anything.
+class MazeBoxSoA
+{
+public:
+    static constexpr Uint32 BatchSize = 8;
+
+    // Added boxes are empty
+    void Resize(Uint32 NumBoxes);
+    void Clear() { Resize(0); }
+
+    Uint32 Add(const float3& Min, const float3& Max);
+    void   Set(Uint32 i, const float3& Min, const float3& Max);
+    void   SetEmpty(Uint32 i);
+
+    Uint32 GetSize() const { return m_Size; }
+
+    float3 GetMin(Uint32 i) const { return float3{m_MinX[i], m_MinY[i], m_MinZ[i]}; }
+    float3 GetMax(Uint32 i) const { return float3{m_MaxX[i], m_MaxY[i], m_MaxZ[i]}; }
+
+    const float* GetMinX() const { return m_MinX.data(); }
+    const float* GetMinY() const { return m_MinY.data(); }
+    const float* GetMinZ() const { return m_MinZ.data(); }
+    const float* GetMaxX() const { return m_MaxX.data(); }
+    const float* GetMaxY() const { return m_MaxY.data(); }
+    const float* GetMaxZ() const { return m_MaxZ.data(); }
+
+private:
+    // Arrays are padded with at least BatchSize empty boxes so that a batch that
+    // starts at any box can be loaded
+    std::vector<float> m_MinX, m_MinY, m_MinZ;
+    std::vector<float> m_MaxX, m_MaxY, m_MaxZ;
+
+    Uint32 m_Size = 0;
+};
+
+// Query spheres, also stored as separate arrays
+struct MazeSphereSoA
+{
+    std::vector<float> X, Y, Z, Radius;
+
+    void Clear()
+    {
+        X.clear();
+        Y.clear();
+        Z.clear();
+        Radius.clear();
+    }
+
+    Uint32 Add(const float3& Center, float R)
+    {
+        X.push_back(Center.x);
+        Y.push_back(Center.y);
+        Z.push_back(Center.z);
+        Radius.push_back(R);
+        return static_cast<Uint32>(X.size() - 1);
+    }
+
+    Uint32 GetSize() const { return static_cast<Uint32>(X.size()); }
+};
+
+struct MazeSphereBoxOverlap
+{
+    Uint32 Sphere;
+    Uint32 Box;
+};
+
+// Appends all pairs of a sphere and a box in [FirstBox, FirstBox + NumBoxes) such that the
+// distance from the sphere center to the box is less than the radius. Pairs are grouped by
+// batch of MazeBoxSoA::BatchSize boxes, then by block of 64 spheres, and ordered by box, then
+// by sphere within the group; with up to 64 spheres, they are ordered by box, then by sphere.
+// The kernel tests MazeBoxSoA::BatchSize boxes per instruction with AVX, with two SSE2 or NEON
+// registers, or with a scalar fallback.
+void FindSphereBoxOverlaps(const MazeSphereSoA& Spheres, const MazeBoxSoA& Boxes, Uint32 FirstBox, Uint32 NumBoxes,
+                           std::vector<MazeSphereBoxOverlap>& Overlaps);
+
+// Reference implementation that tests one sphere against one box at a time
+void FindSphereBoxOverlapsScalar(const MazeSphereSoA& Spheres, const MazeBoxSoA& Boxes, Uint32 FirstBox, Uint32 NumBoxes,
+                                 std::vector<MazeSphereBoxOverlap>& Overlaps);
+
+// Name of the instruction set used by FindSphereBoxOverlaps()
+const char* GetSphereBoxKernelName();
+
+// Checks the kernel against the scalar implementation on random boxes and spheres,
+// measures both with 1 and 64 query spheres and logs the results.
+void RunSphereBoxBenchmark(Uint32 NumBoxes);
+
+} // namespace Diligent
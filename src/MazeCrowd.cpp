@@ -0,0 +1,494 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeCrowd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+
+#include "DebugUtilities.hpp"
+#include "Timer.hpp"
+#include "MazeChunk.hpp"
+
+namespace Diligent
+{
+
+MazeCrowd::~MazeCrowd()
+{
+    Stop();
+}
+
+void MazeCrowd::Initialize(const CreateInfo& CI)
+{
+    VERIFY_EXPR(CI.pLevel != nullptr && CI.SeparationRadius > 0);
+
+    Stop();
+
+    m_CI = CI;
+    m_Lod.Initialize(m_CI.Lod);
+}
+
+void MazeCrowd::Stop()
+{
+    for (auto* pArray : {&m_PosX, &m_PosZ, &m_VelX, &m_VelZ, &m_Yaw, &m_PrevPosX, &m_PrevPosZ, &m_PrevYaw, &m_LodPending, &m_LodElapsed})
+        pArray->clear();
+    m_State.clear();
+    m_SeesPlayer.clear();
+    m_Cell.clear();
+    m_PathNext.clear();
+}
+
+Uint32 MazeCrowd::AddAgent(const float3& Pos)
+{
+    const Uint32 Agent = GetNumAgents();
+    for (auto* pArray : {&m_PosX, &m_PrevPosX})
+        pArray->push_back(Pos.x);
+    for (auto* pArray : {&m_PosZ, &m_PrevPosZ})
+        pArray->push_back(Pos.z);
+    for (auto* pArray : {&m_VelX, &m_VelZ, &m_Yaw, &m_PrevYaw, &m_LodPending, &m_LodElapsed})
+        pArray->push_back(0);
+    m_State.push_back(MAZE_CROWD_STATE_LOST);
+    m_SeesPlayer.push_back(0);
+    m_Cell.push_back(m_CI.pLevel->GetCellAt(Pos));
+    return Agent;
+}
+
+void MazeCrowd::SetPath(const std::vector<int2>& Cells)
+{
+    m_PathNext.clear();
+    for (size_t i = 0; i + 1 < Cells.size(); ++i)
+        m_PathNext.emplace(PackMazeCoord(Cells[i]), Cells[i + 1]);
+}
+
+void MazeCrowd::ParallelFor(Uint32 Count, const RangeFunc& Func)
+{
+    if (m_CI.pJobs != nullptr)
+        m_CI.pJobs->ParallelFor(Count, BatchSize, Func);
+    else if (Count > 0)
+        Func(0, Count);
+}
+
+int2 MazeCrowd::GetHashCell(float x, float z) const
+{
+    const float CellSize = m_CI.SeparationRadius * 2;
+    return int2{static_cast<int>(std::floor(x / CellSize)), static_cast<int>(std::floor(z / CellSize))};
+}
+
+Uint32 MazeCrowd::GetHashBucket(const int2& HashCell) const
+{
+    const Uint32 Hash = (static_cast<Uint32>(HashCell.x) * 73856093u) ^ (static_cast<Uint32>(HashCell.y) * 19349663u);
+    return Hash & static_cast<Uint32>(m_HashStart.size() - 2);
+}
+
+void MazeCrowd::BuildSpatialHash()
+{
+    // Twice as many buckets as agents, plus one for the end of the last bucket
+    const Uint32 NumAgents  = GetNumAgents();
+    Uint32       NumBuckets = 64;
+    while (NumBuckets < NumAgents * 2)
+        NumBuckets *= 2;
+    m_HashStart.assign(NumBuckets + 1, 0);
+    m_HashAgents.resize(NumAgents);
+    m_AgentBucket.resize(NumAgents);
+
+    // Counting sort of the agents by bucket
+    for (Uint32 i = 0; i < NumAgents; ++i)
+    {
+        m_AgentBucket[i] = GetHashBucket(GetHashCell(m_PosX[i], m_PosZ[i]));
+        ++m_HashStart[m_AgentBucket[i] + 1];
+    }
+    for (Uint32 b = 0; b < NumBuckets; ++b)
+        m_HashStart[b + 1] += m_HashStart[b];
+    for (Uint32 i = 0; i < NumAgents; ++i)
+        m_HashAgents[m_HashStart[m_AgentBucket[i]]++] = i;
+    // The fill moved every start to the end of its bucket
+    for (Uint32 b = NumBuckets; b > 0; --b)
+        m_HashStart[b] = m_HashStart[b - 1];
+    m_HashStart[0] = 0;
+}
+
+void MazeCrowd::SteerAgents(const MazeFlowField& Field, const float3& PlayerPos, const Uint32* pAgents, Uint32 Count)
+{
+    const MazeLevel& Level     = *m_CI.pLevel;
+    const float      Radius    = m_CI.SeparationRadius;
+    const float      MaxSpeed2 = m_CI.Speed * m_CI.Speed;
+
+    for (Uint32 a = 0; a < Count; ++a)
+    {
+        const Uint32 i = pAgents[a];
+        const float  x = m_PosX[i];
+        const float  z = m_PosZ[i];
+
+        const float ToPlayerX    = PlayerPos.x - x;
+        const float ToPlayerZ    = PlayerPos.z - z;
+        const float DistToPlayer = std::sqrt(ToPlayerX * ToPlayerX + ToPlayerZ * ToPlayerZ);
+        const bool  SeesPlayer   = m_CI.pRayCaster != nullptr && DistToPlayer < m_CI.PerceptionRange &&
+            m_CI.pRayCaster->HasLineOfSight(float3{x, 0, z}, PlayerPos);
+
+        // Walk to the center of the next cell toward the player. The agents that see the player,
+        // the agents in the player's cell and the agents without a route head straight for the player.
+        float DesiredX = 0, DesiredZ = 0;
+        Uint8 State    = MAZE_CROWD_STATE_CHASING;
+        if (DistToPlayer > m_CI.StopDistance)
+        {
+            const int2 Cell  = m_Cell[i];
+            float      GoalX = PlayerPos.x;
+            float      GoalZ = PlayerPos.z;
+            int2       NextCell;
+            if (SeesPlayer)
+                State = MAZE_CROWD_STATE_CHASING;
+            else if (Field.GetNextCell(Cell, NextCell))
+            {
+                const float3 Center = Level.GetCellCenter(NextCell.x, NextCell.y);
+                GoalX               = Center.x;
+                GoalZ               = Center.z;
+            }
+            else if (Field.GetDistance(Cell) != 0)
+            {
+                auto PathIt = m_PathNext.find(PackMazeCoord(Cell));
+                if (PathIt != m_PathNext.end())
+                {
+                    const float3 Center = Level.GetCellCenter(PathIt->second.x, PathIt->second.y);
+                    GoalX               = Center.x;
+                    GoalZ               = Center.z;
+                    State               = MAZE_CROWD_STATE_ON_PATH;
+                }
+                else
+                {
+                    State = MAZE_CROWD_STATE_LOST;
+                }
+            }
+
+            const float ToGoalX  = GoalX - x;
+            const float ToGoalZ  = GoalZ - z;
+            const float GoalDist = std::sqrt(ToGoalX * ToGoalX + ToGoalZ * ToGoalZ);
+            if (GoalDist > 1e-4f)
+            {
+                DesiredX = ToGoalX / GoalDist * m_CI.Speed;
+                DesiredZ = ToGoalZ / GoalDist * m_CI.Speed;
+            }
+        }
+        if (DistToPlayer < m_CI.AttackRange && (SeesPlayer || m_CI.pRayCaster == nullptr))
+            State = MAZE_CROWD_STATE_ATTACKING;
+
+        // Separation from the neighbors in the 2x2 hash cells that the separation circle of
+        // the agent overlaps. Different cells may share a bucket, so every bucket is visited once.
+        // Distant agents skip it; nobody sees them bump into each other.
+        const int2 FirstHashCell = GetHashCell(x - Radius, z - Radius);
+
+        float  SepX = 0, SepZ = 0;
+        Uint32 Buckets[4];
+        Uint32 NumBuckets   = 0;
+        Uint32 NumNeighbors = 0;
+        if (m_Lod.GetEntityTier(i) == 0)
+        {
+            for (int dz = 0; dz <= 1; ++dz)
+            {
+                for (int dx = 0; dx <= 1; ++dx)
+                {
+                    const Uint32 Bucket = GetHashBucket(FirstHashCell + int2{dx, dz});
+                    if (std::find(Buckets, Buckets + NumBuckets, Bucket) != Buckets + NumBuckets)
+                        continue;
+                    Buckets[NumBuckets++] = Bucket;
+
+                    for (Uint32 h = m_HashStart[Bucket]; h < m_HashStart[Bucket + 1] && NumNeighbors < m_CI.MaxNeighbors; ++h)
+                    {
+                        const Uint32 j = m_HashAgents[h];
+                        if (j == i)
+                            continue;
+
+                        const float OffsetX = x - m_PosX[j];
+                        const float OffsetZ = z - m_PosZ[j];
+                        const float Dist2   = OffsetX * OffsetX + OffsetZ * OffsetZ;
+                        if (Dist2 >= Radius * Radius)
+                            continue;
+
+                        // The push grows linearly from zero at the separation radius. Agents at the
+                        // same position are pushed apart in opposite directions.
+                        ++NumNeighbors;
+                        if (Dist2 > 1e-8f)
+                        {
+                            const float Dist = std::sqrt(Dist2);
+                            const float Push = (1.0f - Dist / Radius) / Dist;
+                            SepX += OffsetX * Push;
+                            SepZ += OffsetZ * Push;
+                        }
+                        else
+                        {
+                            SepX += i < j ? 1.0f : -1.0f;
+                        }
+                    }
+                }
+            }
+        }
+        DesiredX += SepX * m_CI.Speed * m_CI.SeparationWeight;
+        DesiredZ += SepZ * m_CI.Speed * m_CI.SeparationWeight;
+
+        const float Desired2 = DesiredX * DesiredX + DesiredZ * DesiredZ;
+        if (Desired2 > MaxSpeed2)
+        {
+            const float Scale = m_CI.Speed / std::sqrt(Desired2);
+            DesiredX *= Scale;
+            DesiredZ *= Scale;
+        }
+
+        const float Blend = std::min(m_CI.Acceleration * m_LodElapsed[i], 1.0f);
+        m_VelX[i] += (DesiredX - m_VelX[i]) * Blend;
+        m_VelZ[i] += (DesiredZ - m_VelZ[i]) * Blend;
+        m_State[i]      = State;
+        m_SeesPlayer[i] = SeesPlayer ? 1 : 0;
+    }
+}
+
+void MazeCrowd::MoveAgents(const MazeFlowField& Field, const Uint32* pAgents, Uint32 Count)
+{
+    const MazeLevel& Level = *m_CI.pLevel;
+    const auto       IsBlocked = [&](float x, float z) { return Field.IsBlocked(Level.GetCellAt(float3{x, 0, z})); };
+
+    for (Uint32 a = 0; a < Count; ++a)
+    {
+        const Uint32 i  = pAgents[a];
+        const float  x  = m_PosX[i];
+        const float  z  = m_PosZ[i];
+        const float  dt = m_LodElapsed[i];
+
+        // Agents slide along the walls of the window. An agent that is already in a wall,
+        // e.g. spawned there, may walk out of it.
+        float NewX = x + m_VelX[i] * dt;
+        float NewZ = z + m_VelZ[i] * dt;
+        if (IsBlocked(NewX, NewZ) && !IsBlocked(x, z))
+        {
+            if (!IsBlocked(NewX, z))
+                NewZ = z;
+            else if (!IsBlocked(x, NewZ))
+                NewX = x;
+            else
+            {
+                NewX = x;
+                NewZ = z;
+            }
+        }
+        m_PosX[i] = NewX;
+        m_PosZ[i] = NewZ;
+
+        // Agents face the direction they move in
+        if (m_VelX[i] * m_VelX[i] + m_VelZ[i] * m_VelZ[i] > 0.01f)
+            m_Yaw[i] = std::atan2(m_VelX[i], m_VelZ[i]);
+    }
+}
+
+void MazeCrowd::Update(const MazeFlowField& Field, const float3& PlayerPos, float dt, UpdateStats& Stats)
+{
+    Stats = {};
+
+    const Uint32 NumAgents = GetNumAgents();
+    if (NumAgents == 0)
+        return;
+
+    // Agents that are not updated in this tick stay where they are between the ticks
+    ParallelFor(NumAgents, [&](Uint32 Begin, Uint32 End) {
+        for (Uint32 i = Begin; i < End; ++i)
+        {
+            m_PrevPosX[i] = m_PosX[i];
+            m_PrevPosZ[i] = m_PosZ[i];
+            m_PrevYaw[i]  = m_Yaw[i];
+            m_Cell[i]     = m_CI.pLevel->GetCellAt(float3{m_PosX[i], 0, m_PosZ[i]});
+        }
+    });
+
+    m_Lod.Schedule(m_CI.pLevel->GetCellAt(PlayerPos), dt, NumAgents, m_Cell.data(), m_LodPending.data(), m_LodElapsed.data(), Stats.Lod);
+    const std::vector<Uint32>& Scheduled = m_Lod.GetScheduled();
+
+    // All agents are hashed since the scheduled ones steer away from the others
+    BuildSpatialHash();
+    ParallelFor(static_cast<Uint32>(Scheduled.size()), [&](Uint32 Begin, Uint32 End) {
+        SteerAgents(Field, PlayerPos, Scheduled.data() + Begin, End - Begin);
+    });
+    ParallelFor(static_cast<Uint32>(Scheduled.size()), [&](Uint32 Begin, Uint32 End) {
+        MoveAgents(Field, Scheduled.data() + Begin, End - Begin);
+    });
+
+    for (Uint32 i = 0; i < NumAgents; ++i)
+    {
+        Stats.NumSeeing += m_SeesPlayer[i];
+        switch (m_State[i])
+        {
+            case MAZE_CROWD_STATE_ATTACKING: ++Stats.NumAttacking; break;
+            case MAZE_CROWD_STATE_ON_PATH:
+                if (Stats.NumLost + Stats.NumOnPath++ == 0)
+                    Stats.RouteCell = m_CI.pLevel->GetCellAt(GetAgentPos(i));
+                break;
+            case MAZE_CROWD_STATE_LOST:
+                if (Stats.NumLost++ == 0)
+                    Stats.RouteCell = m_CI.pLevel->GetCellAt(GetAgentPos(i));
+                break;
+            default: break;
+        }
+    }
+}
+
+float4x4 MazeCrowd::GetAgentTransform(Uint32 Agent, float Alpha) const
+{
+    // Turn along the shorter arc
+    float YawDelta = m_Yaw[Agent] - m_PrevYaw[Agent];
+    if (YawDelta > PI_F)
+        YawDelta -= 2 * PI_F;
+    else if (YawDelta < -PI_F)
+        YawDelta += 2 * PI_F;
+
+    const float x = lerp(m_PrevPosX[Agent], m_PosX[Agent], Alpha);
+    const float z = lerp(m_PrevPosZ[Agent], m_PosZ[Agent], Alpha);
+    return float4x4::RotationY(m_PrevYaw[Agent] + YawDelta * Alpha) * float4x4::Translation(x, m_CI.Height, z);
+}
+
+void MazeCrowd::RunBenchmark(const MazeLevel& Level, const MazeGenerator& Generator, Uint32 NumAgents)
+{
+    if (!Generator.IsInitialized() || NumAgents == 0)
+        return;
+
+    // All doors stay closed
+    MazeFlowField::CreateInfo FieldCI;
+    FieldCI.pLevel     = &Level;
+    FieldCI.pGenerator = &Generator;
+
+    MazeFlowField Field;
+    Field.Initialize(FieldCI);
+    Field.SetTarget(MazeGenerator::GetSpawnCell());
+
+    MazeRayCaster::CreateInfo CasterCI;
+    CasterCI.pLevel = &Level;
+    CasterCI.pField = &Field;
+
+    MazeRayCaster Caster;
+    Caster.Initialize(CasterCI);
+
+    std::vector<int2> Cells;
+    Field.GetReachableCells(8, Cells);
+    if (Cells.empty())
+    {
+        LOG_ERROR_MESSAGE("Crowd benchmark: no reachable cells around the spawn cell");
+        return;
+    }
+
+    // Agents start in random reachable cells and converge on the player, so the
+    // separation gets more expensive as the crowd gets denser
+    std::mt19937                          Rng{1234u};
+    std::uniform_real_distribution<float> RandJitter{-0.3f, 0.3f};
+    std::vector<float3>                   StartPos(NumAgents);
+    for (float3& Pos : StartPos)
+    {
+        const int2 Cell = Cells[Rng() % Cells.size()];
+        Pos             = Level.GetCellCenter(Cell.x, Cell.y) + float3{RandJitter(Rng), 0, RandJitter(Rng)} * Level.GetCellSize();
+    }
+    const int2   SpawnCell = MazeGenerator::GetSpawnCell();
+    const float3 PlayerPos = Level.GetCellCenter(SpawnCell.x, SpawnCell.y);
+
+    struct Object
+    {
+        float4x4 ModelMat;
+        float4x4 NormalMat;
+    };
+    std::vector<Object> Objects(NumAgents);
+
+    constexpr Uint32 NumTicks = 300;
+    constexpr float  TickTime = 1.0f / 60.0f;
+
+    // Every thread count runs once with all agents at full rate and once with the default
+    // simulation level of detail
+    const Uint32 MaxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::string  Report;
+    for (bool UseLod : {false, true})
+    {
+        std::vector<float> ReferencePos;
+        for (Uint32 NumThreads : {1u, MaxThreads})
+        {
+            if (NumThreads == 1 && !ReferencePos.empty())
+                break;
+
+            JobSystem::CreateInfo JobsCI;
+            JobsCI.NumWorkerThreads = NumThreads - 1;
+            JobSystem Jobs;
+            Jobs.Initialize(JobsCI);
+
+            CreateInfo CI;
+            CI.pLevel     = &Level;
+            CI.pRayCaster = &Caster;
+            CI.pJobs      = &Jobs;
+            if (!UseLod)
+            {
+                for (int& Distance : CI.Lod.TierDistances)
+                    Distance = std::numeric_limits<int>::max();
+            }
+
+            MazeCrowd Crowd;
+            Crowd.Initialize(CI);
+            for (const float3& Pos : StartPos)
+                Crowd.AddAgent(Pos);
+
+            UpdateStats              Stats;
+            MazeSimulationLod::Stats LodStats;
+            double                   UpdateTime = 0, WriteTime = 0;
+            for (Uint32 Tick = 0; Tick < NumTicks; ++Tick)
+            {
+                Timer UpdateTimer;
+                Crowd.Update(Field, PlayerPos, TickTime, Stats);
+                UpdateTime += UpdateTimer.GetElapsedTime();
+                LodStats += Stats.Lod;
+
+                Timer WriteTimer;
+                Crowd.WriteTransforms(Objects.data(), 1.0f);
+                WriteTime += WriteTimer.GetElapsedTime();
+            }
+
+            // Agents only write their own state, so the thread count must not change the result
+            std::vector<float> FinalPos;
+            for (Uint32 i = 0; i < NumAgents; ++i)
+            {
+                FinalPos.push_back(Crowd.m_PosX[i]);
+                FinalPos.push_back(Crowd.m_PosZ[i]);
+            }
+            if (ReferencePos.empty())
+                ReferencePos = std::move(FinalPos);
+            else if (FinalPos != ReferencePos)
+                LOG_ERROR_MESSAGE("Crowd benchmark: agents simulated on ", NumThreads, " threads do not match the single-threaded simulation");
+
+            Uint32 NumUpdates = 0;
+            for (Uint32 Updated : LodStats.NumUpdated)
+                NumUpdates += Updated;
+            Report += "\n  " + std::string{UseLod ? "LOD, " : "full rate, "} + std::to_string(NumThreads) + (NumThreads == 1 ? " thread: " : " threads: ") +
+                std::to_string(static_cast<double>(NumAgents) * NumTicks / UpdateTime / 1e6) + "M agents simulated/s (" +
+                std::to_string(static_cast<double>(NumUpdates) / NumAgents / NumTicks * 100.0) + "% updated per tick), " +
+                std::to_string(UpdateTime * 1000.0 / NumTicks) + " ms per tick, transforms " + std::to_string(WriteTime * 1000.0 / NumTicks) +
+                " ms per frame; " + std::to_string(Stats.NumSeeing) + " agents see the player, " + std::to_string(Stats.NumAttacking) + " attack";
+        }
+    }
+    LOG_INFO_MESSAGE("Crowd benchmark (", NumAgents, " agents, ", NumTicks, " ticks):", Report);
+}
+
+} // namespace Diligent
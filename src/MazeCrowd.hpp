@@ -0,0 +1,192 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "JobSystem.hpp"
+#include "MazeFlowField.hpp"
+#include "MazeRayCaster.hpp"
+#include "MazeSimulationLod.hpp"
+
+namespace Diligent
+{
+
+enum MAZE_CROWD_STATE : Uint8
+{
+    MAZE_CROWD_STATE_CHASING = 0, // Follows the flow field, or heads straight for the player in sight
+    MAZE_CROWD_STATE_ON_PATH,     // Outside of the flow field, follows the planned path
+    MAZE_CROWD_STATE_LOST,        // Has no route and heads straight for the player
+    MAZE_CROWD_STATE_ATTACKING,   // Within attack range of the player
+};
+
+// Monsters that chase the player. Agents are stored as arrays of their components, and
+// every tick runs two passes over them on the threads of a job system: the steering pass reads
+// the positions of the neighbors found in a spatial hash and writes the velocities, and the
+// move pass integrates the velocities. Agents only write their own elements, so the result
+// does not depend on the number of threads.
+//
+// Agents that see the player head straight for them; the others walk to the center of the next
+// flow field cell. Agents outside of the field follow the path given to SetPath(), and the rest
+// head straight for the player. Only agents that see the player attack.
+//
+// Agents far from the player are updated at reduced rates, see MazeSimulationLod, and do not
+// steer away from their neighbors.
+class MazeCrowd
+{
+public:
+    struct CreateInfo
+    {
+        const MazeLevel*     pLevel     = nullptr;
+        const MazeRayCaster* pRayCaster = nullptr; // Tests whether agents see the player. If null, all agents in range attack.
+
+        // Runs the passes over the agents on its threads; if null, the crowd runs on the calling thread
+        JobSystem* pJobs = nullptr;
+
+        float  Height           = 3.0f; // World-space height of the agents
+        float  Speed            = 3.0f;
+        float  Acceleration     = 8.0f; // Fraction of the velocity change applied per second
+        float  SeparationRadius = 1.0f; // Agents closer than this push each other apart
+        float  SeparationWeight = 1.5f;
+        float  StopDistance     = 1.5f; // Agents do not get closer to the player
+        float  AttackRange      = 2.0f;
+        float  PerceptionRange  = 30.0f;
+        Uint32 MaxNeighbors     = 16; // Neighbors considered for separation
+
+        MazeSimulationLod::CreateInfo Lod;
+    };
+
+    struct UpdateStats
+    {
+        Uint32 NumAttacking = 0;
+        Uint32 NumSeeing    = 0; // Agents that see the player, including the attacking ones
+        Uint32 NumOnPath    = 0;
+        Uint32 NumLost      = 0;
+        int2   RouteCell; // Cell of the first lost agent, or of the first agent on the path if none is lost
+
+        MazeSimulationLod::Stats Lod;
+    };
+
+    MazeCrowd() = default;
+    ~MazeCrowd();
+
+    // clang-format off
+    MazeCrowd           (const MazeCrowd&) = delete;
+    MazeCrowd& operator=(const MazeCrowd&) = delete;
+    MazeCrowd           (MazeCrowd&&)      = delete;
+    MazeCrowd& operator=(MazeCrowd&&)      = delete;
+    // clang-format on
+
+    void Initialize(const CreateInfo& CI);
+    void Stop();
+
+    // Returns the index of the new agent
+    Uint32 AddAgent(const float3& Pos);
+    Uint32 GetNumAgents() const { return static_cast<Uint32>(m_PosX.size()); }
+
+    // Replaces the path that agents outside of the flow field follow
+    void SetPath(const std::vector<int2>& Cells);
+
+    // Advances the agents by one tick toward the player at the target of the flow field
+    void Update(const MazeFlowField& Field, const float3& PlayerPos, float dt, UpdateStats& Stats);
+
+    float3 GetAgentPos(Uint32 Agent) const { return float3{m_PosX[Agent], m_CI.Height, m_PosZ[Agent]}; }
+    MAZE_CROWD_STATE GetAgentState(Uint32 Agent) const { return static_cast<MAZE_CROWD_STATE>(m_State[Agent]); }
+
+    // Agent transform between the states before and after the last tick
+    float4x4 GetAgentTransform(Uint32 Agent, float Alpha) const;
+
+    // Writes the transposed transforms of all agents to the ModelMat and NormalMat members of
+    // consecutive objects, in parallel
+    template <typename ObjectType>
+    void WriteTransforms(ObjectType* pObjects, float Alpha)
+    {
+        ParallelFor(GetNumAgents(), [&](Uint32 Begin, Uint32 End) {
+            for (Uint32 i = Begin; i < End; ++i)
+            {
+                pObjects[i].ModelMat  = GetAgentTransform(i, Alpha).Transpose();
+                pObjects[i].NormalMat = pObjects[i].ModelMat;
+            }
+        });
+    }
+
+    // Simulates crowds of NumAgents agents on a generated world with one thread and with all
+    // threads, checks that the results match and logs the agent updates per second.
+    static void RunBenchmark(const MazeLevel& Level, const MazeGenerator& Generator, Uint32 NumAgents);
+
+private:
+    using RangeFunc = JobSystem::RangeFunc;
+
+    // Splits [0, Count) into batches that run on the threads of the job system, and returns
+    // when all of them are done
+    void ParallelFor(Uint32 Count, const RangeFunc& Func);
+
+    void BuildSpatialHash();
+    // Both passes process the agents pAgents[0] ... pAgents[Count - 1]
+    void SteerAgents(const MazeFlowField& Field, const float3& PlayerPos, const Uint32* pAgents, Uint32 Count);
+    void MoveAgents(const MazeFlowField& Field, const Uint32* pAgents, Uint32 Count);
+
+    int2   GetHashCell(float x, float z) const;
+    Uint32 GetHashBucket(const int2& HashCell) const;
+
+    static constexpr Uint32 BatchSize = 256;
+
+    CreateInfo m_CI;
+
+    // Agent components
+    std::vector<float> m_PosX;
+    std::vector<float> m_PosZ;
+    std::vector<float> m_VelX;
+    std::vector<float> m_VelZ;
+    std::vector<float> m_Yaw;
+    std::vector<Uint8> m_State;      // MAZE_CROWD_STATE
+    std::vector<Uint8> m_SeesPlayer; // Result of the last line-of-sight test
+    std::vector<int2>  m_Cell;       // Level cell at the start of the tick
+
+    // Simulation level of detail. m_LodElapsed is the time that the current tick simulates
+    // for every agent.
+    MazeSimulationLod  m_Lod;
+    std::vector<float> m_LodPending;
+    std::vector<float> m_LodElapsed;
+
+    // State before the last tick, for interpolation
+    std::vector<float> m_PrevPosX;
+    std::vector<float> m_PrevPosZ;
+    std::vector<float> m_PrevYaw;
+
+    // Spatial hash of cells twice the separation radius in size. The agents of bucket b are
+    // m_HashAgents[m_HashStart[b]] ... m_HashAgents[m_HashStart[b + 1] - 1].
+    std::vector<Uint32> m_HashStart;
+    std::vector<Uint32> m_HashAgents;
+    std::vector<Uint32> m_AgentBucket;
+
+    // Next cell on the planned path by packed cell coordinates, see PackMazeCoord()
+    std::unordered_map<Uint64, int2> m_PathNext;
+};
+
+} // namespace Diligent
@@ -0,0 +1,342 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeFlowField.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <unordered_set>
+
+#include "DebugUtilities.hpp"
+#include "Timer.hpp"
+#include "MazeChunk.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+int FloorDiv(int a, int b)
+{
+    return (a >= 0 ? a : a - b + 1) / b;
+}
+
+} // namespace
+
+const int2 MazeFlowField::NeighborDeltas[4] = {int2{1, 0}, int2{-1, 0}, int2{0, 1}, int2{0, -1}};
+
+void MazeFlowField::Initialize(const CreateInfo& CI)
+{
+    VERIFY_EXPR(CI.pLevel != nullptr && CI.WindowRadius > 0);
+
+    m_CI        = CI;
+    m_HasTarget = false;
+    m_Size      = int2{};
+    if (m_CI.pGenerator == nullptr)
+        SetWindow(int2{0, 0}, int2{m_CI.pLevel->GetCols(), m_CI.pLevel->GetRows()});
+}
+
+bool MazeFlowField::SetTarget(const int2& Cell)
+{
+    if (m_HasTarget && Cell == m_Target)
+        return false;
+
+    m_Target    = Cell;
+    m_HasTarget = true;
+
+    if (m_CI.pGenerator != nullptr)
+    {
+        // Keep at least half of the radius between the target and the border of the window
+        const int Radius = m_CI.WindowRadius;
+        const int Margin = Radius / 2;
+        if (m_Size.x == 0 ||
+            Cell.x < m_Origin.x + Margin || Cell.x >= m_Origin.x + m_Size.x - Margin ||
+            Cell.y < m_Origin.y + Margin || Cell.y >= m_Origin.y + m_Size.y - Margin)
+        {
+            SetWindow(Cell - int2{Radius, Radius}, int2{2 * Radius + 1, 2 * Radius + 1});
+        }
+    }
+
+    ComputeField();
+    return true;
+}
+
+void MazeFlowField::SetWindow(const int2& Origin, const int2& Size)
+{
+    m_Origin = Origin;
+    m_Size   = Size;
+    m_Stride = Size.x + 2;
+
+    const size_t NumCells = static_cast<size_t>(m_Stride) * static_cast<size_t>(Size.y + 2);
+    m_Open.assign(NumCells, 0);
+    m_Distance.assign(NumCells, InvalidDistance);
+    m_Direction.assign(NumCells, 0);
+    m_Queue.resize(NumCells);
+    m_ClosedDoors.clear();
+
+    const MazeLevel& Level = *m_CI.pLevel;
+
+    // x and z are relative to the window origin
+    const auto SetCell = [&](int x, int z, Uint8 BlockType) {
+        const Uint32 Idx  = static_cast<Uint32>((z + 1) * m_Stride + x + 1);
+        const Uint8  Kind = Level.GetBlockType(BlockType).Kind;
+        if (Kind == MAZE_BLOCK_KIND_WALL)
+            return;
+        if (Kind == MAZE_BLOCK_KIND_DOOR)
+        {
+            const int2 Cell = m_Origin + int2{x, z};
+            if (!m_CI.IsDoorOpen || !m_CI.IsDoorOpen(Cell, BlockType))
+            {
+                m_ClosedDoors.push_back({Idx, Cell, BlockType});
+                return;
+            }
+        }
+        m_Open[Idx] = 1;
+    };
+
+    if (m_CI.pGenerator != nullptr)
+    {
+        // Generate every chunk that overlaps the window
+        const int          ChunkSize = m_CI.pGenerator->GetChunkSize();
+        std::vector<Uint8> Cells(static_cast<size_t>(ChunkSize) * static_cast<size_t>(ChunkSize));
+
+        const int2 FirstChunk{FloorDiv(Origin.x, ChunkSize), FloorDiv(Origin.y, ChunkSize)};
+        const int2 LastChunk{FloorDiv(Origin.x + Size.x - 1, ChunkSize), FloorDiv(Origin.y + Size.y - 1, ChunkSize)};
+        for (int cz = FirstChunk.y; cz <= LastChunk.y; ++cz)
+        {
+            for (int cx = FirstChunk.x; cx <= LastChunk.x; ++cx)
+            {
+                m_CI.pGenerator->GenerateChunk(int2{cx, cz}, Cells.data());
+
+                // Part of the chunk inside the window, relative to the chunk
+                const int2 Start{cx * ChunkSize - Origin.x, cz * ChunkSize - Origin.y};
+                const int2 Min{std::max(0, -Start.x), std::max(0, -Start.y)};
+                const int2 Max{std::min(ChunkSize, Size.x - Start.x), std::min(ChunkSize, Size.y - Start.y)};
+                for (int z = Min.y; z < Max.y; ++z)
+                {
+                    for (int x = Min.x; x < Max.x; ++x)
+                        SetCell(Start.x + x, Start.y + z, Cells[static_cast<size_t>(z) * ChunkSize + x]);
+                }
+            }
+        }
+    }
+    else
+    {
+        for (int z = 0; z < Size.y; ++z)
+        {
+            for (int x = 0; x < Size.x; ++x)
+                SetCell(x, z, Level.GetCell(Origin.x + x, Origin.y + z));
+        }
+    }
+}
+
+void MazeFlowField::ComputeField()
+{
+    // Blocked cells are never visited, which saves the test of m_Open in the loop below
+    for (size_t i = 0; i < m_Distance.size(); ++i)
+        m_Distance[i] = m_Open[i] ? InvalidDistance : BlockedDistance;
+
+    // The field is empty if the target left the level
+    const Uint32 TargetIdx = GetIndex(m_Target);
+    if (TargetIdx == ~0u)
+        return;
+
+    const int Offsets[4] = {1, -1, m_Stride, -m_Stride};
+
+    // The target itself is the seed even if it is blocked, e.g. when the player clips into a wall
+    m_Distance[TargetIdx] = 0;
+    size_t Head = 0, Tail = 0;
+    m_Queue[Tail++] = TargetIdx;
+    while (Head < Tail)
+    {
+        const Uint32 Idx      = m_Queue[Head++];
+        const Uint32 NextDist = m_Distance[Idx] + 1;
+        for (Uint8 d = 0; d < 4; ++d)
+        {
+            const Uint32 Neighbor = static_cast<Uint32>(static_cast<int>(Idx) + Offsets[d]);
+            if (m_Distance[Neighbor] == InvalidDistance)
+            {
+                m_Distance[Neighbor]  = NextDist;
+                m_Direction[Neighbor] = d ^ 1u; // Back toward Idx
+                m_Queue[Tail++]       = Neighbor;
+            }
+        }
+    }
+}
+
+void MazeFlowField::LowerDistances(Uint32 SeedIdx)
+{
+    const int Offsets[4] = {1, -1, m_Stride, -m_Stride};
+
+    // The opened cell is reached through its closest neighbor
+    Uint32 Best    = InvalidDistance;
+    Uint8  BestDir = 0;
+    for (Uint8 d = 0; d < 4; ++d)
+    {
+        const Uint32 Dist = m_Distance[static_cast<Uint32>(static_cast<int>(SeedIdx) + Offsets[d])];
+        if (Dist < BlockedDistance && Dist + 1 < Best)
+        {
+            Best    = Dist + 1;
+            BestDir = d;
+        }
+    }
+    if (Best >= m_Distance[SeedIdx])
+        return;
+
+    m_Distance[SeedIdx]  = Best;
+    m_Direction[SeedIdx] = BestDir;
+
+    // Distances only decrease, and a wave from a single seed reaches every cell
+    // first on its shortest path, so every lowered cell is queued once.
+    size_t Head = 0, Tail = 0;
+    m_Queue[Tail++] = SeedIdx;
+    while (Head < Tail)
+    {
+        const Uint32 Idx      = m_Queue[Head++];
+        const Uint32 NextDist = m_Distance[Idx] + 1;
+        for (Uint8 d = 0; d < 4; ++d)
+        {
+            const Uint32 Neighbor = static_cast<Uint32>(static_cast<int>(Idx) + Offsets[d]);
+            if (m_Open[Neighbor] && NextDist < m_Distance[Neighbor])
+            {
+                m_Distance[Neighbor]  = NextDist;
+                m_Direction[Neighbor] = d ^ 1u;
+                m_Queue[Tail++]       = Neighbor;
+            }
+        }
+    }
+}
+
+Uint32 MazeFlowField::UpdateDoors()
+{
+    if (!m_CI.IsDoorOpen)
+        return 0;
+
+    // Cells of a merged door are opened one by one; the field is exact after every cell
+    Uint32 NumOpened = 0;
+    for (size_t i = 0; i < m_ClosedDoors.size();)
+    {
+        const DoorCell Door = m_ClosedDoors[i];
+        if (!m_CI.IsDoorOpen(Door.Cell, Door.BlockType))
+        {
+            ++i;
+            continue;
+        }
+
+        m_ClosedDoors[i] = m_ClosedDoors.back();
+        m_ClosedDoors.pop_back();
+
+        m_Open[Door.Idx] = 1;
+        if (m_Distance[Door.Idx] == BlockedDistance)
+            m_Distance[Door.Idx] = InvalidDistance;
+        if (m_HasTarget)
+            LowerDistances(Door.Idx);
+        ++NumOpened;
+    }
+    return NumOpened;
+}
+
+void MazeFlowField::GetReachableCells(Uint32 MinDistance, std::vector<int2>& Cells) const
+{
+    for (int z = 0; z < m_Size.y; ++z)
+    {
+        for (int x = 0; x < m_Size.x; ++x)
+        {
+            const Uint32 Dist = m_Distance[static_cast<size_t>(z + 1) * m_Stride + x + 1];
+            if (Dist >= MinDistance && Dist < BlockedDistance)
+                Cells.push_back(m_Origin + int2{x, z});
+        }
+    }
+}
+
+void MazeFlowField::RunBenchmark(const MazeLevel& Level, const MazeGenerator& Generator, Uint32 NumUpdates)
+{
+    if (!Generator.IsInitialized() || NumUpdates == 0)
+        return;
+
+    std::string Report;
+    for (int Radius : {64, 256, 1024})
+    {
+        std::unordered_set<Uint64> OpenDoors;
+
+        CreateInfo CI;
+        CI.pLevel       = &Level;
+        CI.pGenerator   = &Generator;
+        CI.WindowRadius = Radius;
+        CI.IsDoorOpen   = [&OpenDoors](const int2& Cell, Uint8) { return OpenDoors.count(PackMazeCoord(Cell)) != 0; };
+
+        MazeFlowField Field;
+        Field.Initialize(CI);
+
+        Timer WindowTimer;
+        Field.SetTarget(MazeGenerator::GetSpawnCell());
+        const double WindowTime = WindowTimer.GetElapsedTime();
+
+        // Open targets that do not move the window
+        std::mt19937                       Rng{1234u};
+        std::uniform_int_distribution<int> RandOffset{-Radius / 2 + 1, Radius / 2 - 1};
+        std::vector<int2>                  Targets;
+        while (Targets.size() < NumUpdates)
+        {
+            const int2 Cell = MazeGenerator::GetSpawnCell() + int2{RandOffset(Rng), RandOffset(Rng)};
+            if (Field.m_Open[Field.GetIndex(Cell)] && (Targets.empty() || Targets.back() != Cell))
+                Targets.push_back(Cell);
+        }
+
+        Timer FullTimer;
+        for (const int2& Cell : Targets)
+            Field.SetTarget(Cell);
+        const double FullTime = FullTimer.GetElapsedTime();
+
+        // Open the doors one at a time in random order
+        std::vector<DoorCell> Doors = Field.m_ClosedDoors;
+        std::shuffle(Doors.begin(), Doors.end(), Rng);
+        Doors.resize(std::min(Doors.size(), size_t{NumUpdates}));
+
+        double DoorTime = 0;
+        for (const DoorCell& Door : Doors)
+        {
+            OpenDoors.insert(PackMazeCoord(Door.Cell));
+            Timer DoorTimer;
+            Field.UpdateDoors();
+            DoorTime += DoorTimer.GetElapsedTime();
+        }
+
+        const std::vector<Uint32> IncrementalDistance = Field.m_Distance;
+        Field.ComputeField();
+        if (IncrementalDistance != Field.m_Distance)
+            LOG_ERROR_MESSAGE("Flow field with ", Doors.size(), " incrementally opened doors does not match the full update in a ", Field.m_Size.x, "x", Field.m_Size.y, " window");
+
+        Report += "\n  " + std::to_string(Field.m_Size.x) + "x" + std::to_string(Field.m_Size.y) + " cells: window build " +
+            std::to_string(WindowTime * 1000.0) + " ms, full update " + std::to_string(FullTime * 1e6 / Targets.size()) + " us, door update " +
+            std::to_string(DoorTime * 1e6 / std::max(Doors.size(), size_t{1})) + " us (" + std::to_string(Doors.size()) + " doors)";
+    }
+    LOG_INFO_MESSAGE("Flow field benchmark (", NumUpdates, " updates):", Report);
+}
+
+} // namespace Diligent
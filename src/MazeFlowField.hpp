@@ -0,0 +1,150 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "MazeLevel.hpp"
+#include "MazeGenerator.hpp"
+
+namespace Diligent
+{
+
+// Breadth-first flow field toward a target cell, usually the player's. Every reachable cell
+// stores its distance to the target and the neighbor that is one step closer, so any number
+// of agents steer with a constant-time lookup instead of searching for a path.
+//
+// The field covers a window of cells: the whole level, or in a generated world a square of
+// (2 * WindowRadius + 1) cells that is moved when the target gets close to its border.
+// Walls are blocked; doors are blocked until IsDoorOpen reports them open.
+class MazeFlowField
+{
+public:
+    static constexpr Uint32 InvalidDistance = ~0u;
+
+    struct CreateInfo
+    {
+        const MazeLevel*     pLevel     = nullptr;
+        const MazeGenerator* pGenerator = nullptr; // If not null, cells are generated instead of read from the level
+
+        int WindowRadius = 64; // Generated worlds only
+
+        // Returns true if the door with the given block type in the given cell is open
+        std::function<bool(const int2& Cell, Uint8 BlockType)> IsDoorOpen;
+    };
+    void Initialize(const CreateInfo& CI);
+
+    // Recomputes the field if the target cell has changed. Returns true if the field was updated.
+    bool SetTarget(const int2& Cell);
+
+    // Opens the door cells of the window that IsDoorOpen now reports as open and lowers the
+    // distances of the cells that got closer to the target. Only these cells are visited.
+    // Returns the number of opened cells.
+    Uint32 UpdateDoors();
+
+    // Distance to the target in cells, or InvalidDistance if the cell is unreachable or outside of the window
+    Uint32 GetDistance(const int2& Cell) const
+    {
+        const Uint32 Idx = GetIndex(Cell);
+        return Idx != ~0u && m_Distance[Idx] < BlockedDistance ? m_Distance[Idx] : InvalidDistance;
+    }
+
+    // Returns the neighbor of the cell that is one step closer to the target.
+    // Returns false if the cell is the target, is unreachable or is outside of the window.
+    bool GetNextCell(const int2& Cell, int2& Next) const
+    {
+        const Uint32 Idx = GetIndex(Cell);
+        if (Idx == ~0u || m_Distance[Idx] == 0 || m_Distance[Idx] >= BlockedDistance)
+            return false;
+        Next = Cell + NeighborDeltas[m_Direction[Idx]];
+        return true;
+    }
+
+    bool IsInWindow(const int2& Cell) const { return GetIndex(Cell) != ~0u; }
+
+    // Returns true if the cell is a wall or a closed door inside of the window.
+    // Cells outside of the window are unknown and never blocked.
+    bool IsBlocked(const int2& Cell) const
+    {
+        const Uint32 Idx = GetIndex(Cell);
+        return Idx != ~0u && !m_Open[Idx];
+    }
+
+    // Appends the cells that are at least MinDistance steps away from the target and reachable from it
+    void GetReachableCells(Uint32 MinDistance, std::vector<int2>& Cells) const;
+
+    const int2& GetTarget() const { return m_Target; }
+
+    // Measures full field updates and incremental door updates on generated windows of
+    // increasing size, checks the incremental results against full updates and logs the times.
+    static void RunBenchmark(const MazeLevel& Level, const MazeGenerator& Generator, Uint32 NumUpdates);
+
+private:
+    // Index of the cell in the padded window, or ~0u if the cell is outside of the window
+    Uint32 GetIndex(const int2& Cell) const
+    {
+        const int x = Cell.x - m_Origin.x;
+        const int z = Cell.y - m_Origin.y;
+        if (x < 0 || z < 0 || x >= m_Size.x || z >= m_Size.y)
+            return ~0u;
+        return static_cast<Uint32>((z + 1) * m_Stride + x + 1);
+    }
+
+    void SetWindow(const int2& Origin, const int2& Size);
+    void ComputeField();
+    void LowerDistances(Uint32 SeedIdx);
+
+    static const int2 NeighborDeltas[4];
+
+    // Distance of blocked cells, except for a blocked target
+    static constexpr Uint32 BlockedDistance = InvalidDistance - 1;
+
+    CreateInfo m_CI;
+
+    int2 m_Origin;
+    int2 m_Size;
+    int  m_Stride = 0; // Window width plus one blocked cell on each side
+    int2 m_Target;
+    bool m_HasTarget = false;
+
+    // Padded window, row by row. Border cells are always blocked, so neighbors are never out of range.
+    std::vector<Uint8>  m_Open;
+    std::vector<Uint32> m_Distance;
+    std::vector<Uint8>  m_Direction; // Index in NeighborDeltas of the next cell toward the target
+    std::vector<Uint32> m_Queue;
+
+    struct DoorCell
+    {
+        Uint32 Idx;
+        int2   Cell;
+        Uint8  BlockType;
+    };
+    std::vector<DoorCell> m_ClosedDoors;
+};
+
+} // namespace Diligent
@@ -0,0 +1,336 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeGenerator.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "DebugUtilities.hpp"
+#include "Timer.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+// SplitMix64 step; used both to mix the seed with chunk coordinates and as a random generator
+Uint64 SplitMix64(Uint64& State)
+{
+    Uint64 z = (State += 0x9E3779B97F4A7C15ull);
+    z        = (z ^ (z >> 30u)) * 0xBF58476D1CE4E5B9ull;
+    z        = (z ^ (z >> 27u)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31u);
+}
+
+// Random sequence that only depends on the seed, the chunk and the stream
+class ChunkRandom
+{
+public:
+    ChunkRandom(Uint32 Seed, const int2& Coord, Uint32 Stream) :
+        m_State{(Uint64{Seed} << 32u) | Stream}
+    {
+        m_State ^= SplitMix64(m_State) + static_cast<Uint32>(Coord.x);
+        m_State ^= SplitMix64(m_State) + static_cast<Uint32>(Coord.y);
+    }
+
+    // Uniformly distributed integer in [0, Range)
+    Uint32 Next(Uint32 Range)
+    {
+        return static_cast<Uint32>(((SplitMix64(m_State) >> 32u) * Range) >> 32u);
+    }
+
+    // Uniformly distributed float in [0, 1)
+    float NextFloat()
+    {
+        return static_cast<float>(SplitMix64(m_State) >> 40u) * (1.f / 16777216.f);
+    }
+
+private:
+    Uint64 m_State;
+};
+
+enum CHUNK_RANDOM_STREAM : Uint32
+{
+    CHUNK_RANDOM_STREAM_WEST_BORDER = 0,
+    CHUNK_RANDOM_STREAM_NORTH_BORDER,
+    CHUNK_RANDOM_STREAM_MAZE
+};
+
+} // namespace
+
+bool MazeGenerator::Initialize(const MazeLevel& Level, const CreateInfo& CI)
+{
+    m_pLevel = nullptr;
+    m_KeyDoorPairs.clear();
+
+    // Node masks of the chunk borders are stored in 32-bit integers
+    if (CI.ChunkSize < 2 || CI.ChunkSize % 2 != 0 || CI.ChunkSize > 64)
+    {
+        LOG_ERROR_MESSAGE("Procedural chunk size (", CI.ChunkSize, ") must be an even number between 2 and 64");
+        return false;
+    }
+
+    if (CI.WallBlockType >= Level.GetNumBlockTypes() || Level.GetBlockType(CI.WallBlockType).Kind != MAZE_BLOCK_KIND_WALL)
+    {
+        LOG_ERROR_MESSAGE("Block type ", Uint32{CI.WallBlockType}, " is not a wall and can't be used by the maze generator");
+        return false;
+    }
+
+    bool FoundEmpty = false;
+    for (Uint32 t = 0; t < Level.GetNumBlockTypes() && !FoundEmpty; ++t)
+    {
+        if (Level.GetBlockType(t).Kind == MAZE_BLOCK_KIND_EMPTY)
+        {
+            m_EmptyBlockType = static_cast<Uint8>(t);
+            FoundEmpty       = true;
+        }
+    }
+    if (!FoundEmpty)
+    {
+        LOG_ERROR_MESSAGE("The level has no empty block type that the maze generator could use for corridors");
+        return false;
+    }
+
+    // Bindings are validated by the level
+    for (Uint32 b = 0; b < Level.GetNumKeyDoorBindings(); ++b)
+    {
+        const MazeKeyDoorBinding& Binding = Level.GetKeyDoorBinding(b);
+        m_KeyDoorPairs.push_back({static_cast<Uint8>(Binding.KeyBlockType), static_cast<Uint8>(Binding.DoorBlockType)});
+    }
+
+    m_pLevel = &Level;
+    m_CI     = CI;
+    return true;
+}
+
+Uint32 MazeGenerator::GetBorderOpenings(const int2& Coord, bool West) const
+{
+    const Uint32 NumNodes    = static_cast<Uint32>(m_CI.ChunkSize / 2);
+    const Uint32 NumOpenings = std::min(std::max(m_CI.NumBorderOpenings, 1u), NumNodes);
+
+    ChunkRandom Rng{m_CI.Seed, Coord, West ? CHUNK_RANDOM_STREAM_WEST_BORDER : CHUNK_RANDOM_STREAM_NORTH_BORDER};
+
+    Uint32 Mask = 0;
+    for (Uint32 i = 0; i < NumOpenings;)
+    {
+        const Uint32 Bit = 1u << Rng.Next(NumNodes);
+        if ((Mask & Bit) == 0)
+        {
+            Mask |= Bit;
+            ++i;
+        }
+    }
+    return Mask;
+}
+
+void MazeGenerator::GenerateChunk(const int2& Coord, Uint8* pCells) const
+{
+    VERIFY(IsInitialized(), "The generator is not initialized");
+
+    const int S = m_CI.ChunkSize;
+    const int n = S / 2; // Nodes along each axis
+
+    const auto Cell = [pCells, S](int x, int z) -> Uint8& {
+        return pCells[static_cast<size_t>(z) * static_cast<size_t>(S) + static_cast<size_t>(x)];
+    };
+
+    std::fill(pCells, pCells + static_cast<size_t>(S) * static_cast<size_t>(S), m_CI.WallBlockType);
+
+    ChunkRandom Rng{m_CI.Seed, Coord, CHUNK_RANDOM_STREAM_MAZE};
+
+    // Randomized Prim's algorithm over the nodes. Node (i, j) is at cell (2i + 1, 2j + 1);
+    // the wall between two adjacent nodes is at the cell between them.
+    struct Edge
+    {
+        int From;
+        int To;
+    };
+    std::vector<int>  Parent(static_cast<size_t>(n * n), -1);
+    std::vector<int>  Order; // Nodes in the order they were added; parents always come first
+    std::vector<bool> InMaze(static_cast<size_t>(n * n), false);
+    std::vector<Edge> Frontier;
+    Order.reserve(static_cast<size_t>(n * n));
+
+    const auto AddNode = [&](int Node, int From) {
+        InMaze[Node] = true;
+        Parent[Node] = From;
+        Order.push_back(Node);
+
+        const int i = Node % n;
+        const int j = Node / n;
+        Cell(2 * i + 1, 2 * j + 1) = m_EmptyBlockType;
+        if (From >= 0)
+            Cell(i + From % n + 1, j + From / n + 1) = m_EmptyBlockType;
+
+        if (i > 0) Frontier.push_back({Node, Node - 1});
+        if (i < n - 1) Frontier.push_back({Node, Node + 1});
+        if (j > 0) Frontier.push_back({Node, Node - n});
+        if (j < n - 1) Frontier.push_back({Node, Node + n});
+    };
+
+    const int Root = static_cast<int>(Rng.Next(static_cast<Uint32>(n * n)));
+    AddNode(Root, -1);
+    while (!Frontier.empty())
+    {
+        const size_t Idx = Rng.Next(static_cast<Uint32>(Frontier.size()));
+        const Edge   E   = Frontier[Idx];
+        Frontier[Idx]    = Frontier.back();
+        Frontier.pop_back();
+        if (!InMaze[E.To])
+            AddNode(E.To, E.From);
+    }
+
+    // Open the borders that the chunk owns and find the nodes that connect to the neighbors.
+    // The east and south openings belong to the neighbors but are known from their coordinates.
+    const Uint32 WestMask  = GetBorderOpenings(Coord, true);
+    const Uint32 NorthMask = GetBorderOpenings(Coord, false);
+    const Uint32 EastMask  = GetBorderOpenings(int2{Coord.x + 1, Coord.y}, true);
+    const Uint32 SouthMask = GetBorderOpenings(int2{Coord.x, Coord.y + 1}, false);
+
+    std::vector<bool> MustBeReachable(static_cast<size_t>(n * n), false);
+    for (int k = 0; k < n; ++k)
+    {
+        if (WestMask & (1u << k))
+        {
+            Cell(0, 2 * k + 1)     = m_EmptyBlockType;
+            MustBeReachable[k * n] = true;
+        }
+        if (NorthMask & (1u << k))
+        {
+            Cell(2 * k + 1, 0) = m_EmptyBlockType;
+            MustBeReachable[k] = true;
+        }
+        if (EastMask & (1u << k))
+            MustBeReachable[k * n + n - 1] = true;
+        if (SouthMask & (1u << k))
+            MustBeReachable[(n - 1) * n + k] = true;
+    }
+
+    // The player spawns in the first node of the origin chunk
+    if (Coord.x == 0 && Coord.y == 0)
+        MustBeReachable[0] = true;
+
+    if (m_KeyDoorPairs.empty() || Rng.NextFloat() >= m_CI.KeyDoorChance)
+        return;
+
+    // Lock a subtree that no border opening leads to, so that the rest of the chunk
+    // and the neighbors stay reachable without the key.
+    std::vector<Uint32> SubtreeSize(static_cast<size_t>(n * n), 1);
+    for (size_t k = Order.size() - 1; k > 0; --k)
+    {
+        const int Node = Order[k];
+        SubtreeSize[Parent[Node]] += SubtreeSize[Node];
+        if (MustBeReachable[Node])
+            MustBeReachable[Parent[Node]] = true;
+    }
+
+    std::vector<int> Candidates;
+    for (int Node : Order)
+    {
+        if (Node != Root && !MustBeReachable[Node] && SubtreeSize[Node] >= m_CI.MinLockedNodes && SubtreeSize[Node] <= m_CI.MaxLockedNodes)
+            Candidates.push_back(Node);
+    }
+    if (Candidates.empty())
+        return;
+
+    const int         Locked = Candidates[Rng.Next(static_cast<Uint32>(Candidates.size()))];
+    std::vector<bool> IsLocked(static_cast<size_t>(n * n), false);
+    IsLocked[Locked] = true;
+    std::vector<int> KeyNodes;
+    for (int Node : Order)
+    {
+        if (Node != Locked && Parent[Node] >= 0 && IsLocked[Parent[Node]])
+            IsLocked[Node] = true;
+        if (!IsLocked[Node])
+            KeyNodes.push_back(Node);
+    }
+
+    const KeyDoorPair& Pair    = m_KeyDoorPairs[Rng.Next(static_cast<Uint32>(m_KeyDoorPairs.size()))];
+    const int          KeyNode = KeyNodes[Rng.Next(static_cast<Uint32>(KeyNodes.size()))];
+    const int          Door    = Parent[Locked];
+
+    Cell(Locked % n + Door % n + 1, Locked / n + Door / n + 1) = Pair.DoorBlockType;
+    Cell(2 * (KeyNode % n) + 1, 2 * (KeyNode / n) + 1)         = Pair.KeyBlockType;
+}
+
+void MazeGenerator::RunBenchmark(Uint32 NumChunks) const
+{
+    if (!IsInitialized() || NumChunks == 0)
+        return;
+
+    // Generates chunks [First, End) of a strip that is 256 chunks wide and returns
+    // the sum of their hashes, which does not depend on the order of the chunks.
+    const auto GenerateChunks = [this](Uint32 First, Uint32 End) {
+        std::vector<Uint8> Cells(static_cast<size_t>(m_CI.ChunkSize) * static_cast<size_t>(m_CI.ChunkSize));
+        Uint32             Checksum = 0;
+        for (Uint32 c = First; c < End; ++c)
+        {
+            GenerateChunk(int2{static_cast<int>(c % 256u), static_cast<int>(c / 256u)}, Cells.data());
+
+            Uint32 Hash = 2166136261u;
+            for (Uint8 Val : Cells)
+                Hash = (Hash ^ Val) * 16777619u;
+            Checksum += Hash;
+        }
+        return Checksum;
+    };
+
+    Timer        SingleTimer;
+    const Uint32 SingleChecksum = GenerateChunks(0, NumChunks);
+    const double SingleTime     = SingleTimer.GetElapsedTime();
+
+    const Uint32 NumThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::vector<Uint32>      Checksums(NumThreads);
+    std::vector<std::thread> Threads;
+    Timer                    MultiTimer;
+    for (Uint32 t = 0; t < NumThreads; ++t)
+    {
+        Threads.emplace_back([&, t]() {
+            Checksums[t] = GenerateChunks(static_cast<Uint32>(Uint64{NumChunks} * t / NumThreads),
+                                          static_cast<Uint32>(Uint64{NumChunks} * (t + 1) / NumThreads));
+        });
+    }
+    for (std::thread& Thread : Threads)
+        Thread.join();
+    const double MultiTime = MultiTimer.GetElapsedTime();
+
+    Uint32 MultiChecksum = 0;
+    for (Uint32 Checksum : Checksums)
+        MultiChecksum += Checksum;
+
+    const double SingleRate = NumChunks / std::max(SingleTime, 1e-9);
+    const double MultiRate  = NumChunks / std::max(MultiTime, 1e-9);
+    LOG_INFO_MESSAGE("Maze generator benchmark: ", NumChunks, " chunks of ", m_CI.ChunkSize, "x", m_CI.ChunkSize, " cells, seed ", m_CI.Seed,
+                     "\n  1 thread:  ", SingleRate, " chunks/s per core",
+                     "\n  ", NumThreads, " threads: ", MultiRate, " chunks/s, ", MultiRate / NumThreads, " chunks/s per core");
+    if (SingleChecksum != MultiChecksum)
+        LOG_ERROR_MESSAGE("Maze generator is not deterministic: single-threaded and multithreaded runs produced different chunks");
+}
+
+} // namespace Diligent
@@ -0,0 +1,103 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "MazeLevel.hpp"
+
+namespace Diligent
+{
+
+// Deterministic procedural maze generator. Every chunk is a maze carved with the
+// randomized Prim's algorithm and depends only on the seed and the chunk coordinates,
+// so chunks can be generated in any order on any thread.
+//
+// A chunk of ChunkSize x ChunkSize cells holds (ChunkSize / 2)^2 corridor nodes at odd
+// local coordinates. The chunk owns its west column and north row, where a few border
+// cells are opened to connect it with the neighbors; the east and south borders belong
+// to the neighbors. Optionally, a subtree of the maze that does not touch any border
+// opening is locked behind a door, and the key that opens it is placed elsewhere in the chunk.
+class MazeGenerator
+{
+public:
+    struct CreateInfo
+    {
+        Uint32 Seed = 0;
+
+        // Chunk size in cells, must be even
+        int ChunkSize = 16;
+
+        // Block type used for the walls
+        Uint8 WallBlockType = 1;
+
+        // Number of openings in each border of a chunk
+        Uint32 NumBorderOpenings = 2;
+
+        // Probability that a chunk has a locked area
+        float KeyDoorChance = 0.35f;
+
+        // Number of nodes in a locked area
+        Uint32 MinLockedNodes = 3;
+        Uint32 MaxLockedNodes = 12;
+    };
+
+    // The level provides the block type table and the key-door bindings
+    bool Initialize(const MazeLevel& Level, const CreateInfo& CI);
+
+    bool IsInitialized() const { return m_pLevel != nullptr; }
+
+    // Writes ChunkSize x ChunkSize block types of the chunk row by row. Thread-safe.
+    void GenerateChunk(const int2& Coord, Uint8* pCells) const;
+
+    int    GetChunkSize() const { return m_CI.ChunkSize; }
+    Uint32 GetSeed() const { return m_CI.Seed; }
+
+    // Global coordinates of a cell that is always open
+    static int2 GetSpawnCell() { return int2{1, 1}; }
+
+    // Generates NumChunks chunks on one thread and on all hardware threads
+    // and logs the throughput in chunks per second per core.
+    void RunBenchmark(Uint32 NumChunks) const;
+
+private:
+    // Bit mask of the nodes next to the openings in the west (West == true) or north border of the chunk
+    Uint32 GetBorderOpenings(const int2& Coord, bool West) const;
+
+    struct KeyDoorPair
+    {
+        Uint8 KeyBlockType;
+        Uint8 DoorBlockType;
+    };
+
+    const MazeLevel*         m_pLevel = nullptr;
+    CreateInfo               m_CI;
+    Uint8                    m_EmptyBlockType = 0;
+    std::vector<KeyDoorPair> m_KeyDoorPairs;
+};
+
+} // namespace Diligent
@@ -0,0 +1,179 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeLevel.hpp"
+
+#include "DebugUtilities.hpp"
+#include "Timer.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+bool IsSectionValid(size_t FileSize, Uint32 Offset, Uint64 Count, size_t ElementSize)
+{
+    return (Offset % 4) == 0 && Offset <= FileSize && Count * ElementSize <= FileSize - Offset;
+}
+
+} // namespace
+
+bool MazeLevel::Load(const char* Path, Uint32 NumMaterials)
+{
+    m_pHeader = nullptr;
+
+    Timer LoadTimer;
+
+    if (!m_File.Open(Path))
+    {
+        LOG_ERROR_MESSAGE("Failed to open maze level '", Path, "'");
+        return false;
+    }
+
+    const Uint8* pData    = m_File.GetData();
+    const size_t FileSize = m_File.GetSize();
+    if (FileSize < sizeof(MazeLevelHeader))
+    {
+        LOG_ERROR_MESSAGE("Maze level '", Path, "' is truncated");
+        return false;
+    }
+
+    const auto* pHeader = reinterpret_cast<const MazeLevelHeader*>(pData);
+    if (pHeader->Magic != MazeLevelMagic)
+    {
+        LOG_ERROR_MESSAGE("'", Path, "' is not a maze level file");
+        return false;
+    }
+    if (pHeader->Version != MazeLevelVersion)
+    {
+        LOG_ERROR_MESSAGE("Maze level '", Path, "' has version ", pHeader->Version, " while version ", MazeLevelVersion, " is expected");
+        return false;
+    }
+    if (pHeader->Cols == 0 || pHeader->Rows == 0 || !(pHeader->CellSize > 0) || !(pHeader->WallHeight > 0))
+    {
+        LOG_ERROR_MESSAGE("Maze level '", Path, "' has invalid dimensions");
+        return false;
+    }
+
+    const Uint64 NumCells = Uint64{pHeader->Cols} * Uint64{pHeader->Rows};
+    // clang-format off
+    if (!IsSectionValid(FileSize, pHeader->BlockTypesOffset,      pHeader->NumBlockTypes,      sizeof(MazeBlockTypeDesc))  ||
+        !IsSectionValid(FileSize, pHeader->KeyDoorBindingsOffset, pHeader->NumKeyDoorBindings, sizeof(MazeKeyDoorBinding)) ||
+        !IsSectionValid(FileSize, pHeader->SpawnPointsOffset,     pHeader->NumSpawnPoints,     sizeof(MazeSpawnPoint))     ||
+        !IsSectionValid(FileSize, pHeader->CellsOffset,           NumCells,                    sizeof(Uint8)))
+    // clang-format on
+    {
+        LOG_ERROR_MESSAGE("Maze level '", Path, "' is corrupted: a section is out of the file bounds");
+        return false;
+    }
+
+    const auto* pBlockTypes      = reinterpret_cast<const MazeBlockTypeDesc*>(pData + pHeader->BlockTypesOffset);
+    const auto* pKeyDoorBindings = reinterpret_cast<const MazeKeyDoorBinding*>(pData + pHeader->KeyDoorBindingsOffset);
+    const auto* pSpawnPoints     = reinterpret_cast<const MazeSpawnPoint*>(pData + pHeader->SpawnPointsOffset);
+    const auto* pCells           = pData + pHeader->CellsOffset;
+
+    if (pHeader->NumBlockTypes == 0 || pHeader->NumBlockTypes > 256)
+    {
+        LOG_ERROR_MESSAGE("Maze level '", Path, "' has ", pHeader->NumBlockTypes, " block types; 1 to 256 are allowed");
+        return false;
+    }
+    for (Uint32 t = 0; t < pHeader->NumBlockTypes; ++t)
+    {
+        if (pBlockTypes[t].Kind >= MAZE_BLOCK_KIND_COUNT)
+        {
+            LOG_ERROR_MESSAGE("Maze level '", Path, "': block type ", t, " has unknown kind ", Uint32{pBlockTypes[t].Kind});
+            return false;
+        }
+        if (pBlockTypes[t].Material >= NumMaterials)
+        {
+            LOG_ERROR_MESSAGE("Maze level '", Path, "': block type ", t, " uses material ", Uint32{pBlockTypes[t].Material}, "; only ", NumMaterials,
+                              " materials are available");
+            return false;
+        }
+    }
+    for (Uint32 i = 0; i < pHeader->NumKeyDoorBindings; ++i)
+    {
+        const auto& Binding = pKeyDoorBindings[i];
+        if (Binding.KeyBlockType >= pHeader->NumBlockTypes || pBlockTypes[Binding.KeyBlockType].Kind != MAZE_BLOCK_KIND_KEY ||
+            Binding.DoorBlockType >= pHeader->NumBlockTypes || pBlockTypes[Binding.DoorBlockType].Kind != MAZE_BLOCK_KIND_DOOR)
+        {
+            LOG_ERROR_MESSAGE("Maze level '", Path, "': key-door binding ", i, " does not reference a key and a door block type");
+            return false;
+        }
+    }
+
+    // Cell values are only checked when the table does not cover the whole Uint8 range.
+    if (pHeader->NumBlockTypes < 256)
+    {
+        const Uint8 MaxType = static_cast<Uint8>(pHeader->NumBlockTypes - 1);
+        Uint8       Max     = 0;
+        for (Uint64 i = 0; i < NumCells; ++i)
+            Max = std::max(Max, pCells[i]);
+        if (Max > MaxType)
+        {
+            LOG_ERROR_MESSAGE("Maze level '", Path, "' references block type ", Uint32{Max}, " that is not in the block type table");
+            return false;
+        }
+    }
+
+    m_pHeader          = pHeader;
+    m_pBlockTypes      = pBlockTypes;
+    m_pKeyDoorBindings = pKeyDoorBindings;
+    m_pSpawnPoints     = pSpawnPoints;
+    m_pCells           = pCells;
+
+    LOG_INFO_MESSAGE("Loaded maze level '", Path, "' (", pHeader->Cols, "x", pHeader->Rows, " cells, ",
+                     m_File.IsMapped() ? "mapped" : "copied", ") in ", LoadTimer.GetElapsedTime() * 1000.0, " ms");
+
+    return true;
+}
+
+const MazeSpawnPoint* MazeLevel::FindSpawnPoint(MAZE_SPAWN_KIND Kind) const
+{
+    for (Uint32 i = 0; i < GetNumSpawnPoints(); ++i)
+    {
+        if (m_pSpawnPoints[i].Kind == Kind)
+            return &m_pSpawnPoints[i];
+    }
+    return nullptr;
+}
+
+Uint64 MazeLevel::ComputeContentHash() const
+{
+    const Uint8* pData = m_File.GetData();
+    const size_t Size  = m_File.GetSize();
+
+    Uint64 Hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < Size; ++i)
+    {
+        Hash ^= pData[i];
+        Hash *= 0x100000001b3ull;
+    }
+    return Hash;
+}
+
+} // namespace Diligent
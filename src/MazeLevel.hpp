@@ -0,0 +1,172 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include "BasicMath.hpp"
+#include "MappedFile.hpp"
+
+namespace Diligent
+{
+
+// Binary maze level format (little-endian).
+//
+//  | MazeLevelHeader | MazeBlockTypeDesc[NumBlockTypes] | MazeKeyDoorBinding[NumKeyDoorBindings] | MazeSpawnPoint[NumSpawnPoints] | Uint8 Cells[Rows * Cols] |
+//
+// Every section starts at the offset stored in the header and is aligned to 4 bytes, so that
+// the level can be used directly from the mapped file without any parsing or copying.
+// Cells are stored row by row; a cell value is an index into the block type table.
+
+static constexpr Uint32 MazeLevelMagic   = 0x564C5242; // 'BRLV'
+static constexpr Uint32 MazeLevelVersion = 1;
+
+enum MAZE_BLOCK_KIND : Uint8
+{
+    MAZE_BLOCK_KIND_EMPTY = 0,
+    MAZE_BLOCK_KIND_WALL,
+    MAZE_BLOCK_KIND_DOOR,
+    MAZE_BLOCK_KIND_KEY,
+    MAZE_BLOCK_KIND_COUNT
+};
+
+enum MAZE_BLOCK_FLAGS : Uint8
+{
+    MAZE_BLOCK_FLAG_NONE = 0,
+
+    // Adjacent cells of the same type are merged into a single object
+    MAZE_BLOCK_FLAG_MERGE = 1u << 0u,
+};
+
+enum MAZE_SPAWN_KIND : Uint32
+{
+    MAZE_SPAWN_KIND_PLAYER = 0,
+    MAZE_SPAWN_KIND_MONSTER,
+};
+
+struct MazeLevelHeader
+{
+    Uint32 Magic;
+    Uint32 Version;
+    Uint32 Cols;
+    Uint32 Rows;
+    float  CellSize;   // World-space size of a cell in XZ plane
+    float  WallHeight; // World-space height of a wall
+
+    Uint32 NumBlockTypes;
+    Uint32 BlockTypesOffset;
+    Uint32 NumKeyDoorBindings;
+    Uint32 KeyDoorBindingsOffset;
+    Uint32 NumSpawnPoints;
+    Uint32 SpawnPointsOffset;
+    Uint32 CellsOffset;
+    Uint32 Reserved;
+};
+static_assert(sizeof(MazeLevelHeader) == 56, "Level header layout must not change");
+
+struct MazeBlockTypeDesc
+{
+    Uint8  Kind;     // MAZE_BLOCK_KIND
+    Uint8  Flags;    // MAZE_BLOCK_FLAGS
+    Uint16 Material; // Index in the cube material range
+};
+static_assert(sizeof(MazeBlockTypeDesc) == 4, "Block type layout must not change");
+
+struct MazeKeyDoorBinding
+{
+    Uint32 KeyBlockType;
+    Uint32 DoorBlockType;
+};
+
+struct MazeSpawnPoint
+{
+    Uint32 Kind; // MAZE_SPAWN_KIND
+    float3 Pos;
+    float  Yaw;
+    float  Pitch;
+};
+static_assert(sizeof(MazeSpawnPoint) == 24, "Spawn point layout must not change");
+
+// Maze level that references the data in the mapped level file.
+class MazeLevel
+{
+public:
+    // Block types must use one of the first NumMaterials cube materials
+    bool Load(const char* Path, Uint32 NumMaterials);
+
+    bool IsLoaded() const { return m_pHeader != nullptr; }
+
+    int   GetCols() const { return static_cast<int>(m_pHeader->Cols); }
+    int   GetRows() const { return static_cast<int>(m_pHeader->Rows); }
+    float GetCellSize() const { return m_pHeader->CellSize; }
+    float GetWallHeight() const { return m_pHeader->WallHeight; }
+
+    Uint8 GetCell(int x, int z) const { return m_pCells[static_cast<size_t>(z) * m_pHeader->Cols + static_cast<size_t>(x)]; }
+
+    const Uint8* GetCells() const { return m_pCells; }
+
+    bool IsInside(int x, int z) const { return x >= 0 && z >= 0 && x < GetCols() && z < GetRows(); }
+
+    Uint32                   GetNumBlockTypes() const { return m_pHeader->NumBlockTypes; }
+    const MazeBlockTypeDesc& GetBlockType(Uint32 Type) const { return m_pBlockTypes[Type]; }
+
+    Uint32                    GetNumKeyDoorBindings() const { return m_pHeader->NumKeyDoorBindings; }
+    const MazeKeyDoorBinding& GetKeyDoorBinding(Uint32 i) const { return m_pKeyDoorBindings[i]; }
+
+    Uint32                GetNumSpawnPoints() const { return m_pHeader->NumSpawnPoints; }
+    const MazeSpawnPoint& GetSpawnPoint(Uint32 i) const { return m_pSpawnPoints[i]; }
+
+    // Returns the first spawn point of the given kind or null if there is none
+    const MazeSpawnPoint* FindSpawnPoint(MAZE_SPAWN_KIND Kind) const;
+
+    // 64-bit FNV-1a hash of the level file contents
+    Uint64 ComputeContentHash() const;
+
+    // World-space center of the cell at the floor level
+    float3 GetCellCenter(int x, int z) const
+    {
+        return float3{(static_cast<float>(x) - GetCols() / 2.0f) * GetCellSize(),
+                      0.f,
+                      (static_cast<float>(z) - GetRows() / 2.0f) * GetCellSize()};
+    }
+
+    // Cell that contains the world-space position. The result may be outside of the grid.
+    int2 GetCellAt(const float3& Pos) const
+    {
+        return int2{static_cast<int>(std::floor(Pos.x / GetCellSize() + GetCols() / 2.0f + 0.5f)),
+                    static_cast<int>(std::floor(Pos.z / GetCellSize() + GetRows() / 2.0f + 0.5f))};
+    }
+
+private:
+    MappedFile m_File;
+
+    const MazeLevelHeader*    m_pHeader          = nullptr;
+    const MazeBlockTypeDesc*  m_pBlockTypes      = nullptr;
+    const MazeKeyDoorBinding* m_pKeyDoorBindings = nullptr;
+    const MazeSpawnPoint*     m_pSpawnPoints     = nullptr;
+    const Uint8*              m_pCells           = nullptr;
+};
+
+} // namespace Diligent
@@ -0,0 +1,829 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazePathPlanner.hpp"
+
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <string>
+
+#include "DebugUtilities.hpp"
+#include "Timer.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+int FloorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// East, west, south and north; the opposite direction of Dir is Dir ^ 1
+const int2 DirDeltas[4] = {int2{1, 0}, int2{-1, 0}, int2{0, 1}, int2{0, -1}};
+
+constexpr Uint16 UnreachableCell = 0xFFFFu;
+
+// Clusters of generated worlds are dropped when there are more of them and rebuilt on demand
+constexpr size_t MaxCachedClusters = 16384;
+
+} // namespace
+
+MazePathPlanner::~MazePathPlanner()
+{
+    Stop();
+}
+
+void MazePathPlanner::Start(const CreateInfo& CI)
+{
+    Stop();
+    Initialize(CI);
+
+    m_Stop   = false;
+    m_Worker = std::thread{&MazePathPlanner::WorkerThread, this};
+}
+
+void MazePathPlanner::Stop()
+{
+    if (m_Worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> Lock{m_Mtx};
+            m_Stop = true;
+        }
+        m_WorkCV.notify_all();
+        m_Worker.join();
+    }
+
+    m_Queue.clear();
+    m_Results.clear();
+    m_Busy = false;
+    m_Clusters.clear();
+    m_UnlockedDoors.clear();
+}
+
+void MazePathPlanner::Initialize(const CreateInfo& CI)
+{
+    VERIFY_EXPR(CI.pLevel != nullptr && CI.pLevel->IsLoaded());
+    VERIFY(CI.ClusterSize > 0 && CI.ClusterSize * CI.ClusterSize <= UnreachableCell, "Invalid cluster size");
+    VERIFY(CI.pGenerator == nullptr || CI.pGenerator->GetChunkSize() == CI.ClusterSize, "Generator chunk size must match the cluster size");
+
+    m_CI = CI;
+    m_Clusters.clear();
+    m_UnlockedDoors.clear();
+
+    const size_t NumCells = static_cast<size_t>(m_CI.ClusterSize) * static_cast<size_t>(m_CI.ClusterSize);
+    m_SearchDist.resize(NumCells);
+    m_SearchParent.resize(NumCells);
+    m_SearchQueue.resize(NumCells);
+
+    // The graph of a level is built in advance
+    if (m_CI.pGenerator == nullptr)
+    {
+        const int2 NumClusters{(m_CI.pLevel->GetCols() + m_CI.ClusterSize - 1) / m_CI.ClusterSize,
+                               (m_CI.pLevel->GetRows() + m_CI.ClusterSize - 1) / m_CI.ClusterSize};
+        for (int z = 0; z < NumClusters.y; ++z)
+        {
+            for (int x = 0; x < NumClusters.x; ++x)
+                GetGraph(int2{x, z});
+        }
+    }
+}
+
+Uint32 MazePathPlanner::RequestPath(const int2& Start, const int2& Goal)
+{
+    Command Cmd;
+    Cmd.Start = Start;
+    Cmd.Goal  = Goal;
+    {
+        std::lock_guard<std::mutex> Lock{m_Mtx};
+        Cmd.RequestId = m_NextRequestId;
+        if (++m_NextRequestId == 0)
+            m_NextRequestId = 1;
+        m_Queue.push_back(Cmd);
+    }
+    m_WorkCV.notify_all();
+    return Cmd.RequestId;
+}
+
+bool MazePathPlanner::PopResult(MazePath& Path)
+{
+    std::lock_guard<std::mutex> Lock{m_Mtx};
+    if (m_Results.empty())
+        return false;
+
+    Path = std::move(m_Results.front());
+    m_Results.pop_front();
+    return true;
+}
+
+void MazePathPlanner::UnlockDoors(const int2& LockScope, Uint8 DoorBlockType)
+{
+    Command Cmd;
+    Cmd.IsUnlock      = true;
+    Cmd.Start         = LockScope;
+    Cmd.DoorBlockType = DoorBlockType;
+    {
+        std::lock_guard<std::mutex> Lock{m_Mtx};
+        m_Queue.push_back(Cmd);
+    }
+    m_WorkCV.notify_all();
+}
+
+void MazePathPlanner::WaitIdle()
+{
+    std::unique_lock<std::mutex> Lock{m_Mtx};
+    m_IdleCV.wait(Lock, [this]() { return m_Queue.empty() && !m_Busy; });
+}
+
+void MazePathPlanner::WorkerThread()
+{
+    for (;;)
+    {
+        Command Cmd;
+        {
+            std::unique_lock<std::mutex> Lock{m_Mtx};
+            m_WorkCV.wait(Lock, [this]() { return m_Stop || !m_Queue.empty(); });
+            if (m_Stop)
+                return;
+
+            Cmd = m_Queue.front();
+            m_Queue.pop_front();
+            m_Busy = true;
+        }
+
+        MazePath Path;
+        if (Cmd.IsUnlock)
+        {
+            OpenDoors(Cmd.Start, Cmd.DoorBlockType);
+        }
+        else
+        {
+            Path.RequestId = Cmd.RequestId;
+            FindPath(Cmd.Start, Cmd.Goal, Path);
+        }
+
+        {
+            std::lock_guard<std::mutex> Lock{m_Mtx};
+            if (!Cmd.IsUnlock)
+                m_Results.push_back(std::move(Path));
+            m_Busy = false;
+        }
+        m_IdleCV.notify_all();
+    }
+}
+
+int2 MazePathPlanner::GetClusterAt(const int2& Cell) const
+{
+    return int2{FloorDiv(Cell.x, m_CI.ClusterSize), FloorDiv(Cell.y, m_CI.ClusterSize)};
+}
+
+int2 MazePathPlanner::GetLockScope(const int2& ClusterCoord) const
+{
+    // Same lock scopes as in BuildMazeChunk()
+    return m_CI.pGenerator != nullptr ? ClusterCoord : int2{};
+}
+
+bool MazePathPlanner::IsSearchable(const int2& Coord, const int2& StartCoord) const
+{
+    if (m_CI.pGenerator != nullptr)
+        return std::abs(Coord.x - StartCoord.x) <= m_CI.MaxSearchRadius && std::abs(Coord.y - StartCoord.y) <= m_CI.MaxSearchRadius;
+
+    return Coord.x >= 0 && Coord.y >= 0 &&
+        Coord.x * m_CI.ClusterSize < m_CI.pLevel->GetCols() && Coord.y * m_CI.ClusterSize < m_CI.pLevel->GetRows();
+}
+
+MazePathPlanner::Cluster& MazePathPlanner::GetCells(const int2& Coord)
+{
+    auto it = m_Clusters.find(PackMazeCoord(Coord));
+    if (it != m_Clusters.end())
+        return it->second;
+
+    const int        Size  = m_CI.ClusterSize;
+    const MazeLevel& Level = *m_CI.pLevel;
+
+    Cluster& C = m_Clusters[PackMazeCoord(Coord)];
+    C.Coord    = Coord;
+    C.Open.assign(static_cast<size_t>(Size) * static_cast<size_t>(Size), 0);
+
+    const Uint64 LockScope = PackMazeCoord(GetLockScope(Coord));
+    const auto   SetCell   = [&](int x, int z, Uint8 BlockType) {
+        const Uint16 Cell = static_cast<Uint16>(z * Size + x);
+        const Uint8  Kind = Level.GetBlockType(BlockType).Kind;
+        if (Kind == MAZE_BLOCK_KIND_WALL)
+            return;
+        if (Kind == MAZE_BLOCK_KIND_DOOR && m_UnlockedDoors.count({LockScope, BlockType}) == 0)
+        {
+            C.ClosedDoors.push_back({Cell, BlockType});
+            return;
+        }
+        C.Open[Cell] = 1;
+    };
+
+    if (m_CI.pGenerator != nullptr)
+    {
+        std::vector<Uint8> Cells(C.Open.size());
+        m_CI.pGenerator->GenerateChunk(Coord, Cells.data());
+        for (int z = 0; z < Size; ++z)
+        {
+            for (int x = 0; x < Size; ++x)
+                SetCell(x, z, Cells[static_cast<size_t>(z) * Size + x]);
+        }
+    }
+    else
+    {
+        // Cells outside of the level stay blocked
+        const int2 Start{Coord.x * Size, Coord.y * Size};
+        for (int z = 0; z < Size; ++z)
+        {
+            for (int x = 0; x < Size; ++x)
+            {
+                if (Level.IsInside(Start.x + x, Start.y + z))
+                    SetCell(x, z, Level.GetCell(Start.x + x, Start.y + z));
+            }
+        }
+    }
+
+    return C;
+}
+
+MazePathPlanner::Cluster& MazePathPlanner::GetGraph(const int2& Coord)
+{
+    Cluster& C = GetCells(Coord);
+    if (!C.HasGraph)
+        BuildGraph(C);
+    return C;
+}
+
+void MazePathPlanner::BuildGraph(Cluster& C)
+{
+    const int Size = m_CI.ClusterSize;
+
+    // Local index of the I-th cell along the border of the cluster in the given direction
+    const auto GetBorderCell = [Size](Uint32 Dir, int I) {
+        switch (Dir)
+        {
+            case 0: return static_cast<Uint16>(I * Size + Size - 1);
+            case 1: return static_cast<Uint16>(I * Size);
+            case 2: return static_cast<Uint16>((Size - 1) * Size + I);
+            default: return static_cast<Uint16>(I);
+        }
+    };
+
+    C.Nodes.clear();
+    const auto AddEntrance = [&C](Uint16 Cell, Uint32 Dir) {
+        auto it = std::find_if(C.Nodes.begin(), C.Nodes.end(), [Cell](const Node& N) { return N.Cell == Cell; });
+        if (it == C.Nodes.end())
+        {
+            C.Nodes.emplace_back();
+            it       = C.Nodes.end() - 1;
+            it->Cell = Cell;
+        }
+        it->PortalDirs |= static_cast<Uint8>(1u << Dir);
+    };
+
+    // Every run of cells that are open on both sides of a border gets an entrance in the middle,
+    // or two at the ends if it is long. The neighbor finds the same entrances from its side.
+    for (Uint32 Dir = 0; Dir < 4; ++Dir)
+    {
+        C.pNeighbors[Dir]       = &GetCells(C.Coord + DirDeltas[Dir]);
+        const Cluster& Neighbor = *C.pNeighbors[Dir];
+        for (int Begin = 0; Begin < Size;)
+        {
+            const auto IsOpen = [&](int I) { return C.Open[GetBorderCell(Dir, I)] && Neighbor.Open[GetBorderCell(Dir ^ 1u, I)]; };
+            if (!IsOpen(Begin))
+            {
+                ++Begin;
+                continue;
+            }
+            int End = Begin + 1;
+            while (End < Size && IsOpen(End))
+                ++End;
+
+            if (End - Begin <= 6)
+            {
+                AddEntrance(GetBorderCell(Dir, (Begin + End - 1) / 2), Dir);
+            }
+            else
+            {
+                AddEntrance(GetBorderCell(Dir, Begin), Dir);
+                AddEntrance(GetBorderCell(Dir, End - 1), Dir);
+            }
+            Begin = End;
+        }
+    }
+
+    // Paths between the entrances inside the cluster
+    for (size_t i = 0; i < C.Nodes.size(); ++i)
+    {
+        SearchCluster(C, C.Nodes[i].Cell);
+        for (size_t j = 0; j < C.Nodes.size(); ++j)
+        {
+            const Uint16 Dist = m_SearchDist[C.Nodes[j].Cell];
+            if (j != i && Dist != UnreachableCell)
+                C.Nodes[i].Edges.push_back({static_cast<Uint16>(j), Dist});
+        }
+    }
+
+    // The entrances were renumbered, so the neighbors find the entrances across their borders again
+    for (Uint32 Dir = 0; Dir < 4; ++Dir)
+    {
+        for (Node& N : C.pNeighbors[Dir]->Nodes)
+            N.Across[Dir ^ 1u] = 0xFFFF;
+    }
+
+    C.HasGraph = true;
+}
+
+void MazePathPlanner::SearchCluster(const Cluster& C, Uint16 FromCell)
+{
+    const int Size = m_CI.ClusterSize;
+
+    std::fill(m_SearchDist.begin(), m_SearchDist.end(), UnreachableCell);
+    m_SearchDist[FromCell] = 0;
+
+    size_t Head = 0, Tail = 0;
+    m_SearchQueue[Tail++] = FromCell;
+    while (Head < Tail)
+    {
+        const Uint16 Cell = m_SearchQueue[Head++];
+        const int    x    = Cell % Size;
+        const int    z    = Cell / Size;
+        for (const int2& Delta : DirDeltas)
+        {
+            const int nx = x + Delta.x;
+            const int nz = z + Delta.y;
+            if (nx < 0 || nz < 0 || nx >= Size || nz >= Size)
+                continue;
+
+            const Uint16 Neighbor = static_cast<Uint16>(nz * Size + nx);
+            if (C.Open[Neighbor] && m_SearchDist[Neighbor] == UnreachableCell)
+            {
+                m_SearchDist[Neighbor]   = m_SearchDist[Cell] + 1;
+                m_SearchParent[Neighbor] = Cell;
+                m_SearchQueue[Tail++]    = Neighbor;
+            }
+        }
+    }
+}
+
+bool MazePathPlanner::RefineSegment(const int2& From, const int2& To, std::vector<int2>& Cells)
+{
+    const int2 FromCluster = GetClusterAt(From);
+    if (FromCluster != GetClusterAt(To))
+    {
+        // Entrances on both sides of a border are neighbors
+        Cells.push_back(To);
+        return true;
+    }
+
+    const int      Size   = m_CI.ClusterSize;
+    const int2     Origin = FromCluster * Size;
+    const Cluster& C      = GetCells(FromCluster);
+    const Uint16   Target = static_cast<Uint16>((To.y - Origin.y) * Size + To.x - Origin.x);
+    SearchCluster(C, static_cast<Uint16>((From.y - Origin.y) * Size + From.x - Origin.x));
+    if (m_SearchDist[Target] == UnreachableCell)
+        return false;
+
+    const size_t First = Cells.size();
+    Cells.resize(First + m_SearchDist[Target]);
+    for (Uint16 Cell = Target, i = m_SearchDist[Target]; i > 0; Cell = m_SearchParent[Cell], --i)
+        Cells[First + i - 1] = Origin + int2{Cell % Size, Cell / Size};
+    return true;
+}
+
+void MazePathPlanner::FindPath(const int2& Start, const int2& Goal, MazePath& Path)
+{
+    Path.Found = false;
+    Path.Cells.clear();
+    Path.Waypoints.clear();
+
+    if (m_CI.pGenerator != nullptr && m_Clusters.size() > MaxCachedClusters)
+        m_Clusters.clear();
+
+    const int  Size = m_CI.ClusterSize;
+    const int2 StartCoord{GetClusterAt(Start)};
+    const int2 GoalCoord{GetClusterAt(Goal)};
+    if (!IsSearchable(StartCoord, StartCoord) || !IsSearchable(GoalCoord, StartCoord))
+        return;
+
+    Cluster&     StartCluster = GetGraph(StartCoord);
+    Cluster&     GoalCluster  = GetGraph(GoalCoord);
+    const Uint16 StartCell    = static_cast<Uint16>((Start.y - StartCoord.y * Size) * Size + Start.x - StartCoord.x * Size);
+    const Uint16 GoalCell     = static_cast<Uint16>((Goal.y - GoalCoord.y * Size) * Size + Goal.x - GoalCoord.x * Size);
+    if (!StartCluster.Open[StartCell] || !GoalCluster.Open[GoalCell])
+        return;
+
+    Path.Cells.push_back(Start);
+    if (StartCoord == GoalCoord && RefineSegment(Start, Goal, Path.Cells))
+    {
+        Path.Found = true;
+        return;
+    }
+
+    // Distances from the entrances of the goal cluster to the goal
+    SearchCluster(GoalCluster, GoalCell);
+    std::vector<Uint16> GoalDist(GoalCluster.Nodes.size());
+    for (size_t n = 0; n < GoalCluster.Nodes.size(); ++n)
+        GoalDist[n] = m_SearchDist[GoalCluster.Nodes[n].Cell];
+
+    // A* over the entrances. The search state is kept in the nodes.
+    if (++m_SearchId == 0)
+    {
+        for (auto& it : m_Clusters)
+        {
+            for (Node& N : it.second.Nodes)
+                N.SearchId = 0;
+        }
+        m_SearchId = 1;
+    }
+
+    struct OpenEntry
+    {
+        Uint32   F;
+        Uint32   G;
+        Cluster* pCluster;
+        Uint16   NodeIdx;
+        bool     operator<(const OpenEntry& Other) const { return F > Other.F; }
+    };
+    std::priority_queue<OpenEntry> OpenList;
+
+    const auto Relax = [&](Cluster& C, Uint16 NodeIdx, Uint32 G, Cluster* pParent, Uint16 ParentNode) {
+        Node& N = C.Nodes[NodeIdx];
+        if (N.SearchId == m_SearchId && G >= N.G)
+            return;
+        N.SearchId   = m_SearchId;
+        N.G          = G;
+        N.Closed     = false;
+        N.pParent    = pParent;
+        N.ParentNode = ParentNode;
+
+        const int2 Cell = C.Coord * Size + int2{N.Cell % Size, N.Cell / Size};
+        OpenList.push({G + static_cast<Uint32>(std::abs(Goal.x - Cell.x) + std::abs(Goal.y - Cell.y)), G, &C, NodeIdx});
+    };
+
+    SearchCluster(StartCluster, StartCell);
+    for (size_t n = 0; n < StartCluster.Nodes.size(); ++n)
+    {
+        const Uint16 Dist = m_SearchDist[StartCluster.Nodes[n].Cell];
+        if (Dist != UnreachableCell)
+            Relax(StartCluster, static_cast<Uint16>(n), Dist, nullptr, 0);
+    }
+
+    Uint32   BestGoalG   = ~0u;
+    Cluster* pGoalParent = nullptr;
+    Uint16   GoalParent  = 0;
+    while (!OpenList.empty())
+    {
+        const OpenEntry Entry = OpenList.top();
+        OpenList.pop();
+        if (Entry.F >= BestGoalG)
+            break;
+
+        Cluster& C = *Entry.pCluster;
+        Node&    N = C.Nodes[Entry.NodeIdx];
+        if (N.Closed || Entry.G != N.G)
+            continue;
+        N.Closed = true;
+
+        if (&C == &GoalCluster && GoalDist[Entry.NodeIdx] != UnreachableCell && N.G + GoalDist[Entry.NodeIdx] < BestGoalG)
+        {
+            BestGoalG   = N.G + GoalDist[Entry.NodeIdx];
+            pGoalParent = &C;
+            GoalParent  = Entry.NodeIdx;
+        }
+
+        for (const Edge& E : N.Edges)
+            Relax(C, E.Node, N.G + E.Cost, &C, Entry.NodeIdx);
+
+        for (Uint32 Dir = 0; Dir < 4; ++Dir)
+        {
+            if ((N.PortalDirs & (1u << Dir)) == 0 || !IsSearchable(C.Coord + DirDeltas[Dir], StartCoord))
+                continue;
+
+            Cluster& Neighbor = *C.pNeighbors[Dir];
+            if (!Neighbor.HasGraph)
+                BuildGraph(Neighbor);
+
+            if (N.Across[Dir] == 0xFFFF)
+            {
+                // The entrance on the other side of the border. The index stays valid until the
+                // neighbor is rebuilt, which resets it, see BuildGraph().
+                const int2   Local{N.Cell % Size, N.Cell / Size};
+                const int2   Across{(Local.x + DirDeltas[Dir].x + Size) % Size, (Local.y + DirDeltas[Dir].y + Size) % Size};
+                const Uint16 AcrossCell = static_cast<Uint16>(Across.y * Size + Across.x);
+                for (size_t n = 0; n < Neighbor.Nodes.size(); ++n)
+                {
+                    if (Neighbor.Nodes[n].Cell == AcrossCell)
+                        N.Across[Dir] = static_cast<Uint16>(n);
+                }
+                VERIFY(N.Across[Dir] != 0xFFFF, "Entrances on both sides of a border must match");
+                if (N.Across[Dir] == 0xFFFF)
+                    continue;
+            }
+            Relax(Neighbor, N.Across[Dir], N.G + 1, &C, Entry.NodeIdx);
+        }
+    }
+
+    if (BestGoalG == ~0u)
+    {
+        Path.Cells.clear();
+        return;
+    }
+
+    // Entrances from the start to the goal
+    std::vector<int2> Entrances{Goal};
+    for (const Cluster* pCluster = pGoalParent; pCluster != nullptr;)
+    {
+        const Node& N = pCluster->Nodes[GoalParent];
+        Entrances.push_back(pCluster->Coord * Size + int2{N.Cell % Size, N.Cell / Size});
+        pCluster   = N.pParent;
+        GoalParent = N.ParentNode;
+    }
+    std::reverse(Entrances.begin(), Entrances.end());
+
+    // Only the first segments inside clusters are refined
+    Uint32 NumRefined = 0;
+    size_t i          = 0;
+    for (; i < Entrances.size() && NumRefined < m_CI.MaxRefinedSegments; ++i)
+    {
+        const int2 From = Path.Cells.back();
+        if (Entrances[i] == From)
+            continue;
+        if (GetClusterAt(From) == GetClusterAt(Entrances[i]))
+            ++NumRefined;
+        if (!RefineSegment(From, Entrances[i], Path.Cells))
+        {
+            UNEXPECTED("Entrances of a cluster must be connected as recorded in the graph");
+            Path.Cells.clear();
+            return;
+        }
+    }
+    Path.Waypoints.assign(Entrances.begin() + i, Entrances.end());
+    Path.Found = true;
+}
+
+void MazePathPlanner::OpenDoors(const int2& LockScope, Uint8 DoorBlockType)
+{
+    const Uint64 ScopeKey = PackMazeCoord(LockScope);
+    if (!m_UnlockedDoors.insert({ScopeKey, DoorBlockType}).second)
+        return;
+
+    const int Size = m_CI.ClusterSize;
+
+    // Clusters that are built later read the unlocked doors from m_UnlockedDoors.
+    // Built clusters with the doors and their neighbors across the doors are rebuilt.
+    std::vector<Cluster*> Affected;
+    const auto            AddAffected = [&Affected](Cluster& C) {
+        if (C.HasGraph && std::find(Affected.begin(), Affected.end(), &C) == Affected.end())
+            Affected.push_back(&C);
+    };
+    for (auto& it : m_Clusters)
+    {
+        Cluster& C = it.second;
+        if (PackMazeCoord(GetLockScope(C.Coord)) != ScopeKey)
+            continue;
+
+        for (size_t d = 0; d < C.ClosedDoors.size();)
+        {
+            const DoorCell Door = C.ClosedDoors[d];
+            if (Door.BlockType != DoorBlockType)
+            {
+                ++d;
+                continue;
+            }
+            C.ClosedDoors[d] = C.ClosedDoors.back();
+            C.ClosedDoors.pop_back();
+            C.Open[Door.Cell] = 1;
+
+            AddAffected(C);
+            const int2 Local{Door.Cell % Size, Door.Cell / Size};
+            for (const int2& Delta : DirDeltas)
+            {
+                const int2 Across = Local + Delta;
+                if (Across.x < 0 || Across.y < 0 || Across.x >= Size || Across.y >= Size)
+                {
+                    auto NeighborIt = m_Clusters.find(PackMazeCoord(C.Coord + Delta));
+                    if (NeighborIt != m_Clusters.end())
+                        AddAffected(NeighborIt->second);
+                }
+            }
+        }
+    }
+
+    for (Cluster* pCluster : Affected)
+        BuildGraph(*pCluster);
+}
+
+void MazePathPlanner::RunBenchmark(const MazeLevel& Level, const MazeGenerator& Generator, Uint32 NumQueries)
+{
+    if (!Generator.IsInitialized() || NumQueries == 0)
+        return;
+
+    const int Size = Generator.GetChunkSize();
+
+    CreateInfo CI;
+    CI.pLevel             = &Level;
+    CI.pGenerator         = &Generator;
+    CI.ClusterSize        = Size;
+    CI.MaxSearchRadius    = 16;
+    CI.MaxRefinedSegments = ~0u;
+
+    MazePathPlanner Planner;
+    Planner.Initialize(CI);
+
+    // Cell-level reference over a square of clusters around the origin, doors closed
+    const int          RegionRadius = 8;
+    const int2         RegionOrigin{-RegionRadius * Size, -RegionRadius * Size};
+    const int          RegionSize = (2 * RegionRadius + 1) * Size;
+    std::vector<Uint8> RegionOpen(static_cast<size_t>(RegionSize) * RegionSize);
+    {
+        std::vector<Uint8> Cells(static_cast<size_t>(Size) * Size);
+        for (int cz = -RegionRadius; cz <= RegionRadius; ++cz)
+        {
+            for (int cx = -RegionRadius; cx <= RegionRadius; ++cx)
+            {
+                Generator.GenerateChunk(int2{cx, cz}, Cells.data());
+                for (int z = 0; z < Size; ++z)
+                {
+                    for (int x = 0; x < Size; ++x)
+                    {
+                        const Uint8 Kind = Level.GetBlockType(Cells[static_cast<size_t>(z) * Size + x]).Kind;
+                        const int   rx   = (cx + RegionRadius) * Size + x;
+                        const int   rz   = (cz + RegionRadius) * Size + z;
+
+                        RegionOpen[static_cast<size_t>(rz) * RegionSize + rx] = Kind != MAZE_BLOCK_KIND_WALL && Kind != MAZE_BLOCK_KIND_DOOR;
+                    }
+                }
+            }
+        }
+    }
+
+    // Breadth-first search over the region cells; returns the path length or ~0u
+    std::vector<Uint32> GridDist(RegionOpen.size());
+    std::vector<Uint32> GridQueue(RegionOpen.size());
+    const auto          SearchGrid = [&](const int2& Start, const int2& Goal) {
+        std::fill(GridDist.begin(), GridDist.end(), ~0u);
+        const auto Index = [&](const int2& Cell) { return static_cast<Uint32>((Cell.y - RegionOrigin.y) * RegionSize + Cell.x - RegionOrigin.x); };
+
+        const Uint32 GoalIdx = Index(Goal);
+        size_t       Head = 0, Tail = 0;
+        GridDist[Index(Start)] = 0;
+        GridQueue[Tail++]      = Index(Start);
+        while (Head < Tail)
+        {
+            const Uint32 Idx = GridQueue[Head++];
+            if (Idx == GoalIdx)
+                return GridDist[Idx];
+
+            const int x = static_cast<int>(Idx % RegionSize);
+            const int z = static_cast<int>(Idx / RegionSize);
+            for (const int2& Delta : DirDeltas)
+            {
+                const int nx = x + Delta.x;
+                const int nz = z + Delta.y;
+                if (nx < 0 || nz < 0 || nx >= RegionSize || nz >= RegionSize)
+                    continue;
+                const Uint32 Neighbor = static_cast<Uint32>(nz * RegionSize + nx);
+                if (RegionOpen[Neighbor] && GridDist[Neighbor] == ~0u)
+                {
+                    GridDist[Neighbor]  = GridDist[Idx] + 1;
+                    GridQueue[Tail++]   = Neighbor;
+                }
+            }
+        }
+        return ~0u;
+    };
+
+    // Random pairs of open cells
+    std::mt19937                       Rng{1234u};
+    std::uniform_int_distribution<int> RandCell{0, RegionSize - 1};
+    std::vector<std::pair<int2, int2>> Queries;
+    while (Queries.size() < NumQueries)
+    {
+        int2 Cells[2];
+        for (int2& Cell : Cells)
+        {
+            do
+            {
+                Cell = int2{RandCell(Rng), RandCell(Rng)};
+            } while (!RegionOpen[static_cast<size_t>(Cell.y) * RegionSize + Cell.x]);
+            Cell = Cell + RegionOrigin;
+        }
+        Queries.emplace_back(Cells[0], Cells[1]);
+    }
+
+    Timer               GridTimer;
+    std::vector<Uint32> GridLengths;
+    for (const auto& Query : Queries)
+        GridLengths.push_back(SearchGrid(Query.first, Query.second));
+    const double GridTime = GridTimer.GetElapsedTime();
+
+    // The first pass builds the clusters
+    MazePath Path;
+    Timer    ColdTimer;
+    for (const auto& Query : Queries)
+        Planner.FindPath(Query.first, Query.second, Path);
+    const double ColdTime = ColdTimer.GetElapsedTime();
+
+    Timer  FullTimer;
+    Uint64 GridLength = 0, PlannerLength = 0;
+    Uint32 NumFound   = 0;
+    for (size_t q = 0; q < Queries.size(); ++q)
+    {
+        Planner.FindPath(Queries[q].first, Queries[q].second, Path);
+        if (Path.Found != (GridLengths[q] != ~0u))
+        {
+            // Paths may leave the reference region, but a path inside the region must be found
+            if (GridLengths[q] != ~0u)
+                LOG_ERROR_MESSAGE("Path planner did not find a path from (", Queries[q].first.x, ", ", Queries[q].first.y, ") to (",
+                                  Queries[q].second.x, ", ", Queries[q].second.y, ") that the grid search found");
+            continue;
+        }
+        if (!Path.Found)
+            continue;
+
+        bool IsValid = Path.Cells.front() == Queries[q].first && Path.Cells.back() == Queries[q].second;
+        for (size_t c = 1; c < Path.Cells.size() && IsValid; ++c)
+            IsValid = std::abs(Path.Cells[c].x - Path.Cells[c - 1].x) + std::abs(Path.Cells[c].y - Path.Cells[c - 1].y) == 1;
+        if (!IsValid)
+            LOG_ERROR_MESSAGE("Path planner returned a broken path from (", Queries[q].first.x, ", ", Queries[q].first.y, ") to (",
+                              Queries[q].second.x, ", ", Queries[q].second.y, ")");
+
+        GridLength += GridLengths[q];
+        PlannerLength += Path.Cells.size() - 1;
+        ++NumFound;
+    }
+    const double FullTime = FullTimer.GetElapsedTime();
+
+    Planner.m_CI.MaxRefinedSegments = 2;
+    Timer LazyTimer;
+    for (const auto& Query : Queries)
+        Planner.FindPath(Query.first, Query.second, Path);
+    const double LazyTime = LazyTimer.GetElapsedTime();
+
+    // Unlock the doors of every cluster in the region one by one and compare with rebuilding all clusters
+    Timer  DoorTimer;
+    Uint32 NumDoorScopes = 0;
+    for (int cz = -RegionRadius; cz <= RegionRadius; ++cz)
+    {
+        for (int cx = -RegionRadius; cx <= RegionRadius; ++cx)
+        {
+            const Cluster& C = Planner.GetCells(int2{cx, cz});
+            if (C.ClosedDoors.empty())
+                continue;
+            Planner.OpenDoors(C.Coord, C.ClosedDoors.front().BlockType);
+            ++NumDoorScopes;
+        }
+    }
+    const double DoorTime = DoorTimer.GetElapsedTime();
+
+    // Building a graph may add neighbor clusters to the map
+    std::vector<Cluster*> Built;
+    for (auto& it : Planner.m_Clusters)
+    {
+        if (it.second.HasGraph)
+            Built.push_back(&it.second);
+    }
+    Timer RebuildTimer;
+    for (Cluster* pCluster : Built)
+        Planner.BuildGraph(*pCluster);
+    const double RebuildTime = RebuildTimer.GetElapsedTime();
+
+    LOG_INFO_MESSAGE("Path planner benchmark: ", NumQueries, " queries on ", RegionSize, "x", RegionSize, " generated cells, ", NumFound, " paths",
+                     "\n  grid BFS:             ", GridTime * 1e6 / NumQueries, " us/query",
+                     "\n  HPA*, cold clusters:  ", ColdTime * 1e6 / NumQueries, " us/query",
+                     "\n  HPA*, full refine:    ", FullTime * 1e6 / NumQueries, " us/query, ",
+                     static_cast<double>(PlannerLength) / std::max(GridLength, Uint64{1}), "x the shortest length",
+                     "\n  HPA*, lazy refine:    ", LazyTime * 1e6 / NumQueries, " us/query",
+                     "\n  door unlock:          ", DoorTime * 1e6 / std::max(NumDoorScopes, 1u), " us (", NumDoorScopes, " lock scopes); rebuilding all ",
+                     Built.size(), " clusters: ", RebuildTime * 1e6, " us");
+}
+
+} // namespace Diligent
@@ -0,0 +1,204 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "MazeChunk.hpp"
+
+namespace Diligent
+{
+
+// Result of a path query. The path is refined to cells only for its first segments;
+// the rest is a list of cluster entrances that the agent follows by querying again
+// when it runs out of cells.
+struct MazePath
+{
+    Uint32 RequestId = 0;
+    bool   Found     = false;
+
+    std::vector<int2> Cells;     // Cells from the start, the start included
+    std::vector<int2> Waypoints; // Unrefined entrances after the last cell, up to the goal
+};
+
+// Hierarchical path planner (HPA*) for the maze grid. The grid is split into clusters
+// that match the streaming chunks. Every cluster stores its entrances, which are cells on
+// the cluster border that connect to the neighbor cluster, and the in-cluster distances
+// between them. A query searches this graph of entrances and refines only the first
+// segments of the result into cells.
+//
+// The level clusters are built when the planner starts. Generated worlds are unbounded,
+// so their clusters are built the first time a search reaches them, and searches do not
+// leave the square of MaxSearchRadius clusters around the start.
+//
+// Queries and door updates run in order on a worker thread that owns the graph.
+class MazePathPlanner
+{
+public:
+    struct CreateInfo
+    {
+        // The level provides the cells, or only the block types if pGenerator is not null
+        const MazeLevel*     pLevel     = nullptr;
+        const MazeGenerator* pGenerator = nullptr;
+
+        // Cluster size in cells; must match the generator chunk size, which is also the door lock scope
+        int ClusterSize = 16;
+
+        // Chebyshev distance, in clusters, from the start cluster. Generated worlds only.
+        int MaxSearchRadius = 32;
+
+        // Number of path segments between entrances that are refined into cells
+        Uint32 MaxRefinedSegments = 2;
+    };
+
+    MazePathPlanner() = default;
+    ~MazePathPlanner();
+
+    // clang-format off
+    MazePathPlanner           (const MazePathPlanner&) = delete;
+    MazePathPlanner& operator=(const MazePathPlanner&) = delete;
+    MazePathPlanner           (MazePathPlanner&&)      = delete;
+    MazePathPlanner& operator=(MazePathPlanner&&)      = delete;
+    // clang-format on
+
+    void Start(const CreateInfo& CI);
+    void Stop();
+
+    // Queues a query from the start to the goal cell and returns its id, which is never 0
+    Uint32 RequestPath(const int2& Start, const int2& Goal);
+
+    // Moves the next finished query into Path. Returns false if no query has finished.
+    bool PopResult(MazePath& Path);
+
+    // Opens the doors of the given block type in the lock scope, see BuildMazeChunk().
+    // Only the clusters that contain the doors and their neighbors across the doors are updated.
+    void UnlockDoors(const int2& LockScope, Uint8 DoorBlockType);
+
+    // Blocks until all queued queries and door updates have been processed
+    void WaitIdle();
+
+    // Compares queries on a generated world with a cell-level search and measures door updates
+    // against rebuilding the clusters, and logs the results.
+    static void RunBenchmark(const MazeLevel& Level, const MazeGenerator& Generator, Uint32 NumQueries);
+
+private:
+    struct Edge
+    {
+        Uint16 Node; // Index in Cluster::Nodes
+        Uint16 Cost;
+    };
+
+    struct Cluster;
+
+    struct Node
+    {
+        Uint16            Cell       = 0; // Local cell index, z * ClusterSize + x
+        Uint8             PortalDirs = 0; // Bit mask of the directions in which the cell leads to the neighbor cluster
+        Uint16            Across[4]  = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF}; // Entrance on the other side of the border, found on first use
+        std::vector<Edge> Edges; // Paths to the other entrances inside the cluster
+
+        // Search state, valid if SearchId is the id of the current search
+        Uint32   SearchId   = 0;
+        Uint32   G          = 0;
+        bool     Closed     = false;
+        Cluster* pParent    = nullptr; // Null for the entrances reached from the start
+        Uint16   ParentNode = 0;
+    };
+
+    struct DoorCell
+    {
+        Uint16 Cell;
+        Uint8  BlockType;
+    };
+
+    struct Cluster
+    {
+        int2                  Coord;
+        std::vector<Uint8>    Open; // ClusterSize x ClusterSize, row by row
+        std::vector<DoorCell> ClosedDoors;
+        std::vector<Node>     Nodes;
+        Cluster*              pNeighbors[4] = {}; // Set when the graph is built
+        bool                  HasGraph      = false;
+    };
+
+    struct Command
+    {
+        bool   IsUnlock = false;
+        Uint32 RequestId = 0;
+        int2   Start; // Or the lock scope
+        int2   Goal;
+        Uint8  DoorBlockType = 0;
+    };
+
+    void WorkerThread();
+
+    void     Initialize(const CreateInfo& CI);
+    Cluster& GetCells(const int2& Coord);
+    Cluster& GetGraph(const int2& Coord);
+    void     BuildGraph(Cluster& C);
+    void     OpenDoors(const int2& LockScope, Uint8 DoorBlockType);
+    bool     IsSearchable(const int2& Coord, const int2& StartCoord) const;
+
+    // Distances from the local cell to every cell of the cluster; 0xFFFF for unreachable cells
+    void SearchCluster(const Cluster& C, Uint16 FromCell);
+    // Appends the cells after From up to and including To, which must be in the same cluster
+    bool RefineSegment(const int2& From, const int2& To, std::vector<int2>& Cells);
+
+    void FindPath(const int2& Start, const int2& Goal, MazePath& Path);
+
+    int2 GetClusterAt(const int2& Cell) const;
+    int2 GetLockScope(const int2& ClusterCoord) const;
+
+    CreateInfo m_CI;
+
+    // Worker thread only
+    std::unordered_map<Uint64, Cluster>        m_Clusters;
+    std::set<std::pair<Uint64, Uint8>>         m_UnlockedDoors; // Packed lock scope and door block type
+    std::vector<Uint16>                        m_SearchDist;
+    std::vector<Uint16>                        m_SearchParent;
+    std::vector<Uint16>                        m_SearchQueue;
+    Uint32                                     m_SearchId = 0;
+
+    // Shared with the worker thread
+    std::thread             m_Worker;
+    std::mutex              m_Mtx;
+    std::condition_variable m_WorkCV;
+    std::condition_variable m_IdleCV;
+    std::deque<Command>     m_Queue;
+    std::deque<MazePath>    m_Results;
+    bool                    m_Busy          = false;
+    bool                    m_Stop          = false;
+    Uint32                  m_NextRequestId = 1;
+};
+
+} // namespace Diligent
@@ -0,0 +1,286 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazePvs.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include "MazeFlowField.hpp"
+#include "MazeVisibility.hpp"
+#include "FileWrapper.hpp"
+#include "FileSystem.hpp"
+#include "DebugUtilities.hpp"
+#include "Align.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+bool IsSectionValid(size_t FileSize, Uint32 Offset, Uint64 Count, size_t ElementSize)
+{
+    return (Offset % 8) == 0 && Offset <= FileSize && Count * ElementSize <= FileSize - Offset;
+}
+
+// Appends the data to the blob at an 8-byte aligned offset and returns the offset
+Uint32 AppendSection(std::vector<Uint8>& Blob, const void* pData, size_t Size)
+{
+    Blob.resize(AlignUp(Blob.size(), size_t{8}));
+    const size_t Offset = Blob.size();
+    if (Size > 0)
+    {
+        Blob.resize(Offset + Size);
+        memcpy(Blob.data() + Offset, pData, Size);
+    }
+    return static_cast<Uint32>(Offset);
+}
+
+// Appends the run lengths of the square, starting with hidden cells. The last run of hidden cells is omitted.
+void EncodeRuns(const std::vector<Uint8>& Visible, std::vector<Uint16>& Runs)
+{
+    size_t Last = Visible.size();
+    while (Last > 0 && Visible[Last - 1] == 0)
+        --Last;
+
+    Uint8  Value = 0;
+    Uint16 Count = 0;
+    for (size_t i = 0; i < Last; ++i)
+    {
+        if (Visible[i] != Value)
+        {
+            Runs.push_back(Count);
+            Value = Visible[i];
+            Count = 0;
+        }
+        ++Count;
+    }
+    if (Count > 0)
+        Runs.push_back(Count);
+}
+
+} // namespace
+
+bool MazePvs::Bake(const char* Path, const BakeInfo& Info)
+{
+    VERIFY_EXPR(Info.pLevel != nullptr && Info.Radius > 0 && Info.Radius <= MaxRadius);
+
+    const MazeLevel& Level  = *Info.pLevel;
+    const int        Cols   = Level.GetCols();
+    const int        Rows   = Level.GetRows();
+    const int        Radius = Info.Radius;
+    const int        Size   = 2 * Radius + 1;
+
+    // All doors are closed
+    MazeFlowField            Field;
+    MazeFlowField::CreateInfo FieldCI;
+    FieldCI.pLevel = &Level;
+    Field.Initialize(FieldCI);
+
+    std::vector<MazePvsDoor> Doors;
+    for (int z = 0; z < Rows; ++z)
+    {
+        for (int x = 0; x < Cols; ++x)
+        {
+            if (Level.GetBlockType(Level.GetCell(x, z)).Kind == MAZE_BLOCK_KIND_DOOR)
+                Doors.push_back(MazePvsDoor{x, z});
+        }
+    }
+
+    // Every cell is viewed from a grid of points that includes its corners, in four directions
+    // that together cover all angles. Traversals from a door cell pass through the door.
+    static constexpr float Offsets[] = {0.02f, 0.5f, 0.98f};
+    static const float3    Directions[] = {float3{1, 0, 0}, float3{-1, 0, 0}, float3{0, 0, 1}, float3{0, 0, -1}};
+    static constexpr float HalfAngle    = PI_F / 4.f + 0.01f;
+
+    std::vector<std::vector<Uint16>> RowRuns(Rows);
+    std::vector<MazePvsCell>         Cells(static_cast<size_t>(Rows) * Cols);
+    std::atomic<int>                 NextRow{0};
+
+    const auto Worker = [&]() {
+        MazeVisibility             Visibility;
+        MazeVisibility::CreateInfo VisibilityCI;
+        VisibilityCI.pLevel = &Level;
+        VisibilityCI.pField = &Field;
+        Visibility.Initialize(VisibilityCI);
+
+        std::vector<Uint8> Visible(static_cast<size_t>(Size) * Size);
+        for (int z = NextRow.fetch_add(1); z < Rows; z = NextRow.fetch_add(1))
+        {
+            std::vector<Uint16>& Runs = RowRuns[z];
+            for (int x = 0; x < Cols; ++x)
+            {
+                MazePvsCell& Cell = Cells[static_cast<size_t>(z) * Cols + x];
+                Cell.FirstRun     = static_cast<Uint32>(Runs.size());
+                Cell.NumRuns      = 0;
+                if (Level.GetBlockType(Level.GetCell(x, z)).Kind == MAZE_BLOCK_KIND_WALL)
+                    continue;
+
+                std::fill(Visible.begin(), Visible.end(), Uint8{0});
+                const int2 Origin{x - Radius, z - Radius};
+                for (float OffsetZ : Offsets)
+                {
+                    for (float OffsetX : Offsets)
+                    {
+                        const float3 Pos{(x + OffsetX - Cols / 2.0f - 0.5f) * Level.GetCellSize(), 0,
+                                         (z + OffsetZ - Rows / 2.0f - 0.5f) * Level.GetCellSize()};
+                        for (const float3& Dir : Directions)
+                        {
+                            Visibility.Update(Pos, Dir, HalfAngle, Radius);
+                            Visibility.ProcessVisibleCells([&](const int2& VisibleCell) {
+                                const int2 Local = VisibleCell - Origin;
+                                if (Local.x >= 0 && Local.y >= 0 && Local.x < Size && Local.y < Size)
+                                    Visible[static_cast<size_t>(Local.y) * Size + Local.x] = 1;
+                            });
+                        }
+                    }
+                }
+                EncodeRuns(Visible, Runs);
+                Cell.NumRuns = static_cast<Uint32>(Runs.size()) - Cell.FirstRun;
+            }
+        }
+    };
+
+    const int NumThreads = std::max(std::min(static_cast<int>(std::thread::hardware_concurrency()), Rows), 1);
+
+    std::vector<std::thread> Threads;
+    for (int t = 1; t < NumThreads; ++t)
+        Threads.emplace_back(Worker);
+    Worker();
+    for (auto& Thread : Threads)
+        Thread.join();
+
+    // Merge the runs of all rows
+    std::vector<Uint16> Runs;
+    for (int z = 0; z < Rows; ++z)
+    {
+        const Uint32 FirstRun = static_cast<Uint32>(Runs.size());
+        for (int x = 0; x < Cols; ++x)
+            Cells[static_cast<size_t>(z) * Cols + x].FirstRun += FirstRun;
+        Runs.insert(Runs.end(), RowRuns[z].begin(), RowRuns[z].end());
+    }
+
+    MazePvsHeader Header{};
+    Header.Magic       = MazePvsMagic;
+    Header.Version     = MazePvsVersion;
+    Header.ContentHash = Info.ContentHash;
+    Header.Cols        = static_cast<Uint32>(Cols);
+    Header.Rows        = static_cast<Uint32>(Rows);
+    Header.Radius      = static_cast<Uint32>(Radius);
+    Header.NumDoors    = static_cast<Uint32>(Doors.size());
+    Header.NumRuns     = static_cast<Uint32>(Runs.size());
+
+    std::vector<Uint8> Blob(sizeof(Header));
+    Header.DoorsOffset = AppendSection(Blob, Doors.data(), Doors.size() * sizeof(Doors[0]));
+    Header.CellsOffset = AppendSection(Blob, Cells.data(), Cells.size() * sizeof(Cells[0]));
+    Header.RunsOffset  = AppendSection(Blob, Runs.data(), Runs.size() * sizeof(Runs[0]));
+    memcpy(Blob.data(), &Header, sizeof(Header));
+
+    FileWrapper File{Path, EFileAccessMode::Overwrite};
+    if (!File || !File->Write(Blob.data(), Blob.size()))
+    {
+        LOG_WARNING_MESSAGE("Failed to write visibility sets '", Path, "'");
+        return false;
+    }
+    return true;
+}
+
+bool MazePvs::Load(const char* Path, Uint64 ContentHash)
+{
+    Close();
+
+    // Missing sets are not an error
+    if (!FileSystem::FileExists(Path) || !m_File.Open(Path))
+        return false;
+
+    const Uint8* pData    = m_File.GetData();
+    const size_t FileSize = m_File.GetSize();
+    if (FileSize < sizeof(MazePvsHeader))
+        return false;
+
+    const auto* pHeader = reinterpret_cast<const MazePvsHeader*>(pData);
+    if (pHeader->Magic != MazePvsMagic || pHeader->Version != MazePvsVersion || pHeader->ContentHash != ContentHash)
+    {
+        LOG_INFO_MESSAGE("Visibility sets '", Path, "' are out of date");
+        m_File.Close();
+        return false;
+    }
+
+    const Uint64 NumCells = Uint64{pHeader->Cols} * Uint64{pHeader->Rows};
+    // clang-format off
+    if (pHeader->Radius == 0 || pHeader->Radius > MaxRadius                                          ||
+        !IsSectionValid(FileSize, pHeader->DoorsOffset, pHeader->NumDoors, sizeof(MazePvsDoor)) ||
+        !IsSectionValid(FileSize, pHeader->CellsOffset, NumCells,          sizeof(MazePvsCell)) ||
+        !IsSectionValid(FileSize, pHeader->RunsOffset,  pHeader->NumRuns,  sizeof(Uint16)))
+    // clang-format on
+    {
+        LOG_WARNING_MESSAGE("Visibility sets '", Path, "' are corrupted and will be rebuilt");
+        m_File.Close();
+        return false;
+    }
+
+    // Runs must not extend past the square of the cell
+    const Uint64 SquareSize = Uint64{pHeader->Radius * 2 + 1} * Uint64{pHeader->Radius * 2 + 1};
+    const auto*  pCells     = reinterpret_cast<const MazePvsCell*>(pData + pHeader->CellsOffset);
+    const auto*  pRuns      = reinterpret_cast<const Uint16*>(pData + pHeader->RunsOffset);
+    for (Uint64 i = 0; i < NumCells; ++i)
+    {
+        bool IsValid = Uint64{pCells[i].FirstRun} + pCells[i].NumRuns <= pHeader->NumRuns;
+        if (IsValid)
+        {
+            Uint64 Length = 0;
+            for (Uint32 r = 0; r < pCells[i].NumRuns; ++r)
+                Length += pRuns[pCells[i].FirstRun + r];
+            IsValid = Length <= SquareSize;
+        }
+        if (!IsValid)
+        {
+            LOG_WARNING_MESSAGE("Visibility sets '", Path, "' are corrupted and will be rebuilt");
+            m_File.Close();
+            return false;
+        }
+    }
+
+    m_pHeader = pHeader;
+    m_pDoors  = reinterpret_cast<const MazePvsDoor*>(pData + pHeader->DoorsOffset);
+    m_pCells  = pCells;
+    m_pRuns   = pRuns;
+    return true;
+}
+
+void MazePvs::Close()
+{
+    m_pHeader = nullptr;
+    m_pDoors  = nullptr;
+    m_pCells  = nullptr;
+    m_pRuns   = nullptr;
+    m_File.Close();
+}
+
+} // namespace Diligent
@@ -0,0 +1,146 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "MazeLevel.hpp"
+
+namespace Diligent
+{
+
+// Precomputed potentially visible sets of the cells of a level (little-endian):
+//
+//  | MazePvsHeader | MazePvsDoor[NumDoors] | MazePvsCell[Rows * Cols] | Uint16 Runs[NumRuns] |
+//
+// The set of a cell holds the cells of the square of Radius cells around it that may be seen
+// from any point in the cell with all doors closed. It is stored as run lengths over the square,
+// row by row, alternating between hidden and visible cells and starting with hidden ones.
+// Walls have no set. The set of a door cell is baked as if the door were open and holds the cells
+// seen through the door; it is added to the set of the camera's cell while the door is open and
+// visible. Like the scene cache, the file is keyed by a hash of the level contents and the radius.
+// Sections are aligned to 8 bytes.
+
+static constexpr Uint32 MazePvsMagic   = 0x56504252; // 'BRPV'
+static constexpr Uint32 MazePvsVersion = 1;
+
+struct MazePvsHeader
+{
+    Uint32 Magic;
+    Uint32 Version;
+    Uint64 ContentHash;
+
+    Uint32 Cols;
+    Uint32 Rows;
+    Uint32 Radius;
+
+    Uint32 NumDoors;
+    Uint32 DoorsOffset;
+    Uint32 CellsOffset;
+
+    Uint32 NumRuns;
+    Uint32 RunsOffset;
+};
+static_assert(sizeof(MazePvsHeader) == 48, "Unexpected MazePvsHeader size");
+
+struct MazePvsCell
+{
+    Uint32 FirstRun;
+    Uint32 NumRuns;
+};
+static_assert(sizeof(MazePvsCell) == 8, "Unexpected MazePvsCell size");
+
+struct MazePvsDoor
+{
+    Int32 x;
+    Int32 z;
+};
+static_assert(sizeof(MazePvsDoor) == 8, "Unexpected MazePvsDoor size");
+
+class MazePvs
+{
+public:
+    // Run lengths are 16-bit
+    static constexpr int MaxRadius = 127;
+
+    struct BakeInfo
+    {
+        const MazeLevel* pLevel      = nullptr;
+        Uint64           ContentHash = 0;
+        int              Radius      = 64;
+    };
+
+    // Computes the sets of all cells of the level and writes the file.
+    // Returns false if the file could not be written.
+    static bool Bake(const char* Path, const BakeInfo& Info);
+
+    // Maps the file. Returns false if the file does not exist, is invalid,
+    // or was baked from different content.
+    bool Load(const char* Path, Uint64 ContentHash);
+
+    void Close();
+
+    bool IsLoaded() const { return m_pHeader != nullptr; }
+
+    int GetRadius() const { return static_cast<int>(m_pHeader->Radius); }
+
+    Uint32 GetNumDoors() const { return m_pHeader->NumDoors; }
+    int2   GetDoor(Uint32 i) const { return int2{m_pDoors[i].x, m_pDoors[i].z}; }
+
+    // Returns true if the cell has a set
+    bool HasCell(const int2& Cell) const
+    {
+        Uint32 NumRuns = 0;
+        return GetRuns(Cell, NumRuns) != nullptr;
+    }
+
+    // Returns the runs of the cell's set, or null if the cell has no set
+    const Uint16* GetRuns(const int2& Cell, Uint32& NumRuns) const
+    {
+        if (!IsLoaded() || Cell.x < 0 || Cell.y < 0 ||
+            static_cast<Uint32>(Cell.x) >= m_pHeader->Cols || static_cast<Uint32>(Cell.y) >= m_pHeader->Rows)
+            return nullptr;
+
+        const MazePvsCell& Src = m_pCells[static_cast<size_t>(Cell.y) * m_pHeader->Cols + static_cast<size_t>(Cell.x)];
+        NumRuns                = Src.NumRuns;
+        return NumRuns > 0 ? m_pRuns + Src.FirstRun : nullptr;
+    }
+
+    Uint32 GetNumRuns() const { return m_pHeader->NumRuns; }
+    size_t GetFileSize() const { return m_File.GetSize(); }
+
+private:
+    MappedFile m_File;
+
+    const MazePvsHeader* m_pHeader = nullptr;
+    const MazePvsDoor*   m_pDoors  = nullptr;
+    const MazePvsCell*   m_pCells  = nullptr;
+    const Uint16*        m_pRuns   = nullptr;
+};
+
+} // namespace Diligent
@@ -0,0 +1,252 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeRayCaster.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "DebugUtilities.hpp"
+#include "Timer.hpp"
+
+namespace Diligent
+{
+
+void MazeRayCaster::Initialize(const CreateInfo& CI)
+{
+    VERIFY_EXPR(CI.pLevel != nullptr && CI.pField != nullptr);
+    m_CI = CI;
+}
+
+MazeRayHit MazeRayCaster::CastRay(const float3& Origin, const float3& Dir, float MaxDistance) const
+{
+    const MazeLevel&     Level    = *m_CI.pLevel;
+    const MazeFlowField& Field    = *m_CI.pField;
+    const float          CellSize = Level.GetCellSize();
+
+    // Position in cell units, see MazeLevel::GetCellAt(). Cell x spans [x, x + 1).
+    const float u = Origin.x / CellSize + Level.GetCols() / 2.0f + 0.5f;
+    const float v = Origin.z / CellSize + Level.GetRows() / 2.0f + 0.5f;
+
+    MazeRayHit Hit;
+    Hit.Cell     = int2{static_cast<int>(std::floor(u)), static_cast<int>(std::floor(v))};
+    Hit.Distance = MaxDistance;
+    if (!Field.IsInWindow(Hit.Cell))
+    {
+        Hit.Type     = MAZE_RAY_HIT_OUT_OF_RANGE;
+        Hit.Distance = 0;
+        return Hit;
+    }
+
+    const float Len = std::sqrt(Dir.x * Dir.x + Dir.z * Dir.z);
+    if (Len == 0)
+        return Hit;
+    const float DirX = Dir.x / Len;
+    const float DirZ = Dir.z / Len;
+
+    // Distances along the ray to the next cell boundary on each axis and between two boundaries
+    constexpr float Inf    = std::numeric_limits<float>::infinity();
+    const int       StepX  = DirX > 0 ? 1 : -1;
+    const int       StepZ  = DirZ > 0 ? 1 : -1;
+    const float     DeltaX = DirX != 0 ? CellSize / std::abs(DirX) : Inf;
+    const float     DeltaZ = DirZ != 0 ? CellSize / std::abs(DirZ) : Inf;
+    float           NextX  = DirX > 0 ? (Hit.Cell.x + 1 - u) * DeltaX : (DirX < 0 ? (u - Hit.Cell.x) * DeltaX : Inf);
+    float           NextZ  = DirZ > 0 ? (Hit.Cell.y + 1 - v) * DeltaZ : (DirZ < 0 ? (v - Hit.Cell.y) * DeltaZ : Inf);
+
+    int2 Cell = Hit.Cell;
+    while (true)
+    {
+        float Dist;
+        int2  Normal;
+        if (NextX < NextZ)
+        {
+            Dist = NextX;
+            Cell.x += StepX;
+            NextX += DeltaX;
+            Normal = int2{-StepX, 0};
+        }
+        else
+        {
+            Dist = NextZ;
+            Cell.y += StepZ;
+            NextZ += DeltaZ;
+            Normal = int2{0, -StepZ};
+        }
+
+        if (Dist >= MaxDistance)
+            return Hit;
+
+        if (!Field.IsInWindow(Cell) || Field.IsBlocked(Cell))
+        {
+            Hit.Type     = Field.IsInWindow(Cell) ? MAZE_RAY_HIT_WALL : MAZE_RAY_HIT_OUT_OF_RANGE;
+            Hit.Distance = Dist;
+            Hit.Cell     = Cell;
+            Hit.Normal   = Normal;
+            return Hit;
+        }
+    }
+}
+
+bool MazeRayCaster::HasLineOfSight(const float3& From, const float3& To) const
+{
+    const float3     Dir = float3{To.x - From.x, 0, To.z - From.z};
+    const MazeRayHit Hit = CastRay(From, Dir, length(Dir));
+    return Hit.Type == MAZE_RAY_HIT_NONE || (Hit.Type == MAZE_RAY_HIT_WALL && Hit.Cell == m_CI.pLevel->GetCellAt(To));
+}
+
+void MazeRayCaster::CastRays(Uint32 NumRays, const float3* pOrigins, const float3* pDirs, const float* pMaxDistances, MazeRayHit* pHits) const
+{
+    for (Uint32 i = 0; i < NumRays; ++i)
+        pHits[i] = CastRay(pOrigins[i], pDirs[i], pMaxDistances[i]);
+}
+
+void MazeRayCaster::TestLinesOfSight(Uint32 NumRays, const float3* pFrom, const float3* pTo, bool* pVisible) const
+{
+    for (Uint32 i = 0; i < NumRays; ++i)
+        pVisible[i] = HasLineOfSight(pFrom[i], pTo[i]);
+}
+
+void MazeRayCaster::RunBenchmark(const MazeLevel& Level, const MazeGenerator& Generator, Uint32 NumRays)
+{
+    if (!Generator.IsInitialized() || NumRays == 0)
+        return;
+
+    // All doors stay closed
+    MazeFlowField::CreateInfo FieldCI;
+    FieldCI.pLevel     = &Level;
+    FieldCI.pGenerator = &Generator;
+
+    MazeFlowField Field;
+    Field.Initialize(FieldCI);
+    Field.SetTarget(MazeGenerator::GetSpawnCell());
+
+    CreateInfo CI;
+    CI.pLevel = &Level;
+    CI.pField = &Field;
+
+    MazeRayCaster Caster;
+    Caster.Initialize(CI);
+
+    // Rays of up to 20 cells start at random points of the open cells around the spawn cell
+    std::vector<int2> Cells;
+    Field.GetReachableCells(0, Cells);
+    const float CellSize    = Level.GetCellSize();
+    const float MaxDistance = CellSize * 20;
+
+    std::mt19937                          Rng{1234u};
+    std::uniform_real_distribution<float> RandOffset{-0.5f, 0.5f};
+    std::uniform_real_distribution<float> RandAngle{0, 2 * PI_F};
+    std::vector<float3>                   Origins(NumRays), Dirs(NumRays), Targets(NumRays);
+    std::vector<float>                    MaxDistances(NumRays, MaxDistance);
+    for (Uint32 i = 0; i < NumRays; ++i)
+    {
+        const int2  Cell  = Cells[Rng() % Cells.size()];
+        const float Angle = RandAngle(Rng);
+        Origins[i]        = Level.GetCellCenter(Cell.x, Cell.y) + float3{RandOffset(Rng), 0, RandOffset(Rng)} * CellSize;
+        Dirs[i]           = float3{std::cos(Angle), 0, std::sin(Angle)};
+        Targets[i]        = Origins[i] + Dirs[i] * (MaxDistance * std::abs(RandOffset(Rng)) * 2);
+    }
+
+    std::vector<MazeRayHit> Hits(NumRays);
+    Timer                   CastTimer;
+    Caster.CastRays(NumRays, Origins.data(), Dirs.data(), MaxDistances.data(), Hits.data());
+    const double CastTime = CastTimer.GetElapsedTime();
+
+    std::unique_ptr<bool[]> Visible{new bool[NumRays]};
+    Timer                   SightTimer;
+    Caster.TestLinesOfSight(NumRays, Origins.data(), Targets.data(), Visible.get());
+    const double SightTime = SightTimer.GetElapsedTime();
+
+    // Brute-force reference: the closest entry into any blocked or unknown cell around the ray
+    Uint32       NumMismatches = 0, NumWallHits = 0, NumVisible = 0;
+    const Uint32 NumChecked    = std::min(NumRays, 10000u);
+    for (Uint32 i = 0; i < NumChecked; ++i)
+    {
+        const int2 StartCell = Level.GetCellAt(Origins[i]);
+        const int2 EndCell   = Level.GetCellAt(Origins[i] + Dirs[i] * MaxDistance);
+
+        MazeRayHit Ref;
+        Ref.Distance = MaxDistance;
+        for (int z = std::min(StartCell.y, EndCell.y) - 1; z <= std::max(StartCell.y, EndCell.y) + 1; ++z)
+        {
+            for (int x = std::min(StartCell.x, EndCell.x) - 1; x <= std::max(StartCell.x, EndCell.x) + 1; ++x)
+            {
+                const int2 Cell{x, z};
+                if (Cell == StartCell || (Field.IsInWindow(Cell) && !Field.IsBlocked(Cell)))
+                    continue;
+
+                // Slab test against the cell square
+                const float3 Min   = Level.GetCellCenter(x, z) - float3{CellSize, 0, CellSize} * 0.5f;
+                float        Enter = 0, Exit = MaxDistance;
+                for (int Axis : {0, 2})
+                {
+                    const float o = Origins[i][Axis], d = Dirs[i][Axis];
+                    const float Lo = Min[Axis], Hi = Min[Axis] + CellSize;
+                    if (d == 0)
+                    {
+                        if (o < Lo || o >= Hi)
+                            Exit = -1;
+                        continue;
+                    }
+                    const float t0 = (Lo - o) / d, t1 = (Hi - o) / d;
+                    Enter = std::max(Enter, std::min(t0, t1));
+                    Exit  = std::min(Exit, std::max(t0, t1));
+                }
+                if (Enter <= Exit && Enter < Ref.Distance)
+                {
+                    Ref.Type     = Field.IsInWindow(Cell) ? MAZE_RAY_HIT_WALL : MAZE_RAY_HIT_OUT_OF_RANGE;
+                    Ref.Distance = Enter;
+                    Ref.Cell     = Cell;
+                }
+            }
+        }
+
+        const MazeRayHit& Hit = Hits[i];
+        if (Hit.Type != Ref.Type || std::abs(Hit.Distance - Ref.Distance) > 1e-3f * CellSize ||
+            (Hit.Type != MAZE_RAY_HIT_NONE && Hit.Cell != Ref.Cell))
+            ++NumMismatches;
+    }
+    for (Uint32 i = 0; i < NumRays; ++i)
+    {
+        NumWallHits += Hits[i].Type == MAZE_RAY_HIT_WALL ? 1 : 0;
+        NumVisible += Visible[i] ? 1 : 0;
+    }
+
+    // Rays that graze the corner of a cell may legitimately hit either of its neighbors
+    if (NumMismatches > NumChecked / 1000)
+        LOG_ERROR_MESSAGE("Ray caster benchmark: ", NumMismatches, " of ", NumChecked, " rays do not match the brute-force intersection");
+
+    LOG_INFO_MESSAGE("Ray caster benchmark (", NumRays, " rays of up to 20 cells): ",
+                     NumRays / CastTime / 1e6, "M rays/s (", NumWallHits * 100.0 / NumRays, "% hit a wall), ",
+                     NumRays / SightTime / 1e6, "M line-of-sight tests/s (", NumVisible * 100.0 / NumRays, "% visible); ",
+                     NumMismatches, " of ", NumChecked, " rays differ from the brute-force intersection");
+}
+
+} // namespace Diligent
@@ -0,0 +1,87 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include "MazeFlowField.hpp"
+
+namespace Diligent
+{
+
+enum MAZE_RAY_HIT : Uint8
+{
+    MAZE_RAY_HIT_NONE = 0,     // The ray reached its maximum distance
+    MAZE_RAY_HIT_WALL,         // The ray hit a wall or a closed door
+    MAZE_RAY_HIT_OUT_OF_RANGE, // The ray left the cells known to the flow field
+};
+
+struct MazeRayHit
+{
+    MAZE_RAY_HIT Type = MAZE_RAY_HIT_NONE;
+
+    float Distance = 0; // Horizontal distance to the hit, the end of the ray or the edge of the known cells
+    int2  Cell;         // Cell that was hit
+    int2  Normal;       // Side of the cell that was hit, e.g. {-1, 0} for the side that faces -X
+};
+
+// Casts rays on the CPU through the cells of the flow field window with a 2D DDA. Walls and
+// closed doors fill their cells, so a ray visits only the cells it crosses until the first
+// blocked one, and the cost depends on the distance rather than on the number of walls.
+// The GPU acceleration structures are not used.
+//
+// Rays are horizontal; the Y coordinate is ignored. The cell that contains the origin of the
+// ray is never hit, so rays cast from an agent that clipped into a wall still leave it.
+// All methods are const and may be called from several threads while the field is not updated.
+class MazeRayCaster
+{
+public:
+    struct CreateInfo
+    {
+        const MazeLevel*     pLevel = nullptr;
+        const MazeFlowField* pField = nullptr; // Provides the blocked cells
+    };
+    void Initialize(const CreateInfo& CI);
+
+    // Dir does not need to be normalized
+    MazeRayHit CastRay(const float3& Origin, const float3& Dir, float MaxDistance) const;
+
+    // Returns true if no blocked cell lies between the cells of From and To and all cells on
+    // the way are known. The cell of To is not tested.
+    bool HasLineOfSight(const float3& From, const float3& To) const;
+
+    // Batched versions of the queries above for arrays of NumRays elements
+    void CastRays(Uint32 NumRays, const float3* pOrigins, const float3* pDirs, const float* pMaxDistances, MazeRayHit* pHits) const;
+    void TestLinesOfSight(Uint32 NumRays, const float3* pFrom, const float3* pTo, bool* pVisible) const;
+
+    // Checks random rays on a generated world against a brute-force intersection with every
+    // blocked cell, measures the rays per second and logs the results.
+    static void RunBenchmark(const MazeLevel& Level, const MazeGenerator& Generator, Uint32 NumRays);
+
+private:
+    CreateInfo m_CI;
+};
+
+} // namespace Diligent
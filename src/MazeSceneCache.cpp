@@ -0,0 +1,213 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeSceneCache.hpp"
+
+#include <cstring>
+
+#include "FileWrapper.hpp"
+#include "FileSystem.hpp"
+#include "DebugUtilities.hpp"
+#include "Align.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+bool IsSectionValid(size_t FileSize, Uint32 Offset, Uint64 Count, size_t ElementSize)
+{
+    return (Offset % 8) == 0 && Offset <= FileSize && Count * ElementSize <= FileSize - Offset;
+}
+
+// Appends the data to the blob at an 8-byte aligned offset and returns the offset
+Uint32 AppendSection(std::vector<Uint8>& Blob, const void* pData, size_t Size)
+{
+    Blob.resize(AlignUp(Blob.size(), size_t{8}));
+    const size_t Offset = Blob.size();
+    if (Size > 0)
+    {
+        Blob.resize(Offset + Size);
+        memcpy(Blob.data() + Offset, pData, Size);
+    }
+    return static_cast<Uint32>(Offset);
+}
+
+} // namespace
+
+bool MazeSceneCache::Write(const char* Path, const BakeInfo& Info)
+{
+    VERIFY_EXPR(Info.pChunks != nullptr || Info.NumChunks.x * Info.NumChunks.y == 0);
+
+    const size_t NumChunks = static_cast<size_t>(Info.NumChunks.x) * static_cast<size_t>(Info.NumChunks.y);
+
+    std::vector<MazeSceneCacheChunk> Chunks(NumChunks);
+    std::vector<MazeChunkBox>        Boxes;
+    for (size_t i = 0; i < NumChunks; ++i)
+    {
+        const MazeChunk& Chunk = Info.pChunks[i];
+        Chunks[i].FirstBox     = static_cast<Uint32>(Boxes.size());
+        Chunks[i].NumBoxes     = static_cast<Uint32>(Chunk.Boxes.size());
+        Chunks[i].NumWalls     = Chunk.NumWalls;
+        Boxes.insert(Boxes.end(), Chunk.Boxes.begin(), Chunk.Boxes.end());
+    }
+
+    std::vector<MazeSceneCacheMesh> Meshes(Info.NumMeshes);
+    for (Uint32 i = 0; i < Info.NumMeshes; ++i)
+    {
+        const MeshDesc&     Src = Info.pMeshes[i];
+        MazeSceneCacheMesh& Dst = Meshes[i];
+        memset(Dst.Name, 0, sizeof(Dst.Name));
+        strncpy(Dst.Name, Src.Name.c_str(), sizeof(Dst.Name) - 1);
+        Dst.FirstVertex = Src.FirstVertex;
+        Dst.NumVertices = Src.NumVertices;
+        Dst.FirstIndex  = Src.FirstIndex;
+        Dst.NumIndices  = Src.NumIndices;
+        Dst.Material    = Src.Material;
+    }
+
+    MazeSceneCacheHeader Header{};
+    Header.Magic        = MazeSceneCacheMagic;
+    Header.Version      = MazeSceneCacheVersion;
+    Header.ContentHash  = Info.ContentHash;
+    Header.ChunkSize    = static_cast<Uint32>(Info.ChunkSize);
+    Header.NumChunksX   = static_cast<Uint32>(Info.NumChunks.x);
+    Header.NumChunksZ   = static_cast<Uint32>(Info.NumChunks.y);
+    Header.NumBoxes     = static_cast<Uint32>(Boxes.size());
+    Header.NumMeshes    = Info.NumMeshes;
+    Header.VertexStride = Info.VertexStride;
+    Header.NumVertices  = Info.NumVertices;
+    Header.NumIndices   = Info.NumIndices;
+
+    std::vector<Uint8> Blob(sizeof(Header));
+    Header.MeshesOffset   = AppendSection(Blob, Meshes.data(), Meshes.size() * sizeof(Meshes[0]));
+    Header.ChunksOffset   = AppendSection(Blob, Chunks.data(), Chunks.size() * sizeof(Chunks[0]));
+    Header.BoxesOffset    = AppendSection(Blob, Boxes.data(), Boxes.size() * sizeof(Boxes[0]));
+    Header.VerticesOffset = AppendSection(Blob, Info.pVertices, size_t{Info.VertexStride} * Info.NumVertices);
+    Header.IndicesOffset  = AppendSection(Blob, Info.pIndices, size_t{Info.NumIndices} * sizeof(Uint32));
+    memcpy(Blob.data(), &Header, sizeof(Header));
+
+    FileWrapper File{Path, EFileAccessMode::Overwrite};
+    if (!File || !File->Write(Blob.data(), Blob.size()))
+    {
+        LOG_WARNING_MESSAGE("Failed to write scene cache '", Path, "'");
+        return false;
+    }
+    return true;
+}
+
+bool MazeSceneCache::Load(const char* Path, Uint64 ContentHash)
+{
+    Close();
+
+    // A missing cache is not an error
+    if (!FileSystem::FileExists(Path) || !m_File.Open(Path))
+        return false;
+
+    const Uint8* pData    = m_File.GetData();
+    const size_t FileSize = m_File.GetSize();
+    if (FileSize < sizeof(MazeSceneCacheHeader))
+        return false;
+
+    const auto* pHeader = reinterpret_cast<const MazeSceneCacheHeader*>(pData);
+    if (pHeader->Magic != MazeSceneCacheMagic || pHeader->Version != MazeSceneCacheVersion || pHeader->ContentHash != ContentHash)
+    {
+        LOG_INFO_MESSAGE("Scene cache '", Path, "' is out of date");
+        m_File.Close();
+        return false;
+    }
+
+    const Uint64 NumChunks = Uint64{pHeader->NumChunksX} * Uint64{pHeader->NumChunksZ};
+    // clang-format off
+    if (!IsSectionValid(FileSize, pHeader->MeshesOffset,   pHeader->NumMeshes,   sizeof(MazeSceneCacheMesh))  ||
+        !IsSectionValid(FileSize, pHeader->ChunksOffset,   NumChunks,            sizeof(MazeSceneCacheChunk)) ||
+        !IsSectionValid(FileSize, pHeader->BoxesOffset,    pHeader->NumBoxes,    sizeof(MazeChunkBox))        ||
+        !IsSectionValid(FileSize, pHeader->VerticesOffset, pHeader->NumVertices, pHeader->VertexStride)       ||
+        !IsSectionValid(FileSize, pHeader->IndicesOffset,  pHeader->NumIndices,  sizeof(Uint32)))
+    // clang-format on
+    {
+        LOG_WARNING_MESSAGE("Scene cache '", Path, "' is corrupted and will be rebuilt");
+        m_File.Close();
+        return false;
+    }
+
+    const auto* pChunks = reinterpret_cast<const MazeSceneCacheChunk*>(pData + pHeader->ChunksOffset);
+    for (Uint64 i = 0; i < NumChunks; ++i)
+    {
+        if (Uint64{pChunks[i].FirstBox} + pChunks[i].NumBoxes > pHeader->NumBoxes || pChunks[i].NumWalls > pChunks[i].NumBoxes)
+        {
+            LOG_WARNING_MESSAGE("Scene cache '", Path, "' is corrupted and will be rebuilt");
+            m_File.Close();
+            return false;
+        }
+    }
+
+    m_pHeader = pHeader;
+    m_pMeshes = reinterpret_cast<const MazeSceneCacheMesh*>(pData + pHeader->MeshesOffset);
+    m_pChunks = pChunks;
+    m_pBoxes  = reinterpret_cast<const MazeChunkBox*>(pData + pHeader->BoxesOffset);
+    return true;
+}
+
+void MazeSceneCache::Close()
+{
+    m_pHeader = nullptr;
+    m_pMeshes = nullptr;
+    m_pChunks = nullptr;
+    m_pBoxes  = nullptr;
+    m_File.Close();
+}
+
+bool MazeSceneCache::GetChunk(const int2& Coord, MazeChunk& Chunk) const
+{
+    if (!IsLoaded() || Coord.x < 0 || Coord.y < 0 ||
+        static_cast<Uint32>(Coord.x) >= m_pHeader->NumChunksX || static_cast<Uint32>(Coord.y) >= m_pHeader->NumChunksZ)
+        return false;
+
+    const MazeSceneCacheChunk& Src = m_pChunks[static_cast<size_t>(Coord.y) * m_pHeader->NumChunksX + static_cast<size_t>(Coord.x)];
+
+    Chunk.Coord = Coord;
+    Chunk.Boxes.assign(m_pBoxes + Src.FirstBox, m_pBoxes + Src.FirstBox + Src.NumBoxes);
+    Chunk.NumWalls = Src.NumWalls;
+    return true;
+}
+
+MazeSceneCache::MeshDesc MazeSceneCache::GetMesh(Uint32 i) const
+{
+    const MazeSceneCacheMesh& Src = m_pMeshes[i];
+
+    MeshDesc Desc;
+    Desc.Name        = String{Src.Name, strnlen(Src.Name, sizeof(Src.Name))};
+    Desc.FirstVertex = Src.FirstVertex;
+    Desc.NumVertices = Src.NumVertices;
+    Desc.FirstIndex  = Src.FirstIndex;
+    Desc.NumIndices  = Src.NumIndices;
+    Desc.Material    = Src.Material;
+    return Desc;
+}
+
+} // namespace Diligent
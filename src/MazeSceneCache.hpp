@@ -0,0 +1,163 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "MazeChunk.hpp"
+
+namespace Diligent
+{
+
+// Baked scene data of a level (little-endian):
+//
+//  | MazeSceneCacheHeader | MazeSceneCacheMesh[NumMeshes] | MazeSceneCacheChunk[NumChunksX * NumChunksZ] | MazeChunkBox[NumBoxes] | Vertices | Uint32 Indices[NumIndices] |
+//
+// The cache is keyed by a hash of everything it was baked from: the level file contents and the
+// parameters that affect chunks and meshes. Like the level, it is used directly from the mapped file.
+// Sections are aligned to 8 bytes.
+
+static constexpr Uint32 MazeSceneCacheMagic   = 0x43534252; // 'BRSC'
+static constexpr Uint32 MazeSceneCacheVersion = 2;
+
+struct MazeSceneCacheHeader
+{
+    Uint32 Magic;
+    Uint32 Version;
+    Uint64 ContentHash;
+
+    Uint32 ChunkSize;
+    Uint32 NumChunksX;
+    Uint32 NumChunksZ;
+    Uint32 ChunksOffset;
+
+    Uint32 NumBoxes;
+    Uint32 BoxesOffset;
+
+    Uint32 NumMeshes;
+    Uint32 MeshesOffset;
+
+    Uint32 VertexStride;
+    Uint32 NumVertices;
+    Uint32 VerticesOffset;
+
+    Uint32 NumIndices;
+    Uint32 IndicesOffset;
+    Uint32 Reserved;
+};
+static_assert(sizeof(MazeSceneCacheHeader) == 72, "Unexpected MazeSceneCacheHeader size");
+
+struct MazeSceneCacheMesh
+{
+    char   Name[32];
+    Uint32 FirstVertex;
+    Uint32 NumVertices;
+    Uint32 FirstIndex;
+    Uint32 NumIndices;
+    Uint32 Material;
+    Uint32 Reserved;
+};
+static_assert(sizeof(MazeSceneCacheMesh) == 56, "Unexpected MazeSceneCacheMesh size");
+
+struct MazeSceneCacheChunk
+{
+    Uint32 FirstBox;
+    Uint32 NumBoxes;
+    Uint32 NumWalls;
+};
+static_assert(sizeof(MazeSceneCacheChunk) == 12, "Unexpected MazeSceneCacheChunk size");
+static_assert(sizeof(MazeChunkBox) == 48, "MazeChunkBox is stored in the cache as is");
+
+class MazeSceneCache
+{
+public:
+    struct MeshDesc
+    {
+        String Name;
+        Uint32 FirstVertex = 0;
+        Uint32 NumVertices = 0;
+        Uint32 FirstIndex  = 0;
+        Uint32 NumIndices  = 0;
+        Uint32 Material    = 0; // Material of a batch of a baked mesh, see MazeWallMesh
+    };
+
+    struct BakeInfo
+    {
+        Uint64 ContentHash = 0;
+
+        // All chunks of the level, row by row
+        int              ChunkSize = 0;
+        int2             NumChunks;
+        const MazeChunk* pChunks = nullptr;
+
+        const MeshDesc* pMeshes   = nullptr;
+        Uint32          NumMeshes = 0;
+
+        // Merged vertex and index data of all meshes
+        const void*   pVertices    = nullptr;
+        Uint32        VertexStride = 0;
+        Uint32        NumVertices  = 0;
+        const Uint32* pIndices     = nullptr;
+        Uint32        NumIndices   = 0;
+    };
+
+    // Writes the cache file. Returns false if the file could not be written.
+    static bool Write(const char* Path, const BakeInfo& Info);
+
+    // Maps the cache file. Returns false if the file does not exist, is invalid,
+    // or was baked from different content.
+    bool Load(const char* Path, Uint64 ContentHash);
+
+    void Close();
+
+    bool IsLoaded() const { return m_pHeader != nullptr; }
+
+    // Copies the boxes of the chunk. Returns false if the chunk is not in the cache. Thread-safe.
+    bool GetChunk(const int2& Coord, MazeChunk& Chunk) const;
+
+    int GetChunkSize() const { return static_cast<int>(m_pHeader->ChunkSize); }
+
+    Uint32   GetNumMeshes() const { return m_pHeader->NumMeshes; }
+    MeshDesc GetMesh(Uint32 i) const;
+
+    const void*   GetVertices() const { return m_File.GetData() + m_pHeader->VerticesOffset; }
+    Uint32        GetVertexStride() const { return m_pHeader->VertexStride; }
+    Uint32        GetNumVertices() const { return m_pHeader->NumVertices; }
+    const Uint32* GetIndices() const { return reinterpret_cast<const Uint32*>(m_File.GetData() + m_pHeader->IndicesOffset); }
+    Uint32        GetNumIndices() const { return m_pHeader->NumIndices; }
+
+private:
+    MappedFile m_File;
+
+    const MazeSceneCacheHeader* m_pHeader = nullptr;
+    const MazeSceneCacheMesh*   m_pMeshes = nullptr;
+    const MazeSceneCacheChunk*  m_pChunks = nullptr;
+    const MazeChunkBox*         m_pBoxes  = nullptr;
+};
+
+} // namespace Diligent
@@ -0,0 +1,107 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeSimulationLod.hpp"
+
+#include <algorithm>
+
+#include "DebugUtilities.hpp"
+
+namespace Diligent
+{
+
+MazeSimulationLod::Stats& MazeSimulationLod::Stats::operator+=(const Stats& Other)
+{
+    for (Uint32 t = 0; t < NumTiers; ++t)
+    {
+        NumEntities[t] += Other.NumEntities[t];
+        NumUpdated[t] += Other.NumUpdated[t];
+    }
+    NumDeferred += Other.NumDeferred;
+    return *this;
+}
+
+void MazeSimulationLod::Initialize(const CreateInfo& CI)
+{
+    VERIFY(CI.TierPeriods[0] == 1, "Tier 0 must be updated every tick");
+    VERIFY(CI.MaxReducedUpdatesPerTick > 0, "The update budget must not be zero");
+    m_CI   = CI;
+    m_Tick = 0;
+}
+
+void MazeSimulationLod::Schedule(const int2& PlayerCell, float dt, Uint32 NumEntities, const int2* pCells, float* pPendingTimes,
+                                 float* pElapsedTimes, Stats& EntityStats)
+{
+    EntityStats = {};
+    m_Scheduled.clear();
+    m_Due.clear();
+    m_Tiers.resize(NumEntities);
+
+    for (Uint32 i = 0; i < NumEntities; ++i)
+    {
+        const Uint32 Tier = GetTier(pCells[i], PlayerCell);
+        m_Tiers[i]        = static_cast<Uint8>(Tier);
+        ++EntityStats.NumEntities[Tier];
+
+        pPendingTimes[i] += dt;
+        pElapsedTimes[i] = 0;
+        if (Tier == 0)
+        {
+            m_Scheduled.push_back(i);
+            continue;
+        }
+
+        // An entity is due on its tick of the period, or as soon as it has waited longer than
+        // the period, e.g. after it was deferred or moved away from the player
+        const Uint32 Period = m_CI.TierPeriods[Tier];
+        if ((m_Tick + i) % Period == 0 || pPendingTimes[i] > static_cast<float>(Period) * dt * 1.5f)
+            m_Due.push_back(i);
+    }
+    ++m_Tick;
+
+    // Entities that waited longest are updated first
+    if (m_Due.size() > m_CI.MaxReducedUpdatesPerTick)
+    {
+        EntityStats.NumDeferred = static_cast<Uint32>(m_Due.size()) - m_CI.MaxReducedUpdatesPerTick;
+        std::nth_element(m_Due.begin(), m_Due.begin() + m_CI.MaxReducedUpdatesPerTick, m_Due.end(),
+                         [pPendingTimes](Uint32 a, Uint32 b) { return pPendingTimes[a] > pPendingTimes[b] || (pPendingTimes[a] == pPendingTimes[b] && a < b); });
+        m_Due.resize(m_CI.MaxReducedUpdatesPerTick);
+        std::sort(m_Due.begin(), m_Due.end());
+    }
+
+    const size_t NumNear = m_Scheduled.size();
+    m_Scheduled.insert(m_Scheduled.end(), m_Due.begin(), m_Due.end());
+    std::inplace_merge(m_Scheduled.begin(), m_Scheduled.begin() + static_cast<ptrdiff_t>(NumNear), m_Scheduled.end());
+
+    for (Uint32 i : m_Scheduled)
+    {
+        ++EntityStats.NumUpdated[m_Tiers[i]];
+        pElapsedTimes[i] = std::min(pPendingTimes[i], m_CI.MaxElapsedTime);
+        pPendingTimes[i] = 0;
+    }
+}
+
+} // namespace Diligent
@@ -0,0 +1,99 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "BasicMath.hpp"
+
+namespace Diligent
+{
+
+// Simulation level of detail. Entities are assigned to tiers by their Chebyshev distance, in
+// cells, from the player. Tier 0 is updated every tick. Entities of the other tiers are updated
+// once every TierPeriods[Tier] ticks with the time accumulated since their last update, and their
+// owners may use cheaper logic for them. Entities are spread over the ticks of a period by their
+// index, and at most MaxReducedUpdatesPerTick of them are updated per tick; entities that do not
+// fit are deferred, and the ones that waited longest go first.
+class MazeSimulationLod
+{
+public:
+    static constexpr Uint32 NumTiers = 3;
+
+    struct CreateInfo
+    {
+        int    TierDistances[NumTiers - 1] = {16, 48};   // Distance, in cells, at which tiers 1 and 2 start
+        Uint32 TierPeriods[NumTiers]       = {1, 4, 12}; // Ticks between updates
+        Uint32 MaxReducedUpdatesPerTick    = 1024;       // Tier 0 is never limited
+        float  MaxElapsedTime              = 0.25f;      // Longer delays are dropped rather than simulated at once
+    };
+
+    struct Stats
+    {
+        Uint32 NumEntities[NumTiers] = {};
+        Uint32 NumUpdated[NumTiers]  = {};
+        Uint32 NumDeferred           = 0;
+
+        Stats& operator+=(const Stats& Other);
+    };
+
+    void Initialize(const CreateInfo& CI);
+
+    Uint32 GetTier(const int2& Cell, const int2& PlayerCell) const
+    {
+        const int Distance = std::max(std::abs(Cell.x - PlayerCell.x), std::abs(Cell.y - PlayerCell.y));
+        Uint32    Tier     = 0;
+        while (Tier < NumTiers - 1 && Distance >= m_CI.TierDistances[Tier])
+            ++Tier;
+        return Tier;
+    }
+
+    // Assigns the entities in pCells to tiers and selects the ones to update in this tick of
+    // length dt. pPendingTimes holds the time every entity has not been simulated for; it starts
+    // at zero and is only modified by the scheduler. The scheduled entities are returned in
+    // ascending order, and pElapsedTimes receives the time to simulate for each entity, which
+    // is zero for the entities that are not scheduled.
+    void Schedule(const int2& PlayerCell, float dt, Uint32 NumEntities, const int2* pCells, float* pPendingTimes,
+                  float* pElapsedTimes, Stats& EntityStats);
+
+    const std::vector<Uint32>& GetScheduled() const { return m_Scheduled; }
+
+    // Tier of the entity in the last Schedule() call
+    Uint32 GetEntityTier(Uint32 Entity) const { return m_Tiers[Entity]; }
+
+private:
+    CreateInfo m_CI;
+    Uint32     m_Tick = 0;
+
+    std::vector<Uint32> m_Scheduled;
+    std::vector<Uint32> m_Due;
+    std::vector<Uint8>  m_Tiers;
+};
+
+} // namespace Diligent
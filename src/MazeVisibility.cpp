@@ -0,0 +1,271 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeVisibility.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "MazePvs.hpp"
+#include "DebugUtilities.hpp"
+
+namespace Diligent
+{
+
+void MazeVisibility::Initialize(const CreateInfo& CI)
+{
+    VERIFY_EXPR(CI.pLevel != nullptr && CI.pField != nullptr);
+    m_CI           = CI;
+    m_Size         = 0;
+    m_PvsOpenDoors = ~0u;
+}
+
+void MazeVisibility::ResetSquare(const int2& Origin, int Size)
+{
+    const size_t NumCells = static_cast<size_t>(Size) * Size;
+    if (m_Visible.size() != NumCells)
+    {
+        m_Range.assign(NumCells, float2{1, -1});
+        m_Visible.assign(NumCells, 0);
+        m_Queued.assign(NumCells, 0);
+    }
+    else
+    {
+        // The queue holds every cell that got a range
+        for (Uint32 Idx : m_Queue)
+            m_Range[Idx] = float2{1, -1};
+        for (Uint32 Idx : m_VisibleCells)
+            m_Visible[Idx] = 0;
+    }
+    m_Queue.clear();
+    m_VisibleCells.clear();
+
+    m_Origin = Origin;
+    m_Size   = Size;
+}
+
+void MazeVisibility::MarkVisible(Uint32 Idx)
+{
+    if (m_Visible[Idx] != 0)
+        return;
+    m_Visible[Idx] = 1;
+    m_VisibleCells.push_back(Idx);
+}
+
+void MazeVisibility::MarkVisibleAround(const int2& Local)
+{
+    // Diagonal neighbors are included because wall corners may be seen from the cell
+    for (int z = std::max(Local.y - 1, 0); z <= std::min(Local.y + 1, m_Size - 1); ++z)
+    {
+        for (int x = std::max(Local.x - 1, 0); x <= std::min(Local.x + 1, m_Size - 1); ++x)
+            MarkVisible(static_cast<Uint32>(z * m_Size + x));
+    }
+}
+
+void MazeVisibility::Update(const float3& CameraPos, const float3& ViewDir, float HalfAngle, int Radius)
+{
+    const MazeLevel&     Level = *m_CI.pLevel;
+    const MazeFlowField& Field = *m_CI.pField;
+
+    // Position in cell units, see MazeLevel::GetCellAt(). Cell x spans [x, x + 1).
+    const float2 Eye{CameraPos.x / Level.GetCellSize() + Level.GetCols() / 2.0f + 0.5f,
+                     CameraPos.z / Level.GetCellSize() + Level.GetRows() / 2.0f + 0.5f};
+    const int2   EyeCell{static_cast<int>(std::floor(Eye.x)), static_cast<int>(std::floor(Eye.y))};
+
+    if (m_CI.pPvs != nullptr && UpdateFromPvs(EyeCell))
+        return;
+
+    m_PvsOpenDoors = ~0u;
+    ResetSquare(EyeCell - int2{Radius, Radius}, 2 * Radius + 1);
+
+    // Angles are measured from the horizontal view direction
+    float2 Forward{ViewDir.x, ViewDir.z};
+    if (length(Forward) < 1e-3f)
+        HalfAngle = PI_F;
+    else
+        Forward = normalize(Forward);
+    HalfAngle = std::min(HalfAngle, PI_F);
+
+    const auto GetAngle = [&](const float2& Pos) {
+        const float2 Dir = Pos - Eye;
+        return std::atan2(Forward.x * Dir.y - Forward.y * Dir.x, Forward.x * Dir.x + Forward.y * Dir.y);
+    };
+
+    static const int2 Deltas[] = {int2{1, 0}, int2{-1, 0}, int2{0, 1}, int2{0, -1}};
+
+    const Uint32 EyeIdx = static_cast<Uint32>(Radius * m_Size + Radius);
+    m_Range[EyeIdx]     = float2{-HalfAngle, HalfAngle};
+    m_Queued[EyeIdx]    = 1;
+    m_Queue.push_back(EyeIdx);
+    for (size_t q = 0; q < m_Queue.size(); ++q)
+    {
+        // A cell is queued again when it is reached with a wider range of angles
+        const Uint32 Idx = m_Queue[q];
+        m_Queued[Idx]    = 0;
+
+        const int2   Local{static_cast<int>(Idx % m_Size), static_cast<int>(Idx / m_Size)};
+        const int2   Cell  = m_Origin + Local;
+        const float2 Range = m_Range[Idx];
+        MarkVisibleAround(Local);
+
+        for (const int2& Delta : Deltas)
+        {
+            const int2 NeighborLocal = Local + Delta;
+            if (NeighborLocal.x < 0 || NeighborLocal.y < 0 || NeighborLocal.x >= m_Size || NeighborLocal.y >= m_Size)
+                continue;
+            if (Field.IsBlocked(Cell + Delta))
+                continue;
+
+            float2 PortalRange = Range;
+            if (HalfAngle < PI_F)
+            {
+                // The side between the cells. Sides close to the eye are not narrowed: their angles
+                // may wrap around behind the eye.
+                const float2 Center{Cell.x + 0.5f + Delta.x * 0.5f, Cell.y + 0.5f + Delta.y * 0.5f};
+                if (length(Center - Eye) >= 1.f)
+                {
+                    const float2 Side{Delta.y != 0 ? 0.5f : 0.f, Delta.x != 0 ? 0.5f : 0.f};
+                    const float  Angle0 = GetAngle(Center - Side);
+                    const float  Angle1 = GetAngle(Center + Side);
+                    // A side that wraps around is behind the eye and outside of the view
+                    if (std::abs(Angle1 - Angle0) > PI_F)
+                        continue;
+                    PortalRange.x = std::max(PortalRange.x, std::min(Angle0, Angle1));
+                    PortalRange.y = std::min(PortalRange.y, std::max(Angle0, Angle1));
+                    if (PortalRange.x > PortalRange.y)
+                        continue;
+                }
+            }
+
+            const Uint32 NeighborIdx   = static_cast<Uint32>(NeighborLocal.y * m_Size + NeighborLocal.x);
+            float2&      NeighborRange = m_Range[NeighborIdx];
+            if (NeighborRange.x <= NeighborRange.y)
+            {
+                if (PortalRange.x >= NeighborRange.x && PortalRange.y <= NeighborRange.y)
+                    continue;
+                PortalRange.x = std::min(PortalRange.x, NeighborRange.x);
+                PortalRange.y = std::max(PortalRange.y, NeighborRange.y);
+            }
+            NeighborRange = PortalRange;
+            if (m_Queued[NeighborIdx] == 0)
+            {
+                m_Queued[NeighborIdx] = 1;
+                m_Queue.push_back(NeighborIdx);
+            }
+        }
+    }
+}
+
+bool MazeVisibility::UpdateFromPvs(const int2& EyeCell)
+{
+    const MazePvs&       Pvs   = *m_CI.pPvs;
+    const MazeFlowField& Field = *m_CI.pField;
+    if (!Pvs.HasCell(EyeCell))
+        return false;
+
+    // Doors never close, so the set is up to date while the number of open doors is the same
+    Uint32 NumOpenDoors = 0;
+    for (Uint32 i = 0; i < Pvs.GetNumDoors(); ++i)
+        NumOpenDoors += Field.IsBlocked(Pvs.GetDoor(i)) ? 0 : 1;
+    if (m_PvsOpenDoors == NumOpenDoors && m_PvsCell == EyeCell)
+        return true;
+
+    const int Radius = Pvs.GetRadius();
+    ResetSquare(EyeCell - int2{Radius, Radius}, 2 * Radius + 1);
+    AddPvsRuns(EyeCell);
+
+    // The set of a door cell holds the cells seen through the open door. Doors seen through
+    // other open doors are added until no more open doors become visible.
+    m_PvsDoorAdded.assign(Pvs.GetNumDoors(), 0);
+    for (bool Added = NumOpenDoors > 0; Added;)
+    {
+        Added = false;
+        for (Uint32 i = 0; i < Pvs.GetNumDoors(); ++i)
+        {
+            const int2 Door = Pvs.GetDoor(i);
+            if (m_PvsDoorAdded[i] != 0 || Field.IsBlocked(Door) || !IsCellVisible(Door))
+                continue;
+            AddPvsRuns(Door);
+            m_PvsDoorAdded[i] = 1;
+            Added             = true;
+        }
+    }
+
+    m_PvsCell      = EyeCell;
+    m_PvsOpenDoors = NumOpenDoors;
+    return true;
+}
+
+void MazeVisibility::AddPvsRuns(const int2& Cell)
+{
+    const MazePvs& Pvs     = *m_CI.pPvs;
+    Uint32         NumRuns = 0;
+    const Uint16*  pRuns   = Pvs.GetRuns(Cell, NumRuns);
+    if (pRuns == nullptr)
+        return;
+
+    // Runs alternate between hidden and visible cells of the square around the cell, starting
+    // with hidden ones
+    const int  Radius = Pvs.GetRadius();
+    const int  Size   = 2 * Radius + 1;
+    const int2 Offset = Cell - int2{Radius, Radius} - m_Origin;
+
+    Uint32 Pos = 0;
+    for (Uint32 r = 0; r < NumRuns; ++r)
+    {
+        const Uint32 End = Pos + pRuns[r];
+        for (Uint32 i = (r & 1u) != 0 ? Pos : End; i < End; ++i)
+        {
+            const int2 Local = Offset + int2{static_cast<int>(i % Size), static_cast<int>(i / Size)};
+            if (Local.x >= 0 && Local.y >= 0 && Local.x < m_Size && Local.y < m_Size)
+                MarkVisible(static_cast<Uint32>(Local.y * m_Size + Local.x));
+        }
+        Pos = End;
+    }
+}
+
+bool MazeVisibility::IsBoxVisible(const float3& Min, const float3& Max) const
+{
+    if (m_Size == 0)
+        return true;
+
+    const int2 MinLocal = m_CI.pLevel->GetCellAt(Min) - m_Origin;
+    const int2 MaxLocal = m_CI.pLevel->GetCellAt(Max) - m_Origin;
+    if (MinLocal.x < 0 || MinLocal.y < 0 || MaxLocal.x >= m_Size || MaxLocal.y >= m_Size)
+        return true;
+
+    for (int z = MinLocal.y; z <= MaxLocal.y; ++z)
+    {
+        for (int x = MinLocal.x; x <= MaxLocal.x; ++x)
+        {
+            if (m_Visible[static_cast<size_t>(z) * m_Size + x] != 0)
+                return true;
+        }
+    }
+    return false;
+}
+
+} // namespace Diligent
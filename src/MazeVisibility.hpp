@@ -0,0 +1,116 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "MazeFlowField.hpp"
+
+namespace Diligent
+{
+
+class MazePvs;
+
+// Conservative visibility of the maze cells from the camera, used to cull the rasterized objects.
+//
+// Starting at the camera's cell, a breadth-first traversal crosses the sides between the open
+// cells of the flow field window. Every side is a portal that narrows the horizontal view angle
+// that reaches the cells behind it, so a cell is only entered while some line of sight through
+// the portals on the way remains in the view. Walls and closed doors around the entered cells
+// are visible. Cells outside of the flow field window are never blocked.
+//
+// If the level has a precomputed visible set for the camera's cell, the set is used instead
+// of the traversal, see MazePvs, and is only rebuilt when the camera enters another cell or
+// a door opens. The set does not depend on the view direction.
+class MazeVisibility
+{
+public:
+    struct CreateInfo
+    {
+        const MazeLevel*     pLevel = nullptr;
+        const MazeFlowField* pField = nullptr; // Provides the blocked cells
+        const MazePvs*       pPvs   = nullptr; // Optional precomputed visible sets
+    };
+    void Initialize(const CreateInfo& CI);
+
+    // Finds the cells visible from the camera in the square of cells at most Radius cells away
+    // from the camera's cell. ViewDir is the view direction; HalfAngle is the horizontal half
+    // angle of the view in radians. If HalfAngle is PI or more, portals are not narrowed.
+    // Precomputed sets cover the square of their own radius.
+    void Update(const float3& CameraPos, const float3& ViewDir, float HalfAngle, int Radius);
+
+    // Returns true if any cell under the XZ bounds of the box is visible.
+    // Boxes that are not inside of the square of the last update are always visible.
+    bool IsBoxVisible(const float3& Min, const float3& Max) const;
+
+    bool IsCellVisible(const int2& Cell) const
+    {
+        const int2 Local = Cell - m_Origin;
+        return Local.x >= 0 && Local.y >= 0 && Local.x < m_Size && Local.y < m_Size &&
+            m_Visible[static_cast<size_t>(Local.y) * m_Size + Local.x] != 0;
+    }
+
+    // Calls Handler(const int2& Cell) for every visible cell
+    template <typename HandlerType>
+    void ProcessVisibleCells(HandlerType&& Handler) const
+    {
+        for (Uint32 Idx : m_VisibleCells)
+            Handler(m_Origin + int2{static_cast<int>(Idx % m_Size), static_cast<int>(Idx / m_Size)});
+    }
+
+    Uint32 GetNumVisibleCells() const { return static_cast<Uint32>(m_VisibleCells.size()); }
+
+    // True if the last update used a precomputed set
+    bool IsPvsUsed() const { return m_PvsOpenDoors != ~0u; }
+
+private:
+    void ResetSquare(const int2& Origin, int Size);
+    void MarkVisible(Uint32 Idx);
+    void MarkVisibleAround(const int2& Local);
+    bool UpdateFromPvs(const int2& EyeCell);
+    void AddPvsRuns(const int2& Cell);
+
+    CreateInfo m_CI;
+
+    int2 m_Origin; // First cell of the square
+    int  m_Size = 0;
+
+    // Square of cells, row by row. Only the cells in m_Queue and m_VisibleCells are reset
+    // before the next update.
+    std::vector<float2> m_Range;   // View angles that reach the cell; empty if x > y
+    std::vector<Uint8>  m_Visible;
+    std::vector<Uint8>  m_Queued;
+    std::vector<Uint32> m_Queue;
+    std::vector<Uint32> m_VisibleCells; // Indices in the square
+
+    // Cell and number of open doors of the precomputed set in m_Visible; ~0u if the set is not used
+    int2                m_PvsCell;
+    Uint32              m_PvsOpenDoors = ~0u;
+    std::vector<Uint8>  m_PvsDoorAdded;
+};
+
+} // namespace Diligent
@@ -0,0 +1,167 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeWallMerger.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+static constexpr Uint32 NoMergeKey = 0;
+static constexpr Uint32 UniqueKey  = ~0u;
+
+// Cells with equal keys may be merged into one rectangle
+Uint32 GetMergeKey(const MazeLevel& Level, Uint8 BlockType)
+{
+    const MazeBlockTypeDesc& Desc = Level.GetBlockType(BlockType);
+    if (Desc.Kind != MAZE_BLOCK_KIND_WALL && Desc.Kind != MAZE_BLOCK_KIND_DOOR)
+        return NoMergeKey;
+    if ((Desc.Flags & MAZE_BLOCK_FLAG_MERGE) == 0)
+        return UniqueKey;
+    return Desc.Kind == MAZE_BLOCK_KIND_WALL ?
+        (1u << 16u) | Desc.Material :
+        (2u << 16u) | BlockType;
+}
+
+// Greedy meshing over the region. When Transposed is true, rectangles are grown along Z first.
+void MergeGreedy(const Uint8* pCells, const int2& Size, size_t Stride, const int2& Origin, const std::vector<Uint32>& Keys, bool Transposed, std::vector<MazeWallRect>& Rects)
+{
+    // Major axis is the one along which rectangles are grown first
+    const int SizeU = Transposed ? Size.y : Size.x;
+    const int SizeV = Transposed ? Size.x : Size.y;
+
+    // Keys are stored row by row for the region
+    const auto CellIdx = [&](int u, int v) {
+        return Transposed ?
+            static_cast<size_t>(u) * static_cast<size_t>(Size.x) + static_cast<size_t>(v) :
+            static_cast<size_t>(v) * static_cast<size_t>(Size.x) + static_cast<size_t>(u);
+    };
+
+    std::vector<bool> Covered(Keys.size(), false);
+    for (int v = 0; v < SizeV; ++v)
+    {
+        for (int u = 0; u < SizeU; ++u)
+        {
+            const size_t Idx = CellIdx(u, v);
+            const Uint32 Key = Keys[Idx];
+            if (Covered[Idx] || Key == NoMergeKey)
+                continue;
+
+            int RunU = 1;
+            int RunV = 1;
+            if (Key != UniqueKey)
+            {
+                while (u + RunU < SizeU && !Covered[CellIdx(u + RunU, v)] && Keys[CellIdx(u + RunU, v)] == Key)
+                    ++RunU;
+
+                for (; v + RunV < SizeV; ++RunV)
+                {
+                    bool RowMatches = true;
+                    for (int i = 0; i < RunU && RowMatches; ++i)
+                        RowMatches = !Covered[CellIdx(u + i, v + RunV)] && Keys[CellIdx(u + i, v + RunV)] == Key;
+                    if (!RowMatches)
+                        break;
+                }
+            }
+
+            for (int j = 0; j < RunV; ++j)
+            {
+                for (int i = 0; i < RunU; ++i)
+                    Covered[CellIdx(u + i, v + j)] = true;
+            }
+
+            MazeWallRect Rect;
+            const int x    = Transposed ? v : u;
+            const int z    = Transposed ? u : v;
+            Rect.x         = Origin.x + x;
+            Rect.z         = Origin.y + z;
+            Rect.SizeX     = Transposed ? RunV : RunU;
+            Rect.SizeZ     = Transposed ? RunU : RunV;
+            Rect.BlockType = pCells[static_cast<size_t>(z) * Stride + static_cast<size_t>(x)];
+            Rects.push_back(Rect);
+        }
+    }
+}
+
+} // namespace
+
+MazeWallMergeStats MergeMazeWalls(const MazeLevel& Level, std::vector<MazeWallRect>& Rects)
+{
+    return MergeMazeWalls(Level, int2{0, 0}, int2{Level.GetCols(), Level.GetRows()}, Rects);
+}
+
+MazeWallMergeStats MergeMazeWalls(const MazeLevel& Level, const int2& RegionStart, const int2& RegionEnd, std::vector<MazeWallRect>& Rects)
+{
+    const int2 Start{std::max(RegionStart.x, 0), std::max(RegionStart.y, 0)};
+    const int2 End{std::min(RegionEnd.x, Level.GetCols()), std::min(RegionEnd.y, Level.GetRows())};
+    if (End.x <= Start.x || End.y <= Start.y)
+        return {};
+
+    const size_t Stride = static_cast<size_t>(Level.GetCols());
+    const Uint8* pCells = Level.GetCells() + static_cast<size_t>(Start.y) * Stride + static_cast<size_t>(Start.x);
+    return MergeMazeWalls(Level, pCells, int2{End.x - Start.x, End.y - Start.y}, Stride, Start, Rects);
+}
+
+MazeWallMergeStats MergeMazeWalls(const MazeLevel& Level, const Uint8* pCells, const int2& Size, size_t Stride, const int2& Origin, std::vector<MazeWallRect>& Rects)
+{
+    MazeWallMergeStats Stats;
+    if (Size.x <= 0 || Size.y <= 0)
+        return Stats;
+
+    // Resolve merge keys once so that both passes do not have to look up the block type table
+    Uint32 TypeKeys[256] = {};
+    for (Uint32 t = 0; t < Level.GetNumBlockTypes(); ++t)
+        TypeKeys[t] = GetMergeKey(Level, static_cast<Uint8>(t));
+
+    std::vector<Uint32> Keys(static_cast<size_t>(Size.x) * static_cast<size_t>(Size.y));
+    for (int z = 0; z < Size.y; ++z)
+    {
+        for (int x = 0; x < Size.x; ++x)
+        {
+            Uint32& Key = Keys[static_cast<size_t>(z) * static_cast<size_t>(Size.x) + static_cast<size_t>(x)];
+            Key         = TypeKeys[pCells[static_cast<size_t>(z) * Stride + static_cast<size_t>(x)]];
+            if (Key != NoMergeKey)
+                ++Stats.NumCells;
+        }
+    }
+
+    // Corridors in the maze run along both axes, so try growing rectangles along
+    // each axis first and keep the result with fewer rectangles.
+    std::vector<MazeWallRect> RowMajor;
+    std::vector<MazeWallRect> ColMajor;
+    MergeGreedy(pCells, Size, Stride, Origin, Keys, false, RowMajor);
+    MergeGreedy(pCells, Size, Stride, Origin, Keys, true, ColMajor);
+
+    const std::vector<MazeWallRect>& Best = RowMajor.size() <= ColMajor.size() ? RowMajor : ColMajor;
+    Rects.insert(Rects.end(), Best.begin(), Best.end());
+    Stats.NumRects = static_cast<Uint32>(Best.size());
+
+    return Stats;
+}
+
+} // namespace Diligent
@@ -0,0 +1,65 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "MazeLevel.hpp"
+
+namespace Diligent
+{
+
+// Rectangle of maze cells covered by a single wall or door object
+struct MazeWallRect
+{
+    int   x         = 0; // First cell
+    int   z         = 0;
+    int   SizeX     = 1; // Number of cells along X
+    int   SizeZ     = 1; // Number of cells along Z
+    Uint8 BlockType = 0; // Block type of the first cell
+};
+
+struct MazeWallMergeStats
+{
+    Uint32 NumCells = 0; // Wall and door cells, i.e. the number of objects without merging
+    Uint32 NumRects = 0; // Number of objects after merging
+};
+
+// Covers wall and door cells of the level with rectangles using greedy 2D merging.
+// Walls with MAZE_BLOCK_FLAG_MERGE are merged when they share the material, doors are
+// merged only with cells of the same block type so that key-door bindings are preserved.
+// Cells without the merge flag always get their own rectangle.
+MazeWallMergeStats MergeMazeWalls(const MazeLevel& Level, std::vector<MazeWallRect>& Rects);
+
+// Same as above, but only covers cells in [RegionStart, RegionEnd). Rectangles never cross the region boundary.
+MazeWallMergeStats MergeMazeWalls(const MazeLevel& Level, const int2& RegionStart, const int2& RegionEnd, std::vector<MazeWallRect>& Rects);
+
+// Covers Size.x x Size.y cells stored row by row with the given stride, e.g. a generated chunk.
+// The level only provides the block type table. Origin is added to the coordinates of the rectangles.
+MazeWallMergeStats MergeMazeWalls(const MazeLevel& Level, const Uint8* pCells, const int2& Size, size_t Stride, const int2& Origin, std::vector<MazeWallRect>& Rects);
+
+} // namespace Diligent
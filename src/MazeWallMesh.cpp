@@ -0,0 +1,167 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "MazeWallMesh.hpp"
+
+#include <map>
+
+#include "MazeWallMerger.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+// Appends the part [U0, U1] of a rectangular face. Corner is the top-left corner of the face seen
+// from the outside, Right and Down are the unit directions of U and V that span Width x Height.
+// Triangles are clockwise when seen from the outside, like the faces of the cube.
+void AddFaceQuad(const float3& Corner, const float3& Right, const float3& Down, float Width, float Height, const float3& Normal,
+                 float U0, float U1, std::vector<MazeMeshVertex>& Vertices, std::vector<Uint32>& Indices)
+{
+    const Uint32 First = static_cast<Uint32>(Vertices.size());
+
+    Vertices.push_back({Corner + Right * (U0 * Width), Normal, float2{U0, 0}});
+    Vertices.push_back({Corner + Right * (U1 * Width), Normal, float2{U1, 0}});
+    Vertices.push_back({Corner + Right * (U0 * Width) + Down * Height, Normal, float2{U0, 1}});
+    Vertices.push_back({Corner + Right * (U1 * Width) + Down * Height, Normal, float2{U1, 1}});
+
+    const Uint32 QuadIndices[] = {0, 1, 2, 2, 1, 3};
+    for (Uint32 i : QuadIndices)
+        Indices.push_back(First + i);
+}
+
+} // namespace
+
+MazeWallMeshStats BakeMazeWallMesh(const MazeLevel& Level, const Uint8* pCells, const int2& Size, size_t Stride, const int2& Origin, MazeWallMesh& Mesh)
+{
+    const float CellSize   = Level.GetCellSize();
+    const float WallHeight = Level.GetWallHeight();
+
+    Mesh.Vertices.clear();
+    Mesh.Indices.clear();
+    Mesh.Batches.clear();
+
+    // Doors are opened and keys are collected, so only walls hide the faces of their neighbors.
+    // Cells outside of the region are treated as empty.
+    const auto IsStaticWall = [&](int x, int z) {
+        if (x < 0 || z < 0 || x >= Size.x || z >= Size.y)
+            return false;
+        return Level.GetBlockType(pCells[static_cast<size_t>(z) * Stride + static_cast<size_t>(x)]).Kind == MAZE_BLOCK_KIND_WALL;
+    };
+
+    std::vector<MazeWallRect> Rects;
+    MergeMazeWalls(Level, pCells, Size, Stride, Origin, Rects);
+
+    MazeWallMeshStats Stats;
+
+    // Faces are grouped by material and concatenated when all walls are processed
+    std::map<Uint16, std::vector<Uint32>> MaterialIndices;
+    for (const MazeWallRect& Rect : Rects)
+    {
+        const MazeBlockTypeDesc& Desc = Level.GetBlockType(Rect.BlockType);
+        if (Desc.Kind != MAZE_BLOCK_KIND_WALL)
+            continue;
+
+        ++Stats.NumWalls;
+        std::vector<Uint32>& Indices = MaterialIndices[Desc.Material];
+
+        // Same extents as the wall box, see BuildMazeChunk()
+        const float3 Corner = Level.GetCellCenter(Rect.x, Rect.z);
+        const float  MinX   = Corner.x - CellSize * 0.5f;
+        const float  MinZ   = Corner.z - CellSize * 0.5f;
+        const float  MaxX   = MinX + CellSize * Rect.SizeX;
+        const float  MaxZ   = MinZ + CellSize * Rect.SizeZ;
+        const float  MinY   = -0.2f;
+        const float  MaxY   = WallHeight * 2.0f - 0.2f;
+
+        // The top face is kept even where it touches the ceiling: shadow rays only hit back faces
+        AddFaceQuad(float3{MinX, MaxY, MaxZ}, float3{1, 0, 0}, float3{0, 0, -1}, MaxX - MinX, MaxZ - MinZ, float3{0, 1, 0},
+                    0.f, 1.f, Mesh.Vertices, Indices);
+
+        // Side faces are split into runs of cells whose neighbors are not walls
+        struct SideFace
+        {
+            float3 Normal;
+            float3 Corner;
+            float3 Right;
+            int    NumCells;
+            int2   FirstNeighbor; // Neighbor of the leftmost cell of the face, in region coordinates
+            int2   Step;          // From one neighbor to the next one to the right
+        };
+        const int2 Cell{Rect.x - Origin.x, Rect.z - Origin.y};
+        // clang-format off
+        const SideFace Sides[] =
+        {
+            {float3{ 1, 0, 0}, float3{MaxX, MaxY, MinZ}, float3{ 0, 0,  1}, Rect.SizeZ, int2{Cell.x + Rect.SizeX,     Cell.y},                  int2{ 0,  1}},
+            {float3{-1, 0, 0}, float3{MinX, MaxY, MaxZ}, float3{ 0, 0, -1}, Rect.SizeZ, int2{Cell.x - 1,              Cell.y + Rect.SizeZ - 1}, int2{ 0, -1}},
+            {float3{ 0, 0, 1}, float3{MaxX, MaxY, MaxZ}, float3{-1, 0,  0}, Rect.SizeX, int2{Cell.x + Rect.SizeX - 1, Cell.y + Rect.SizeZ},     int2{-1,  0}},
+            {float3{ 0, 0,-1}, float3{MinX, MaxY, MinZ}, float3{ 1, 0,  0}, Rect.SizeX, int2{Cell.x,                  Cell.y - 1},              int2{ 1,  0}},
+        };
+        // clang-format on
+        for (const SideFace& Side : Sides)
+        {
+            const float Width = CellSize * Side.NumCells;
+            for (int i = 0; i < Side.NumCells;)
+            {
+                if (IsStaticWall(Side.FirstNeighbor.x + Side.Step.x * i, Side.FirstNeighbor.y + Side.Step.y * i))
+                {
+                    ++i;
+                    continue;
+                }
+
+                int End = i + 1;
+                while (End < Side.NumCells && !IsStaticWall(Side.FirstNeighbor.x + Side.Step.x * End, Side.FirstNeighbor.y + Side.Step.y * End))
+                    ++End;
+
+                AddFaceQuad(Side.Corner, Side.Right, float3{0, -1, 0}, Width, MaxY - MinY, Side.Normal,
+                            static_cast<float>(i) / Side.NumCells, static_cast<float>(End) / Side.NumCells, Mesh.Vertices, Indices);
+                i = End;
+            }
+        }
+    }
+
+    for (const auto& It : MaterialIndices)
+    {
+        MazeMeshBatch Batch;
+        Batch.Material   = It.first;
+        Batch.FirstIndex = static_cast<Uint32>(Mesh.Indices.size());
+        Batch.NumIndices = static_cast<Uint32>(It.second.size());
+        Mesh.Indices.insert(Mesh.Indices.end(), It.second.begin(), It.second.end());
+        Mesh.Batches.push_back(Batch);
+    }
+
+    Stats.NumCubeTriangles = Stats.NumWalls * 12;
+    Stats.NumTriangles     = static_cast<Uint32>(Mesh.Indices.size() / 3);
+    return Stats;
+}
+
+MazeWallMeshStats BakeMazeWallMesh(const MazeLevel& Level, MazeWallMesh& Mesh)
+{
+    return BakeMazeWallMesh(Level, Level.GetCells(), int2{Level.GetCols(), Level.GetRows()}, static_cast<size_t>(Level.GetCols()), int2{0, 0}, Mesh);
+}
+
+} // namespace Diligent
@@ -0,0 +1,76 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "MazeLevel.hpp"
+
+namespace Diligent
+{
+
+// Vertex of a baked mesh; same layout as the vertices of the cube and the plane
+struct MazeMeshVertex
+{
+    float3 Pos;
+    float3 Normal;
+    float2 UV;
+};
+
+// Indices of a baked mesh that use the same material
+struct MazeMeshBatch
+{
+    Uint16 Material   = 0; // Material from the block type description
+    Uint32 FirstIndex = 0;
+    Uint32 NumIndices = 0;
+};
+
+struct MazeWallMesh
+{
+    std::vector<MazeMeshVertex> Vertices;
+    std::vector<Uint32>         Indices; // Relative to the first vertex
+    std::vector<MazeMeshBatch>  Batches; // Sorted by material
+};
+
+struct MazeWallMeshStats
+{
+    Uint32 NumWalls         = 0; // Merged wall rectangles, i.e. the number of cube objects without the bake
+    Uint32 NumCubeTriangles = 0; // Triangles of the cube objects
+    Uint32 NumTriangles     = 0; // Triangles of the baked mesh
+};
+
+// Bakes the static walls of Size.x x Size.y cells stored row by row with the given stride into
+// a single world-space mesh. Doors and keys are not included as they are removed during the game.
+// Walls cover the same rectangles and extents as the wall boxes of BuildMazeChunk(), but faces
+// between two walls and the faces under the floor are removed. Faces on the region boundary
+// are kept. Every face keeps the texture coordinates of the corresponding box face.
+MazeWallMeshStats BakeMazeWallMesh(const MazeLevel& Level, const Uint8* pCells, const int2& Size, size_t Stride, const int2& Origin, MazeWallMesh& Mesh);
+
+// Same as above for the whole level
+MazeWallMeshStats BakeMazeWallMesh(const MazeLevel& Level, MazeWallMesh& Mesh);
+
+} // namespace Diligent
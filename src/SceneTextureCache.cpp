@@ -0,0 +1,135 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "SceneTextureCache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "TextureLoader.h"
+#include "FileSystem.hpp"
+#include "DebugUtilities.hpp"
+#include "Timer.hpp"
+
+namespace Diligent
+{
+
+Uint32 SceneTextureCache::Request(const char* Path, const TextureLoadInfo& LoadInfo)
+{
+    ++m_NumRequests;
+
+    // Textures baked by tools/bake_textures.py are block-compressed and contain all mips
+    String          FilePath = Path;
+    TextureLoadInfo FileLoadInfo{LoadInfo};
+    {
+        String BakedPath = FilePath + ".dds";
+        if (FileSystem::FileExists(BakedPath.c_str()))
+        {
+            FilePath                  = std::move(BakedPath);
+            FileLoadInfo.GenerateMips = false;
+        }
+    }
+
+    // Only the settings the materials can differ in are part of the key
+    String Key = FilePath;
+    Key += '|';
+    Key += std::to_string(static_cast<Uint32>(FileLoadInfo.Format));
+    Key += FileLoadInfo.IsSRGB ? "|srgb" : "|linear";
+    Key += FileLoadInfo.GenerateMips ? "|mips" : "|nomips";
+    Key += FileLoadInfo.FlipVertically ? "|flip" : "";
+    Key += '|';
+    Key += std::to_string(FileLoadInfo.MipLevels);
+
+    auto it = m_EntryIndex.find(Key);
+    if (it != m_EntryIndex.end())
+        return it->second;
+
+    const Uint32 Index = static_cast<Uint32>(m_Entries.size());
+    m_Entries.push_back({std::move(FilePath), FileLoadInfo});
+    m_EntryIndex.emplace(std::move(Key), Index);
+    return Index;
+}
+
+void SceneTextureCache::Load(IRenderDevice* pDevice, IDeviceContext* pContext, std::vector<RefCntAutoPtr<ITexture>>& Textures)
+{
+    Timer LoadTimer;
+
+    const Uint32 NumTextures = GetNumTextures();
+
+    // Decode images and generate mips in parallel. Loaders only touch CPU memory.
+    std::vector<RefCntAutoPtr<ITextureLoader>> Loaders(NumTextures);
+    {
+        std::atomic<Uint32> NextEntry{0};
+
+        const auto Worker = [&]() {
+            for (Uint32 i = NextEntry.fetch_add(1); i < NumTextures; i = NextEntry.fetch_add(1))
+            {
+                const Entry& Ent = m_Entries[i];
+                CreateTextureLoaderFromFile(Ent.Path.c_str(), IMAGE_FILE_FORMAT_UNKNOWN, Ent.LoadInfo, &Loaders[i]);
+            }
+        };
+
+        const Uint32 NumThreads = std::max(std::min(std::thread::hardware_concurrency(), NumTextures), 1u);
+
+        std::vector<std::thread> Threads;
+        for (Uint32 t = 1; t < NumThreads; ++t)
+            Threads.emplace_back(Worker);
+        Worker();
+        for (auto& Thread : Threads)
+            Thread.join();
+    }
+    const double DecodeTime = LoadTimer.GetElapsedTime();
+
+    // Create all textures, then transition them to the shader resource state with a single call
+    Textures.resize(NumTextures);
+    std::vector<StateTransitionDesc> Barriers;
+    Barriers.reserve(NumTextures);
+    for (Uint32 i = 0; i < NumTextures; ++i)
+    {
+        Textures[i] = nullptr;
+        if (!Loaders[i])
+        {
+            LOG_ERROR_MESSAGE("Failed to load texture '", m_Entries[i].Path, "'");
+            continue;
+        }
+
+        Loaders[i]->CreateTexture(pDevice, &Textures[i]);
+        Loaders[i].Release();
+        if (Textures[i])
+            Barriers.emplace_back(Textures[i], RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_SHADER_RESOURCE, STATE_TRANSITION_FLAG_UPDATE_STATE);
+    }
+    if (!Barriers.empty())
+        pContext->TransitionResourceStates(static_cast<Uint32>(Barriers.size()), Barriers.data());
+
+    const auto NumBaked = std::count_if(m_Entries.begin(), m_Entries.end(), [](const Entry& Ent) {
+        return Ent.Path.size() > 4 && Ent.Path.compare(Ent.Path.size() - 4, 4, ".dds") == 0;
+    });
+    LOG_INFO_MESSAGE("Loaded ", NumTextures, " unique textures (", NumBaked, " baked) for ", m_NumRequests, " requests in ",
+                     LoadTimer.GetElapsedTime() * 1000.0, " ms (decoding: ", DecodeTime * 1000.0, " ms)");
+}
+
+} // namespace Diligent
@@ -0,0 +1,68 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "RefCntAutoPtr.hpp"
+#include "TextureUtilities.h"
+
+namespace Diligent
+{
+
+// Collects the textures requested by the scene materials and loads every distinct
+// file and load settings combination once. Images are decoded and their mips are
+// generated on worker threads; the textures are then created on the calling thread.
+// Block-compressed versions baked offline ('<file>.dds') are preferred over the source images.
+class SceneTextureCache
+{
+public:
+    // Returns the index of the texture in the array filled by Load(). Requests with the
+    // same path and load settings share the texture.
+    Uint32 Request(const char* Path, const TextureLoadInfo& LoadInfo);
+
+    // Loads all requested textures. Textures that fail to load are null.
+    void Load(IRenderDevice* pDevice, IDeviceContext* pContext, std::vector<RefCntAutoPtr<ITexture>>& Textures);
+
+    Uint32 GetNumRequests() const { return m_NumRequests; }
+    Uint32 GetNumTextures() const { return static_cast<Uint32>(m_Entries.size()); }
+
+private:
+    struct Entry
+    {
+        String          Path;
+        TextureLoadInfo LoadInfo;
+    };
+    std::vector<Entry>                 m_Entries;
+    std::unordered_map<String, Uint32> m_EntryIndex; // Path and load settings -> index in m_Entries
+    Uint32                             m_NumRequests = 0;
+};
+
+} // namespace Diligent
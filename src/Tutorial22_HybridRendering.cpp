@@ -24,6 +24,13 @@
  *  of the possibility of such damages.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <unordered_set>
+
 #include "Tutorial22_HybridRendering.hpp"
 
 #include "MapHelper.hpp"
@@ -34,6 +41,13 @@
 #include "ImGuiUtils.hpp"
 #include "../imGuIZMO.quat/imGuIZMO.h"
 #include "Align.hpp"
+#include "AdvancedMath.hpp"
+#include "Timer.hpp"
+#include "HashUtils.hpp"
+#include "SceneTextureCache.hpp"
+#include "MazeWallMesh.hpp"
+#include "CommandLineParser.hpp"
+#include "PlatformMisc.hpp"
 
 namespace Diligent
 {
@@ -46,25 +60,26 @@ SampleBase* CreateSample()
     return new Tutorial22_HybridRendering();
 }
 
-struct AABB
-{
-    float3 min;
-    float3 max;
-};
+// Collision boxes of walls and doors, see HandleCollisions()
+MazeBoxSoA MazeWalls;
+
+// Walls near the camera gathered from the collision grid for the collision kernel
+MazeBoxSoA          CollisionCandidates;
+std::vector<Uint32> CollisionCandidateIds;
 
-std::vector<AABB> MazeWalls;
+std::vector<MazeSphereBoxOverlap> CollisionOverlaps;
 
 struct Key
 {
-    float3           Min;
-    float3           Max;
-    bool             Collected = false;
-    int              ObjectIdx = -1; 
-    int              WallIdx   = -1; 
-    std::vector<int> DoorIds;
+    int    ObjectIdx = -1; 
+    int    WallIdx   = -1; 
+    Uint64 Cell      = 0; // Packed cell coordinates
+    int2   LockScope;
+    Uint8  BlockType = 0;
 };
 
 std::vector<Key> m_Keys;
+MazeBoxSoA       m_KeyBounds; // Bounds of m_Keys; collected keys are removed from both
 int              m_KeysCollected = 0;
 
 struct Door
@@ -78,21 +93,60 @@ struct Door
     float4x4 OriginalMat;      
     int      Id;              
     int      BlockType;
+    int2     LockScope;
+    int2     Cell;
+    float    LodPendingTime = 0.0f; // See MazeSimulationLod
 };
 std::vector<Door> m_Doors;
 
+// Keys and doors of evicted chunks are destroyed, so their state is kept separately
+std::unordered_set<Uint64> m_CollectedKeys; // Cells of collected keys
+std::unordered_set<Uint64> m_UnlockedDoors; // Door block types unlocked by collected keys, see GetDoorLockId()
+
+// A key opens the doors of the bound block types that are in the same lock scope:
+// the whole level, or a single chunk of a generated world.
+Uint64 GetDoorLockId(const int2& LockScope, Uint32 DoorBlockType)
+{
+    return (static_cast<Uint64>(static_cast<Uint32>(LockScope.x) & 0xFFFFFFu) << 40u) |
+        (static_cast<Uint64>(static_cast<Uint32>(LockScope.y) & 0xFFFFFFu) << 16u) |
+        DoorBlockType;
+}
+
 bool  m_ShowUnlockMsg  = false;
 float m_UnlockMsgTimer = 0.0f;
 float m_UnlockMsgTime  = 3.0f; 
 
-struct KeyDoorBinding
-{
-    int KeyBlockType;
-    int DoorBlockType;
-};
-
-std::vector<KeyDoorBinding> m_KeyDoorBindings;
 
+// Images of the cube materials, which the block types of levels index
+const char* const CubeMaterialImages[] = {
+    "DGLogo0.png",
+    "DGLogo1.png",
+    "payaso.png",
+    "bichoraro.png",
+    "DGLogo4.png",
+    "ExitHell.jpg",
+    "ExitHell1.jpg",
+    "ExitHell2.jpg",
+    "Techo.jpg",
+    "DGLogo4.png",
+    "DGLogo4.png",
+    "DGLogo4.png",
+    "DGLogo4.png",
+    "DGLogo4.png",
+    "DGLogo4.png",
+    "DGLogo4.png",
+    "DGLogo4.png",
+    "DGLogo5.jpeg",
+    "payaso2.png",
+    "key.jpg",
+    "key.jpg",
+    "key.jpg",
+    "key.jpg",
+    "key.jpg",
+    "key.jpg",
+    "key.jpg",
+    "key.jpg",
+};
 
 void Tutorial22_HybridRendering::CreateSceneMaterials(uint2& CubeMaterialRange, Uint32& GroundMaterial, std::vector<HLSL::MaterialAttribs>& Materials)
 {
@@ -121,515 +175,351 @@ void Tutorial22_HybridRendering::CreateSceneMaterials(uint2& CubeMaterialRange,
         m_Scene.Samplers.push_back(std::move(pSampler));
     }
 
+    // Materials that use the same image share the texture. All textures are loaded at once below.
+    SceneTextureCache TexCache;
+
     const auto LoadMaterial = [&](const char* ColorMapName, const float4& BaseColor, Uint32 SamplerInd) //
     {
         TextureLoadInfo loadInfo;
         loadInfo.IsSRGB       = true;
         loadInfo.GenerateMips = true;
-        RefCntAutoPtr<ITexture> Tex;
-        CreateTextureFromFile(ColorMapName, loadInfo, m_pDevice, &Tex);
-        VERIFY_EXPR(Tex);
 
         HLSL::MaterialAttribs mtr;
         mtr.SampInd         = SamplerInd;
         mtr.BaseColorMask   = BaseColor;
-        mtr.BaseColorTexInd = static_cast<Uint32>(m_Scene.Textures.size());
-        m_Scene.Textures.push_back(std::move(Tex));
+        mtr.BaseColorTexInd = TexCache.Request(ColorMapName, loadInfo);
         Materials.push_back(mtr);
     };
 
     // Cube materials
     CubeMaterialRange.x = static_cast<Uint32>(Materials.size());
-    LoadMaterial("DGLogo0.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("DGLogo1.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("payaso.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("bichoraro.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("DGLogo4.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("ExitHell.jpg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("ExitHell1.jpg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("ExitHell2.jpg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("Techo.jpg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("DGLogo4.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("DGLogo4.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("DGLogo4.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("DGLogo4.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("DGLogo4.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("DGLogo4.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("DGLogo4.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("DGLogo4.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("DGLogo5.jpeg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("payaso2.png", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("key.jpg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("key.jpg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("key.jpg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("key.jpg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("key.jpg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("key.jpg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("key.jpg", float4{1.f}, AnisotropicClampSampInd);
-    LoadMaterial("key.jpg", float4{1.f}, AnisotropicClampSampInd);
+    for (const char* ImageName : CubeMaterialImages)
+        LoadMaterial(ImageName, float4{1.f}, AnisotropicClampSampInd);
 
     CubeMaterialRange.y = static_cast<Uint32>(Materials.size());
 
     // Ground material
     GroundMaterial = static_cast<Uint32>(Materials.size());
     LoadMaterial("Marble.jpg", float4{1.f}, AnisotropicWrapSampInd);
+
+    TexCache.Load(m_pDevice, m_pImmediateContext, m_Scene.Textures);
 }
 
-Tutorial22_HybridRendering::Mesh Tutorial22_HybridRendering::CreateTexturedPlaneMesh(IRenderDevice* pDevice, float2 UVScale)
+void Tutorial22_HybridRendering::GetTexturedPlaneGeometry(float2 UVScale, std::vector<HLSL::Vertex>& Vertices, std::vector<Uint32>& Indices)
 {
-    Mesh PlaneMesh;
-    PlaneMesh.Name = "Ground";
+    struct PlaneVertex // Alias for HLSL::Vertex
+    {
+        float3 pos;
+        float3 norm;
+        float2 uv;
+    };
+    static_assert(sizeof(PlaneVertex) == sizeof(HLSL::Vertex), "Vertex size mismatch");
 
+    // clang-format off
+    const PlaneVertex PlaneVertices[] = 
     {
-        struct PlaneVertex // Alias for HLSL::Vertex
-        {
-            float3 pos;
-            float3 norm;
-            float2 uv;
-        };
-        static_assert(sizeof(PlaneVertex) == sizeof(HLSL::Vertex), "Vertex size mismatch");
+        {float3{-1, 0, -1}, float3{0, 1, 0}, float2{0,         0        }},
+        {float3{ 1, 0, -1}, float3{0, 1, 0}, float2{UVScale.x, 0        }},
+        {float3{-1, 0,  1}, float3{0, 1, 0}, float2{0,         UVScale.y}},
+        {float3{ 1, 0,  1}, float3{0, 1, 0}, float2{UVScale.x, UVScale.y}}
+    };
+    // clang-format on
+    Vertices.resize(_countof(PlaneVertices));
+    memcpy(Vertices.data(), PlaneVertices, sizeof(PlaneVertices));
 
-        // clang-format off
-        const PlaneVertex Vertices[] = 
-        {
-            {float3{-1, 0, -1}, float3{0, 1, 0}, float2{0,         0        }},
-            {float3{ 1, 0, -1}, float3{0, 1, 0}, float2{UVScale.x, 0        }},
-            {float3{-1, 0,  1}, float3{0, 1, 0}, float2{0,         UVScale.y}},
-            {float3{ 1, 0,  1}, float3{0, 1, 0}, float2{UVScale.x, UVScale.y}}
-        };
-        // clang-format on
-        PlaneMesh.NumVertices = _countof(Vertices);
+    Indices = {0, 2, 3, 3, 1, 0};
+}
+
+void Tutorial22_HybridRendering::CreateSceneMeshData(float2                                 FloorUVScale,
+                                                     std::vector<MazeSceneCache::MeshDesc>& Meshes,
+                                                     std::vector<HLSL::Vertex>&             Vertices,
+                                                     std::vector<Uint32>&                   Indices) const
+{
+    RefCntAutoPtr<IDataBlob> pCubeVertices;
+    RefCntAutoPtr<IDataBlob> pCubeIndices;
+    GeometryPrimitiveInfo    CubeGeoInfo;
+    CreateGeometryPrimitive(CubeGeometryPrimitiveAttributes{2.f, GEOMETRY_PRIMITIVE_VERTEX_FLAG_ALL},
+                            &pCubeVertices, &pCubeIndices, &CubeGeoInfo);
+    VERIFY(CubeGeoInfo.VertexSize == sizeof(HLSL::Vertex), "Cube vertex layout does not match HLSL::Vertex");
+
+    std::vector<HLSL::Vertex> PlaneVertices;
+    std::vector<Uint32>       PlaneIndices;
+    GetTexturedPlaneGeometry(FloorUVScale, PlaneVertices, PlaneIndices);
+
+    const auto RTProps = m_pDevice->GetAdapterInfo().RayTracing;
+
+    Meshes.resize(2);
+
+    // Cube mesh goes to the beginning of the buffers
+    MazeSceneCache::MeshDesc& Cube = Meshes[0];
+    Cube.Name                      = "Cube";
+    Cube.FirstVertex               = 0;
+    Cube.NumVertices               = CubeGeoInfo.NumVertices;
+    Cube.FirstIndex                = 0;
+    Cube.NumIndices                = CubeGeoInfo.NumIndices;
+
+    // Plane mesh data resides after the cube. Offsets must be properly aligned!
+    MazeSceneCache::MeshDesc& Plane = Meshes[1];
+    Plane.Name                      = "Ground";
+    Plane.FirstVertex               = AlignUp(Cube.NumVertices * Uint32{sizeof(HLSL::Vertex)}, RTProps.VertexBufferAlignment) / sizeof(HLSL::Vertex);
+    Plane.NumVertices               = static_cast<Uint32>(PlaneVertices.size());
+    Plane.FirstIndex                = AlignUp(Cube.NumIndices * Uint32{sizeof(Uint32)}, RTProps.IndexBufferAlignment) / sizeof(Uint32);
+    Plane.NumIndices                = static_cast<Uint32>(PlaneIndices.size());
+
+    Vertices.assign(size_t{Plane.FirstVertex} + Plane.NumVertices, HLSL::Vertex{});
+    memcpy(&Vertices[Cube.FirstVertex], pCubeVertices->GetConstDataPtr(), size_t{Cube.NumVertices} * sizeof(HLSL::Vertex));
+    std::copy(PlaneVertices.begin(), PlaneVertices.end(), Vertices.begin() + Plane.FirstVertex);
+
+    Indices.assign(size_t{Plane.FirstIndex} + Plane.NumIndices, 0);
+    memcpy(&Indices[Cube.FirstIndex], pCubeIndices->GetConstDataPtr(), size_t{Cube.NumIndices} * sizeof(Uint32));
+    std::copy(PlaneIndices.begin(), PlaneIndices.end(), Indices.begin() + Plane.FirstIndex);
+
+    // Static walls of the level are baked into one mesh with a batch of indices per material.
+    // Every batch is a separate "Walls" mesh that becomes a geometry of the walls BLAS, so its
+    // offset in the index buffer must be aligned as well.
+    if (m_Generator.IsInitialized())
+        return;
+
+    Timer        BakeTimer;
+    MazeWallMesh WallMesh;
+    const auto   Stats = BakeMazeWallMesh(m_Level, WallMesh);
+    static_assert(sizeof(MazeMeshVertex) == sizeof(HLSL::Vertex), "Vertex size mismatch");
 
-        BufferDesc VBDesc;
-        VBDesc.Name              = "Plane vertex buffer";
-        VBDesc.Usage             = USAGE_IMMUTABLE;
-        VBDesc.BindFlags         = BIND_VERTEX_BUFFER | BIND_SHADER_RESOURCE | BIND_RAY_TRACING;
-        VBDesc.Size              = sizeof(Vertices);
-        VBDesc.Mode              = BUFFER_MODE_STRUCTURED;
-        VBDesc.ElementByteStride = sizeof(Vertices[0]);
-        BufferData VBData{Vertices, VBDesc.Size};
-        pDevice->CreateBuffer(VBDesc, &VBData, &PlaneMesh.VertexBuffer);
+    const Uint32 WallsFirstVertex = AlignUp(static_cast<Uint32>(Vertices.size()) * Uint32{sizeof(HLSL::Vertex)}, RTProps.VertexBufferAlignment) / sizeof(HLSL::Vertex);
+    Vertices.resize(size_t{WallsFirstVertex} + WallMesh.Vertices.size());
+    memcpy(&Vertices[WallsFirstVertex], WallMesh.Vertices.data(), WallMesh.Vertices.size() * sizeof(HLSL::Vertex));
+
+    for (const MazeMeshBatch& Batch : WallMesh.Batches)
+    {
+        MazeSceneCache::MeshDesc Walls;
+        Walls.Name        = "Walls";
+        Walls.FirstVertex = WallsFirstVertex;
+        Walls.NumVertices = static_cast<Uint32>(WallMesh.Vertices.size());
+        Walls.FirstIndex  = AlignUp(static_cast<Uint32>(Indices.size()) * Uint32{sizeof(Uint32)}, RTProps.IndexBufferAlignment) / sizeof(Uint32);
+        Walls.NumIndices  = Batch.NumIndices;
+        Walls.Material    = Batch.Material;
+        Meshes.push_back(Walls);
+
+        Indices.resize(size_t{Walls.FirstIndex} + Walls.NumIndices);
+        std::copy(WallMesh.Indices.begin() + Batch.FirstIndex, WallMesh.Indices.begin() + Batch.FirstIndex + Batch.NumIndices, Indices.begin() + Walls.FirstIndex);
     }
 
+    LOG_INFO_MESSAGE("Baked ", Stats.NumWalls, " static walls (", Stats.NumCubeTriangles, " cube triangles) into a mesh of ", Stats.NumTriangles,
+                     " triangles and ", WallMesh.Batches.size(), " materials in ", BakeTimer.GetElapsedTime() * 1000.0, " ms");
+}
+
+bool Tutorial22_HybridRendering::BakeSceneCache(const char*                                  Path,
+                                                Uint64                                       ContentHash,
+                                                const std::vector<MazeSceneCache::MeshDesc>& Meshes,
+                                                const std::vector<HLSL::Vertex>&             Vertices,
+                                                const std::vector<Uint32>&                   Indices) const
+{
+    Timer BakeTimer;
+
+    const int2 NumChunks{(m_Level.GetCols() + m_ChunkSize - 1) / m_ChunkSize,
+                         (m_Level.GetRows() + m_ChunkSize - 1) / m_ChunkSize};
+
+    // Chunks are independent, so rows of chunks are distributed between the threads
+    std::vector<MazeChunk> Chunks(static_cast<size_t>(NumChunks.x) * static_cast<size_t>(NumChunks.y));
     {
-        const Uint32 Indices[] = {0, 2, 3, 3, 1, 0};
-        PlaneMesh.NumIndices   = _countof(Indices);
+        const int NumThreads = std::max(std::min(static_cast<int>(std::thread::hardware_concurrency()), NumChunks.y), 1);
 
-        BufferDesc IBDesc;
-        IBDesc.Name              = "Plane index buffer";
-        IBDesc.BindFlags         = BIND_INDEX_BUFFER | BIND_SHADER_RESOURCE | BIND_RAY_TRACING;
-        IBDesc.Size              = sizeof(Indices);
-        IBDesc.Mode              = BUFFER_MODE_STRUCTURED;
-        IBDesc.ElementByteStride = sizeof(Indices[0]);
-        BufferData IBData{Indices, IBDesc.Size};
-        pDevice->CreateBuffer(IBDesc, &IBData, &PlaneMesh.IndexBuffer);
+        std::vector<std::thread> Threads;
+        for (int t = 0; t < NumThreads; ++t)
+        {
+            Threads.emplace_back([&, t]() {
+                for (int z = t; z < NumChunks.y; z += NumThreads)
+                {
+                    for (int x = 0; x < NumChunks.x; ++x)
+                    {
+                        MazeChunk& Chunk = Chunks[static_cast<size_t>(z) * NumChunks.x + x];
+                        Chunk.Coord      = int2{x, z};
+                        BuildMazeChunk(m_Level, nullptr, m_ChunkSize, Chunk);
+                    }
+                }
+            });
+        }
+        for (auto& Thread : Threads)
+            Thread.join();
     }
 
-    return PlaneMesh;
+    MazeSceneCache::BakeInfo Info;
+    Info.ContentHash  = ContentHash;
+    Info.ChunkSize    = m_ChunkSize;
+    Info.NumChunks    = NumChunks;
+    Info.pChunks      = Chunks.data();
+    Info.pMeshes      = Meshes.data();
+    Info.NumMeshes    = static_cast<Uint32>(Meshes.size());
+    Info.pVertices    = Vertices.data();
+    Info.VertexStride = sizeof(HLSL::Vertex);
+    Info.NumVertices  = static_cast<Uint32>(Vertices.size());
+    Info.pIndices     = Indices.data();
+    Info.NumIndices   = static_cast<Uint32>(Indices.size());
+    if (!MazeSceneCache::Write(Path, Info))
+        return false;
+
+    LOG_INFO_MESSAGE("Baked scene cache '", Path, "' (", Chunks.size(), " chunks) in ", BakeTimer.GetElapsedTime() * 1000.0, " ms");
+    return true;
 }
 
 void Tutorial22_HybridRendering::CreateSceneObjects(const uint2 CubeMaterialRange, const Uint32 GroundMaterial)
 {
-    Uint32 CubeMeshId  = 0;
-    Uint32 PlaneMeshId = 0;
-
-    // Create meshes
+    // One floor texture tile spans FloorTileCells cells
+    constexpr float FloorTileCells = 4;
+    const float     FloorUVScale   = GetStreamingWindowSize() / (FloorTileCells * m_Level.GetCellSize());
+
+    // Level chunks and meshes are baked into a cache next to the level file. The cache is keyed
+    // by the level contents and everything else the baked data depends on, so an edited level
+    // or changed settings simply produce a new bake. Generated worlds are not cached.
+    const bool UseSceneCache = !m_Generator.IsInitialized();
+    const auto CachePath     = m_LevelPath + ".cache";
+    Uint64     CacheHash     = 0;
+    if (UseSceneCache)
     {
-        Mesh CubeMesh;
-        CubeMesh.Name = "Cube";
-        GeometryPrimitiveBuffersCreateInfo CubeBuffersCI;
-        CubeBuffersCI.VertexBufferBindFlags = BIND_VERTEX_BUFFER | BIND_SHADER_RESOURCE | BIND_RAY_TRACING;
-        CubeBuffersCI.IndexBufferBindFlags  = BIND_INDEX_BUFFER | BIND_SHADER_RESOURCE | BIND_RAY_TRACING;
-        CubeBuffersCI.VertexBufferMode      = BUFFER_MODE_STRUCTURED;
-        CubeBuffersCI.IndexBufferMode       = BUFFER_MODE_STRUCTURED;
-        GeometryPrimitiveInfo CubeGeoInfo;
-        CreateGeometryPrimitiveBuffers(m_pDevice, CubeGeometryPrimitiveAttributes{2.f, GEOMETRY_PRIMITIVE_VERTEX_FLAG_ALL},
-                                       &CubeBuffersCI, &CubeMesh.VertexBuffer, &CubeMesh.IndexBuffer, &CubeGeoInfo);
-        CubeMesh.NumVertices = CubeGeoInfo.NumVertices;
-        CubeMesh.NumIndices  = CubeGeoInfo.NumIndices;
+        const auto RTProps = m_pDevice->GetAdapterInfo().RayTracing;
+        CacheHash          = static_cast<Uint64>(ComputeHash(m_Level.ComputeContentHash(), MazeSceneCacheVersion, m_ChunkSize, FloorUVScale,
+                                                             RTProps.VertexBufferAlignment, RTProps.IndexBufferAlignment));
+        m_SceneCacheWarm   = m_SceneCache.Load(CachePath.c_str(), CacheHash);
+    }
 
-        auto PlaneMesh = CreateTexturedPlaneMesh(m_pDevice, float2{25});
+    std::vector<MazeSceneCache::MeshDesc> MeshDescs;
+    std::vector<HLSL::Vertex>             Vertices;
+    std::vector<Uint32>                   Indices;
+    if (m_SceneCache.IsLoaded())
+    {
+        MeshDescs.resize(m_SceneCache.GetNumMeshes());
+        for (Uint32 i = 0; i < m_SceneCache.GetNumMeshes(); ++i)
+            MeshDescs[i] = m_SceneCache.GetMesh(i);
+    }
+    else
+    {
+        CreateSceneMeshData(float2{FloorUVScale}, MeshDescs, Vertices, Indices);
+        if (UseSceneCache && BakeSceneCache(CachePath.c_str(), CacheHash, MeshDescs, Vertices, Indices))
+            m_SceneCache.Load(CachePath.c_str(), CacheHash);
+    }
 
-        const auto RTProps = m_pDevice->GetAdapterInfo().RayTracing;
+    // Walls, doors and keys are built by chunks around the camera on the streamer threads
+    // or copied from the scene cache
+    {
+        MazeChunkStreamer::CreateInfo StreamerCI;
+        StreamerCI.pLevel           = &m_Level;
+        StreamerCI.pGenerator       = m_Generator.IsInitialized() ? &m_Generator : nullptr;
+        StreamerCI.pCache           = m_SceneCache.IsLoaded() ? &m_SceneCache : nullptr;
+        StreamerCI.ChunkSize        = m_ChunkSize;
+        StreamerCI.LoadRadius       = m_ChunkLoadRadius;
+        StreamerCI.LookAheadChunks  = m_ChunkLookAhead;
+        StreamerCI.EvictRadius      = m_ChunkEvictRadius;
+        StreamerCI.NumWorkerThreads = std::max(std::min(std::thread::hardware_concurrency() / 2u, 4u), 1u);
+        m_ChunkStreamer.Start(StreamerCI);
+    }
 
-        // Cube mesh will be copied to the beginning of the buffers
-        CubeMesh.FirstVertex = 0;
-        CubeMesh.FirstIndex  = 0;
-        // Plane mesh data will reside after the cube. Offsets must be properly aligned!
-        PlaneMesh.FirstVertex = AlignUp(CubeMesh.NumVertices * Uint32{sizeof(HLSL::Vertex)}, RTProps.VertexBufferAlignment) / sizeof(HLSL::Vertex);
-        PlaneMesh.FirstIndex  = AlignUp(CubeMesh.NumIndices * Uint32{sizeof(uint)}, RTProps.IndexBufferAlignment) / sizeof(uint);
+    Uint32 CubeMeshId  = 0;
+    Uint32 PlaneMeshId = 0;
+    Uint32 WallMeshId  = ~0u;
 
-        // Merge vertex buffers
+    // Create meshes. All meshes share one vertex and one index buffer that are initialized
+    // directly from the cache or from the freshly built data.
+    {
+        const bool    FromCache   = Vertices.empty();
+        const void*   pVertices   = FromCache ? m_SceneCache.GetVertices() : Vertices.data();
+        const Uint32  NumVertices = FromCache ? m_SceneCache.GetNumVertices() : static_cast<Uint32>(Vertices.size());
+        const Uint32* pIndices    = FromCache ? m_SceneCache.GetIndices() : Indices.data();
+        const Uint32  NumIndices  = FromCache ? m_SceneCache.GetNumIndices() : static_cast<Uint32>(Indices.size());
+        VERIFY(!FromCache || m_SceneCache.GetVertexStride() == sizeof(HLSL::Vertex), "Unexpected vertex stride in the scene cache");
+
+        RefCntAutoPtr<IBuffer> pSharedVB;
         {
             BufferDesc VBDesc;
             VBDesc.Name              = "Shared vertex buffer";
+            VBDesc.Usage             = USAGE_IMMUTABLE;
             VBDesc.BindFlags         = BIND_VERTEX_BUFFER | BIND_SHADER_RESOURCE | BIND_RAY_TRACING;
-            VBDesc.Size              = (Uint64{PlaneMesh.FirstVertex} + Uint64{PlaneMesh.NumVertices}) * sizeof(HLSL::Vertex);
+            VBDesc.Size              = Uint64{NumVertices} * sizeof(HLSL::Vertex);
             VBDesc.Mode              = BUFFER_MODE_STRUCTURED;
             VBDesc.ElementByteStride = sizeof(HLSL::Vertex);
-
-            RefCntAutoPtr<IBuffer> pSharedVB;
-            m_pDevice->CreateBuffer(VBDesc, nullptr, &pSharedVB);
-
-            // Copy cube vertices
-            m_pImmediateContext->CopyBuffer(CubeMesh.VertexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
-                                            pSharedVB, CubeMesh.FirstVertex * sizeof(HLSL::Vertex), CubeMesh.NumVertices * sizeof(HLSL::Vertex),
-                                            RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-
-            // Copy plane vertices
-            m_pImmediateContext->CopyBuffer(PlaneMesh.VertexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
-                                            pSharedVB, PlaneMesh.FirstVertex * sizeof(HLSL::Vertex), PlaneMesh.NumVertices * sizeof(HLSL::Vertex),
-                                            RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-
-            CubeMesh.VertexBuffer  = pSharedVB;
-            PlaneMesh.VertexBuffer = pSharedVB;
+            BufferData VBData{pVertices, VBDesc.Size};
+            m_pDevice->CreateBuffer(VBDesc, &VBData, &pSharedVB);
         }
 
-        // Merge index buffers
+        RefCntAutoPtr<IBuffer> pSharedIB;
         {
             BufferDesc IBDesc;
             IBDesc.Name              = "Shared index buffer";
+            IBDesc.Usage             = USAGE_IMMUTABLE;
             IBDesc.BindFlags         = BIND_INDEX_BUFFER | BIND_SHADER_RESOURCE | BIND_RAY_TRACING;
-            IBDesc.Size              = (Uint64{PlaneMesh.FirstIndex} + Uint64{PlaneMesh.NumIndices}) * sizeof(uint);
+            IBDesc.Size              = Uint64{NumIndices} * sizeof(Uint32);
             IBDesc.Mode              = BUFFER_MODE_STRUCTURED;
-            IBDesc.ElementByteStride = sizeof(uint);
-
-            RefCntAutoPtr<IBuffer> pSharedIB;
-            m_pDevice->CreateBuffer(IBDesc, nullptr, &pSharedIB);
-
-            // Copy cube indices
-            m_pImmediateContext->CopyBuffer(CubeMesh.IndexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
-                                            pSharedIB, CubeMesh.FirstIndex * sizeof(uint), CubeMesh.NumIndices * sizeof(uint),
-                                            RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-
-            // Copy plane indices
-            m_pImmediateContext->CopyBuffer(PlaneMesh.IndexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
-                                            pSharedIB, PlaneMesh.FirstIndex * sizeof(uint), PlaneMesh.NumIndices * sizeof(uint),
-                                            RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-
-            CubeMesh.IndexBuffer  = pSharedIB;
-            PlaneMesh.IndexBuffer = pSharedIB;
+            IBDesc.ElementByteStride = sizeof(Uint32);
+            BufferData IBData{pIndices, IBDesc.Size};
+            m_pDevice->CreateBuffer(IBDesc, &IBData, &pSharedIB);
         }
 
-        CubeMeshId = static_cast<Uint32>(m_Scene.Meshes.size());
-        m_Scene.Meshes.push_back(CubeMesh);
-        PlaneMeshId = static_cast<Uint32>(m_Scene.Meshes.size());
-        m_Scene.Meshes.push_back(PlaneMesh);
-    }
-    const int mazeRows = 50;
-    const int mazeCols = 100;
-
-    int maze[mazeRows][mazeCols] = {
-        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 19, 1, 1, 1, 1, 1, 1, 1, 1, 1, 19, 1, 1, 1, 1},
-        {1, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 1, 1, 1, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 3, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 19},
-        {1, 3, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 3, 1, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 3, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 3, 1, 1, 1, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 23, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 3, 0, 0, 1, 1, 0, 24, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 3, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 3, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 3, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 19},
-        {1, 3, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 3, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 3, 3, 3, 3, 3, 14, 14, 14, 14, 14, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 15, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 12, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 13, 13, 13, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-        {1, 0, 0, 0, 0, 1, 0, 0, 25, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 11, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 5, 5, 5, 1, 13, 13, 13, 1, 5, 5, 5, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 22, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 7, 6, 8, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 3, 1, 3, 1, 3, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1},
-        {1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 27, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 4, 0, 0, 0, 0, 0, 21, 0, 0, 0, 0, 4, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1},
-        {1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 4, 1, 2, 1, 10, 10, 10, 10, 1, 2, 1, 1, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 17, 17, 17, 1, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, 0, 0, 1},
-        {1, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 20, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1},
-        {1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1},
-        {1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 26, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}};
-
-    std::vector<std::vector<bool>> visited(mazeRows, std::vector<bool>(mazeCols, false));
-    m_KeyDoorBindings.push_back({20, 10});
-    m_KeyDoorBindings.push_back({21, 11});
-    m_KeyDoorBindings.push_back({22, 12});
-    m_KeyDoorBindings.push_back({23, 13});
-    m_KeyDoorBindings.push_back({24, 14});
-    m_KeyDoorBindings.push_back({25, 15});
-    m_KeyDoorBindings.push_back({26, 16});
-    m_KeyDoorBindings.push_back({27, 17});
-
-    // PASADA 1: Muros, puertas y bloques especiales
-    for (int z = 0; z < mazeRows; ++z)
-    {
-        for (int x = 0; x < mazeCols; ++x)
+        for (const auto& Desc : MeshDescs)
         {
-            if (!visited[z][x] && maze[z][x] != 0)
+            // Material batches of the baked walls are the geometries of a single mesh
+            if (Desc.Name == "Walls")
             {
-                int blockType = maze[z][x];
-
-                if (blockType == 1)
-                {
-                    visited[z][x] = true;
-                    float spacing = 2.0f;
-                    float scaleY  = 3.0f;
-                    float posY    = scaleY - 0.2f;
-                    float scaleX  = spacing * 0.5f;
-                    float scaleZ  = spacing * 0.5f;
-                    float posX    = (x - mazeCols / 2.0f) * spacing;
-                    float posZ    = (z - mazeRows / 2.0f) * spacing;
-
-                    int materialOffset = CubeMaterialRange.x + (blockType - 1);
-
-                    HLSL::ObjectAttribs obj;
-                    obj.ModelMat = (float4x4::Scale(scaleX, scaleY, scaleZ) *
-                                    float4x4::Translation(posX, posY, posZ))
-                                       .Transpose();
-                    obj.NormalMat   = obj.ModelMat;
-                    obj.MaterialId  = materialOffset;
-                    obj.MeshId      = CubeMeshId;
-                    obj.FirstIndex  = m_Scene.Meshes[obj.MeshId].FirstIndex;
-                    obj.FirstVertex = m_Scene.Meshes[obj.MeshId].FirstVertex;
-                    m_Scene.Objects.push_back(obj);
-
-                    float3 wallMin = {posX - scaleX, 0.0f, posZ - scaleZ};
-                    float3 wallMax = {posX + scaleX, scaleY, posZ + scaleZ};
-                    MazeWalls.push_back({wallMin, wallMax});
-                }
-                else if (blockType >= 10 && blockType <= 17) // puerta
-                {
-                    int runX = 1;
-                    while (x + runX < mazeCols && maze[z][x + runX] == blockType && !visited[z][x + runX])
-                        runX++;
-                    int runZ = 1;
-                    while (z + runZ < mazeRows && maze[z + runZ][x] == blockType && !visited[z + runZ][x])
-                        runZ++;
-
-                    bool horizontal = runX >= runZ;
-                    int  runLength  = horizontal ? runX : runZ;
-
-                    for (int i = 0; i < runLength; ++i)
-                    {
-                        if (horizontal)
-                            visited[z][x + i] = true;
-                        else
-                            visited[z + i][x] = true;
-                    }
-
-                    float spacing = 2.0f;
-                    float scaleY  = 3.0f;
-                    float posY    = scaleY - 0.2f;
-                    float posX, posZ, scaleX, scaleZ;
-
-                    if (horizontal)
-                    {
-                        scaleX = spacing * runLength * 0.5f;
-                        scaleZ = spacing * 0.5f;
-                        posX   = (x + (runLength - 1) * 0.5f - mazeCols / 2.0f) * spacing;
-                        posZ   = (z - mazeRows / 2.0f) * spacing;
-                    }
-                    else
-                    {
-                        scaleX = spacing * 0.5f;
-                        scaleZ = spacing * runLength * 0.5f;
-                        posX   = (x - mazeCols / 2.0f) * spacing;
-                        posZ   = (z + (runLength - 1) * 0.5f - mazeRows / 2.0f) * spacing;
-                    }
-
-                    int materialOffset = CubeMaterialRange.x + (blockType - 1);
-
-                    HLSL::ObjectAttribs obj;
-                    obj.ModelMat = (float4x4::Scale(scaleX, scaleY, scaleZ) *
-                                    float4x4::Translation(posX, posY, posZ))
-                                       .Transpose();
-                    obj.NormalMat   = obj.ModelMat;
-                    obj.MaterialId  = materialOffset;
-                    obj.MeshId      = CubeMeshId;
-                    obj.FirstIndex  = m_Scene.Meshes[obj.MeshId].FirstIndex;
-                    obj.FirstVertex = m_Scene.Meshes[obj.MeshId].FirstVertex;
-
-                    int objIdx = static_cast<int>(m_Scene.Objects.size());
-                    m_Scene.Objects.push_back(obj);
-
-                    float3 wallMin = {posX - scaleX, 0.0f, posZ - scaleZ};
-                    float3 wallMax = {posX + scaleX, scaleY, posZ + scaleZ};
-                    int    wallIdx = static_cast<int>(MazeWalls.size());
-                    MazeWalls.push_back({wallMin, wallMax});
-
-                    Door door;
-                    door.WallIdx     = wallIdx;
-                    door.ObjectIdx   = objIdx;
-                    door.Opened      = false;
-                    door.Rising      = false;
-                    door.RiseTimer   = 0.0f;
-                    door.OriginalMat = {};
-                    door.Id          = m_nextDoorId++;
-                    m_Doors.push_back(door);
-                }
-                else if (blockType >= 2 && blockType <= 9 || blockType == 19)
+                if (!m_UseWallMesh)
+                    continue;
+                if (WallMeshId == ~0u)
                 {
-                    int runX = 1;
-                    while (x + runX < mazeCols && maze[z][x + runX] == blockType && !visited[z][x + runX])
-                        runX++;
-
-                    int runZ = 1;
-                    while (z + runZ < mazeRows && maze[z + runZ][x] == blockType && !visited[z + runZ][x])
-                        runZ++;
-
-                    bool horizontal = runX >= runZ;
-                    int  runLength  = horizontal ? runX : runZ;
-
-                    for (int i = 0; i < runLength; ++i)
-                    {
-                        if (horizontal)
-                            visited[z][x + i] = true;
-                        else
-                            visited[z + i][x] = true;
-                    }
-
-                    float spacing = 2.0f;
-                    float scaleY  = 3.0f;
-                    float posY    = scaleY - 0.2f;
-
-                    float posX, posZ, scaleX, scaleZ;
-
-                    if (horizontal)
-                    {
-                        scaleX = spacing * runLength * 0.5f;
-                        scaleZ = spacing * 0.5f;
-                        posX   = (x + (runLength - 1) / 2.0f - mazeCols / 2.0f) * spacing;
-                        posZ   = (z - mazeRows / 2.0f) * spacing;
-                    }
-                    else
-                    {
-                        scaleX = spacing * 0.5f;
-                        scaleZ = spacing * runLength * 0.5f;
-                        posX   = (x - mazeCols / 2.0f) * spacing;
-                        posZ   = (z + (runLength - 1) / 2.0f - mazeRows / 2.0f) * spacing;
-                    }
-
-                    int materialOffset = CubeMaterialRange.x + (blockType - 1);
-
-                    HLSL::ObjectAttribs obj;
-                    obj.ModelMat = (float4x4::Scale(scaleX, scaleY, scaleZ) *
-                                    float4x4::Translation(posX, posY, posZ))
-                                       .Transpose();
-                    obj.NormalMat   = obj.ModelMat;
-                    obj.MaterialId  = materialOffset;
-                    obj.MeshId      = CubeMeshId;
-                    obj.FirstIndex  = m_Scene.Meshes[obj.MeshId].FirstIndex;
-                    obj.FirstVertex = m_Scene.Meshes[obj.MeshId].FirstVertex;
-                    m_Scene.Objects.push_back(obj);
-
-                    float3 wallMin = {posX - scaleX, 0.0f, posZ - scaleZ};
-                    float3 wallMax = {posX + scaleX, scaleY, posZ + scaleZ};
-                    MazeWalls.push_back({wallMin, wallMax});
+                    Mesh Walls;
+                    Walls.Name         = Desc.Name;
+                    Walls.VertexBuffer = pSharedVB;
+                    Walls.IndexBuffer  = pSharedIB;
+                    Walls.FirstVertex  = Desc.FirstVertex;
+                    Walls.NumVertices  = Desc.NumVertices;
+                    Walls.FirstIndex   = Desc.FirstIndex;
+                    WallMeshId         = static_cast<Uint32>(m_Scene.Meshes.size());
+                    m_Scene.Meshes.push_back(Walls);
                 }
+                Mesh& Walls      = m_Scene.Meshes[WallMeshId];
+                Walls.NumIndices = Desc.FirstIndex + Desc.NumIndices - Walls.FirstIndex;
+                Walls.Geometries.push_back({Desc.FirstIndex, Desc.NumIndices, Desc.Material});
+                continue;
             }
+
+            Mesh NewMesh;
+            NewMesh.Name         = Desc.Name;
+            NewMesh.VertexBuffer = pSharedVB;
+            NewMesh.IndexBuffer  = pSharedIB;
+            NewMesh.FirstVertex  = Desc.FirstVertex;
+            NewMesh.NumVertices  = Desc.NumVertices;
+            NewMesh.FirstIndex   = Desc.FirstIndex;
+            NewMesh.NumIndices   = Desc.NumIndices;
+            if (NewMesh.Name == "Cube")
+                CubeMeshId = static_cast<Uint32>(m_Scene.Meshes.size());
+            else if (NewMesh.Name == "Ground")
+                PlaneMeshId = static_cast<Uint32>(m_Scene.Meshes.size());
+            m_Scene.Meshes.push_back(NewMesh);
         }
     }
-
-    // PASADA 2: Llaves
-    for (int z = 0; z < mazeRows; ++z)
+    // Every geometry of every mesh has an element in the geometry attribs buffer, see CreateScene()
     {
-        for (int x = 0; x < mazeCols; ++x)
+        Uint32 NumGeometries = 0;
+        for (auto& Mesh : m_Scene.Meshes)
         {
-            int blockType = maze[z][x];
-            if (blockType >= 20 && blockType <= 27 && !visited[z][x])
-            {
-                visited[z][x] = true;
-
-                float spacing = 2.0f;
-                float size    = 0.5f;
-                float posX    = (x - mazeCols / 2.0f) * spacing;
-                float posY    = size + 2.0f;
-                float posZ    = (z - mazeRows / 2.0f) * spacing;
-
-                HLSL::ObjectAttribs keyObj;
-                keyObj.ModelMat = (float4x4::Scale(size, size, size) *
-                                   float4x4::Translation(posX, posY, posZ))
-                                      .Transpose();
-                keyObj.NormalMat   = keyObj.ModelMat;
-                keyObj.MaterialId  = CubeMaterialRange.x + (blockType - 1);
-                keyObj.MeshId      = CubeMeshId;
-                keyObj.FirstIndex  = m_Scene.Meshes[keyObj.MeshId].FirstIndex;
-                keyObj.FirstVertex = m_Scene.Meshes[keyObj.MeshId].FirstVertex;
-
-                int objIdx = static_cast<int>(m_Scene.Objects.size());
-                m_Scene.Objects.push_back(keyObj);
-
-                Key newKey;
-                newKey.Min       = {posX - size, posY - size, posZ - size};
-                newKey.Max       = {posX + size, posY + size, posZ + size};
-                newKey.ObjectIdx = objIdx;
-
-                int doorType = -1;
-                for (const auto& binding : m_KeyDoorBindings)
-                {
-                    if (binding.KeyBlockType == blockType)
-                    {
-                        doorType = binding.DoorBlockType;
-                        break;
-                    }
-                }
-
-                for (const Door& door : m_Doors)
-                {
-                    const HLSL::ObjectAttribs& doorObj = m_Scene.Objects[door.ObjectIdx];
-                    if (doorObj.MaterialId == CubeMaterialRange.x + (doorType - 1))
-                    {
-                        newKey.DoorIds.push_back(door.Id);
-                    }
-                }
-
-
-                m_Keys.push_back(newKey);
-            }
+            Mesh.FirstGeometryId = NumGeometries;
+            NumGeometries += std::max(static_cast<Uint32>(Mesh.Geometries.size()), 1u);
         }
     }
+    m_CubeMeshId         = CubeMeshId;
+    m_CubeMaterialOffset = CubeMaterialRange.x;
+    m_WallMeshId         = WallMeshId;
 
-
-    // Crear instancia para todos los cubos del laberinto
+    // Floor, ceiling, baked walls and monsters are the only objects that do not belong to a chunk.
+    // The floor and the ceiling cover the streaming window and follow the camera.
     InstancedObjects InstObj;
-    InstObj.MeshInd             = CubeMeshId;
-    InstObj.NumObjects          = static_cast<Uint32>(m_Scene.Objects.size());
-    InstObj.ObjectAttribsOffset = 0;
-    m_Scene.ObjectInstances.push_back(InstObj);
-
 
     // Crear plano del suelo
     InstObj.ObjectAttribsOffset = static_cast<Uint32>(m_Scene.Objects.size());
     InstObj.MeshInd             = PlaneMeshId;
     {
-        HLSL::ObjectAttribs obj;
-        obj.ModelMat    = (float4x4::Scale(100.f, 1.f, 50.f) * float4x4::Translation(0.f, -0.2f, 0.f)).Transpose();
-        obj.NormalMat   = float3x3::Identity();
-        obj.MaterialId  = GroundMaterial;
-        obj.MeshId      = PlaneMeshId;
-        obj.FirstIndex  = m_Scene.Meshes[obj.MeshId].FirstIndex;
-        obj.FirstVertex = m_Scene.Meshes[obj.MeshId].FirstVertex;
+        SceneObject obj;
+        obj.NormalMat  = float3x3::Identity();
+        obj.MaterialId = GroundMaterial;
+        obj.MeshId     = PlaneMeshId;
+        obj.GeometryId = m_Scene.Meshes[obj.MeshId].FirstGeometryId;
+        m_FloorObjectIdx = static_cast<Uint32>(m_Scene.Objects.size());
         m_Scene.Objects.push_back(obj);
     }
     InstObj.NumObjects = static_cast<Uint32>(m_Scene.Objects.size()) - InstObj.ObjectAttribsOffset;
@@ -641,81 +531,328 @@ void Tutorial22_HybridRendering::CreateSceneObjects(const uint2 CubeMaterialRang
     ceilingInst.ObjectAttribsOffset = static_cast<Uint32>(m_Scene.Objects.size());
 
     {
-        HLSL::ObjectAttribs obj;
+        SceneObject obj;
+        obj.MaterialId = CubeMaterialRange.x + 8;
+        obj.MeshId     = CubeMeshId;
+        obj.GeometryId = m_Scene.Meshes[obj.MeshId].FirstGeometryId;
 
-        float spacing       = 2.0f;
-        float mazeWidth     = mazeCols * spacing;
-        float mazeDepth     = mazeRows * spacing;
-        float thickness     = 0.5f;
-        float ceilingHeight = 6.0f;
+        m_CeilingObjectIdx = static_cast<Uint32>(m_Scene.Objects.size());
+        m_Scene.Objects.push_back(obj);
+    }
 
-        float scaleX = mazeWidth * 0.5f;
-        float scaleY = thickness;
-        float scaleZ = mazeDepth * 0.5f;
+    ceilingInst.NumObjects = static_cast<Uint32>(m_Scene.Objects.size()) - ceilingInst.ObjectAttribsOffset;
+    m_Scene.ObjectInstances.push_back(ceilingInst);
 
-        float posX = 0.0f;
-        float posY = ceilingHeight + scaleY * 0.5f;
-        float posZ = 0.0f;
+    // Baked walls have one object and one draw call per material
+    if (WallMeshId != ~0u)
+    {
+        const Mesh& Walls = m_Scene.Meshes[WallMeshId];
+        for (Uint32 g = 0; g < static_cast<Uint32>(Walls.Geometries.size()); ++g)
+        {
+            const MeshGeometry& Geometry = Walls.Geometries[g];
+
+            InstancedObjects wallInst;
+            wallInst.MeshInd             = WallMeshId;
+            wallInst.ObjectAttribsOffset = static_cast<Uint32>(m_Scene.Objects.size());
+            wallInst.NumObjects          = 1;
+            wallInst.FirstIndex          = Geometry.FirstIndex;
+            wallInst.NumIndices          = Geometry.NumIndices;
+            m_Scene.ObjectInstances.push_back(wallInst);
+
+            SceneObject obj;
+            obj.ModelMat   = float4x4::Identity();
+            obj.NormalMat  = float3x3::Identity();
+            obj.MaterialId = CubeMaterialRange.x + Geometry.Material;
+            obj.MeshId     = WallMeshId;
+            obj.GeometryId = Walls.FirstGeometryId + g;
+            m_Scene.Objects.push_back(obj);
+        }
+    }
 
-        obj.ModelMat = (float4x4::Scale(scaleX, scaleY, scaleZ) *
-                        float4x4::Translation(posX, posY, posZ))
-                           .Transpose();
 
-        obj.NormalMat   = obj.ModelMat;
-        obj.MaterialId  = CubeMaterialRange.x + 8;
-        obj.MeshId      = CubeMeshId;
-        obj.FirstIndex  = m_Scene.Meshes[obj.MeshId].FirstIndex;
-        obj.FirstVertex = m_Scene.Meshes[obj.MeshId].FirstVertex;
+    // Monsters occupy consecutive objects that are drawn with one instanced draw call.
+    // Their transforms are written by the crowd, see SpawnMonsters(). Monsters are rotated,
+    // so they are the only objects with full transforms.
+    {
+        SceneObject obj;
+        obj.ModelMat   = float4x4::Scale(0, 0, 0).Transpose();
+        obj.NormalMat  = float3x3::Identity();
+        obj.MaterialId = CubeMaterialRange.x + 17;
+        obj.MeshId     = CubeMeshId;
+        obj.GeometryId = m_Scene.Meshes[obj.MeshId].FirstGeometryId;
+
+        m_FirstMonsterObject = static_cast<Uint32>(m_Scene.Objects.size());
+        m_Scene.Objects.resize(m_Scene.Objects.size() + static_cast<size_t>(m_NumMonsters), obj);
+        for (Uint32 i = 0; i < static_cast<Uint32>(m_NumMonsters); ++i)
+            m_Scene.Objects[m_FirstMonsterObject + i].TransformId = i;
+    }
+    if (m_NumMonsters > 0)
+    {
+        InstancedObjects monsterInst;
+        monsterInst.MeshInd             = CubeMeshId;
+        monsterInst.ObjectAttribsOffset = m_FirstMonsterObject;
+        monsterInst.NumObjects          = static_cast<Uint32>(m_NumMonsters);
+        m_Scene.ObjectInstances.push_back(monsterInst);
+    }
+    m_NumStaticInstances = static_cast<Uint32>(m_Scene.ObjectInstances.size());
+
+    // Every resident chunk occupies a fixed-size slot in m_Scene.Objects and MazeWalls,
+    // so the arrays, the object attribs buffer and the TLAS are sized by the streaming
+    // window rather than by the level.
+    m_ChunkSlots.clear();
+    m_ChunkSlots.resize(m_ChunkStreamer.GetMaxResidentChunks());
+    m_FirstChunkObject   = static_cast<Uint32>(m_Scene.Objects.size());
+    m_MaxObjectsPerChunk = m_ChunkStreamer.GetMaxBoxesPerChunk();
+    m_Scene.Objects.resize(m_FirstChunkObject + m_MaxObjectsPerChunk * static_cast<Uint32>(m_ChunkSlots.size()));
+    m_Scene.ObjectDirty.assign(m_Scene.Objects.size(), 0);
+    m_Scene.DirtyObjects.reserve(m_Scene.Objects.size());
+    MazeWalls.Resize(m_MaxObjectsPerChunk * static_cast<Uint32>(m_ChunkSlots.size()));
+    m_CollisionGrid.Initialize(m_Level.GetCellSize(), MazeWalls.GetSize());
+
+    // Build the chunks around the spawn point before the first frame
+    Timer             LoadTimer;
+    std::vector<int2> EvictedChunks;
+    m_ChunkStreamer.Update(m_Camera.GetPos(), EvictedChunks);
+    m_ChunkStreamer.WaitIdle();
+    UpdateWorldStreaming(m_ChunkStreamer.GetMaxResidentChunks());
+    LOG_INFO_MESSAGE("World streaming: ", m_ChunkStreamer.GetNumResidentChunks(), " chunks of ", m_ChunkSize, "x", m_ChunkSize,
+                     " cells around the spawn point built in ", LoadTimer.GetElapsedTime() * 1000.0, " ms; ",
+                     m_ChunkSlots.size(), " chunk slots of ", m_MaxObjectsPerChunk, " objects");
+}
 
-        m_Scene.Objects.push_back(obj);
+void Tutorial22_HybridRendering::AddChunk(const MazeChunk& Chunk)
+{
+    auto SlotIt = std::find_if(m_ChunkSlots.begin(), m_ChunkSlots.end(), [](const ChunkSlot& Slot) { return !Slot.InUse; });
+    if (SlotIt == m_ChunkSlots.end())
+    {
+        UNEXPECTED("The streamer never keeps more chunks than there are slots");
+        return;
     }
 
-    ceilingInst.NumObjects = static_cast<Uint32>(m_Scene.Objects.size()) - ceilingInst.ObjectAttribsOffset;
-    m_Scene.ObjectInstances.push_back(ceilingInst);
+    const Uint32 SlotIdx     = static_cast<Uint32>(SlotIt - m_ChunkSlots.begin());
+    const Uint32 FirstObject = m_FirstChunkObject + SlotIdx * m_MaxObjectsPerChunk;
+    const Uint32 FirstWall   = SlotIdx * m_MaxObjectsPerChunk;
+    const Mesh&  CubeMesh    = m_Scene.Meshes[m_CubeMeshId];
+
+    ChunkSlot& Slot = *SlotIt;
+    Slot.Coord      = Chunk.Coord;
+    Slot.InUse      = true;
+    Slot.NumObjects = 0;
+    Slot.NumWalls   = 0;
+
+    for (const MazeChunkBox& Box : Chunk.Boxes)
+    {
+        // Doors and keys keep their state when the chunk is evicted and streamed in again
+        if (Box.Kind == MAZE_BLOCK_KIND_DOOR && m_UnlockedDoors.count(GetDoorLockId(Box.LockScope, Box.BlockType)) != 0)
+            continue;
+        if (Box.Kind == MAZE_BLOCK_KIND_KEY && m_CollectedKeys.count(Box.Cell) != 0)
+            continue;
+
+        // Static walls are drawn by the baked walls mesh and are only added to the collision grid
+        int objIdx = -1;
+        if (m_WallMeshId == ~0u || Box.Kind != MAZE_BLOCK_KIND_WALL)
+        {
+            SceneObject obj;
+            obj.ModelMat = (float4x4::Scale(Box.HalfSize) *
+                            float4x4::Translation(Box.Center))
+                               .Transpose();
+            obj.NormalMat  = obj.ModelMat;
+            obj.MaterialId = m_CubeMaterialOffset + Box.Material;
+            obj.MeshId     = m_CubeMeshId;
+            obj.GeometryId = CubeMesh.FirstGeometryId;
+
+            objIdx                  = static_cast<int>(FirstObject + Slot.NumObjects++);
+            m_Scene.Objects[objIdx] = obj;
+            MarkObjectDirty(static_cast<Uint32>(objIdx));
+        }
+
+        if (Box.Kind == MAZE_BLOCK_KIND_KEY)
+        {
+            Key newKey;
+            newKey.ObjectIdx = objIdx;
+            newKey.Cell      = Box.Cell;
+            newKey.LockScope = Box.LockScope;
+            newKey.BlockType = Box.BlockType;
+            m_Keys.push_back(newKey);
+            m_KeyBounds.Add(Box.Center - Box.HalfSize, Box.Center + Box.HalfSize);
+            continue;
+        }
+
+        const int wallIdx  = static_cast<int>(FirstWall + Slot.NumWalls++);
+        const float3 WallMin{Box.Center.x - Box.HalfSize.x, 0.0f, Box.Center.z - Box.HalfSize.z};
+        const float3 WallMax{Box.Center.x + Box.HalfSize.x, Box.HalfSize.y, Box.Center.z + Box.HalfSize.z};
+        MazeWalls.Set(static_cast<Uint32>(wallIdx), WallMin, WallMax);
+        m_CollisionGrid.Insert(static_cast<Uint32>(wallIdx), WallMin, WallMax);
+
+        if (Box.Kind == MAZE_BLOCK_KIND_DOOR) // puerta
+        {
+            Door door;
+            door.WallIdx     = wallIdx;
+            door.ObjectIdx   = objIdx;
+            door.Opened      = false;
+            door.Rising      = false;
+            door.RiseTimer   = 0.0f;
+            door.OriginalMat = {};
+            door.Id          = m_nextDoorId++;
+            door.BlockType   = Box.BlockType;
+            door.LockScope   = Box.LockScope;
+            door.Cell        = UnpackMazeCoord(Box.Cell);
+            m_Doors.push_back(door);
+        }
+    }
+
+    UpdateChunkInstances();
+}
 
+void Tutorial22_HybridRendering::EvictChunk(const int2& Coord)
+{
+    auto SlotIt = std::find_if(m_ChunkSlots.begin(), m_ChunkSlots.end(), [&Coord](const ChunkSlot& Slot) { return Slot.InUse && Slot.Coord == Coord; });
+    if (SlotIt == m_ChunkSlots.end())
+        return;
 
-    // Crear instancia para el monstruo
-    InstancedObjects monsterInst;
-    monsterInst.MeshInd             = CubeMeshId;
-    monsterInst.ObjectAttribsOffset = static_cast<Uint32>(m_Scene.Objects.size());
+    const Uint32 SlotIdx     = static_cast<Uint32>(SlotIt - m_ChunkSlots.begin());
+    const int    FirstObject = static_cast<int>(m_FirstChunkObject + SlotIdx * m_MaxObjectsPerChunk);
+    const int EndObject   = FirstObject + static_cast<int>(m_MaxObjectsPerChunk);
+    const auto InSlot     = [&](int ObjectIdx) { return ObjectIdx >= FirstObject && ObjectIdx < EndObject; };
 
+    // Key bounds are compacted together with the keys
+    Uint32 NumKeys = 0;
+    for (Uint32 k = 0; k < m_Keys.size(); ++k)
     {
-        HLSL::ObjectAttribs obj;
-        float3              startPos     = float3{0.f, 3.f, -20.f};
-        float               monsterScale = 0.01f;
+        if (InSlot(m_Keys[k].ObjectIdx))
+            continue;
+        if (k != NumKeys)
+        {
+            m_Keys[NumKeys] = m_Keys[k];
+            m_KeyBounds.Set(NumKeys, m_KeyBounds.GetMin(k), m_KeyBounds.GetMax(k));
+        }
+        ++NumKeys;
+    }
+    m_Keys.resize(NumKeys);
+    m_KeyBounds.Resize(NumKeys);
+    m_Doors.erase(std::remove_if(m_Doors.begin(), m_Doors.end(), [&](const Door& door) { return InSlot(door.ObjectIdx); }), m_Doors.end());
+    // The slot may be reused by a chunk added before the interpolated transforms are written
+    m_InterpolatedObjects.erase(std::remove_if(m_InterpolatedObjects.begin(), m_InterpolatedObjects.end(),
+                                               [&](const InterpolatedObject& InterpObj) { return InSlot(static_cast<int>(InterpObj.ObjectIdx)); }),
+                                m_InterpolatedObjects.end());
+
+    // Opened doors have already been removed from the grid
+    for (Uint32 w = 0; w < SlotIt->NumWalls; ++w)
+        m_CollisionGrid.Remove(SlotIdx * m_MaxObjectsPerChunk + w);
+
+    SlotIt->InUse      = false;
+    SlotIt->NumObjects = 0;
+    SlotIt->NumWalls   = 0;
+
+    UpdateChunkInstances();
+}
 
-        obj.ModelMat = (float4x4::Scale(0.01f, monsterScale, monsterScale) *
-                        float4x4::Translation(startPos))
-                           .Transpose();
-        obj.NormalMat   = float3x3::Identity();
-        obj.MaterialId  = CubeMaterialRange.x + 17;
-        obj.MeshId      = CubeMeshId;
-        obj.FirstIndex  = m_Scene.Meshes[obj.MeshId].FirstIndex;
-        obj.FirstVertex = m_Scene.Meshes[obj.MeshId].FirstVertex;
+void Tutorial22_HybridRendering::UpdateChunkInstances()
+{
+    // Static objects are followed by one instanced draw per resident chunk
+    m_Scene.ObjectInstances.resize(m_NumStaticInstances);
+    for (size_t i = 0; i < m_ChunkSlots.size(); ++i)
+    {
+        const ChunkSlot& Slot = m_ChunkSlots[i];
+        if (!Slot.InUse || Slot.NumObjects == 0)
+            continue;
+
+        InstancedObjects InstObj;
+        InstObj.MeshInd             = m_CubeMeshId;
+        InstObj.ObjectAttribsOffset = m_FirstChunkObject + static_cast<Uint32>(i) * m_MaxObjectsPerChunk;
+        InstObj.NumObjects          = Slot.NumObjects;
+        m_Scene.ObjectInstances.push_back(InstObj);
+    }
 
-        Uint32 monsterIndex = static_cast<Uint32>(m_Scene.Objects.size());
-        m_Scene.Objects.push_back(obj);
+    // The number of TLAS instances has changed
+    m_Scene.TLASNeedsRebuild = true;
+    m_Scene.CullRangesDirty  = true;
+}
 
-        //  dinámico para poder moverlo
-        m_Scene.DynamicObjects.push_back({monsterIndex});
+void Tutorial22_HybridRendering::UpdateWorldStreaming(Uint32 MaxChunksToAdd)
+{
+    const float3 CamPos = m_Camera.GetPos();
+
+    std::vector<int2> EvictedChunks;
+    m_ChunkStreamer.Update(CamPos, EvictedChunks);
+    for (const int2& Coord : EvictedChunks)
+        EvictChunk(Coord);
+
+    // Chunks are built on the worker thread; adding one only copies its boxes,
+    // but the number per frame is still limited to keep the frame time stable.
+    MazeChunk Chunk;
+    for (Uint32 i = 0; i < MaxChunksToAdd && m_ChunkStreamer.PopChunk(Chunk); ++i)
+        AddChunk(Chunk);
+
+    // Keep the floor and the ceiling centered at the camera chunk. They move by whole
+    // chunks, which is a multiple of the floor texture tile, so the texture does not swim.
+    const int    ChunkSize  = m_ChunkStreamer.GetChunkSize();
+    const int2   Center     = m_ChunkStreamer.GetChunkAt(CamPos);
+    const float3 CenterPos  = m_Level.GetCellCenter(Center.x * ChunkSize, Center.y * ChunkSize) + float3{1, 0, 1} * ((ChunkSize - 1) * 0.5f * m_Level.GetCellSize());
+    const float  HalfWindow = GetStreamingWindowSize() * 0.5f;
+
+    const float4x4 FloorMat = (float4x4::Scale(HalfWindow, 1.f, HalfWindow) * float4x4::Translation(CenterPos.x, -0.2f, CenterPos.z)).Transpose();
+
+    const float thickness     = 0.5f;
+    const float ceilingHeight = 6.0f;
+
+    const float4x4 CeilingMat = (float4x4::Scale(HalfWindow, thickness, HalfWindow) *
+                                 float4x4::Translation(CenterPos.x, ceilingHeight + thickness * 0.5f, CenterPos.z))
+                                    .Transpose();
+
+    // They only move when the camera enters another chunk
+    auto& Floor = m_Scene.Objects[m_FloorObjectIdx];
+    if (!(Floor.ModelMat == FloorMat))
+    {
+        Floor.ModelMat = FloorMat;
+        MarkObjectMoved(m_FloorObjectIdx);
+    }
+    auto& Ceiling = m_Scene.Objects[m_CeilingObjectIdx];
+    if (!(Ceiling.ModelMat == CeilingMat))
+    {
+        Ceiling.ModelMat  = CeilingMat;
+        Ceiling.NormalMat = Ceiling.ModelMat;
+        MarkObjectMoved(m_CeilingObjectIdx);
     }
-    monsterInst.NumObjects = 1;
-    m_Scene.ObjectInstances.push_back(monsterInst);
+}
+
+float Tutorial22_HybridRendering::GetStreamingWindowSize() const
+{
+    // Resident chunks never leave the square of (2 * EvictRadius + 1) chunks around the camera chunk
+    return static_cast<float>((2 * m_ChunkEvictRadius + 1) * m_ChunkSize) * m_Level.GetCellSize();
 }
 
 void Tutorial22_HybridRendering::HandleCollisions(float3& CameraPos, float CamRadius)
 {
-    for (const auto& wall : MazeWalls)
+    // Only walls in the grid cells around the camera are tested. The cells are found for the
+    // initial position; the camera moves by less than the radius while it is pushed out.
+    CollisionCandidates.Clear();
+    CollisionCandidateIds.clear();
+    m_CollisionGrid.Query(CameraPos, CamRadius, [&](Uint32 WallIdx) {
+        CollisionCandidates.Add(MazeWalls.GetMin(WallIdx), MazeWalls.GetMax(WallIdx));
+        CollisionCandidateIds.push_back(WallIdx);
+    });
+
+    MazeSphereSoA Camera;
+    Camera.Add(CameraPos, CamRadius);
+    CollisionOverlaps.clear();
+    FindSphereBoxOverlaps(Camera, CollisionCandidates, 0, CollisionCandidates.GetSize(), CollisionOverlaps);
+
+    // Push the camera out of the overlapped walls one by one; a push may already resolve the next overlap
+    for (const MazeSphereBoxOverlap& Overlap : CollisionOverlaps)
     {
+        const float3 wallMin = CollisionCandidates.GetMin(Overlap.Box);
+        const float3 wallMax = CollisionCandidates.GetMax(Overlap.Box);
+
         float3 closestPoint;
-        closestPoint.x = std::max(wall.min.x, std::min(CameraPos.x, wall.max.x));
-        closestPoint.y = std::max(wall.min.y, std::min(CameraPos.y, wall.max.y));
-        closestPoint.z = std::max(wall.min.z, std::min(CameraPos.z, wall.max.z));
+        closestPoint.x = std::max(wallMin.x, std::min(CameraPos.x, wallMax.x));
+        closestPoint.y = std::max(wallMin.y, std::min(CameraPos.y, wallMax.y));
+        closestPoint.z = std::max(wallMin.z, std::min(CameraPos.z, wallMax.z));
 
         float3 delta    = CameraPos - closestPoint;
         float  distance = length(delta);
 
-        if (distance < CamRadius)
+        if (distance < CamRadius && distance > 0)
         {
             float3 collisionNormal  = delta / distance;
             float  penetrationDepth = CamRadius - distance;
@@ -727,42 +864,50 @@ void Tutorial22_HybridRendering::HandleCollisions(float3& CameraPos, float CamRa
 
 void Tutorial22_HybridRendering::HandleKeyCollection(const float3& camPos, float camRadius)
 {
-    for (auto& key : m_Keys)
+    MazeSphereSoA Camera;
+    Camera.Add(camPos, camRadius);
+    CollisionOverlaps.clear();
+    FindSphereBoxOverlaps(Camera, m_KeyBounds, 0, m_KeyBounds.GetSize(), CollisionOverlaps);
+
+    // Collected keys are replaced by the last key, so they are removed from the back
+    std::sort(CollisionOverlaps.begin(), CollisionOverlaps.end(),
+              [](const MazeSphereBoxOverlap& a, const MazeSphereBoxOverlap& b) { return a.Box > b.Box; });
+    for (const MazeSphereBoxOverlap& Overlap : CollisionOverlaps)
     {
-        if (key.Collected) continue;
-
-        float3 closest;
-        closest.x = std::max(key.Min.x, std::min(camPos.x, key.Max.x));
-        closest.y = std::max(key.Min.y, std::min(camPos.y, key.Max.y));
-        closest.z = std::max(key.Min.z, std::min(camPos.z, key.Max.z));
-
-        float3 delta = camPos - closest;
-        float  dist  = length(delta);
-
-        if (dist < camRadius)
+        const Key    key     = m_Keys[Overlap.Box];
+        const Uint32 LastKey = static_cast<Uint32>(m_Keys.size() - 1);
+        m_Keys[Overlap.Box]  = m_Keys[LastKey];
+        m_KeyBounds.Set(Overlap.Box, m_KeyBounds.GetMin(LastKey), m_KeyBounds.GetMax(LastKey));
+        m_Keys.pop_back();
+        m_KeyBounds.Resize(LastKey);
+
+        m_ShowUnlockMsg  = true;
+        m_UnlockMsgTimer = 0.0f;
+
+        // Doors in chunks that are not resident will be skipped when they are streamed in
+        m_CollectedKeys.insert(key.Cell);
+        for (Uint32 b = 0; b < m_Level.GetNumKeyDoorBindings(); ++b)
         {
-            key.Collected    = true;
-            m_ShowUnlockMsg  = true;
-            m_UnlockMsgTimer = 0.0f;
-
-            for (int doorId : key.DoorIds)
+            const MazeKeyDoorBinding& binding = m_Level.GetKeyDoorBinding(b);
+            if (binding.KeyBlockType == key.BlockType)
             {
-                for (auto& door : m_Doors)
-                {
-                    if (door.Id == doorId && !door.Opened)
-                    {
-                        door.Opened      = true;
-                        door.Rising      = true;
-                        door.RiseTimer   = 0.0f;
-                        door.OriginalMat = m_Scene.Objects[door.ObjectIdx].ModelMat;
-                        break;
-                    }
-                }
+                m_UnlockedDoors.insert(GetDoorLockId(key.LockScope, binding.DoorBlockType));
+                m_PathPlanner.UnlockDoors(key.LockScope, static_cast<Uint8>(binding.DoorBlockType));
             }
+        }
 
-            auto& obj    = m_Scene.Objects[key.ObjectIdx];
-            obj.ModelMat = float4x4::Scale(0.0f, 0.0f, 0.0f).Transpose();
+        for (auto& door : m_Doors)
+        {
+            if (!door.Opened && m_UnlockedDoors.count(GetDoorLockId(door.LockScope, door.BlockType)) != 0)
+            {
+                door.Opened      = true;
+                door.Rising      = true;
+                door.RiseTimer   = 0.0f;
+                door.OriginalMat = m_Scene.Objects[door.ObjectIdx].ModelMat;
+            }
         }
+
+        DeactivateObject(static_cast<Uint32>(key.ObjectIdx));
     }
 }
 
@@ -792,25 +937,55 @@ void Tutorial22_HybridRendering::CreateSceneAccelStructs()
     {
         RefCntAutoPtr<IBuffer> pScratchBuffer;
 
-        for (auto& Mesh : m_Scene.Meshes)
+        for (Uint32 MeshId = 0; MeshId < m_Scene.Meshes.size(); ++MeshId)
         {
-            // Create BLAS
-            BLASTriangleDesc Triangles;
+            auto& Mesh = m_Scene.Meshes[MeshId];
+
+            // Every material of a baked mesh is a separate geometry, so that the shader can find
+            // the object of the geometry that was hit
+            std::vector<MeshGeometry> Geometries = Mesh.Geometries;
+            if (Geometries.empty())
+                Geometries.push_back({Mesh.FirstIndex, Mesh.NumIndices, 0});
+
+            std::vector<String>                GeometryNames(Geometries.size());
+            std::vector<BLASTriangleDesc>      Triangles(Geometries.size());
+            std::vector<BLASBuildTriangleData> TriangleData(Geometries.size());
+            for (size_t g = 0; g < Geometries.size(); ++g)
             {
-                Triangles.GeometryName         = Mesh.Name.c_str();
-                Triangles.MaxVertexCount       = Mesh.NumVertices;
-                Triangles.VertexValueType      = VT_FLOAT32;
-                Triangles.VertexComponentCount = 3;
-                Triangles.MaxPrimitiveCount    = Mesh.NumIndices / 3;
-                Triangles.IndexType            = VT_UINT32;
+                GeometryNames[g] = Geometries.size() > 1 ? Mesh.Name + " " + std::to_string(g) : Mesh.Name;
+
+                Triangles[g].GeometryName         = GeometryNames[g].c_str();
+                Triangles[g].MaxVertexCount       = Mesh.NumVertices;
+                Triangles[g].VertexValueType      = VT_FLOAT32;
+                Triangles[g].VertexComponentCount = 3;
+                Triangles[g].MaxPrimitiveCount    = Geometries[g].NumIndices / 3;
+                Triangles[g].IndexType            = VT_UINT32;
+
+                TriangleData[g].GeometryName         = Triangles[g].GeometryName;
+                TriangleData[g].pVertexBuffer        = Mesh.VertexBuffer;
+                TriangleData[g].VertexStride         = Mesh.VertexBuffer->GetDesc().ElementByteStride;
+                TriangleData[g].VertexOffset         = Uint64{Mesh.FirstVertex} * Uint64{TriangleData[g].VertexStride};
+                TriangleData[g].VertexCount          = Mesh.NumVertices;
+                TriangleData[g].VertexValueType      = Triangles[g].VertexValueType;
+                TriangleData[g].VertexComponentCount = Triangles[g].VertexComponentCount;
+                TriangleData[g].pIndexBuffer         = Mesh.IndexBuffer;
+                TriangleData[g].IndexOffset          = Uint64{Geometries[g].FirstIndex} * Uint64{Mesh.IndexBuffer->GetDesc().ElementByteStride};
+                TriangleData[g].PrimitiveCount       = Triangles[g].MaxPrimitiveCount;
+                TriangleData[g].IndexType            = Triangles[g].IndexType;
+                TriangleData[g].Flags                = RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+            }
 
+            // Create BLAS. The static walls never change, so their BLAS is compacted after the build.
+            {
                 const auto BLASName{Mesh.Name + " BLAS"};
 
                 BottomLevelASDesc ASDesc;
                 ASDesc.Name          = BLASName.c_str();
                 ASDesc.Flags         = RAYTRACING_BUILD_AS_PREFER_FAST_TRACE;
-                ASDesc.pTriangles    = &Triangles;
-                ASDesc.TriangleCount = 1;
+                ASDesc.pTriangles    = Triangles.data();
+                ASDesc.TriangleCount = static_cast<Uint32>(Triangles.size());
+                if (MeshId == m_WallMeshId)
+                    ASDesc.Flags |= RAYTRACING_BUILD_AS_ALLOW_COMPACTION;
                 m_pDevice->CreateBLAS(ASDesc, &Mesh.BLAS);
             }
 
@@ -828,24 +1003,10 @@ void Tutorial22_HybridRendering::CreateSceneAccelStructs()
             }
 
             // Build BLAS
-            BLASBuildTriangleData TriangleData;
-            TriangleData.GeometryName         = Triangles.GeometryName;
-            TriangleData.pVertexBuffer        = Mesh.VertexBuffer;
-            TriangleData.VertexStride         = Mesh.VertexBuffer->GetDesc().ElementByteStride;
-            TriangleData.VertexOffset         = Uint64{Mesh.FirstVertex} * Uint64{TriangleData.VertexStride};
-            TriangleData.VertexCount          = Mesh.NumVertices;
-            TriangleData.VertexValueType      = Triangles.VertexValueType;
-            TriangleData.VertexComponentCount = Triangles.VertexComponentCount;
-            TriangleData.pIndexBuffer         = Mesh.IndexBuffer;
-            TriangleData.IndexOffset          = Uint64{Mesh.FirstIndex} * Uint64{Mesh.IndexBuffer->GetDesc().ElementByteStride};
-            TriangleData.PrimitiveCount       = Triangles.MaxPrimitiveCount;
-            TriangleData.IndexType            = Triangles.IndexType;
-            TriangleData.Flags                = RAYTRACING_GEOMETRY_FLAG_OPAQUE;
-
             BuildBLASAttribs Attribs;
             Attribs.pBLAS             = Mesh.BLAS;
-            Attribs.pTriangleData     = &TriangleData;
-            Attribs.TriangleDataCount = 1;
+            Attribs.pTriangleData     = TriangleData.data();
+            Attribs.TriangleDataCount = static_cast<Uint32>(TriangleData.size());
 
             // Scratch buffer will be used to store temporary data during the BLAS build.
             // Previous content in the scratch buffer will be discarded.
@@ -860,6 +1021,9 @@ void Tutorial22_HybridRendering::CreateSceneAccelStructs()
         }
     }
 
+    if (m_WallMeshId != ~0u)
+        CompactWallsBLAS();
+
     // Create TLAS
     {
         TopLevelASDesc TLASDesc;
@@ -868,12 +1032,202 @@ void Tutorial22_HybridRendering::CreateSceneAccelStructs()
         TLASDesc.Flags            = RAYTRACING_BUILD_AS_ALLOW_UPDATE | RAYTRACING_BUILD_AS_PREFER_FAST_TRACE;
         m_pDevice->CreateTLAS(TLASDesc, &m_Scene.TLAS);
     }
+
+    // The instance table is allocated once for all objects
+    const size_t NumObjects = m_Scene.Objects.size();
+    m_Scene.TLASInstances.reserve(NumObjects);
+    m_Scene.TLASInstanceNames.resize(NumObjects);
+    m_Scene.ObjectTLASInstance.assign(NumObjects, ~0u);
+    m_Scene.MovedObjects.reserve(NumObjects);
+    m_Scene.ObjectMoved.assign(NumObjects, 0);
+    m_Scene.TLASNeedsRebuild = true;
+}
+
+void Tutorial22_HybridRendering::CompactWallsBLAS()
+{
+    Mesh& Walls = m_Scene.Meshes[m_WallMeshId];
+
+    // The compacted size is written by the GPU and read back once at startup
+    RefCntAutoPtr<IBuffer> pSizeBuffer;
+    {
+        BufferDesc BuffDesc;
+        BuffDesc.Name              = "Walls BLAS compacted size";
+        BuffDesc.Usage             = USAGE_DEFAULT;
+        BuffDesc.BindFlags         = BIND_UNORDERED_ACCESS;
+        BuffDesc.Mode              = BUFFER_MODE_STRUCTURED;
+        BuffDesc.ElementByteStride = sizeof(Uint64);
+        BuffDesc.Size              = sizeof(Uint64);
+        m_pDevice->CreateBuffer(BuffDesc, nullptr, &pSizeBuffer);
+    }
+    RefCntAutoPtr<IBuffer> pReadbackBuffer;
+    {
+        BufferDesc BuffDesc;
+        BuffDesc.Name           = "Walls BLAS compacted size readback";
+        BuffDesc.Usage          = USAGE_STAGING;
+        BuffDesc.CPUAccessFlags = CPU_ACCESS_READ;
+        BuffDesc.Size           = sizeof(Uint64);
+        m_pDevice->CreateBuffer(BuffDesc, nullptr, &pReadbackBuffer);
+    }
+
+    WriteBLASCompactedSizeAttribs SizeAttribs;
+    SizeAttribs.pBLAS                = Walls.BLAS;
+    SizeAttribs.pDestBuffer          = pSizeBuffer;
+    SizeAttribs.BLASTransitionMode   = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+    SizeAttribs.BufferTransitionMode = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+    m_pImmediateContext->WriteBLASCompactedSize(SizeAttribs);
+    m_pImmediateContext->CopyBuffer(pSizeBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
+                                    pReadbackBuffer, 0, sizeof(Uint64), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    m_pImmediateContext->WaitForIdle();
+
+    Uint64 CompactedSize = 0;
+    {
+        MapHelper<Uint64> MappedSize{m_pImmediateContext, pReadbackBuffer, MAP_READ, MAP_FLAG_DO_NOT_WAIT};
+        CompactedSize = *MappedSize;
+    }
+    if (CompactedSize == 0)
+    {
+        LOG_WARNING_MESSAGE("Failed to get the compacted size of the walls BLAS");
+        return;
+    }
+
+    RefCntAutoPtr<IBottomLevelAS> pCompactedBLAS;
+    {
+        BottomLevelASDesc ASDesc;
+        ASDesc.Name          = "Walls compacted BLAS";
+        ASDesc.CompactedSize = CompactedSize;
+        m_pDevice->CreateBLAS(ASDesc, &pCompactedBLAS);
+    }
+
+    CopyBLASAttribs CopyAttribs;
+    CopyAttribs.pSrc              = Walls.BLAS;
+    CopyAttribs.pDst              = pCompactedBLAS;
+    CopyAttribs.Mode              = COPY_AS_MODE_COMPACT;
+    CopyAttribs.SrcTransitionMode = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+    CopyAttribs.DstTransitionMode = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+    m_pImmediateContext->CopyBLAS(CopyAttribs);
+    Walls.BLAS = pCompactedBLAS;
+
+    Uint32 NumTriangles = 0;
+    for (const MeshGeometry& Geometry : Walls.Geometries)
+        NumTriangles += Geometry.NumIndices / 3;
+    LOG_INFO_MESSAGE("Walls BLAS: ", Walls.Geometries.size(), " geometries, ", NumTriangles, " triangles, ",
+                     CompactedSize / 1024.0, " KB after compaction");
 }
 
 void Tutorial22_HybridRendering::UpdateTLAS()
 {
-    const Uint32 NumInstances = static_cast<Uint32>(m_Scene.Objects.size());
-    bool         Update       = true;
+    const auto SetTransform = [this](Uint32 ObjectIdx, TLASBuildInstanceData& Inst) {
+        const auto ModelMat = m_Scene.Objects[ObjectIdx].ModelMat.Transpose();
+        Inst.Transform.SetRotation(ModelMat.Data(), 4);
+        Inst.Transform.SetTranslation(ModelMat.m30, ModelMat.m31, ModelMat.m32);
+    };
+
+    // The TLAS can only be updated if the set of instances is the same
+    bool Update = !m_Scene.TLASNeedsRebuild;
+    if (Update && m_Scene.MovedObjects.empty())
+        return;
+    m_Scene.TLASNeedsRebuild = false;
+
+    // The instances are prepared on the render threads; every thread writes its own instances.
+    // Small updates are not worth waking the workers.
+    static constexpr Uint32 MinObjectsPerThread = 256;
+
+    Timer TLASTimer;
+    if (Update)
+    {
+        const Uint32 NumMoved   = static_cast<Uint32>(m_Scene.MovedObjects.size());
+        const Uint32 NumThreads = std::max(std::min(m_CommandRecorder.GetNumThreads(), NumMoved / MinObjectsPerThread), 1u);
+        m_CommandRecorder.Run(NumThreads, [&](Uint32 ThreadId) {
+            for (Uint32 i = NumMoved * ThreadId / NumThreads; i < NumMoved * (ThreadId + 1) / NumThreads; ++i)
+            {
+                const Uint32 ObjectIdx = m_Scene.MovedObjects[i];
+                const Uint32 InstIdx   = m_Scene.ObjectTLASInstance[ObjectIdx];
+                if (InstIdx != ~0u)
+                    SetTransform(ObjectIdx, m_Scene.TLASInstances[InstIdx]);
+            }
+        });
+    }
+    else
+    {
+        // Objects of a mesh with several geometries share the instance of the first one
+        const auto HasInstance = [this](Uint32 i) {
+            const auto& Obj = m_Scene.Objects[i];
+            return m_Scene.Meshes[Obj.MeshId].Geometries.empty() || i == 0 || m_Scene.Objects[i - 1].MeshId != Obj.MeshId;
+        };
+
+        // Only drawn objects get TLAS instances; unused chunk slots are skipped. The instances of
+        // every element of ObjectInstances are counted first, so that the elements can be filled
+        // independently.
+        std::fill(m_Scene.ObjectTLASInstance.begin(), m_Scene.ObjectTLASInstance.end(), ~0u);
+        const Uint32        NumRanges = static_cast<Uint32>(m_Scene.ObjectInstances.size());
+        std::vector<Uint32> FirstInstance(NumRanges + 1, 0);
+        std::vector<Uint32> NumTriangles(std::max(m_CommandRecorder.GetNumThreads(), 1u), 0);
+        std::atomic<Uint32> NextRange{0};
+
+        const Uint32 NumThreads = std::max(std::min(m_CommandRecorder.GetNumThreads(), static_cast<Uint32>(m_Scene.Objects.size()) / MinObjectsPerThread), 1u);
+        m_CommandRecorder.Run(NumThreads, [&](Uint32) {
+            for (Uint32 r = NextRange.fetch_add(1); r < NumRanges; r = NextRange.fetch_add(1))
+            {
+                const auto& ObjInst = m_Scene.ObjectInstances[r];
+                for (Uint32 i = ObjInst.ObjectAttribsOffset; i < ObjInst.ObjectAttribsOffset + ObjInst.NumObjects; ++i)
+                    FirstInstance[r + 1] += HasInstance(i) ? 1 : 0;
+            }
+        });
+        for (Uint32 r = 0; r < NumRanges; ++r)
+            FirstInstance[r + 1] += FirstInstance[r];
+        m_Scene.TLASInstances.clear();
+        m_Scene.TLASInstances.resize(FirstInstance[NumRanges]);
+
+        NextRange.store(0);
+        m_CommandRecorder.Run(NumThreads, [&](Uint32 ThreadId) {
+            for (Uint32 r = NextRange.fetch_add(1); r < NumRanges; r = NextRange.fetch_add(1))
+            {
+                const auto& ObjInst = m_Scene.ObjectInstances[r];
+                Uint32      InstIdx = FirstInstance[r];
+                for (Uint32 i = ObjInst.ObjectAttribsOffset; i < ObjInst.ObjectAttribsOffset + ObjInst.NumObjects; ++i)
+                {
+                    if (!HasInstance(i))
+                        continue;
+
+                    const auto& Mesh = m_Scene.Meshes[m_Scene.Objects[i].MeshId];
+
+                    // Every object keeps its mesh, so the name only has to be formatted once
+                    auto& Name = m_Scene.TLASInstanceNames[i];
+                    if (Name.empty())
+                        Name = Mesh.Name + " Instance (" + std::to_string(i) + ")";
+
+                    m_Scene.ObjectTLASInstance[i] = InstIdx;
+                    auto& Inst                    = m_Scene.TLASInstances[InstIdx++];
+
+                    Inst.InstanceName = Name.c_str();
+                    Inst.pBLAS        = Mesh.BLAS;
+                    Inst.Mask         = 0xFF;
+
+                    // CustomId will be read in shader by RayQuery::CommittedInstanceID(),
+                    // the geometry index is added to it for meshes with several geometries
+                    Inst.CustomId = i;
+
+                    SetTransform(i, Inst);
+
+                    if (Mesh.Geometries.empty())
+                        NumTriangles[ThreadId] += Mesh.NumIndices / 3;
+                    for (const MeshGeometry& Geometry : Mesh.Geometries)
+                        NumTriangles[ThreadId] += Geometry.NumIndices / 3;
+                }
+            }
+        });
+
+        m_Scene.NumTLASTriangles = 0;
+        for (Uint32 ThreadTriangles : NumTriangles)
+            m_Scene.NumTLASTriangles += ThreadTriangles;
+    }
+
+    for (Uint32 ObjectIdx : m_Scene.MovedObjects)
+        m_Scene.ObjectMoved[ObjectIdx] = 0;
+    m_Scene.MovedObjects.clear();
+
+    m_RecordingStats.NumTLASUpdates += 1;
+    m_RecordingStats.TLASTime += TLASTimer.GetElapsedTime();
 
     // Create scratch buffer
     if (!m_Scene.TLASScratchBuffer)
@@ -894,34 +1248,10 @@ void Tutorial22_HybridRendering::UpdateTLAS()
         BuffDesc.Name      = "TLAS Instance Buffer";
         BuffDesc.Usage     = USAGE_DEFAULT;
         BuffDesc.BindFlags = BIND_RAY_TRACING;
-        BuffDesc.Size      = Uint64{TLAS_INSTANCE_DATA_SIZE} * Uint64{NumInstances};
+        BuffDesc.Size      = Uint64{TLAS_INSTANCE_DATA_SIZE} * Uint64{m_Scene.TLAS->GetDesc().MaxInstanceCount};
         m_pDevice->CreateBuffer(BuffDesc, nullptr, &m_Scene.TLASInstancesBuffer);
     }
 
-    // Setup instances
-    std::vector<TLASBuildInstanceData> Instances(NumInstances);
-    std::vector<String>                InstanceNames(NumInstances);
-    for (Uint32 i = 0; i < NumInstances; ++i)
-    {
-        const auto& Obj      = m_Scene.Objects[i];
-        auto&       Inst     = Instances[i];
-        auto&       Name     = InstanceNames[i];
-        const auto& Mesh     = m_Scene.Meshes[Obj.MeshId];
-        const auto  ModelMat = Obj.ModelMat.Transpose();
-
-        Name = Mesh.Name + " Instance (" + std::to_string(i) + ")";
-
-        Inst.InstanceName = Name.c_str();
-        Inst.pBLAS        = Mesh.BLAS;
-        Inst.Mask         = 0xFF;
-
-        // CustomId will be read in shader by RayQuery::CommittedInstanceID()
-        Inst.CustomId = i;
-
-        Inst.Transform.SetRotation(ModelMat.Data(), 4);
-        Inst.Transform.SetTranslation(ModelMat.m30, ModelMat.m31, ModelMat.m32);
-    }
-
     // Build  TLAS
     BuildTLASAttribs Attribs;
     Attribs.pTLAS  = m_Scene.TLAS;
@@ -935,38 +1265,632 @@ void Tutorial22_HybridRendering::UpdateTLAS()
     // Previous content in the instance buffer will be discarded.
     Attribs.pInstanceBuffer = m_Scene.TLASInstancesBuffer;
 
-    // Instances will be converted to the format that is required by the graphics driver and copied to the instance buffer.
-    Attribs.pInstances    = Instances.data();
-    Attribs.InstanceCount = NumInstances;
+    // Instances will be converted to the format that is required by the graphics driver and copied to the instance buffer.
+    // The engine takes the whole set of instances even for an update.
+    Attribs.pInstances    = m_Scene.TLASInstances.data();
+    Attribs.InstanceCount = static_cast<Uint32>(m_Scene.TLASInstances.size());
+
+    // Allow engine to change resource states.
+    Attribs.TLASTransitionMode           = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+    Attribs.BLASTransitionMode           = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+    Attribs.InstanceBufferTransitionMode = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+    Attribs.ScratchBufferTransitionMode  = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+
+    m_pImmediateContext->BuildTLAS(Attribs);
+}
+
+void Tutorial22_HybridRendering::DeactivateObject(Uint32 ObjectIdx)
+{
+    // The objects of a chunk stay packed at the start of its slot, so that the draw of the chunk
+    // only covers live objects: the last object of the slot takes the place of the removed one.
+    VERIFY_EXPR(ObjectIdx >= m_FirstChunkObject);
+    const Uint32 SlotIdx     = (ObjectIdx - m_FirstChunkObject) / m_MaxObjectsPerChunk;
+    const Uint32 FirstObject = m_FirstChunkObject + SlotIdx * m_MaxObjectsPerChunk;
+    ChunkSlot&   Slot        = m_ChunkSlots[SlotIdx];
+    VERIFY_EXPR(Slot.InUse && ObjectIdx < FirstObject + Slot.NumObjects);
+    const Uint32 LastObject = FirstObject + --Slot.NumObjects;
+
+    m_InterpolatedObjects.erase(std::remove_if(m_InterpolatedObjects.begin(), m_InterpolatedObjects.end(),
+                                               [&](const InterpolatedObject& InterpObj) { return InterpObj.ObjectIdx == ObjectIdx; }),
+                                m_InterpolatedObjects.end());
+    if (ObjectIdx != LastObject)
+    {
+        m_Scene.Objects[ObjectIdx] = m_Scene.Objects[LastObject];
+        for (auto& key : m_Keys)
+        {
+            if (key.ObjectIdx == static_cast<int>(LastObject))
+                key.ObjectIdx = static_cast<int>(ObjectIdx);
+        }
+        for (auto& door : m_Doors)
+        {
+            if (door.ObjectIdx == static_cast<int>(LastObject))
+                door.ObjectIdx = static_cast<int>(ObjectIdx);
+        }
+        for (auto& InterpObj : m_InterpolatedObjects)
+        {
+            if (InterpObj.ObjectIdx == LastObject)
+                InterpObj.ObjectIdx = ObjectIdx;
+        }
+        MarkObjectMoved(ObjectIdx);
+    }
+
+    // The TLAS keeps the instance of the last object until the next rebuild, but the zero mask
+    // excludes it from all rays
+    if (!m_Scene.TLASNeedsRebuild)
+    {
+        Uint32& InstIdx = m_Scene.ObjectTLASInstance[LastObject];
+        if (InstIdx != ~0u)
+            m_Scene.TLASInstances[InstIdx].Mask = 0;
+        InstIdx = ~0u;
+        MarkObjectMoved(LastObject);
+    }
+
+    if (Slot.NumObjects == 0)
+    {
+        UpdateChunkInstances();
+        return;
+    }
+    for (auto& ObjInst : m_Scene.ObjectInstances)
+    {
+        if (ObjInst.ObjectAttribsOffset == FirstObject)
+            ObjInst.NumObjects = Slot.NumObjects;
+    }
+    m_Scene.CullRangesDirty = true;
+}
+
+void Tutorial22_HybridRendering::MarkObjectMoved(Uint32 ObjectIdx)
+{
+    MarkObjectDirty(ObjectIdx);
+
+    // A rebuild refreshes all transforms
+    if (m_Scene.TLASNeedsRebuild || m_Scene.ObjectMoved[ObjectIdx] != 0)
+        return;
+    m_Scene.ObjectMoved[ObjectIdx] = 1;
+    m_Scene.MovedObjects.push_back(ObjectIdx);
+}
+
+void Tutorial22_HybridRendering::MarkObjectDirty(Uint32 ObjectIdx)
+{
+    if (m_Scene.ObjectDirty[ObjectIdx] != 0)
+        return;
+    m_Scene.ObjectDirty[ObjectIdx] = 1;
+    m_Scene.DirtyObjects.push_back(ObjectIdx);
+}
+
+HLSL::ObjectAttribs Tutorial22_HybridRendering::PackObjectAttribs(const SceneObject& Obj)
+{
+    const float4x4& M = Obj.ModelMat;
+    VERIFY(Obj.TransformId != NO_OBJECT_TRANSFORM ||
+               (M.m01 == 0 && M.m02 == 0 && M.m10 == 0 && M.m12 == 0 && M.m20 == 0 && M.m21 == 0),
+           "Objects without a transform must only be scaled and translated");
+    VERIFY(Obj.MaterialId <= 0xFFFFu && Obj.GeometryId <= 0xFFFFu, "Material and geometry ids are packed into 16 bits");
+
+    // ModelMat is transposed, so the translation is in the last column
+    HLSL::ObjectAttribs Attribs;
+    Attribs.CenterX            = M.m03;
+    Attribs.CenterY            = M.m13;
+    Attribs.CenterZ            = M.m23;
+    Attribs.MaterialGeometryId = Obj.MaterialId | (Obj.GeometryId << 16u);
+    Attribs.ScaleX             = M.m00;
+    Attribs.ScaleY             = M.m11;
+    Attribs.ScaleZ             = M.m22;
+    Attribs.TransformId        = Obj.TransformId;
+    return Attribs;
+}
+
+void Tutorial22_HybridRendering::UploadDirtyObjects()
+{
+    m_Scene.NumUploadedBytes  = 0;
+    m_Scene.NumUploadedRanges = 0;
+
+    // Consecutive dirty objects, e.g. the monsters or a newly added chunk, are uploaded with one
+    // update. UpdateBuffer() stages the data in the ring-buffered upload heap of the context.
+    std::sort(m_Scene.DirtyObjects.begin(), m_Scene.DirtyObjects.end());
+    for (size_t i = 0; i < m_Scene.DirtyObjects.size();)
+    {
+        const Uint32 First = m_Scene.DirtyObjects[i];
+        Uint32       Count = 1;
+        while (i + Count < m_Scene.DirtyObjects.size() && m_Scene.DirtyObjects[i + Count] == First + Count)
+            ++Count;
+        i += Count;
+
+        m_Scene.PackedObjects.resize(Count);
+        for (Uint32 j = 0; j < Count; ++j)
+            m_Scene.PackedObjects[j] = PackObjectAttribs(m_Scene.Objects[First + j]);
+
+        const Uint64 Size = Uint64{sizeof(HLSL::ObjectAttribs)} * Count;
+        m_pImmediateContext->UpdateBuffer(m_Scene.ObjectAttribsBuffer, Uint64{sizeof(HLSL::ObjectAttribs)} * First, Size,
+                                          m_Scene.PackedObjects.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        m_Scene.NumUploadedBytes += Size;
+        m_Scene.NumUploadedRanges += 1;
+
+        // Objects with full transforms, i.e. the monsters, have consecutive transform ids
+        for (Uint32 j = 0; j < Count;)
+        {
+            const Uint32 FirstTransform = m_Scene.Objects[First + j].TransformId;
+            if (FirstTransform == NO_OBJECT_TRANSFORM)
+            {
+                ++j;
+                continue;
+            }
+
+            m_Scene.PackedTransforms.clear();
+            while (j < Count && m_Scene.Objects[First + j].TransformId == FirstTransform + m_Scene.PackedTransforms.size())
+            {
+                const SceneObject& Obj = m_Scene.Objects[First + j++];
+                m_Scene.PackedTransforms.push_back({Obj.ModelMat, Obj.NormalMat});
+            }
+
+            const Uint64 TransformsSize = Uint64{sizeof(HLSL::ObjectTransform)} * m_Scene.PackedTransforms.size();
+            m_pImmediateContext->UpdateBuffer(m_Scene.ObjectTransformsBuffer, Uint64{sizeof(HLSL::ObjectTransform)} * FirstTransform, TransformsSize,
+                                              m_Scene.PackedTransforms.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+            m_Scene.NumUploadedBytes += TransformsSize;
+            m_Scene.NumUploadedRanges += 1;
+        }
+    }
+
+    for (Uint32 ObjectIdx : m_Scene.DirtyObjects)
+        m_Scene.ObjectDirty[ObjectIdx] = 0;
+    m_Scene.DirtyObjects.clear();
+}
+
+void Tutorial22_HybridRendering::CullObjects()
+{
+    Timer CullTimer;
+
+    ViewFrustum Frustum;
+    if (m_UseCulling)
+    {
+        const float4x4 Proj = m_Camera.GetProjMatrix();
+        ExtractViewFrustumPlanesFromMatrix(m_Camera.GetViewMatrix() * Proj, Frustum, m_pDevice->GetDeviceInfo().NDC.MinZ == -1);
+
+        // Widest horizontal angle of the frustum. It grows with the pitch because of the corners of
+        // the frustum, and covers all directions if the frustum contains the vertical direction.
+        const float3 Ahead     = m_Camera.GetWorldAhead();
+        const float  Denom     = length(float2{Ahead.x, Ahead.z}) - std::abs(Ahead.y) / Proj.m11;
+        const float  HalfAngle = Denom > 0 ? std::atan(1.f / (Proj.m00 * Denom)) : PI_F;
+
+        // Objects never leave the streaming window, see GetStreamingWindowSize()
+        m_Visibility.Update(m_Camera.GetPos(), Ahead, HalfAngle, (m_ChunkEvictRadius + 1) * m_ChunkSize);
+    }
+
+    m_Scene.VisibleInstances.clear();
+    m_Scene.VisibleObjects.clear();
+    m_Scene.NumCulledCandidates = 0;
+    for (const InstancedObjects& ObjInst : m_Scene.ObjectInstances)
+    {
+        // Only cubes are culled: the floor and the baked walls are larger than the view
+        const bool Cull = m_UseCulling && ObjInst.MeshInd == m_CubeMeshId && ObjInst.NumIndices == 0;
+
+        InstancedObjects VisibleInst    = ObjInst;
+        VisibleInst.ObjectAttribsOffset = static_cast<Uint32>(m_Scene.VisibleObjects.size());
+        for (Uint32 ObjectIdx = ObjInst.ObjectAttribsOffset; ObjectIdx < ObjInst.ObjectAttribsOffset + ObjInst.NumObjects; ++ObjectIdx)
+        {
+            if (Cull)
+            {
+                // World-space bounds of the unit cube. ModelMat is transposed, so every row
+                // transforms one coordinate.
+                const float4x4& M = m_Scene.Objects[ObjectIdx].ModelMat;
+                const float3    Center{M.m03, M.m13, M.m23};
+                const float3    Extent{std::abs(M.m00) + std::abs(M.m01) + std::abs(M.m02),
+                                    std::abs(M.m10) + std::abs(M.m11) + std::abs(M.m12),
+                                    std::abs(M.m20) + std::abs(M.m21) + std::abs(M.m22)};
+                const BoundBox  Box{Center - Extent, Center + Extent};
+                if (!m_Visibility.IsBoxVisible(Box.Min, Box.Max) || GetBoxVisibility(Frustum, Box) == BoxVisibility::Invisible)
+                    continue;
+            }
+            m_Scene.VisibleObjects.push_back(ObjectIdx);
+        }
+        VisibleInst.NumObjects = static_cast<Uint32>(m_Scene.VisibleObjects.size()) - VisibleInst.ObjectAttribsOffset;
+        if (VisibleInst.NumObjects > 0)
+            m_Scene.VisibleInstances.push_back(VisibleInst);
+        m_Scene.NumCulledCandidates += ObjInst.NumObjects;
+    }
+
+    if (!m_Scene.VisibleObjects.empty())
+    {
+        m_pImmediateContext->UpdateBuffer(m_Scene.VisibleObjectsBuffer, 0, sizeof(Uint32) * m_Scene.VisibleObjects.size(),
+                                          m_Scene.VisibleObjects.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    }
+
+    m_Scene.NumDrawnObjects = static_cast<Uint32>(m_Scene.VisibleObjects.size());
+
+    m_CullingStats.NumFrames += 1;
+    m_CullingStats.NumVisible += m_Scene.VisibleObjects.size();
+    m_CullingStats.NumCandidates += m_Scene.NumCulledCandidates;
+    m_CullingStats.NumVisibleCells += m_UseCulling ? m_Visibility.GetNumVisibleCells() : 0;
+    m_CullingStats.NumPvsFrames += m_UseCulling && m_Visibility.IsPvsUsed() ? 1 : 0;
+    m_CullingStats.TotalTime += CullTimer.GetElapsedTime();
+}
+
+Uint32 Tutorial22_HybridRendering::FindGpuDraw(const InstancedObjects& ObjInst) const
+{
+    for (Uint32 DrawId = 0; DrawId < static_cast<Uint32>(m_Scene.GpuDraws.size()); ++DrawId)
+    {
+        const InstancedObjects& Draw = m_Scene.GpuDraws[DrawId];
+        if (Draw.MeshInd == ObjInst.MeshInd && Draw.FirstIndex == ObjInst.FirstIndex && Draw.NumIndices == ObjInst.NumIndices)
+            return DrawId;
+    }
+    return ~0u;
+}
+
+void Tutorial22_HybridRendering::CullObjectsOnGpu()
+{
+    Timer CullTimer;
+
+    ReadBackGpuCullingStats();
+
+    // Ranges only change when chunks are added or evicted or objects are removed
+    if (m_Scene.CullRangesDirty)
+    {
+        m_Scene.CullRanges.clear();
+        m_Scene.NumCulledCandidates = 0;
+        for (const InstancedObjects& ObjInst : m_Scene.ObjectInstances)
+        {
+            const Uint32 DrawId = FindGpuDraw(ObjInst);
+            VERIFY_EXPR(DrawId != ~0u);
+
+            HLSL::CullRange Range{};
+            Range.FirstObject   = ObjInst.ObjectAttribsOffset;
+            Range.NumObjects    = ObjInst.NumObjects;
+            Range.DrawId        = DrawId;
+            Range.VisibleOffset = m_Scene.GpuDraws[DrawId].ObjectAttribsOffset;
+            // Same objects as in CullObjects()
+            Range.Cull = ObjInst.MeshInd == m_CubeMeshId && ObjInst.NumIndices == 0 ? 1 : 0;
+            m_Scene.CullRanges.push_back(Range);
+            m_Scene.NumCulledCandidates += ObjInst.NumObjects;
+        }
+        if (!m_Scene.CullRanges.empty())
+        {
+            m_pImmediateContext->UpdateBuffer(m_Scene.CullRangesBuffer, 0, sizeof(HLSL::CullRange) * m_Scene.CullRanges.size(),
+                                              m_Scene.CullRanges.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        }
+        m_Scene.CullRangesDirty = false;
+    }
+
+    {
+        const float4x4 ViewProj = m_Camera.GetViewMatrix() * m_Camera.GetProjMatrix();
+        ViewFrustum    Frustum;
+        ExtractViewFrustumPlanesFromMatrix(ViewProj, Frustum, m_pDevice->GetDeviceInfo().NDC.MinZ == -1);
+        const Plane3D* Planes[] = {&Frustum.LeftPlane, &Frustum.RightPlane, &Frustum.BottomPlane, &Frustum.TopPlane, &Frustum.NearPlane, &Frustum.FarPlane};
+
+        const TextureDesc& PyramidDesc = m_DepthPyramid->GetDesc();
+
+        MapHelper<HLSL::CullConstants> CullConst{m_pImmediateContext, m_CullConstants, MAP_WRITE, MAP_FLAG_DISCARD};
+        CullConst->PrevViewProj = m_DepthPyramidViewProj.Transpose();
+        for (size_t i = 0; i < _countof(Planes); ++i)
+            CullConst->FrustumPlanes[i] = float4{Planes[i]->Normal, Planes[i]->Distance};
+        CullConst->NumRanges        = static_cast<Uint32>(m_Scene.CullRanges.size());
+        CullConst->UseOcclusion     = m_DepthPyramidValid ? 1 : 0;
+        CullConst->PyramidWidth     = PyramidDesc.Width;
+        CullConst->PyramidHeight    = PyramidDesc.Height;
+        CullConst->NumPyramidLevels = PyramidDesc.MipLevels;
+    }
+
+    // Every draw starts with no instances
+    const Uint64 DrawArgsSize = m_Scene.DrawArgsBuffer->GetDesc().Size;
+    m_pImmediateContext->CopyBuffer(m_Scene.DrawArgsTemplateBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
+                                    m_Scene.DrawArgsBuffer, 0, DrawArgsSize, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+
+    // One thread group per range
+    if (!m_Scene.CullRanges.empty())
+    {
+        DispatchComputeAttribs DispatchAttribs{static_cast<Uint32>(m_Scene.CullRanges.size()), 1, 1};
+        DispatchAttribs.MtlThreadGroupSizeX = CullGroupSize;
+        DispatchAttribs.MtlThreadGroupSizeY = 1;
+        DispatchAttribs.MtlThreadGroupSizeZ = 1;
+
+        m_pImmediateContext->SetPipelineState(m_CullPSO);
+        m_pImmediateContext->CommitShaderResources(m_CullSRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        m_pImmediateContext->DispatchCompute(DispatchAttribs);
+    }
+
+    // The arguments are copied for the stats unless all staging buffers are still in flight
+    DrawArgsReadback& Readback = m_DrawArgsReadbacks[m_NextDrawArgsReadback];
+    if (Readback.FenceValue == 0)
+    {
+        m_pImmediateContext->CopyBuffer(m_Scene.DrawArgsBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
+                                        Readback.Buffer, 0, DrawArgsSize, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        Readback.FenceValue    = ++m_CullFenceValue;
+        Readback.NumCandidates = m_Scene.NumCulledCandidates;
+        m_pImmediateContext->EnqueueSignal(m_CullFence, Readback.FenceValue);
+        m_NextDrawArgsReadback = (m_NextDrawArgsReadback + 1) % static_cast<Uint32>(m_DrawArgsReadbacks.size());
+    }
+
+    // Transition the results before the render targets are set
+    const StateTransitionDesc Barriers[] = {
+        {m_Scene.DrawArgsBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_INDIRECT_ARGUMENT, STATE_TRANSITION_FLAG_UPDATE_STATE},
+        {m_Scene.VisibleObjectsBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_SHADER_RESOURCE, STATE_TRANSITION_FLAG_UPDATE_STATE},
+    };
+    m_pImmediateContext->TransitionResourceStates(_countof(Barriers), Barriers);
+
+    m_CullingStats.NumFrames += 1;
+    m_CullingStats.TotalTime += CullTimer.GetElapsedTime();
+}
+
+void Tutorial22_HybridRendering::RecordGBufferDraws(IDeviceContext* pCtx, bool UseGpuCulling, Uint32 FirstDraw, Uint32 EndDraw, RESOURCE_STATE_TRANSITION_MODE TransitionMode)
+{
+    pCtx->SetPipelineState(m_RasterizationPSO);
+    pCtx->CommitShaderResources(m_RasterizationSRB, TransitionMode);
+
+    if (UseGpuCulling)
+    {
+        // The number of draws does not depend on the view; the cull pass writes their instance counts
+        for (Uint32 DrawId = FirstDraw; DrawId < EndDraw; ++DrawId)
+        {
+            const InstancedObjects& Draw      = m_Scene.GpuDraws[DrawId];
+            auto&                   Mesh      = m_Scene.Meshes[Draw.MeshInd];
+            IBuffer*                VBs[]     = {Mesh.VertexBuffer};
+            const Uint64            Offsets[] = {Mesh.FirstVertex * sizeof(HLSL::Vertex)};
+
+            pCtx->SetVertexBuffers(0, _countof(VBs), VBs, Offsets, TransitionMode, SET_VERTEX_BUFFERS_FLAG_RESET);
+            pCtx->SetIndexBuffer(Mesh.IndexBuffer, 0, TransitionMode);
+
+            {
+                MapHelper<HLSL::ObjectConstants> ObjConstants{pCtx, m_Scene.ObjectConstants, MAP_WRITE, MAP_FLAG_DISCARD};
+                ObjConstants->ObjectAttribsOffset = Draw.ObjectAttribsOffset;
+            }
+
+            DrawIndexedIndirectAttribs drawAttribs;
+            drawAttribs.IndexType                        = VT_UINT32;
+            drawAttribs.pAttribsBuffer                   = m_Scene.DrawArgsBuffer;
+            drawAttribs.DrawArgsOffset                   = DrawId * sizeof(HLSL::DrawIndexedArgs);
+            drawAttribs.Flags                            = DRAW_FLAG_VERIFY_ALL;
+            drawAttribs.AttribsBufferStateTransitionMode = RESOURCE_STATE_TRANSITION_MODE_VERIFY;
+            pCtx->DrawIndexedIndirect(drawAttribs);
+        }
+    }
+    else
+    {
+        for (Uint32 DrawId = FirstDraw; DrawId < EndDraw; ++DrawId)
+        {
+            const InstancedObjects& ObjInst = m_Scene.VisibleInstances[DrawId];
+
+            auto&        Mesh      = m_Scene.Meshes[ObjInst.MeshInd];
+            IBuffer*     VBs[]     = {Mesh.VertexBuffer};
+            const Uint64 Offsets[] = {Mesh.FirstVertex * sizeof(HLSL::Vertex)};
+
+            pCtx->SetVertexBuffers(0, _countof(VBs), VBs, Offsets, TransitionMode, SET_VERTEX_BUFFERS_FLAG_RESET);
+            pCtx->SetIndexBuffer(Mesh.IndexBuffer, 0, TransitionMode);
+
+            {
+                MapHelper<HLSL::ObjectConstants> ObjConstants{pCtx, m_Scene.ObjectConstants, MAP_WRITE, MAP_FLAG_DISCARD};
+                ObjConstants->ObjectAttribsOffset = ObjInst.ObjectAttribsOffset;
+            }
+
+            DrawIndexedAttribs drawAttribs;
+            drawAttribs.NumIndices         = ObjInst.NumIndices != 0 ? ObjInst.NumIndices : Mesh.NumIndices;
+            drawAttribs.NumInstances       = ObjInst.NumObjects;
+            drawAttribs.FirstIndexLocation = ObjInst.NumIndices != 0 ? ObjInst.FirstIndex : Mesh.FirstIndex;
+            drawAttribs.IndexType          = VT_UINT32;
+            drawAttribs.Flags              = DRAW_FLAG_VERIFY_ALL;
+            pCtx->DrawIndexed(drawAttribs);
+        }
+    }
+}
+
+void Tutorial22_HybridRendering::ReadBackGpuCullingStats()
+{
+    // Staging buffers are read from the oldest one
+    const Uint64 CompletedValue = m_CullFence->GetCompletedValue();
+    for (size_t i = 0; i < m_DrawArgsReadbacks.size(); ++i)
+    {
+        DrawArgsReadback& Readback = m_DrawArgsReadbacks[(m_NextDrawArgsReadback + i) % m_DrawArgsReadbacks.size()];
+        if (Readback.FenceValue == 0 || Readback.FenceValue > CompletedValue)
+            continue;
+
+        Uint32 NumDrawn = 0;
+        {
+            MapHelper<HLSL::DrawIndexedArgs> DrawArgs{m_pImmediateContext, Readback.Buffer, MAP_READ, MAP_FLAG_DO_NOT_WAIT};
+            if (!DrawArgs)
+                continue;
+            for (size_t DrawId = 0; DrawId < m_Scene.GpuDraws.size(); ++DrawId)
+                NumDrawn += DrawArgs[DrawId].NumInstances;
+        }
+        Readback.FenceValue = 0;
+
+        m_Scene.NumDrawnObjects = NumDrawn;
+        m_CullingStats.NumReadFrames += 1;
+        m_CullingStats.NumVisible += NumDrawn;
+        m_CullingStats.NumCandidates += Readback.NumCandidates;
+    }
+}
+
+void Tutorial22_HybridRendering::BuildDepthPyramid()
+{
+    const TextureDesc& PyramidDesc = m_DepthPyramid->GetDesc();
+
+    // Every level is read by the dispatch of the next one, so the levels are transitioned separately
+    const StateTransitionDesc Barriers[] = {
+        {m_GBuffer.Depth, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_SHADER_RESOURCE, STATE_TRANSITION_FLAG_UPDATE_STATE},
+        {m_DepthPyramid, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_UNORDERED_ACCESS, STATE_TRANSITION_FLAG_UPDATE_STATE},
+    };
+    m_pImmediateContext->TransitionResourceStates(_countof(Barriers), Barriers);
+
+    m_pImmediateContext->SetPipelineState(m_DepthPyramidPSO);
+    for (Uint32 Level = 0; Level < PyramidDesc.MipLevels; ++Level)
+    {
+        const uint2 Size{std::max(PyramidDesc.Width >> Level, 1u), std::max(PyramidDesc.Height >> Level, 1u)};
+
+        DispatchComputeAttribs DispatchAttribs{(Size.x + 7) / 8, (Size.y + 7) / 8, 1};
+        DispatchAttribs.MtlThreadGroupSizeX = 8;
+        DispatchAttribs.MtlThreadGroupSizeY = 8;
+        DispatchAttribs.MtlThreadGroupSizeZ = 1;
+
+        m_pImmediateContext->CommitShaderResources(m_DepthPyramidSRBs[Level], RESOURCE_STATE_TRANSITION_MODE_NONE);
+        m_pImmediateContext->DispatchCompute(DispatchAttribs);
+
+        const StateTransitionDesc LevelBarrier{m_DepthPyramid, RESOURCE_STATE_UNORDERED_ACCESS, RESOURCE_STATE_SHADER_RESOURCE, Level, 1};
+        m_pImmediateContext->TransitionResourceStates(1, &LevelBarrier);
+    }
+    // All levels are read by the cull pass of the next frame
+    m_DepthPyramid->SetState(RESOURCE_STATE_SHADER_RESOURCE);
+
+    m_DepthPyramidViewProj = m_Camera.GetViewMatrix() * m_Camera.GetProjMatrix();
+    m_DepthPyramidValid    = true;
+}
+
+void Tutorial22_HybridRendering::CreateScene()
+{
+    uint2                              CubeMaterialRange;
+    Uint32                             GroundMaterial;
+    std::vector<HLSL::MaterialAttribs> Materials;
+    CreateSceneMaterials(CubeMaterialRange, GroundMaterial, Materials);
+    CreateSceneObjects(CubeMaterialRange, GroundMaterial);
+    CreateSceneAccelStructs();
+
+    // Create buffer for object attribs
+    {
+        // The initial data covers all objects created so far, including the static ones
+        m_Scene.PackedObjects.resize(m_Scene.Objects.size());
+        for (size_t i = 0; i < m_Scene.Objects.size(); ++i)
+            m_Scene.PackedObjects[i] = PackObjectAttribs(m_Scene.Objects[i]);
+
+        BufferDesc BuffDesc;
+        BuffDesc.Name              = "Object attribs buffer";
+        BuffDesc.Usage             = USAGE_DEFAULT;
+        BuffDesc.BindFlags         = BIND_SHADER_RESOURCE;
+        BuffDesc.Size              = static_cast<Uint64>(sizeof(HLSL::ObjectAttribs) * m_Scene.PackedObjects.size());
+        BuffDesc.Mode              = BUFFER_MODE_STRUCTURED;
+        BuffDesc.ElementByteStride = sizeof(HLSL::ObjectAttribs);
+
+        BufferData InitData{m_Scene.PackedObjects.data(), BuffDesc.Size};
+        m_pDevice->CreateBuffer(BuffDesc, &InitData, &m_Scene.ObjectAttribsBuffer);
+    }
+
+    // Create buffer for the full transforms of the objects that are not only scaled and translated
+    {
+        Uint32 NumTransforms = 1; // The buffer must not be empty
+        for (const SceneObject& Obj : m_Scene.Objects)
+        {
+            if (Obj.TransformId != NO_OBJECT_TRANSFORM)
+                NumTransforms = std::max(NumTransforms, Obj.TransformId + 1);
+        }
+        m_Scene.PackedTransforms.assign(NumTransforms, HLSL::ObjectTransform{});
+        for (const SceneObject& Obj : m_Scene.Objects)
+        {
+            if (Obj.TransformId != NO_OBJECT_TRANSFORM)
+                m_Scene.PackedTransforms[Obj.TransformId] = {Obj.ModelMat, Obj.NormalMat};
+        }
+
+        BufferDesc BuffDesc;
+        BuffDesc.Name              = "Object transforms buffer";
+        BuffDesc.Usage             = USAGE_DEFAULT;
+        BuffDesc.BindFlags         = BIND_SHADER_RESOURCE;
+        BuffDesc.Size              = static_cast<Uint64>(sizeof(HLSL::ObjectTransform) * m_Scene.PackedTransforms.size());
+        BuffDesc.Mode              = BUFFER_MODE_STRUCTURED;
+        BuffDesc.ElementByteStride = sizeof(HLSL::ObjectTransform);
+
+        BufferData InitData{m_Scene.PackedTransforms.data(), BuffDesc.Size};
+        m_pDevice->CreateBuffer(BuffDesc, &InitData, &m_Scene.ObjectTransformsBuffer);
+
+        for (Uint32 ObjectIdx : m_Scene.DirtyObjects)
+            m_Scene.ObjectDirty[ObjectIdx] = 0;
+        m_Scene.DirtyObjects.clear();
+
+        const Uint64 FullSize = Uint64{sizeof(HLSL::ObjectAttribs) + sizeof(HLSL::ObjectTransform)} * m_Scene.Objects.size();
+        const Uint64 Size     = m_Scene.ObjectAttribsBuffer->GetDesc().Size + BuffDesc.Size;
+        LOG_INFO_MESSAGE("Object attribs: ", m_Scene.Objects.size(), " objects, ", NumTransforms, " with full transforms, ",
+                         Size / 1024, " KB (", FullSize / 1024, " KB if every object stored full transforms)");
+    }
 
-    // Allow engine to change resource states.
-    Attribs.TLASTransitionMode           = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
-    Attribs.BLASTransitionMode           = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
-    Attribs.InstanceBufferTransitionMode = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
-    Attribs.ScratchBufferTransitionMode  = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+    // Create buffer for geometry attribs, one element per BLAS geometry of every mesh
+    {
+        std::vector<HLSL::GeometryAttribs> Geometries;
+        for (const auto& Mesh : m_Scene.Meshes)
+        {
+            VERIFY_EXPR(Mesh.FirstGeometryId == Geometries.size());
+            if (Mesh.Geometries.empty())
+                Geometries.push_back({Mesh.FirstIndex, Mesh.FirstVertex, 0, 0});
+            for (const MeshGeometry& Geometry : Mesh.Geometries)
+                Geometries.push_back({Geometry.FirstIndex, Mesh.FirstVertex, 0, 0});
+        }
 
-    m_pImmediateContext->BuildTLAS(Attribs);
-}
+        BufferDesc BuffDesc;
+        BuffDesc.Name              = "Geometry attribs buffer";
+        BuffDesc.Usage             = USAGE_IMMUTABLE;
+        BuffDesc.BindFlags         = BIND_SHADER_RESOURCE;
+        BuffDesc.Size              = static_cast<Uint64>(sizeof(Geometries[0]) * Geometries.size());
+        BuffDesc.Mode              = BUFFER_MODE_STRUCTURED;
+        BuffDesc.ElementByteStride = sizeof(Geometries[0]);
 
-void Tutorial22_HybridRendering::CreateScene()
-{
-    uint2                              CubeMaterialRange;
-    Uint32                             GroundMaterial;
-    std::vector<HLSL::MaterialAttribs> Materials;
-    CreateSceneMaterials(CubeMaterialRange, GroundMaterial, Materials);
-    CreateSceneObjects(CubeMaterialRange, GroundMaterial);
-    CreateSceneAccelStructs();
+        BufferData InitData{Geometries.data(), BuffDesc.Size};
+        m_pDevice->CreateBuffer(BuffDesc, &InitData, &m_Scene.GeometryAttribsBuffer);
+    }
 
-    // Create buffer for object attribs
+    // Create buffer for the indices of the objects that passed culling, see CullObjects() and CullObjectsOnGpu()
     {
         BufferDesc BuffDesc;
-        BuffDesc.Name              = "Object attribs buffer";
+        BuffDesc.Name              = "Visible objects buffer";
         BuffDesc.Usage             = USAGE_DEFAULT;
-        BuffDesc.BindFlags         = BIND_SHADER_RESOURCE;
-        BuffDesc.Size              = static_cast<Uint64>(sizeof(m_Scene.Objects[0]) * m_Scene.Objects.size());
+        BuffDesc.BindFlags         = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+        BuffDesc.Size              = static_cast<Uint64>(sizeof(Uint32) * m_Scene.Objects.size());
+        BuffDesc.Mode              = BUFFER_MODE_STRUCTURED;
+        BuffDesc.ElementByteStride = sizeof(Uint32);
+        m_pDevice->CreateBuffer(BuffDesc, nullptr, &m_Scene.VisibleObjectsBuffer);
+        m_Scene.VisibleObjects.reserve(m_Scene.Objects.size());
+    }
+
+    // Create the indirect draws of the GPU culling. Every static range and every chunk slot reserves
+    // space for its objects in the draw of its index range, see CullObjectsOnGpu().
+    {
+        m_Scene.GpuDraws.clear();
+        const auto AddDrawObjects = [&](const InstancedObjects& ObjInst, Uint32 NumObjects) {
+            Uint32 DrawId = FindGpuDraw(ObjInst);
+            if (DrawId == ~0u)
+            {
+                DrawId = static_cast<Uint32>(m_Scene.GpuDraws.size());
+                m_Scene.GpuDraws.push_back(ObjInst);
+                m_Scene.GpuDraws.back().NumObjects = 0;
+            }
+            m_Scene.GpuDraws[DrawId].NumObjects += NumObjects;
+        };
+        for (Uint32 i = 0; i < m_NumStaticInstances; ++i)
+            AddDrawObjects(m_Scene.ObjectInstances[i], m_Scene.ObjectInstances[i].NumObjects);
+
+        // Chunks draw the whole cube mesh, see UpdateChunkInstances()
+        InstancedObjects ChunkInst;
+        ChunkInst.MeshInd = m_CubeMeshId;
+        AddDrawObjects(ChunkInst, m_MaxObjectsPerChunk * static_cast<Uint32>(m_ChunkSlots.size()));
+
+        std::vector<HLSL::DrawIndexedArgs> DrawArgs;
+        Uint32                             VisibleOffset = 0;
+        for (InstancedObjects& Draw : m_Scene.GpuDraws)
+        {
+            Draw.ObjectAttribsOffset = VisibleOffset;
+            VisibleOffset += Draw.NumObjects;
+
+            const Mesh&           DrawMesh = m_Scene.Meshes[Draw.MeshInd];
+            HLSL::DrawIndexedArgs Args{};
+            Args.NumIndices = Draw.NumIndices != 0 ? Draw.NumIndices : DrawMesh.NumIndices;
+            Args.FirstIndex = Draw.NumIndices != 0 ? Draw.FirstIndex : DrawMesh.FirstIndex;
+            DrawArgs.push_back(Args);
+        }
+        VERIFY_EXPR(VisibleOffset <= m_Scene.Objects.size());
+
+        BufferDesc BuffDesc;
+        BuffDesc.Name              = "Draw args template buffer";
+        BuffDesc.Usage             = USAGE_IMMUTABLE;
+        BuffDesc.BindFlags         = BIND_INDIRECT_DRAW_ARGS;
+        BuffDesc.Size              = static_cast<Uint64>(sizeof(DrawArgs[0]) * DrawArgs.size());
         BuffDesc.Mode              = BUFFER_MODE_STRUCTURED;
-        BuffDesc.ElementByteStride = sizeof(m_Scene.Objects[0]);
-        m_pDevice->CreateBuffer(BuffDesc, nullptr, &m_Scene.ObjectAttribsBuffer);
+        BuffDesc.ElementByteStride = sizeof(DrawArgs[0]);
+        BufferData InitData{DrawArgs.data(), BuffDesc.Size};
+        m_pDevice->CreateBuffer(BuffDesc, &InitData, &m_Scene.DrawArgsTemplateBuffer);
+
+        BuffDesc.Name      = "Draw args buffer";
+        BuffDesc.Usage     = USAGE_DEFAULT;
+        BuffDesc.BindFlags = BIND_INDIRECT_DRAW_ARGS | BIND_UNORDERED_ACCESS;
+        m_pDevice->CreateBuffer(BuffDesc, nullptr, &m_Scene.DrawArgsBuffer);
+
+        // Static ranges followed by one range per chunk slot
+        BuffDesc.Name              = "Cull ranges buffer";
+        BuffDesc.BindFlags         = BIND_SHADER_RESOURCE;
+        BuffDesc.Size              = static_cast<Uint64>(sizeof(HLSL::CullRange) * (m_NumStaticInstances + m_ChunkSlots.size()));
+        BuffDesc.ElementByteStride = sizeof(HLSL::CullRange);
+        m_pDevice->CreateBuffer(BuffDesc, nullptr, &m_Scene.CullRangesBuffer);
+        m_Scene.CullRanges.reserve(m_NumStaticInstances + m_ChunkSlots.size());
+        m_Scene.CullRangesDirty = true;
     }
 
     // Create and initialize buffer for material attribs
@@ -1061,6 +1985,8 @@ void Tutorial22_HybridRendering::CreateRasterizationPSO(IShaderSourceInputStream
     m_RasterizationSRB->GetVariableByName(SHADER_TYPE_VERTEX, "g_Constants")->Set(m_Constants);
     m_RasterizationSRB->GetVariableByName(SHADER_TYPE_VERTEX, "g_ObjectConst")->Set(m_Scene.ObjectConstants);
     m_RasterizationSRB->GetVariableByName(SHADER_TYPE_VERTEX, "g_ObjectAttribs")->Set(m_Scene.ObjectAttribsBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+    m_RasterizationSRB->GetVariableByName(SHADER_TYPE_VERTEX, "g_ObjectTransforms")->Set(m_Scene.ObjectTransformsBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+    m_RasterizationSRB->GetVariableByName(SHADER_TYPE_VERTEX, "g_VisibleObjects")->Set(m_Scene.VisibleObjectsBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
     m_RasterizationSRB->GetVariableByName(SHADER_TYPE_PIXEL, "g_MaterialAttribs")->Set(m_Scene.MaterialAttribsBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
 
     // Bind textures
@@ -1128,6 +2054,143 @@ void Tutorial22_HybridRendering::CreatePostProcessPSO(IShaderSourceInputStreamFa
     m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_PostProcessPSO);
 }
 
+void Tutorial22_HybridRendering::CreateCullingPSOs(IShaderSourceInputStreamFactory* pShaderSourceFactory)
+{
+    // Create PSOs for the GPU culling pass and for the depth pyramid it reads
+
+    ShaderMacroHelper Macros;
+    Macros.AddShaderMacro("CULL_GROUP_SIZE", CullGroupSize);
+
+    ShaderCreateInfo ShaderCI;
+    ShaderCI.Desc.ShaderType            = SHADER_TYPE_COMPUTE;
+    ShaderCI.SourceLanguage             = SHADER_SOURCE_LANGUAGE_HLSL;
+    ShaderCI.ShaderCompiler             = m_ShaderCompiler;
+    ShaderCI.pShaderSourceStreamFactory = pShaderSourceFactory;
+    ShaderCI.EntryPoint                 = "CSMain";
+    ShaderCI.Macros                     = Macros;
+
+    {
+        RefCntAutoPtr<IShader> pCS;
+        ShaderCI.Desc.Name = "Culling CS";
+        ShaderCI.FilePath  = "Culling.csh";
+        m_pDevice->CreateShader(ShaderCI, &pCS);
+
+        ComputePipelineStateCreateInfo PSOCreateInfo;
+        PSOCreateInfo.PSODesc.Name         = "Culling PSO";
+        PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_COMPUTE;
+        PSOCreateInfo.pCS                  = pCS;
+
+        // The depth pyramid is recreated when the window is resized
+        const ShaderResourceVariableDesc Vars[] = {
+            {SHADER_TYPE_COMPUTE, "g_DepthPyramid", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC},
+        };
+        PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE;
+        PSOCreateInfo.PSODesc.ResourceLayout.Variables           = Vars;
+        PSOCreateInfo.PSODesc.ResourceLayout.NumVariables        = _countof(Vars);
+
+        m_pDevice->CreateComputePipelineState(PSOCreateInfo, &m_CullPSO);
+        VERIFY_EXPR(m_CullPSO);
+    }
+
+    {
+        RefCntAutoPtr<IShader> pCS;
+        ShaderCI.Desc.Name = "Depth pyramid CS";
+        ShaderCI.FilePath  = "DepthPyramid.csh";
+        ShaderCI.Macros    = {};
+        m_pDevice->CreateShader(ShaderCI, &pCS);
+
+        ComputePipelineStateCreateInfo PSOCreateInfo;
+        PSOCreateInfo.PSODesc.Name                               = "Depth pyramid PSO";
+        PSOCreateInfo.PSODesc.PipelineType                       = PIPELINE_TYPE_COMPUTE;
+        PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE;
+        PSOCreateInfo.pCS                                        = pCS;
+
+        m_pDevice->CreateComputePipelineState(PSOCreateInfo, &m_DepthPyramidPSO);
+        VERIFY_EXPR(m_DepthPyramidPSO);
+    }
+
+    {
+        BufferDesc BuffDesc;
+        BuffDesc.Name           = "Cull constants buffer";
+        BuffDesc.Usage          = USAGE_DYNAMIC;
+        BuffDesc.BindFlags      = BIND_UNIFORM_BUFFER;
+        BuffDesc.Size           = sizeof(HLSL::CullConstants);
+        BuffDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
+        m_pDevice->CreateBuffer(BuffDesc, nullptr, &m_CullConstants);
+    }
+
+    m_CullPSO->CreateShaderResourceBinding(&m_CullSRB);
+    m_CullSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_CullConst")->Set(m_CullConstants);
+    m_CullSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_CullRanges")->Set(m_Scene.CullRangesBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+    m_CullSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_ObjectAttribs")->Set(m_Scene.ObjectAttribsBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+    m_CullSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_ObjectTransforms")->Set(m_Scene.ObjectTransformsBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+    m_CullSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_DrawArgs")->Set(m_Scene.DrawArgsBuffer->GetDefaultView(BUFFER_VIEW_UNORDERED_ACCESS));
+    m_CullSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_VisibleObjects")->Set(m_Scene.VisibleObjectsBuffer->GetDefaultView(BUFFER_VIEW_UNORDERED_ACCESS));
+
+    // The draw arguments are read back a few frames later to report the number of drawn objects
+    {
+        BufferDesc BuffDesc;
+        BuffDesc.Name           = "Draw args readback buffer";
+        BuffDesc.Usage          = USAGE_STAGING;
+        BuffDesc.CPUAccessFlags = CPU_ACCESS_READ;
+        BuffDesc.Size           = m_Scene.DrawArgsBuffer->GetDesc().Size;
+        for (DrawArgsReadback& Readback : m_DrawArgsReadbacks)
+            m_pDevice->CreateBuffer(BuffDesc, nullptr, &Readback.Buffer);
+
+        FenceDesc FenceCI;
+        FenceCI.Name = "Culling fence";
+        m_pDevice->CreateFence(FenceCI, &m_CullFence);
+    }
+}
+
+void Tutorial22_HybridRendering::CreateDepthPyramid(Uint32 Width, Uint32 Height)
+{
+    // Level 0 is the largest power of two that fits in the screen, so every level is half of the previous one
+    TextureDesc PyramidDesc;
+    PyramidDesc.Name      = "Depth pyramid";
+    PyramidDesc.Type      = RESOURCE_DIM_TEX_2D;
+    PyramidDesc.Width     = 1u << PlatformMisc::GetMSB(Width);
+    PyramidDesc.Height    = 1u << PlatformMisc::GetMSB(Height);
+    PyramidDesc.MipLevels = PlatformMisc::GetMSB(std::max(PyramidDesc.Width, PyramidDesc.Height)) + 1;
+    PyramidDesc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+    PyramidDesc.Format    = TEX_FORMAT_R32_FLOAT;
+    m_DepthPyramid.Release();
+    m_pDevice->CreateTexture(PyramidDesc, nullptr, &m_DepthPyramid);
+
+    m_DepthPyramidSRBs.clear();
+    for (Uint32 Level = 0; Level < PyramidDesc.MipLevels; ++Level)
+    {
+        RefCntAutoPtr<ITextureView> pSrcView;
+        if (Level > 0)
+        {
+            TextureViewDesc ViewDesc;
+            ViewDesc.ViewType        = TEXTURE_VIEW_SHADER_RESOURCE;
+            ViewDesc.MostDetailedMip = Level - 1;
+            ViewDesc.NumMipLevels    = 1;
+            m_DepthPyramid->CreateView(ViewDesc, &pSrcView);
+        }
+
+        RefCntAutoPtr<ITextureView> pDstView;
+        {
+            TextureViewDesc ViewDesc;
+            ViewDesc.ViewType        = TEXTURE_VIEW_UNORDERED_ACCESS;
+            ViewDesc.MostDetailedMip = Level;
+            ViewDesc.NumMipLevels    = 1;
+            m_DepthPyramid->CreateView(ViewDesc, &pDstView);
+        }
+
+        RefCntAutoPtr<IShaderResourceBinding> pSRB;
+        m_DepthPyramidPSO->CreateShaderResourceBinding(&pSRB);
+        pSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_SrcDepth")->Set(Level > 0 ? pSrcView.RawPtr() : m_GBuffer.Depth->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE));
+        pSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_DstDepth")->Set(pDstView);
+        m_DepthPyramidSRBs.push_back(pSRB);
+    }
+
+    m_CullSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_DepthPyramid")->Set(m_DepthPyramid->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE));
+    // The new pyramid holds no depth until the next frame is rendered
+    m_DepthPyramidValid = false;
+}
+
 void Tutorial22_HybridRendering::CreateRayTracingPSO(IShaderSourceInputStreamFactory* pShaderSourceFactory)
 {
     // Create compute shader that performs inline ray tracing
@@ -1163,6 +2226,8 @@ void Tutorial22_HybridRendering::CreateRayTracingPSO(IShaderSourceInputStreamFac
             {SHADER_TYPE_COMPUTE, "g_MaterialAttribs", 1,           SHADER_RESOURCE_TYPE_BUFFER_SRV},
             {SHADER_TYPE_COMPUTE, "g_VertexBuffer",    1,           SHADER_RESOURCE_TYPE_BUFFER_SRV},
             {SHADER_TYPE_COMPUTE, "g_IndexBuffer",     1,           SHADER_RESOURCE_TYPE_BUFFER_SRV},
+            {SHADER_TYPE_COMPUTE, "g_ObjectTransforms", 1,          SHADER_RESOURCE_TYPE_BUFFER_SRV},
+            {SHADER_TYPE_COMPUTE, "g_Geometries",      1,           SHADER_RESOURCE_TYPE_BUFFER_SRV},
             {SHADER_TYPE_COMPUTE, "g_Textures",        NumTextures, SHADER_RESOURCE_TYPE_TEXTURE_SRV},
             {SHADER_TYPE_COMPUTE, "g_Samplers",        NumSamplers, SHADER_RESOURCE_TYPE_SAMPLER}
         };
@@ -1241,6 +2306,8 @@ void Tutorial22_HybridRendering::CreateRayTracingPSO(IShaderSourceInputStreamFac
     m_RayTracingSceneSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_Constants")->Set(m_Constants);
     m_RayTracingSceneSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_ObjectAttribs")->Set(m_Scene.ObjectAttribsBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
     m_RayTracingSceneSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_MaterialAttribs")->Set(m_Scene.MaterialAttribsBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+    m_RayTracingSceneSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_ObjectTransforms")->Set(m_Scene.ObjectTransformsBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+    m_RayTracingSceneSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_Geometries")->Set(m_Scene.GeometryAttribsBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
 
     // Bind mesh geometry buffers. All meshes use shared vertex and index buffers.
     m_RayTracingSceneSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_VertexBuffer")->Set(m_Scene.Meshes[0].VertexBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
@@ -1267,6 +2334,8 @@ void Tutorial22_HybridRendering::Initialize(const SampleInitInfo& InitInfo)
 {
     SampleBase::Initialize(InitInfo);
 
+    Timer StartupTimer;
+
     // RayTracing feature indicates that some of ray tracing functionality is supported.
     // Acceleration structures are always supported if RayTracing feature is enabled.
     // Inline ray tracing may be unsupported by old DirectX 12 drivers or if this feature is not supported by Vulkan.
@@ -1276,15 +2345,128 @@ void Tutorial22_HybridRendering::Initialize(const SampleInitInfo& InitInfo)
         return;
     }
 
+    if (!m_Level.Load(m_LevelPath.c_str(), static_cast<Uint32>(_countof(CubeMaterialImages))))
+        LOG_ERROR_AND_THROW("Failed to load maze level '", m_LevelPath, "'");
+
+    if (m_BenchmarkCollisionQueries > 0)
+        MazeCollisionGrid::RunBenchmark(m_Level, m_ChunkSize, static_cast<Uint32>(m_BenchmarkCollisionQueries));
+    if (m_BenchmarkCollisionKernelBoxes > 0)
+        RunSphereBoxBenchmark(static_cast<Uint32>(m_BenchmarkCollisionKernelBoxes));
+
+    if (m_UseProceduralWorld || m_BenchmarkGeneratorChunks > 0 || m_BenchmarkFlowFieldUpdates > 0 || m_BenchmarkPathQueries > 0 ||
+        m_BenchmarkCrowdAgents > 0 || m_BenchmarkRayCasts > 0)
+    {
+        // The level still provides the block types, key-door bindings, cell size and wall height
+        MazeGenerator::CreateInfo GeneratorCI;
+        GeneratorCI.Seed      = static_cast<Uint32>(m_ProceduralSeed);
+        GeneratorCI.ChunkSize = m_ChunkSize;
+        if (!m_Generator.Initialize(m_Level, GeneratorCI))
+            LOG_ERROR_AND_THROW("Failed to initialize the maze generator");
+
+        if (m_BenchmarkGeneratorChunks > 0)
+            m_Generator.RunBenchmark(static_cast<Uint32>(m_BenchmarkGeneratorChunks));
+        if (m_BenchmarkFlowFieldUpdates > 0)
+            MazeFlowField::RunBenchmark(m_Level, m_Generator, static_cast<Uint32>(m_BenchmarkFlowFieldUpdates));
+        if (m_BenchmarkPathQueries > 0)
+            MazePathPlanner::RunBenchmark(m_Level, m_Generator, static_cast<Uint32>(m_BenchmarkPathQueries));
+        if (m_BenchmarkRayCasts > 0)
+            MazeRayCaster::RunBenchmark(m_Level, m_Generator, static_cast<Uint32>(m_BenchmarkRayCasts));
+        if (m_BenchmarkCrowdAgents > 0)
+            MazeCrowd::RunBenchmark(m_Level, m_Generator, static_cast<Uint32>(m_BenchmarkCrowdAgents));
+
+        if (!m_UseProceduralWorld)
+            m_Generator = {};
+    }
+
     // Setup camera.
-    m_Camera.SetPos(float3{-15.7f, 3.7f, -5.8f});
-    m_Camera.SetRotation(17.7f, -0.1f);
+    float2 SpawnRotation{17.7f, -0.1f};
+    if (const MazeSpawnPoint* pSpawn = m_Level.FindSpawnPoint(MAZE_SPAWN_KIND_PLAYER))
+    {
+        m_PlayerSpawnPos = pSpawn->Pos;
+        SpawnRotation    = float2{pSpawn->Yaw, pSpawn->Pitch};
+    }
+    if (m_UseProceduralWorld)
+    {
+        // Level spawn points are meaningless in a generated maze
+        const int2 SpawnCell = MazeGenerator::GetSpawnCell();
+        m_PlayerSpawnPos     = m_Level.GetCellCenter(SpawnCell.x, SpawnCell.y) + float3{0, 3, 0};
+    }
+    ResetSimulationCamera(m_PlayerSpawnPos);
+    m_Camera.SetRotation(SpawnRotation.x, SpawnRotation.y);
     m_Camera.SetRotationSpeed(0.005f);
     m_Camera.SetMoveSpeed(5.f);
     m_Camera.SetSpeedUpScales(5.f, 10.f);
 
     CreateScene();
 
+    // Monsters follow a flow field toward the player's cell
+    {
+        MazeFlowField::CreateInfo FlowFieldCI;
+        FlowFieldCI.pLevel     = &m_Level;
+        FlowFieldCI.pGenerator = m_Generator.IsInitialized() ? &m_Generator : nullptr;
+        FlowFieldCI.IsDoorOpen = [this](const int2& Cell, Uint8 BlockType) {
+            // Same lock scopes as in BuildMazeChunk()
+            const int2 LockScope = m_Generator.IsInitialized() ? m_ChunkStreamer.GetChunkAt(m_Level.GetCellCenter(Cell.x, Cell.y)) : int2{};
+            return m_UnlockedDoors.count(GetDoorLockId(LockScope, BlockType)) != 0;
+        };
+        m_FlowField.Initialize(FlowFieldCI);
+
+        // Monsters see through the open cells of the field
+        MazeRayCaster::CreateInfo RayCasterCI;
+        RayCasterCI.pLevel = &m_Level;
+        RayCasterCI.pField = &m_FlowField;
+        m_RayCaster.Initialize(RayCasterCI);
+
+        // The rasterized objects are culled by the cells seen through the open cells of the field
+        MazeVisibility::CreateInfo VisibilityCI;
+        VisibilityCI.pLevel = &m_Level;
+        VisibilityCI.pField = &m_FlowField;
+        if (m_UseCulling && m_UsePvs && !m_Generator.IsInitialized())
+        {
+            // The sets cover the streaming window, like the traversal, see CullObjects()
+            const int    PvsRadius = std::min((m_ChunkEvictRadius + 1) * m_ChunkSize, MazePvs::MaxRadius);
+            const auto   PvsPath   = m_LevelPath + ".pvs";
+            const Uint64 PvsHash   = static_cast<Uint64>(ComputeHash(m_Level.ComputeContentHash(), MazePvsVersion, PvsRadius));
+            if (!m_Pvs.Load(PvsPath.c_str(), PvsHash))
+            {
+                Timer BakeTimer;
+
+                MazePvs::BakeInfo PvsInfo;
+                PvsInfo.pLevel      = &m_Level;
+                PvsInfo.ContentHash = PvsHash;
+                PvsInfo.Radius      = PvsRadius;
+                if (MazePvs::Bake(PvsPath.c_str(), PvsInfo) && m_Pvs.Load(PvsPath.c_str(), PvsHash))
+                {
+                    LOG_INFO_MESSAGE("Baked visibility sets of ", m_Level.GetCols(), "x", m_Level.GetRows(), " cells in ", BakeTimer.GetElapsedTime() * 1000.0,
+                                     " ms (", m_Pvs.GetFileSize() / 1024.0, " KB)");
+                }
+            }
+            VisibilityCI.pPvs = m_Pvs.IsLoaded() ? &m_Pvs : nullptr;
+        }
+        m_Visibility.Initialize(VisibilityCI);
+
+        // Monsters outside of the flow field plan their paths on the whole maze
+        MazePathPlanner::CreateInfo PlannerCI;
+        PlannerCI.pLevel      = &m_Level;
+        PlannerCI.pGenerator  = FlowFieldCI.pGenerator;
+        PlannerCI.ClusterSize = m_ChunkSize;
+        m_PathPlanner.Start(PlannerCI);
+
+        // The simulation shares the cores with the render threads, the streamer and the planner
+        JobSystem::CreateInfo JobsCI;
+        JobsCI.NumWorkerThreads = std::min(std::max(std::thread::hardware_concurrency(), 1u), 8u) - 1;
+        m_Jobs.Initialize(JobsCI);
+
+        MazeCrowd::CreateInfo CrowdCI;
+        CrowdCI.pLevel     = &m_Level;
+        CrowdCI.pRayCaster = &m_RayCaster;
+        CrowdCI.pJobs      = &m_Jobs;
+        CrowdCI.Lod.MaxReducedUpdatesPerTick = static_cast<Uint32>(m_SimLodBudget);
+        m_Crowd.Initialize(CrowdCI);
+        m_DoorLod.Initialize(CrowdCI.Lod);
+        SpawnMonsters();
+    }
+
     // Create buffer for constants that is shared between all PSOs
     {
         BufferDesc BuffDesc;
@@ -1300,6 +2482,83 @@ void Tutorial22_HybridRendering::Initialize(const SampleInitInfo& InitInfo)
     CreateRasterizationPSO(pShaderSourceFactory);
     CreatePostProcessPSO(pShaderSourceFactory);
     CreateRayTracingPSO(pShaderSourceFactory);
+    CreateCullingPSOs(pShaderSourceFactory);
+
+    m_CommandRecorder.Initialize(m_pDeferredContexts);
+
+    if (m_pDevice->GetDeviceInfo().Features.TimestampQueries)
+        m_RayTracingDuration = std::make_unique<DurationQueryHelper>(m_pDevice);
+
+    LOG_INFO_MESSAGE("Startup (", m_Generator.IsInitialized() ? "procedural" : (m_SceneCacheWarm ? "warm scene cache" : "cold scene cache"),
+                     ") took ", StartupTimer.GetElapsedTime() * 1000.0, " ms");
+}
+
+SampleBase::CommandLineStatus Tutorial22_HybridRendering::ProcessCommandLine(int argc, const char* const* argv)
+{
+    CommandLineParser ArgsParser{argc, argv};
+    // -l / --level <path>: binary maze level to load
+    ArgsParser.Parse("level", 'l', m_LevelPath);
+    // -s / --seed <n>: explore an endless maze generated with the given seed instead of the level cells
+    m_UseProceduralWorld = ArgsParser.Parse("seed", 's', m_ProceduralSeed);
+    // --bench_generator <n>: measure the maze generator throughput on n chunks at startup
+    ArgsParser.Parse("bench_generator", m_BenchmarkGeneratorChunks);
+    // --bench_collisions <n>: compare n collision queries against the grid and a linear scan at startup
+    ArgsParser.Parse("bench_collisions", m_BenchmarkCollisionQueries);
+    // --bench_collision_kernel <n>: check and measure the SIMD sphere-box kernel on n boxes at startup
+    ArgsParser.Parse("bench_collision_kernel", m_BenchmarkCollisionKernelBoxes);
+    // --bench_flow_field <n>: measure n full and incremental flow field updates on large generated grids at startup
+    ArgsParser.Parse("bench_flow_field", m_BenchmarkFlowFieldUpdates);
+    // --bench_path_planner <n>: compare n hierarchical path queries with a grid search at startup
+    ArgsParser.Parse("bench_path_planner", m_BenchmarkPathQueries);
+    // --bench_ray_caster <n>: check and measure n ray casts and line-of-sight tests at startup
+    ArgsParser.Parse("bench_ray_caster", m_BenchmarkRayCasts);
+    // --bench_crowd <n>: measure the crowd simulation of n monsters on one and on all threads at startup
+    ArgsParser.Parse("bench_crowd", m_BenchmarkCrowdAgents);
+    // --monsters <n>: number of monsters that chase the player
+    if (ArgsParser.Parse("monsters", m_NumMonsters) && (m_NumMonsters < 0 || m_NumMonsters > 10000))
+    {
+        LOG_ERROR_MESSAGE("Number of monsters ", m_NumMonsters, " is out of range [0, 10000]");
+        return CommandLineStatus::Error;
+    }
+    // --sim_lod_budget <n>: maximum number of distant monsters, and of distant doors, updated per tick
+    if (ArgsParser.Parse("sim_lod_budget", m_SimLodBudget) && m_SimLodBudget < 1)
+    {
+        LOG_ERROR_MESSAGE("Simulation LOD budget ", m_SimLodBudget, " must be at least 1");
+        return CommandLineStatus::Error;
+    }
+    // --wall_mesh <0|1>: draw the static walls of the level as one baked mesh (default) or as a cube per wall
+    int UseWallMesh = 1;
+    ArgsParser.Parse("wall_mesh", UseWallMesh);
+    m_UseWallMesh = UseWallMesh != 0;
+    // --culling <0|1>: cull the rasterized objects by the view frustum and the visible cells (default) or draw all of them
+    int UseCulling = 1;
+    ArgsParser.Parse("culling", UseCulling);
+    m_UseCulling = UseCulling != 0;
+    // --pvs <0|1>: cull by the visible sets baked for the level cells next to the level file (default) or by the traversal every frame
+    int UsePvs = 1;
+    ArgsParser.Parse("pvs", UsePvs);
+    m_UsePvs = UsePvs != 0;
+    // --gpu_culling <0|1>: cull in a compute pass and draw with indirect draws (default) or cull on the CPU
+    int UseGpuCulling = 1;
+    ArgsParser.Parse("gpu_culling", UseGpuCulling);
+    m_UseGpuCulling = UseGpuCulling != 0;
+    // --render_threads <n>: record the G-buffer draws with deferred contexts on n threads, 0 records everything on the immediate context
+    int NumRenderThreads = static_cast<int>(std::min(std::max(std::thread::hardware_concurrency(), 1u), 4u));
+    if (ArgsParser.Parse("render_threads", NumRenderThreads) && (NumRenderThreads < 0 || NumRenderThreads > 16))
+    {
+        LOG_ERROR_MESSAGE("Number of render threads ", NumRenderThreads, " is out of range [0, 16]");
+        return CommandLineStatus::Error;
+    }
+    m_NumRenderThreads = static_cast<Uint32>(NumRenderThreads);
+    // --job_trace <path>: save the task timings of the first simulation ticks for chrome://tracing or Perfetto
+    ArgsParser.Parse("job_trace", m_JobTracePath);
+    // --tick_rate <hz>: fixed simulation rate, independent of the frame rate
+    if (ArgsParser.Parse("tick_rate", m_SimTickRate) && (m_SimTickRate < 10 || m_SimTickRate > 1000))
+    {
+        LOG_ERROR_MESSAGE("Simulation tick rate ", m_SimTickRate, " Hz is out of range [10, 1000]");
+        return CommandLineStatus::Error;
+    }
+    return CommandLineStatus::OK;
 }
 
 void Tutorial22_HybridRendering::ModifyEngineInitInfo(const ModifyEngineInitInfoAttribs& Attribs)
@@ -1308,6 +2567,10 @@ void Tutorial22_HybridRendering::ModifyEngineInitInfo(const ModifyEngineInitInfo
 
     // Require ray tracing feature.
     Attribs.EngineCI.Features.RayTracing = DEVICE_FEATURE_STATE_ENABLED;
+    // Used to report the GPU time of the ray tracing pass
+    Attribs.EngineCI.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+    // One deferred context per render thread, see DeferredCommandRecorder
+    Attribs.EngineCI.NumDeferredContexts = m_NumRenderThreads;
 }
 
 void Tutorial22_HybridRendering::Render()
@@ -1334,11 +2597,16 @@ void Tutorial22_HybridRendering::Render()
 
         m_pImmediateContext->UpdateBuffer(m_Constants, 0, static_cast<Uint32>(sizeof(GConst)), &GConst, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
-        // Update transformation for scene objects
-        m_pImmediateContext->UpdateBuffer(m_Scene.ObjectAttribsBuffer, 0, static_cast<Uint32>(sizeof(HLSL::ObjectAttribs) * m_Scene.Objects.size()),
-                                          m_Scene.Objects.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        UploadDirtyObjects();
     }
 
+    // Without culling all objects are drawn by the CPU path
+    const bool UseGpuCulling = m_UseCulling && m_UseGpuCulling;
+    if (UseGpuCulling)
+        CullObjectsOnGpu();
+    else
+        CullObjects();
+
     UpdateTLAS();
 
     // Rasterization pass
@@ -1357,33 +2625,46 @@ void Tutorial22_HybridRendering::Render()
         m_pImmediateContext->ClearRenderTarget(RTVs[1], ClearColor, RESOURCE_STATE_TRANSITION_MODE_NONE);
         m_pImmediateContext->ClearDepthStencil(pDSV, CLEAR_DEPTH_FLAG, 1.f, 0, RESOURCE_STATE_TRANSITION_MODE_NONE);
 
-        m_pImmediateContext->SetPipelineState(m_RasterizationPSO);
-        m_pImmediateContext->CommitShaderResources(m_RasterizationSRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-
-        for (auto& ObjInst : m_Scene.ObjectInstances)
+        const Uint32 NumDraws   = static_cast<Uint32>(UseGpuCulling ? m_Scene.GpuDraws.size() : m_Scene.VisibleInstances.size());
+        const Uint32 NumThreads = std::min(m_CommandRecorder.GetNumThreads(), NumDraws);
+        if (NumThreads > 0)
         {
-            auto&        Mesh      = m_Scene.Meshes[ObjInst.MeshInd];
-            IBuffer*     VBs[]     = {Mesh.VertexBuffer};
-            const Uint64 Offsets[] = {Mesh.FirstVertex * sizeof(HLSL::Vertex)};
-
-            m_pImmediateContext->SetVertexBuffers(0, _countof(VBs), VBs, Offsets, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, SET_VERTEX_BUFFERS_FLAG_RESET);
-            m_pImmediateContext->SetIndexBuffer(Mesh.IndexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-
+            // Deferred contexts only verify the resource states
+            m_pImmediateContext->TransitionShaderResources(m_RasterizationSRB);
+            std::vector<StateTransitionDesc> Barriers;
+            std::vector<IBuffer*>            Buffers;
+            for (const Mesh& DrawMesh : m_Scene.Meshes)
             {
-                MapHelper<HLSL::ObjectConstants> ObjConstants{m_pImmediateContext, m_Scene.ObjectConstants, MAP_WRITE, MAP_FLAG_DISCARD};
-                ObjConstants->ObjectAttribsOffset = ObjInst.ObjectAttribsOffset;
+                for (IBuffer* pBuffer : {DrawMesh.VertexBuffer.RawPtr(), DrawMesh.IndexBuffer.RawPtr()})
+                {
+                    if (std::find(Buffers.begin(), Buffers.end(), pBuffer) != Buffers.end())
+                        continue;
+                    Buffers.push_back(pBuffer);
+                    const RESOURCE_STATE NewState = pBuffer == DrawMesh.VertexBuffer ? RESOURCE_STATE_VERTEX_BUFFER : RESOURCE_STATE_INDEX_BUFFER;
+                    Barriers.emplace_back(pBuffer, RESOURCE_STATE_UNKNOWN, NewState, STATE_TRANSITION_FLAG_UPDATE_STATE);
+                }
             }
+            m_pImmediateContext->TransitionResourceStates(static_cast<Uint32>(Barriers.size()), Barriers.data());
 
-            DrawIndexedAttribs drawAttribs;
-            drawAttribs.NumIndices         = Mesh.NumIndices;
-            drawAttribs.NumInstances       = ObjInst.NumObjects;
-            drawAttribs.FirstIndexLocation = Mesh.FirstIndex;
-            drawAttribs.IndexType          = VT_UINT32;
-            drawAttribs.Flags              = DRAW_FLAG_VERIFY_ALL;
-            m_pImmediateContext->DrawIndexed(drawAttribs);
+            // Every thread records a consecutive range of draws, the lists are executed in order
+            m_CommandRecorder.RecordAndExecute(m_pImmediateContext, NumThreads, [&](Uint32 ThreadId, IDeviceContext* pCtx) {
+                pCtx->SetRenderTargets(_countof(RTVs), RTVs, pDSV, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+                RecordGBufferDraws(pCtx, UseGpuCulling, NumDraws * ThreadId / NumThreads, NumDraws * (ThreadId + 1) / NumThreads, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+            });
+        }
+        else
+        {
+            Timer RecordTimer;
+            RecordGBufferDraws(m_pImmediateContext, UseGpuCulling, 0, NumDraws, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+            m_RecordingStats.SerialRecordTime += RecordTimer.GetElapsedTime();
         }
+        m_RecordingStats.NumFrames += 1;
     }
 
+    // The depth of this frame occludes the objects of the next one, see CullObjectsOnGpu()
+    if (UseGpuCulling)
+        BuildDepthPyramid();
+
     // Ray tracing pass
     {
         DispatchComputeAttribs dispatchAttribs;
@@ -1398,7 +2679,17 @@ void Tutorial22_HybridRendering::Render()
         m_pImmediateContext->SetPipelineState(m_RayTracingPSO);
         m_pImmediateContext->CommitShaderResources(m_RayTracingSceneSRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
         m_pImmediateContext->CommitShaderResources(m_RayTracingScreenSRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        if (m_RayTracingDuration)
+            m_RayTracingDuration->Begin(m_pImmediateContext);
         m_pImmediateContext->DispatchCompute(dispatchAttribs);
+
+        // The duration becomes available a few frames later
+        double Duration = 0;
+        if (m_RayTracingDuration && m_RayTracingDuration->End(m_pImmediateContext, Duration))
+        {
+            m_RayTracingStats.NumFrames += 1;
+            m_RayTracingStats.TotalTime += Duration;
+        }
     }
 
     // Post process pass
@@ -1430,110 +2721,285 @@ void Tutorial22_HybridRendering::Update(double CurrTime, double ElapsedTime)
         m_FlashlightEnabled = !m_FlashlightEnabled;
     }
 
-    const float dt = static_cast<float>(ElapsedTime);
+    // The last frame rendered interpolated transforms; the simulation continues from its own state
+    RestoreSimulationState();
 
+    UpdateWorldStreaming(m_MaxChunksAddedPerFrame);
 
-    if (m_DamageEffectTimer > 0.0f)
+    // Gameplay advances in fixed steps independent of the frame rate. Frames that take longer
+    // than m_MaxSimTicksPerFrame steps slow the game down rather than stalling it with catch-up ticks.
+    const double TickTime = 1.0 / m_SimTickRate;
+    m_SimTimeAccumulator  = std::min(m_SimTimeAccumulator + ElapsedTime, TickTime * m_MaxSimTicksPerFrame);
+    while (m_SimTimeAccumulator >= TickTime)
     {
-        m_DamageEffectTimer -= dt;
+        CaptureSimulationState();
+
+        Timer TickTimer;
+        SimulationTick(static_cast<float>(TickTime));
+        const double TickElapsed = TickTimer.GetElapsedTime();
+
+        m_SimStats.NumTicks += 1;
+        m_SimStats.TotalTime += TickElapsed;
+        m_SimStats.MaxTime = std::max(m_SimStats.MaxTime, TickElapsed);
+        m_SimTimeAccumulator -= TickTime;
     }
 
-    float3 PrevCameraPos = m_Camera.GetPos();
-    m_Camera.Update(m_InputController, dt);
+    ApplyInterpolatedState(static_cast<float>(m_SimTimeAccumulator / TickTime));
 
-    if (!m_Scene.DynamicObjects.empty())
+    m_SimStats.ReportTimer += ElapsedTime;
+    if (m_SimStats.ReportTimer >= 10.0 && m_SimStats.NumTicks > 0)
     {
-        auto& DynObj = m_Scene.DynamicObjects[0];
-        auto& Obj    = m_Scene.Objects[DynObj.ObjectAttribsIndex];
-
-        float3   camPos      = m_Camera.GetPos();
-        float4x4 modelMat    = Obj.ModelMat.Transpose();
-        float3   monsterPos  = float3{modelMat[3][0], modelMat[3][1], modelMat[3][2]};
-        float3   dirToCamera = normalize(camPos - monsterPos);
+        LOG_INFO_MESSAGE("Simulation at ", m_SimTickRate, " Hz: ", m_SimStats.NumTicks, " ticks in ", m_SimStats.ReportTimer,
+                         " s, ", m_SimStats.TotalTime * 1000.0 / m_SimStats.NumTicks, " ms per tick (max ", m_SimStats.MaxTime * 1000.0, " ms)");
+
+        // Keys are not scheduled, see SimulationTick(), and are only counted
+        MazeSimulationLod::Stats KeyLod;
+        const int2               PlayerCell = m_Level.GetCellAt(m_Camera.GetPos());
+        for (const Key& key : m_Keys)
+            ++KeyLod.NumEntities[m_DoorLod.GetTier(UnpackMazeCoord(key.Cell), PlayerCell)];
+
+        // Average entities and updates per tick by tier, from near to far
+        const auto FormatLod = [](const MazeSimulationLod::Stats& Stats, Uint32 NumTicks) {
+            std::string Str;
+            for (Uint32 t = 0; t < MazeSimulationLod::NumTiers; ++t)
+            {
+                Str += (t > 0 ? "/" : "") + std::to_string(Stats.NumEntities[t] / NumTicks);
+                if (Stats.NumUpdated[t] != Stats.NumEntities[t])
+                    Str += " (" + std::to_string(Stats.NumUpdated[t] / NumTicks) + " updated)";
+            }
+            return Str;
+        };
+        LOG_INFO_MESSAGE("Simulation LOD per tick (near/mid/far): monsters ", FormatLod(m_SimStats.MonsterLod, m_SimStats.NumTicks),
+                         ", rising doors ", FormatLod(m_SimStats.DoorLod, m_SimStats.NumTicks), ", keys ", FormatLod(KeyLod, 1),
+                         "; ", (m_SimStats.MonsterLod.NumDeferred + m_SimStats.DoorLod.NumDeferred) / m_SimStats.NumTicks, " updates deferred");
 
-        float distance = length(camPos - monsterPos);
-        if (distance > 1.5f)
+        std::string TaskTimes;
+        for (Uint32 Task = 0; Task < m_SimStats.TaskTimes.size(); ++Task)
+        {
+            TaskTimes += std::string{Task > 0 ? ", " : ""} + m_TickGraph.GetTaskName(Task) + " " +
+                std::to_string(m_SimStats.TaskTimes[Task] * 1000.0 / m_SimStats.NumTicks);
+        }
+        LOG_INFO_MESSAGE("Simulation tasks on ", m_Jobs.GetNumThreads(), " threads (ms per tick): ", TaskTimes, "; ",
+                         static_cast<double>(m_Jobs.GetNumStolenJobs()) / m_SimStats.NumTicks, " jobs stolen per tick");
+        m_Jobs.ResetStats();
+        m_SimStats = {};
+
+        std::string RayTracingTime = "not measured";
+        if (m_RayTracingStats.NumFrames > 0)
+            RayTracingTime = std::to_string(m_RayTracingStats.TotalTime * 1000.0 / m_RayTracingStats.NumFrames) + " ms per frame";
+        LOG_INFO_MESSAGE("Ray tracing: ", m_Scene.TLASInstances.size(), " TLAS instances (", m_Scene.TLASInstances.size() * TLAS_INSTANCE_DATA_SIZE / 1024.0,
+                         " KB of instance data), ", m_Scene.NumTLASTriangles, " triangles, ", RayTracingTime, " on the GPU");
+        m_RayTracingStats = {};
+
+        if (m_CullingStats.NumFrames > 0 && m_UseCulling && m_UseGpuCulling)
+        {
+            // Counts are read back a few frames later, so they are averaged over the frames that were read
+            const Uint32 NumReadFrames = std::max(m_CullingStats.NumReadFrames, 1u);
+            LOG_INFO_MESSAGE("GPU culling: ", m_CullingStats.NumVisible / NumReadFrames, " of ", m_CullingStats.NumCandidates / NumReadFrames,
+                             " objects drawn per frame in ", m_Scene.GpuDraws.size(), " indirect draws, ",
+                             m_CullingStats.TotalTime * 1000.0 / m_CullingStats.NumFrames, " ms per frame on the CPU");
+        }
+        else if (m_CullingStats.NumFrames > 0)
         {
-            monsterPos += dirToCamera * 3.0f * dt;
-            monsterPos.y = 3.0f;
+            LOG_INFO_MESSAGE("Culling: ", m_CullingStats.NumVisible / m_CullingStats.NumFrames, " of ", m_CullingStats.NumCandidates / m_CullingStats.NumFrames,
+                             " objects drawn per frame, ", m_CullingStats.NumVisibleCells / m_CullingStats.NumFrames, " visible cells (",
+                             m_CullingStats.NumPvsFrames * 100 / m_CullingStats.NumFrames, "% of frames precomputed), ",
+                             m_CullingStats.TotalTime * 1000.0 / m_CullingStats.NumFrames, " ms per frame on the CPU");
         }
+        m_CullingStats = {};
 
-        Obj.ModelMat = (float4x4::Scale(1.0f, 1.0f, 1.0f) *
-                        float4x4::Translation(monsterPos))
-                           .Transpose();
-        Obj.NormalMat = float4x3{Obj.ModelMat};
+        if (m_RecordingStats.NumFrames > 0)
+        {
+            std::string  ThreadTimes;
+            const Uint32 NumRecordedFrames = m_CommandRecorder.GetNumRecordedFrames();
+            for (Uint32 ThreadId = 0; ThreadId < m_CommandRecorder.GetNumThreads() && NumRecordedFrames > 0; ++ThreadId)
+                ThreadTimes += (ThreadId > 0 ? ", " : "") + std::to_string(m_CommandRecorder.GetRecordTime(ThreadId) * 1000.0 / NumRecordedFrames);
+            LOG_INFO_MESSAGE("Command recording: G-buffer draws on ", m_CommandRecorder.GetNumThreads(), " threads (",
+                             ThreadTimes.empty() ? std::string{"not used"} : ThreadTimes + " ms per frame by thread", ") and ",
+                             m_RecordingStats.SerialRecordTime * 1000.0 / m_RecordingStats.NumFrames, " ms per frame on the immediate context; TLAS instances ",
+                             m_RecordingStats.NumTLASUpdates > 0 ? m_RecordingStats.TLASTime * 1000.0 / m_RecordingStats.NumTLASUpdates : 0.0, " ms per update");
+        }
+        m_RecordingStats = {};
+        m_CommandRecorder.ResetStats();
     }
+}
 
-    // Verificar colisión con el monstruo
-    float3 playerPos  = m_Camera.GetPos();
-    float3 monsterPos = float3(m_Scene.Objects[m_Scene.DynamicObjects[0].ObjectAttribsIndex].ModelMat.Transpose().m30,
-                               m_Scene.Objects[m_Scene.DynamicObjects[0].ObjectAttribsIndex].ModelMat.Transpose().m31,
-                               m_Scene.Objects[m_Scene.DynamicObjects[0].ObjectAttribsIndex].ModelMat.Transpose().m32);
-    float  distance   = length(playerPos - monsterPos);
+void Tutorial22_HybridRendering::SimulationTick(float dt)
+{
+    // The stages of the tick run as a graph on the job system. Tasks that neither depend on each
+    // other nor share state run in parallel: the monsters chase the player while the camera is
+    // collided, the keys are collected and the doors rise. The graph captures the state of this
+    // tick and is rebuilt every tick.
+    const float            CamRadius     = 0.5f;
+    float3                 PrevCameraPos = m_Camera.GetPos();
+    float3                 NewCamPos;
+    MazeCrowd::UpdateStats CrowdStats;
+    bool                   DoorsUnlocked = false;
+
+    m_TickGraph.Clear();
+
+    const Uint32 CameraTask = m_TickGraph.AddTask("Camera", [&]() {
+        if (m_DamageEffectTimer > 0.0f)
+        {
+            m_DamageEffectTimer -= dt;
+        }
 
-    if (distance < 2.0f && !m_IsGameOver)
-    {
-        m_TimeSinceLastDamage += dt;
+        m_Camera.Update(m_InputController, dt);
+
+        // Monsters walk toward the player's cell. The field is only recomputed when the player
+        // enters another cell.
+        m_FlowField.SetTarget(m_Level.GetCellAt(m_Camera.GetPos()));
+    });
+
+    const Uint32 MonstersTask = m_TickGraph.AddTask(
+        "Monsters", [&]() {
+            m_Crowd.Update(m_FlowField, m_Camera.GetPos(), dt, CrowdStats);
+            m_SimStats.MonsterLod += CrowdStats.Lod;
+            UpdateMonsterPath(CrowdStats, dt);
+        },
+        {CameraTask});
+
+    m_TickGraph.AddTask(
+        "Damage", [&]() {
+            // Verificar colisión con los monstruos
+            if (CrowdStats.NumAttacking > 0 && !m_IsGameOver)
+            {
+                m_TimeSinceLastDamage += dt;
 
-        while (m_TimeSinceLastDamage >= m_DamageCooldown)
-        {
-            m_Health = std::max(0, m_Health - 25);
-            m_TimeSinceLastDamage -= m_DamageCooldown;
+                while (m_TimeSinceLastDamage >= m_DamageCooldown)
+                {
+                    m_Health = std::max(0, m_Health - 25);
+                    m_TimeSinceLastDamage -= m_DamageCooldown;
 
-            m_DamageEffectTimer      = 0.3f;
-            m_PostDamageOverlayAlpha = 1.0f;
-            m_PostDamageOverlayTimer = 0.0f;
+                    m_DamageEffectTimer      = 0.3f;
+                    m_PostDamageOverlayAlpha = 1.0f;
+                    m_PostDamageOverlayTimer = 0.0f;
 
-            if (m_Health <= 0)
+                    if (m_Health <= 0)
+                    {
+                        m_IsGameOver = true;
+                        break;
+                    }
+                }
+            }
+            else
             {
-                m_IsGameOver = true;
-                break;
+                m_TimeSinceLastDamage = 0.0f;
             }
-        }
-    }
-    else
-    {
-        m_TimeSinceLastDamage = 0.0f;
-    }
 
-    if (m_PostDamageOverlayAlpha > 0.0f)
-    {
-        m_PostDamageOverlayTimer += dt;
-        float t                  = m_PostDamageOverlayTimer / m_PostDamageOverlayDuration;
-        m_PostDamageOverlayAlpha = std::max(0.0f, 1.0f - t);
-    }
+            if (m_PostDamageOverlayAlpha > 0.0f)
+            {
+                m_PostDamageOverlayTimer += dt;
+                float t                  = m_PostDamageOverlayTimer / m_PostDamageOverlayDuration;
+                m_PostDamageOverlayAlpha = std::max(0.0f, 1.0f - t);
+            }
+        },
+        {MonstersTask});
+
+    const Uint32 CollisionsTask = m_TickGraph.AddTask(
+        "Collisions", [&]() {
+            // Collisions are resolved in steps no longer than the camera radius, so that the camera
+            // cannot tunnel through walls at any speed
+            const float3 CamMove  = m_Camera.GetPos() - PrevCameraPos;
+            const int    NumSteps = std::max(1, static_cast<int>(std::ceil(length(CamMove) / CamRadius)));
+            NewCamPos             = PrevCameraPos;
+            for (int Step = 0; Step < NumSteps; ++Step)
+            {
+                NewCamPos += CamMove / static_cast<float>(NumSteps);
+                HandleCollisions(NewCamPos, CamRadius);
+            }
+        },
+        {CameraTask});
+
+    const Uint32 KeysTask = m_TickGraph.AddTask(
+        "Keys", [&]() {
+            const size_t NumUnlockedDoors = m_UnlockedDoors.size();
+            HandleKeyCollection(NewCamPos, CamRadius);
+            DoorsUnlocked = m_UnlockedDoors.size() != NumUnlockedDoors;
+            if (m_ShowUnlockMsg)
+            {
+                m_UnlockMsgTimer += dt;
+                if (m_UnlockMsgTimer >= m_UnlockMsgTime)
+                    m_ShowUnlockMsg = false;
+            }
 
+            TryOpenDoors();
+        },
+        {CollisionsTask});
+
+    // The monsters read the field, so the doors are only opened in it after they moved
+    m_TickGraph.AddTask(
+        "FlowFieldDoors", [&]() {
+            if (DoorsUnlocked)
+                m_FlowField.UpdateDoors();
+        },
+        {KeysTask, MonstersTask});
+
+    m_TickGraph.AddTask(
+        "Doors", [&]() {
+            // Distant doors rise at reduced rates. The key trigger test above stays per tick: it is a
+            // single pass over the bounds of all resident keys.
+            m_RisingDoors.clear();
+            m_RisingDoorCells.clear();
+            m_RisingDoorPendingTimes.clear();
+            for (Uint32 d = 0; d < m_Doors.size(); ++d)
+            {
+                if (!m_Doors[d].Rising) continue;
 
-    float3 NewCamPos = m_Camera.GetPos();
-    HandleCollisions(NewCamPos, 0.5f);
-    HandleKeyCollection(NewCamPos, 0.5f);
-    if (m_ShowUnlockMsg)
-    {
-        m_UnlockMsgTimer += dt;
-        if (m_UnlockMsgTimer >= m_UnlockMsgTime)
-            m_ShowUnlockMsg = false;
-    }
+                m_RisingDoors.push_back(d);
+                m_RisingDoorCells.push_back(m_Doors[d].Cell);
+                m_RisingDoorPendingTimes.push_back(m_Doors[d].LodPendingTime);
+            }
+            m_RisingDoorElapsedTimes.resize(m_RisingDoors.size());
 
-    TryOpenDoors();
+            MazeSimulationLod::Stats DoorLodStats;
+            m_DoorLod.Schedule(m_Level.GetCellAt(NewCamPos), dt, static_cast<Uint32>(m_RisingDoors.size()), m_RisingDoorCells.data(),
+                               m_RisingDoorPendingTimes.data(), m_RisingDoorElapsedTimes.data(), DoorLodStats);
+            m_SimStats.DoorLod += DoorLodStats;
+            for (size_t r = 0; r < m_RisingDoors.size(); ++r)
+                m_Doors[m_RisingDoors[r]].LodPendingTime = m_RisingDoorPendingTimes[r];
 
-    for (auto& door : m_Doors)
-    {
-        if (!door.Rising) continue;
+            Uint32 NumDoorsFinished = 0;
+            for (Uint32 r : m_DoorLod.GetScheduled())
+            {
+                auto& door = m_Doors[m_RisingDoors[r]];
 
-        door.RiseTimer += dt;
-        float offsetY = door.RiseTimer * door.RiseSpeed;
+                door.RiseTimer += m_RisingDoorElapsedTimes[r];
+                float offsetY = door.RiseTimer * door.RiseSpeed;
 
-        // Corregir cálculo de matriz
-        float4x4 riseTrans                        = float4x4::Translation(0.0f, offsetY, 0.0f).Transpose();
-        m_Scene.Objects[door.ObjectIdx].ModelMat  = (door.OriginalMat * riseTrans);
-        m_Scene.Objects[door.ObjectIdx].NormalMat = float4x3{m_Scene.Objects[door.ObjectIdx].ModelMat};
+                // Corregir cálculo de matriz
+                float4x4 riseTrans                        = float4x4::Translation(0.0f, offsetY, 0.0f).Transpose();
+                m_Scene.Objects[door.ObjectIdx].ModelMat  = (door.OriginalMat * riseTrans);
+                m_Scene.Objects[door.ObjectIdx].NormalMat = float4x3{m_Scene.Objects[door.ObjectIdx].ModelMat};
+                MarkObjectMoved(static_cast<Uint32>(door.ObjectIdx));
 
-        if (offsetY > 3.0f)
-        {
-            MazeWalls[door.WallIdx]                  = {{0, 0, 0}, {0, 0, 0}};
-            m_Scene.Objects[door.ObjectIdx].ModelMat = float4x4::Scale(0, 0, 0).Transpose();
-            door.Rising                              = false;
-        }
+                if (offsetY > 3.0f)
+                {
+                    m_CollisionGrid.Remove(static_cast<Uint32>(door.WallIdx));
+                    DeactivateObject(static_cast<Uint32>(door.ObjectIdx));
+                    door.Rising       = false;
+                    NumDoorsFinished += 1;
+                }
+            }
+            // Doors that are fully open are no longer needed; unlocked doors are not streamed in again
+            if (NumDoorsFinished > 0)
+                m_Doors.erase(std::remove_if(m_Doors.begin(), m_Doors.end(), [](const Door& door) { return door.Opened && !door.Rising; }), m_Doors.end());
+        },
+        {KeysTask});
+
+    m_Jobs.Run(m_TickGraph);
+
+    m_SimStats.TaskTimes.resize(m_TickGraph.GetNumTasks());
+    for (Uint32 Task = 0; Task < m_TickGraph.GetNumTasks(); ++Task)
+    {
+        const JobGraph::TaskTiming& Timing = m_TickGraph.GetTaskTiming(Task);
+        m_SimStats.TaskTimes[Task] += Timing.End - Timing.Start;
+    }
+    if (!m_JobTracePath.empty() && m_JobTrace.GetNumFrames() < JobTraceTicks)
+    {
+        m_JobTrace.AddFrame(m_TickGraph);
+        if (m_JobTrace.GetNumFrames() == JobTraceTicks && m_JobTrace.Save(m_JobTracePath.c_str()))
+            LOG_INFO_MESSAGE("Saved the task timings of ", JobTraceTicks, " simulation ticks to '", m_JobTracePath, "'");
     }
 
     NewCamPos.y = std::max(0.1f, std::min(NewCamPos.y, 60.0f));
@@ -1545,26 +3011,137 @@ void Tutorial22_HybridRendering::Update(double CurrTime, double ElapsedTime)
     // Fijar la altura (Y) de la cámara
     Pos.y = 3.0f;
 
-    const float3 MinXYZ{-100.f, 0.1f, -100.f};
-    const float3 MaxXYZ{+100.f, 60.f, 100.f};
+    // Generated worlds have no borders
+    if (!m_Generator.IsInitialized())
+    {
+        const float  HalfWidth = m_Level.GetCols() * m_Level.GetCellSize() * 0.5f;
+        const float  HalfDepth = m_Level.GetRows() * m_Level.GetCellSize() * 0.5f;
+        const float3 MinXYZ{-HalfWidth, 0.1f, -HalfDepth};
+        const float3 MaxXYZ{+HalfWidth, 60.f, +HalfDepth};
 
-    Pos = clamp(Pos, MinXYZ, MaxXYZ);
+        Pos = clamp(Pos, MinXYZ, MaxXYZ);
+    }
 
     m_Camera.SetPos(Pos);
-    m_Camera.Update(m_InputController, 0);
 
+}
+
+void Tutorial22_HybridRendering::SpawnMonsters()
+{
+    // Monsters spawn in random cells at least 8 steps away from the player. The first monster
+    // of a level starts at the monster spawn point of the level.
+    const MazeSpawnPoint* pSpawn = m_Generator.IsInitialized() ? nullptr : m_Level.FindSpawnPoint(MAZE_SPAWN_KIND_MONSTER);
+
+    std::vector<int2> Cells;
+    m_FlowField.SetTarget(m_Level.GetCellAt(m_Camera.GetPos()));
+    m_FlowField.GetReachableCells(8, Cells);
+
+    std::mt19937                          Rng{static_cast<Uint32>(m_ProceduralSeed)};
+    std::uniform_real_distribution<float> RandJitter{-0.25f, 0.25f};
+    for (int i = 0; i < m_NumMonsters; ++i)
+    {
+        float3 Pos{0.f, 0.f, -20.f};
+        if (i == 0 && pSpawn != nullptr)
+        {
+            Pos = pSpawn->Pos;
+        }
+        else if (!Cells.empty())
+        {
+            const int2 Cell = Cells[Rng() % Cells.size()];
+            Pos             = m_Level.GetCellCenter(Cell.x, Cell.y) + float3{RandJitter(Rng), 0, RandJitter(Rng)} * m_Level.GetCellSize();
+        }
+        m_Crowd.AddAgent(Pos);
+    }
+    if (m_NumMonsters > 0)
+        m_Crowd.WriteTransforms(&m_Scene.Objects[m_FirstMonsterObject], 1.0f);
+}
+
+void Tutorial22_HybridRendering::UpdateMonsterPath(const MazeCrowd::UpdateStats& CrowdStats, float dt)
+{
+    MazePath Path;
+    while (m_PathPlanner.PopResult(Path))
+    {
+        if (Path.RequestId == m_MonsterPathRequest)
+        {
+            m_MonsterPath        = std::move(Path);
+            m_MonsterPathRequest = 0;
+            m_Crowd.SetPath(m_MonsterPath.Cells);
+        }
+    }
+
+    // Monsters outside of the flow field share one path, planned from the first monster without
+    // a route. The path is planned again every second, and when the monsters run out of refined cells.
+    m_MonsterPathAge += dt;
+    if (m_MonsterPathRequest != 0 || CrowdStats.NumLost + CrowdStats.NumOnPath == 0)
+        return;
+
+    const bool ReachedEnd = !m_MonsterPath.Waypoints.empty() && CrowdStats.NumLost > 0 && CrowdStats.NumOnPath == 0;
+    if (m_MonsterPathAge >= 1.0f || ReachedEnd)
+    {
+        m_MonsterPathRequest = m_PathPlanner.RequestPath(CrowdStats.RouteCell, m_FlowField.GetTarget());
+        m_MonsterPathAge     = 0;
+    }
+}
+
+void Tutorial22_HybridRendering::CaptureSimulationState()
+{
+    m_PrevSimCameraPos = m_Camera.GetPos();
+
+    // Rising doors are the only objects besides the monsters that move between ticks.
+    // The crowd keeps the previous state of the monsters itself.
+    m_InterpolatedObjects.clear();
+    for (const auto& door : m_Doors)
+    {
+        if (door.Rising)
+            m_InterpolatedObjects.push_back({static_cast<Uint32>(door.ObjectIdx), m_Scene.Objects[door.ObjectIdx].ModelMat, {}});
+    }
+}
 
-    // Update dynamic objects
-    float RotationSpeed = 0.15f;
-    for (auto& DynObj : m_Scene.DynamicObjects)
+void Tutorial22_HybridRendering::ApplyInterpolatedState(float Alpha)
+{
+    // Objects are rendered between the last two simulation states
+    for (auto& InterpObj : m_InterpolatedObjects)
+    {
+        auto& Obj        = m_Scene.Objects[InterpObj.ObjectIdx];
+        InterpObj.SimMat = Obj.ModelMat;
+        for (int r = 0; r < 4; ++r)
+        {
+            for (int c = 0; c < 4; ++c)
+                Obj.ModelMat[r][c] = lerp(InterpObj.PrevMat[r][c], InterpObj.SimMat[r][c], Alpha);
+        }
+        Obj.NormalMat = float4x3{Obj.ModelMat};
+        MarkObjectMoved(InterpObj.ObjectIdx);
+    }
+    if (m_NumMonsters > 0)
     {
-        auto& Obj      = m_Scene.Objects[DynObj.ObjectAttribsIndex];
-        auto  ModelMat = Obj.ModelMat.Transpose();
-        Obj.ModelMat   = (float4x4::RotationY(PI_F * dt * RotationSpeed) * ModelMat).Transpose();
-        Obj.NormalMat  = float4x3{Obj.ModelMat};
+        m_Crowd.WriteTransforms(&m_Scene.Objects[m_FirstMonsterObject], Alpha);
+        for (Uint32 i = 0; i < static_cast<Uint32>(m_NumMonsters); ++i)
+            MarkObjectMoved(m_FirstMonsterObject + i);
+    }
+
+    m_SimCameraPos = m_Camera.GetPos();
+    m_Camera.SetPos(lerp(m_PrevSimCameraPos, m_SimCameraPos, Alpha));
+    // Mouse look is applied every frame
+    m_Camera.Update(m_InputController, 0);
+}
 
-        RotationSpeed *= 1.5f;
+void Tutorial22_HybridRendering::RestoreSimulationState()
+{
+    for (const auto& InterpObj : m_InterpolatedObjects)
+    {
+        auto& Obj     = m_Scene.Objects[InterpObj.ObjectIdx];
+        Obj.ModelMat  = InterpObj.SimMat;
+        Obj.NormalMat = float4x3{Obj.ModelMat};
+        MarkObjectDirty(InterpObj.ObjectIdx);
     }
+    m_Camera.SetPos(m_SimCameraPos);
+}
+
+void Tutorial22_HybridRendering::ResetSimulationCamera(const float3& Pos)
+{
+    m_Camera.SetPos(Pos);
+    m_PrevSimCameraPos = Pos;
+    m_SimCameraPos     = Pos;
 }
 
 void Tutorial22_HybridRendering::WindowResize(Uint32 Width, Uint32 Height)
@@ -1615,6 +3192,7 @@ void Tutorial22_HybridRendering::WindowResize(Uint32 Width, Uint32 Height)
     m_RayTracedTex.Release();
     m_pDevice->CreateTexture(RTDesc, nullptr, &m_RayTracedTex);
 
+    CreateDepthPyramid(Width, Height);
 
     // Create post-processing SRB
     {
@@ -1757,7 +3335,7 @@ void Tutorial22_HybridRendering::UpdateUI()
                 m_Health            = 100;
                 m_IsGameOver        = false;
                 m_DamageEffectTimer = 0.0f;
-                m_Camera.SetPos(float3{-15.7f, 3.7f, -5.8f});
+                ResetSimulationCamera(m_PlayerSpawnPos);
             }
 
             ImGui::PopStyleColor(2);
@@ -1994,6 +3572,14 @@ void Tutorial22_HybridRendering::UpdateUI()
         ImGui::PopStyleColor();
 
         ImGui::EndGroup();
+
+        ImGui::Spacing();
+        ImGui::Separator();
+        ImGui::Spacing();
+
+        // Datos de objetos subidos a la GPU en el último cuadro
+        ImGui::Text("Objetos subidos: %.1f KB/cuadro (%u rangos)", m_Scene.NumUploadedBytes / 1024.0, m_Scene.NumUploadedRanges);
+        ImGui::Text("Objetos dibujados: %u de %u", m_Scene.NumDrawnObjects, m_Scene.NumCulledCandidates);
     }
     ImGui::End();
 }
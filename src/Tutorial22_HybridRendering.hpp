@@ -26,9 +26,26 @@
 
 #pragma once
 
+#include <array>
+#include <memory>
+
 #include "SampleBase.hpp"
 #include "BasicMath.hpp"
 #include "FirstPersonCamera.hpp"
+#include "DurationQueryHelper.hpp"
+#include "MazeLevel.hpp"
+#include "MazeChunkStreamer.hpp"
+#include "MazeSceneCache.hpp"
+#include "MazeCollisionGrid.hpp"
+#include "MazeCollisionKernel.hpp"
+#include "MazeFlowField.hpp"
+#include "MazePathPlanner.hpp"
+#include "MazeCrowd.hpp"
+#include "MazeSimulationLod.hpp"
+#include "MazeVisibility.hpp"
+#include "MazePvs.hpp"
+#include "DeferredCommandRecorder.hpp"
+#include "JobSystem.hpp"
 
 namespace Diligent
 {
@@ -74,6 +91,7 @@ namespace HLSL
 class Tutorial22_HybridRendering final : public SampleBase
 {
 public:
+    virtual CommandLineStatus ProcessCommandLine(int argc, const char* const* argv) override final;
     virtual void ModifyEngineInitInfo(const ModifyEngineInitInfoAttribs& Attribs) override final;
     virtual void Initialize(const SampleInitInfo& InitInfo) override final;
 
@@ -90,14 +108,45 @@ private:
     void CreateScene();
     void CreateSceneMaterials(uint2& CubeMaterialRange, Uint32& GroundMaterial, std::vector<HLSL::MaterialAttribs>& Materials);
     void CreateSceneObjects(uint2 CubeMaterialRange, Uint32 GroundMaterial);
+    void CreateSceneMeshData(float2 FloorUVScale,
+                             std::vector<MazeSceneCache::MeshDesc>& Meshes,
+                             std::vector<HLSL::Vertex>&             Vertices,
+                             std::vector<Uint32>&                   Indices) const;
+    bool BakeSceneCache(const char* Path, Uint64 ContentHash, const std::vector<MazeSceneCache::MeshDesc>& Meshes,
+                        const std::vector<HLSL::Vertex>& Vertices, const std::vector<Uint32>& Indices) const;
     void HandleCollisions(float3& CameraPos, float CamRadius);
     void HandleKeyCollection(const float3& camPos, float camRadius);
     void TryOpenDoors();
+    void SimulationTick(float dt);
+    void SpawnMonsters();
+    void UpdateMonsterPath(const MazeCrowd::UpdateStats& CrowdStats, float dt);
+    void CaptureSimulationState();
+    void ApplyInterpolatedState(float Alpha);
+    void RestoreSimulationState();
+    void ResetSimulationCamera(const float3& Pos);
+    void UpdateWorldStreaming(Uint32 MaxChunksToAdd);
+    void AddChunk(const MazeChunk& Chunk);
+    void EvictChunk(const int2& Coord);
+    void UpdateChunkInstances();
+    float GetStreamingWindowSize() const;
     void CreateSceneAccelStructs();
+    void CompactWallsBLAS();
     void UpdateTLAS();
+    void MarkObjectMoved(Uint32 ObjectIdx);
+    void MarkObjectDirty(Uint32 ObjectIdx);
+    void UploadDirtyObjects();
+    void CullObjects();
+    void CullObjectsOnGpu();
+    // Records the G-buffer draws [FirstDraw, EndDraw) of m_Scene.GpuDraws or m_Scene.VisibleInstances
+    void RecordGBufferDraws(IDeviceContext* pCtx, bool UseGpuCulling, Uint32 FirstDraw, Uint32 EndDraw, RESOURCE_STATE_TRANSITION_MODE TransitionMode);
+    void ReadBackGpuCullingStats();
+    void BuildDepthPyramid();
+    void DeactivateObject(Uint32 ObjectIdx);
     void CreateRasterizationPSO(IShaderSourceInputStreamFactory* pShaderSourceFactory);
     void CreatePostProcessPSO(IShaderSourceInputStreamFactory* pShaderSourceFactory);
     void CreateRayTracingPSO(IShaderSourceInputStreamFactory* pShaderSourceFactory);
+    void CreateCullingPSOs(IShaderSourceInputStreamFactory* pShaderSourceFactory);
+    void CreateDepthPyramid(Uint32 Width, Uint32 Height);
     bool m_FlashlightEnabled = true;
     int  m_nextDoorId        = 0;
     int   m_Health              = 100;
@@ -132,6 +181,14 @@ private:
     RefCntAutoPtr<IPipelineState>         m_PostProcessPSO;
     RefCntAutoPtr<IShaderResourceBinding> m_PostProcessSRB;
 
+    // Index range of one of the BLAS geometries of a mesh
+    struct MeshGeometry
+    {
+        Uint32 FirstIndex = 0;
+        Uint32 NumIndices = 0;
+        Uint32 Material   = 0; // Index in the cube material range
+    };
+
     // Simple implementation of a mesh
     struct Mesh
     {
@@ -145,8 +202,14 @@ private:
         Uint32 NumIndices  = 0;
         Uint32 FirstIndex  = 0; // Offset in the index buffer if IB and VB are shared between multiple meshes
         Uint32 FirstVertex = 0; // Offset in the vertex buffer
+
+        Uint32 FirstGeometryId = 0; // Index of the first geometry in m_Scene.GeometryAttribsBuffer
+
+        // Geometries of a mesh baked from several materials, empty if the whole mesh is one geometry.
+        // The mesh has one object per geometry; the objects are consecutive and share one TLAS instance.
+        std::vector<MeshGeometry> Geometries;
     };
-    static Mesh CreateTexturedPlaneMesh(IRenderDevice* pDevice, float2 UVScale);
+    static void GetTexturedPlaneGeometry(float2 UVScale, std::vector<HLSL::Vertex>& Vertices, std::vector<Uint32>& Indices);
 
     // Objects with the same mesh are grouped for instanced draw call
     struct InstancedObjects
@@ -154,23 +217,56 @@ private:
         Uint32 MeshInd             = 0; // Index in m_Scene.Meshes
         Uint32 ObjectAttribsOffset = 0; // Offset in m_Scene.ObjectAttribsBuffer
         Uint32 NumObjects          = 0; // Number of instances for a draw call
+        Uint32 FirstIndex          = 0; // Index range to draw if NumIndices is not 0, otherwise the whole mesh
+        Uint32 NumIndices          = 0;
     };
+    // Index in m_Scene.GpuDraws of the draw with the index range of the objects, or ~0u
+    Uint32 FindGpuDraw(const InstancedObjects& ObjInst) const;
 
-    struct DynamicObject
+    // CPU-side object. Objects without TransformId are only scaled and translated and are packed
+    // into a compact HLSL::ObjectAttribs on upload, see PackObjectAttribs().
+    struct SceneObject
     {
-        Uint32 ObjectAttribsIndex = 0; // Index in m_Scene.ObjectAttribsBuffer
+        float4x4 ModelMat;  // Transposed object to world transform
+        float4x3 NormalMat; // Transposed object to world normal transform, only used with TransformId
+
+        Uint32 MaterialId  = 0;                   // Index in m_Scene.MaterialAttribsBuffer
+        Uint32 GeometryId  = 0;                   // Index in m_Scene.GeometryAttribsBuffer
+        Uint32 MeshId      = 0;                   // Index in m_Scene.Meshes
+        Uint32 TransformId = NO_OBJECT_TRANSFORM; // Index in m_Scene.ObjectTransformsBuffer
     };
+    static HLSL::ObjectAttribs PackObjectAttribs(const SceneObject& Obj);
 
     struct Scene
     {
-        std::vector<InstancedObjects>    ObjectInstances;
-        std::vector<DynamicObject>       DynamicObjects;
-        std::vector<HLSL::ObjectAttribs> Objects; // CPU-visible array of HLSL::ObjectAttribs
+        std::vector<InstancedObjects> ObjectInstances;
+        std::vector<SceneObject>      Objects;
+
+        // Draws of the objects that passed culling in the current frame, see CullObjects().
+        // ObjectAttribsOffset of the draws is an offset in VisibleObjects.
+        std::vector<InstancedObjects> VisibleInstances;
+        std::vector<Uint32>           VisibleObjects; // Indices in Objects
+        RefCntAutoPtr<IBuffer>        VisibleObjectsBuffer;
+        Uint32                        NumCulledCandidates = 0; // Objects in ObjectInstances in the current frame
+        Uint32                        NumDrawnObjects     = 0; // In the current frame, or in the last frame read back with GPU culling
+
+        // Indirect draws of the GPU culling, see CullObjectsOnGpu(). One draw covers all objects
+        // with the same index range of a mesh, so the number of draws does not depend on the scene.
+        // ObjectAttribsOffset of a draw is its offset in VisibleObjectsBuffer; NumObjects is the
+        // number of objects it may draw.
+        std::vector<InstancedObjects> GpuDraws;
+        RefCntAutoPtr<IBuffer>        DrawArgsBuffer;         // HLSL::DrawIndexedArgs by draws, written by the cull pass
+        RefCntAutoPtr<IBuffer>        DrawArgsTemplateBuffer; // Arguments with no instances, copied to DrawArgsBuffer every frame
+        std::vector<HLSL::CullRange>  CullRanges;             // By element of ObjectInstances
+        RefCntAutoPtr<IBuffer>        CullRangesBuffer;
+        bool                          CullRangesDirty = true; // Set when ObjectInstances changes
 
         // Resources used by shaders
         std::vector<Mesh>                    Meshes;
         RefCntAutoPtr<IBuffer>               MaterialAttribsBuffer;
-        RefCntAutoPtr<IBuffer>               ObjectAttribsBuffer; // GPU-visible array of HLSL::ObjectAttribs
+        RefCntAutoPtr<IBuffer>               ObjectAttribsBuffer;    // GPU-visible array of HLSL::ObjectAttribs
+        RefCntAutoPtr<IBuffer>               ObjectTransformsBuffer; // GPU-visible array of HLSL::ObjectTransform
+        RefCntAutoPtr<IBuffer>               GeometryAttribsBuffer;  // GPU-visible array of HLSL::GeometryAttribs
         std::vector<RefCntAutoPtr<ITexture>> Textures;
         std::vector<RefCntAutoPtr<ISampler>> Samplers;
         RefCntAutoPtr<IBuffer>               ObjectConstants;
@@ -179,6 +275,26 @@ private:
         RefCntAutoPtr<ITopLevelAS> TLAS;
         RefCntAutoPtr<IBuffer>     TLASInstancesBuffer; // Used to update TLAS
         RefCntAutoPtr<IBuffer>     TLASScratchBuffer;   // Used to update TLAS
+        bool                       TLASNeedsRebuild = true; // Set when instances are added or removed
+
+        // Persistent TLAS instances of the drawn objects. Between rebuilds only the transforms
+        // of the objects in MovedObjects are refreshed, see UpdateTLAS().
+        std::vector<TLASBuildInstanceData> TLASInstances;
+        std::vector<String>                TLASInstanceNames;  // By object; formatted once
+        std::vector<Uint32>                ObjectTLASInstance; // By object; ~0u if the object is not drawn
+        std::vector<Uint32>                MovedObjects;
+        std::vector<Uint8>                 ObjectMoved; // By object; set for the objects in MovedObjects
+        Uint64                             NumTLASTriangles = 0; // Triangles referenced by TLASInstances
+
+        // Objects modified since the last upload. Only their ranges of ObjectAttribsBuffer and
+        // ObjectTransformsBuffer are updated, see UploadDirtyObjects(); objects that never change
+        // are uploaded once.
+        std::vector<Uint32>                DirtyObjects;
+        std::vector<Uint8>                 ObjectDirty;           // By object; set for the objects in DirtyObjects
+        std::vector<HLSL::ObjectAttribs>   PackedObjects;         // Staging for one range of objects
+        std::vector<HLSL::ObjectTransform> PackedTransforms;      // Staging for one range of transforms
+        Uint64                             NumUploadedBytes  = 0; // In the last frame
+        Uint32                             NumUploadedRanges = 0;
     };
     Scene m_Scene;
 
@@ -187,6 +303,134 @@ private:
 
     FirstPersonCamera m_Camera;
 
+    // Maze level; its cells are referenced directly in the mapped level file
+    MazeLevel m_Level;
+    String    m_LevelPath      = "Backrooms.lvl";
+    float3    m_PlayerSpawnPos = float3{-15.7f, 3.7f, -5.8f};
+
+    // Endless procedural maze that replaces the level cells when a seed is given
+    MazeGenerator m_Generator;
+    bool          m_UseProceduralWorld       = false;
+    int           m_ProceduralSeed           = 0;
+    int           m_BenchmarkGeneratorChunks = 0;
+
+    // Level chunks and meshes baked next to the level file, see CreateSceneObjects().
+    // Must outlive the streamer threads that read the chunks.
+    MazeSceneCache m_SceneCache;
+    bool           m_SceneCacheWarm = false; // True if the cache was up to date at startup
+
+    // World streaming. Walls, doors and keys of a resident chunk occupy a fixed-size slot
+    // in m_Scene.Objects starting at m_FirstChunkObject, and in MazeWalls starting at 0.
+    struct ChunkSlot
+    {
+        int2   Coord;
+        bool   InUse      = false;
+        Uint32 NumObjects = 0;
+        Uint32 NumWalls   = 0; // Walls and doors come first in the slot
+    };
+    MazeChunkStreamer      m_ChunkStreamer;
+    std::vector<ChunkSlot> m_ChunkSlots;
+    int                    m_ChunkSize              = 16;
+    int                    m_ChunkLoadRadius        = 2;
+    int                    m_ChunkLookAhead         = 1;
+    int                    m_ChunkEvictRadius       = 3;
+    Uint32                 m_MaxChunksAddedPerFrame = 2;
+    Uint32                 m_FirstChunkObject       = 0;
+    Uint32                 m_MaxObjectsPerChunk     = 0;
+    Uint32                 m_NumStaticInstances     = 0; // Floor, ceiling, baked walls and monsters
+    Uint32                 m_FloorObjectIdx         = 0;
+    Uint32                 m_CeilingObjectIdx       = 0;
+    Uint32                 m_CubeMeshId             = 0;
+    Uint32                 m_CubeMaterialOffset     = 0;
+
+    // Static walls of the level baked into one mesh, see BakeMazeWallMesh(). Chunks only add
+    // their doors and keys as objects. Generated worlds and --wall_mesh 0 use a cube per wall.
+    Uint32 m_WallMeshId  = ~0u;
+    bool   m_UseWallMesh = true;
+
+    // Walls of the resident chunks by grid cell; ids are indices in MazeWalls
+    MazeCollisionGrid m_CollisionGrid;
+    int               m_BenchmarkCollisionQueries     = 0;
+    int               m_BenchmarkCollisionKernelBoxes = 0;
+
+    // Distances to the player's cell that the monster follows around walls
+    MazeFlowField m_FlowField;
+    int           m_BenchmarkFlowFieldUpdates = 0;
+
+    // Line of sight and ray queries against the cells of the flow field
+    MazeRayCaster m_RayCaster;
+    int           m_BenchmarkRayCasts = 0;
+
+    // Cells visible through the open cells of the flow field, used to cull the rasterized objects
+    MazeVisibility m_Visibility;
+    bool           m_UseCulling = true;
+
+    // Visible cells precomputed for every cell of the level, used instead of the traversal
+    MazePvs m_Pvs;
+    bool    m_UsePvs = true;
+
+    // Path of monsters outside of the flow field window, planned on a worker thread
+    MazePathPlanner m_PathPlanner;
+    MazePath        m_MonsterPath;
+    Uint32          m_MonsterPathRequest   = 0; // Pending query, 0 if none
+    float           m_MonsterPathAge       = 0;
+    int             m_BenchmarkPathQueries = 0;
+
+    // Simulation ticks run as a graph of tasks on the job system, which also runs the crowd passes
+    // over the monsters, see SimulationTick(). With --job_trace, the task timings of the first
+    // JobTraceTicks ticks are saved to m_JobTracePath.
+    static constexpr Uint32 JobTraceTicks = 600;
+
+    JobSystem m_Jobs;
+    JobGraph  m_TickGraph;
+    JobTrace  m_JobTrace;
+    String    m_JobTracePath;
+
+    // Monsters are simulated by the crowd and drawn from m_NumMonsters consecutive objects
+    // starting at m_FirstMonsterObject
+    MazeCrowd m_Crowd;
+    int       m_NumMonsters          = 1;
+    Uint32    m_FirstMonsterObject   = 0;
+    int       m_BenchmarkCrowdAgents = 0;
+
+    // Monsters and rising doors far from the player are updated at reduced rates, with at most
+    // m_SimLodBudget reduced-rate updates of each per tick. The rising doors are gathered into
+    // the m_RisingDoor* arrays every tick for the door scheduler.
+    MazeSimulationLod   m_DoorLod;
+    int                 m_SimLodBudget = 1024;
+    std::vector<Uint32> m_RisingDoors;
+    std::vector<int2>   m_RisingDoorCells;
+    std::vector<float>  m_RisingDoorPendingTimes;
+    std::vector<float>  m_RisingDoorElapsedTimes;
+
+    // Fixed-rate gameplay simulation, see Update(). Moving objects and the camera are
+    // rendered interpolated between the last two simulation states.
+    struct InterpolatedObject
+    {
+        Uint32   ObjectIdx = 0; // Index in m_Scene.Objects
+        float4x4 PrevMat;       // Model matrix before the last tick
+        float4x4 SimMat;        // Model matrix after the last tick
+    };
+    struct SimulationStats
+    {
+        Uint32 NumTicks    = 0;
+        double TotalTime   = 0;
+        double MaxTime     = 0;
+        double ReportTimer = 0;
+
+        MazeSimulationLod::Stats MonsterLod;
+        MazeSimulationLod::Stats DoorLod;
+
+        std::vector<double> TaskTimes; // By task of m_TickGraph
+    };
+    int                             m_SimTickRate         = 60;
+    int                             m_MaxSimTicksPerFrame = 8;
+    double                          m_SimTimeAccumulator  = 0;
+    float3                          m_PrevSimCameraPos;
+    float3                          m_SimCameraPos;
+    std::vector<InterpolatedObject> m_InterpolatedObjects;
+    SimulationStats                 m_SimStats;
+
     struct GBuffer
     {
         RefCntAutoPtr<ITexture> Color;
@@ -203,6 +447,72 @@ private:
     GBuffer                 m_GBuffer;
     RefCntAutoPtr<ITexture> m_RayTracedTex;
 
+    // GPU time of the ray tracing pass, reported together with the simulation stats.
+    // Null if the device does not support timestamp queries.
+    std::unique_ptr<DurationQueryHelper> m_RayTracingDuration;
+    struct RayTracingStats
+    {
+        Uint32 NumFrames = 0;
+        double TotalTime = 0;
+    };
+    RayTracingStats m_RayTracingStats;
+
+    // Objects that passed culling, reported together with the simulation stats
+    struct CullingStats
+    {
+        Uint32 NumFrames       = 0;
+        Uint64 NumVisible      = 0;
+        Uint64 NumCandidates   = 0;
+        Uint64 NumVisibleCells = 0;
+        Uint32 NumPvsFrames    = 0; // Frames that used the precomputed sets
+        Uint32 NumReadFrames   = 0; // Frames whose GPU culling results were read back
+        double TotalTime       = 0;
+    };
+    CullingStats m_CullingStats;
+
+    // The G-buffer draws are recorded with deferred contexts on m_NumRenderThreads threads,
+    // which also prepare the TLAS instances. With no threads everything is recorded on the
+    // immediate context.
+    DeferredCommandRecorder m_CommandRecorder;
+    Uint32                  m_NumRenderThreads = 4;
+
+    struct RecordingStats
+    {
+        Uint32 NumFrames        = 0;
+        double SerialRecordTime = 0; // G-buffer draws recorded on the immediate context
+        Uint32 NumTLASUpdates   = 0;
+        double TLASTime         = 0; // Preparation of the TLAS instances
+    };
+    RecordingStats m_RecordingStats;
+
+    // GPU culling: a compute pass culls the objects against the frustum and the depth pyramid of the
+    // previous frame and writes the arguments of the indirect draws
+    static constexpr Uint32               CullGroupSize   = 64; // See Culling.csh
+    bool                                  m_UseGpuCulling = true;
+    RefCntAutoPtr<IPipelineState>         m_CullPSO;
+    RefCntAutoPtr<IShaderResourceBinding> m_CullSRB;
+    RefCntAutoPtr<IBuffer>                m_CullConstants;
+
+    // Farthest depth of the G-buffer by levels. Level 0 is the largest power of two size that fits
+    // the screen; every level is built from the previous one with its own SRB.
+    RefCntAutoPtr<IPipelineState>                      m_DepthPyramidPSO;
+    RefCntAutoPtr<ITexture>                            m_DepthPyramid;
+    std::vector<RefCntAutoPtr<IShaderResourceBinding>> m_DepthPyramidSRBs;
+    float4x4                                           m_DepthPyramidViewProj;
+    bool                                               m_DepthPyramidValid = false; // False until a frame is rendered to the pyramid
+
+    // Draw arguments are copied to staging buffers and read once the fence passes their frame
+    struct DrawArgsReadback
+    {
+        RefCntAutoPtr<IBuffer> Buffer;
+        Uint64                 FenceValue    = 0; // 0 if the buffer is free
+        Uint32                 NumCandidates = 0; // Objects in the cull ranges of the frame
+    };
+    std::array<DrawArgsReadback, 3> m_DrawArgsReadbacks;
+    Uint32                          m_NextDrawArgsReadback = 0;
+    RefCntAutoPtr<IFence>           m_CullFence;
+    Uint64                          m_CullFenceValue = 0;
+
     float3 m_LightDir = normalize(float3{-0.49f, -0.60f, 0.64f});
     int    m_DrawMode = 0;
 
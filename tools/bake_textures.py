@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+"""Bakes material images into block-compressed DDS textures with precomputed mip chains.
+
+Every PNG/JPEG image in the input directory is converted to '<image>.dds' next to it
+(e.g. 'payaso.png' -> 'payaso.png.dds'), which SceneTextureCache loads instead of the
+source image. Images with transparency are compressed to BC7 (mode 6), opaque images
+to BC1. Both are sRGB. Mips are filtered in linear space.
+
+Images that are up to date are skipped unless --force is given.
+
+Requires numpy and Pillow.
+
+Usage:
+    bake_textures.py ../assets
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+import numpy as np
+from PIL import Image
+
+SOURCE_EXTENSIONS = (".png", ".jpg", ".jpeg")
+
+DXGI_FORMAT_BC1_UNORM_SRGB = 72
+DXGI_FORMAT_BC7_UNORM_SRGB = 99
+
+DDSD_CAPS, DDSD_HEIGHT, DDSD_WIDTH = 0x1, 0x2, 0x4
+DDSD_PIXELFORMAT, DDSD_MIPMAPCOUNT, DDSD_LINEARSIZE = 0x1000, 0x20000, 0x80000
+DDPF_FOURCC = 0x4
+DDSCAPS_COMPLEX, DDSCAPS_TEXTURE, DDSCAPS_MIPMAP = 0x8, 0x1000, 0x400000
+D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3
+
+BC7_WEIGHTS = np.array([0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64], dtype=np.float32) / 64.0
+BC1_WEIGHTS = np.array([0, 3, 1, 2], dtype=np.float32) / 3.0  # Palette order of BC1 indices 0..3
+
+
+def srgb_to_linear(c):
+    return np.where(c <= 0.04045, c / 12.92, ((c + 0.055) / 1.055) ** 2.4)
+
+
+def linear_to_srgb(c):
+    return np.where(c <= 0.0031308, c * 12.92, 1.055 * np.power(np.maximum(c, 0.0), 1.0 / 2.4) - 0.055)
+
+
+def build_mip_chain(rgba):
+    """Returns the list of uint8 RGBA mip levels. Color is filtered in linear space."""
+    levels = [rgba]
+    linear = np.concatenate([srgb_to_linear(rgba[..., :3] / 255.0), rgba[..., 3:] / 255.0], axis=-1)
+    while linear.shape[0] > 1 or linear.shape[1] > 1:
+        # Odd dimensions are padded by replicating the last row or column
+        h, w = linear.shape[:2]
+        linear = np.pad(linear, ((0, h & 1), (0, w & 1), (0, 0)), mode="edge")
+        h, w = linear.shape[:2]
+        linear = linear.reshape(h // 2, 2, w // 2, 2, 4).mean(axis=(1, 3))
+        color = np.concatenate([linear_to_srgb(linear[..., :3]), linear[..., 3:]], axis=-1)
+        levels.append(np.clip(np.rint(color * 255.0), 0, 255).astype(np.uint8))
+    return levels
+
+
+def to_blocks(level):
+    """Splits the image into 4x4 blocks of shape (N, 16, 4). Partial blocks are padded with edge pixels."""
+    h, w = level.shape[:2]
+    bh, bw = (h + 3) // 4, (w + 3) // 4
+    padded = np.pad(level, ((0, bh * 4 - h), (0, bw * 4 - w), (0, 0)), mode="edge")
+    return padded.reshape(bh, 4, bw, 4, 4).transpose(0, 2, 1, 3, 4).reshape(bh * bw, 16, 4).astype(np.float32)
+
+
+def principal_endpoints(blocks):
+    """Fits a line through the pixels of every block and returns the extreme points on it."""
+    mean = blocks.mean(axis=1, keepdims=True)
+    centered = blocks - mean
+    cov = np.einsum("nki,nkj->nij", centered, centered)
+    # A few power iterations starting from the main diagonal are enough for 4x4 blocks
+    axis = np.sqrt(np.maximum(np.einsum("nii->ni", cov), 0.0)) + 1e-4
+    for _ in range(8):
+        axis = np.einsum("nij,nj->ni", cov, axis)
+        axis /= np.maximum(np.linalg.norm(axis, axis=1, keepdims=True), 1e-12)
+    proj = np.einsum("nki,ni->nk", centered, axis)
+    lo = mean[:, 0, :] + proj.min(axis=1)[:, None] * axis
+    hi = mean[:, 0, :] + proj.max(axis=1)[:, None] * axis
+    return np.clip(lo, 0, 255), np.clip(hi, 0, 255)
+
+
+def nearest_indices(blocks, palette):
+    """Returns the index of the closest palette entry for every pixel; palette has shape (N, P, C)."""
+    dist = ((blocks[:, :, None, :] - palette[:, None, :, :]) ** 2).sum(axis=-1)
+    return dist.argmin(axis=-1)
+
+
+def encode_bc1(blocks):
+    rgb = blocks[..., :3]
+    lo, hi = principal_endpoints(rgb)
+
+    def to565(c):
+        r, g, b = np.rint(c[:, 0] * 31 / 255), np.rint(c[:, 1] * 63 / 255), np.rint(c[:, 2] * 31 / 255)
+        return (r.astype(np.uint32) << 11) | (g.astype(np.uint32) << 5) | b.astype(np.uint32)
+
+    def from565(v):
+        return np.stack([(v >> 11) * 255 / 31, ((v >> 5) & 63) * 255 / 63, (v & 31) * 255 / 31], axis=-1).astype(np.float32)
+
+    c0, c1 = to565(hi), to565(lo)
+    # Four-color mode requires color0 > color1
+    swap = c0 < c1
+    c0, c1 = np.where(swap, c1, c0), np.where(swap, c0, c1)
+    e0, e1 = from565(c0), from565(c1)
+    palette = e0[:, None, :] + (e1 - e0)[:, None, :] * BC1_WEIGHTS[None, :, None]
+    indices = nearest_indices(rgb, palette).astype(np.uint32)
+    indices[c0 == c1] = 0
+
+    bits = np.zeros(len(blocks), dtype=np.uint32)
+    for i in range(16):
+        bits |= indices[:, i] << (2 * i)
+    out = np.zeros((len(blocks), 2), dtype=np.uint32)
+    out[:, 0] = c0 | (c1 << 16)
+    out[:, 1] = bits
+    return out.astype("<u4").tobytes()
+
+
+def quantize_bc7_endpoint(c):
+    """Quantizes RGBA endpoints to 7 bits plus a shared p-bit, choosing the p-bit with the lower error."""
+    best_q, best_p, best_err = None, None, None
+    for p in (0, 1):
+        q = np.clip(np.rint((c - p) / 2.0), 0, 127)
+        err = (((q * 2 + p) - c) ** 2).sum(axis=1)
+        if best_err is None:
+            best_q, best_p, best_err = q, np.zeros(len(c), dtype=np.uint64), err
+        else:
+            better = err < best_err
+            best_q = np.where(better[:, None], q, best_q)
+            best_p = np.where(better, np.uint64(1), best_p)
+            best_err = np.minimum(err, best_err)
+    return best_q.astype(np.uint64), best_p
+
+
+def encode_bc7_mode6(blocks):
+    lo, hi = principal_endpoints(blocks)
+    q0, p0 = quantize_bc7_endpoint(lo)
+    q1, p1 = quantize_bc7_endpoint(hi)
+    e0 = (q0 * 2 + p0[:, None]).astype(np.float32)
+    e1 = (q1 * 2 + p1[:, None]).astype(np.float32)
+    palette = e0[:, None, :] + (e1 - e0)[:, None, :] * BC7_WEIGHTS[None, :, None]
+    indices = nearest_indices(blocks, palette).astype(np.uint64)
+
+    # The most significant bit of the first index is implicit zero; swap the endpoints if needed
+    swap = indices[:, 0] >= 8
+    q0, q1 = np.where(swap[:, None], q1, q0), np.where(swap[:, None], q0, q1)
+    p0, p1 = np.where(swap, p1, p0), np.where(swap, p0, p1)
+    indices = np.where(swap[:, None], np.uint64(15) - indices, indices)
+
+    lo_bits = np.zeros(len(blocks), dtype=np.uint64)
+    hi_bits = np.zeros(len(blocks), dtype=np.uint64)
+
+    def put(value, offset, count):
+        nonlocal lo_bits, hi_bits
+        value = value.astype(np.uint64) & np.uint64((1 << count) - 1)
+        if offset + count <= 64:
+            lo_bits |= value << np.uint64(offset)
+        elif offset >= 64:
+            hi_bits |= value << np.uint64(offset - 64)
+        else:
+            low_count = 64 - offset
+            lo_bits |= (value & np.uint64((1 << low_count) - 1)) << np.uint64(offset)
+            hi_bits |= value >> np.uint64(low_count)
+
+    put(np.full(len(blocks), 1 << 6, dtype=np.uint64), 0, 7)  # Mode 6
+    offset = 7
+    for channel in range(4):
+        put(q0[:, channel], offset, 7)
+        put(q1[:, channel], offset + 7, 7)
+        offset += 14
+    put(p0, offset, 1)
+    put(p1, offset + 1, 1)
+    offset += 2
+    put(indices[:, 0], offset, 3)
+    offset += 3
+    for i in range(1, 16):
+        put(indices[:, i], offset, 4)
+        offset += 4
+    assert offset == 128
+
+    out = np.stack([lo_bits, hi_bits], axis=1)
+    return out.astype("<u8").tobytes()
+
+
+def dds_header(width, height, num_mips, dxgi_format, top_level_size):
+    flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE
+    pixel_format = struct.pack("<2I4s5I", 32, DDPF_FOURCC, b"DX10", 0, 0, 0, 0, 0)
+    header = struct.pack("<7I44x", 124, flags, height, width, top_level_size, 0, num_mips)
+    header += pixel_format
+    header += struct.pack("<5I", DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP, 0, 0, 0, 0)
+    dx10 = struct.pack("<5I", dxgi_format, D3D10_RESOURCE_DIMENSION_TEXTURE2D, 0, 1, 0)
+    return b"DDS " + header + dx10
+
+
+def bake(source, output, fmt):
+    image = Image.open(source).convert("RGBA")
+    # Direct3D requires the top level of a block-compressed texture to be a multiple of 4
+    width, height = (image.width + 3) & ~3, (image.height + 3) & ~3
+    if (width, height) != image.size:
+        image = image.resize((width, height), Image.LANCZOS)
+    rgba = np.asarray(image, dtype=np.uint8)
+
+    if fmt == "auto":
+        fmt = "bc7" if rgba[..., 3].min() < 255 else "bc1"
+    encode, dxgi_format = (encode_bc7_mode6, DXGI_FORMAT_BC7_UNORM_SRGB) if fmt == "bc7" else (encode_bc1, DXGI_FORMAT_BC1_UNORM_SRGB)
+
+    mips = [encode(to_blocks(level)) for level in build_mip_chain(rgba)]
+    with open(output, "wb") as f:
+        f.write(dds_header(width, height, len(mips), dxgi_format, len(mips[0])))
+        for data in mips:
+            f.write(data)
+
+    source_size = width * height * 4 * 4 // 3
+    baked_size = sum(len(m) for m in mips)
+    print("{} -> {} ({}x{} {}, {} mips, {:.1f}x smaller than RGBA8)".format(
+        os.path.basename(source), os.path.basename(output), width, height, fmt.upper(), len(mips), source_size / baked_size))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("assets")
+    parser.add_argument("--format", choices=["auto", "bc1", "bc7"], default="auto")
+    parser.add_argument("--force", action="store_true", help="rebake images that are up to date")
+    args = parser.parse_args()
+
+    sources = sorted(f for f in os.listdir(args.assets) if f.lower().endswith(SOURCE_EXTENSIONS))
+    if not sources:
+        sys.exit("No images found in {}".format(args.assets))
+
+    for name in sources:
+        source = os.path.join(args.assets, name)
+        output = source + ".dds"
+        if not args.force and os.path.exists(output) and os.path.getmtime(output) >= os.path.getmtime(source):
+            continue
+        bake(source, output, args.format)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Converts a text maze grid into the binary maze level format read by MazeLevel.
+
+The grid is a text file with one maze row per line and comma- or space-separated
+block types. Block types follow the convention used by the game:
+
+    0       - corridor
+    1       - wall
+    2-9, 19 - walls with custom textures
+    10-17   - doors, opened by the key with block type + 10
+    20-27   - keys
+
+Usage:
+    make_maze_level.py Backrooms.txt ../assets/Backrooms.lvl
+"""
+
+import argparse
+import re
+import struct
+
+MAGIC = 0x564C5242  # 'BRLV'
+VERSION = 1
+
+KIND_EMPTY, KIND_WALL, KIND_DOOR, KIND_KEY = 0, 1, 2, 3
+FLAG_MERGE = 1
+
+SPAWN_PLAYER, SPAWN_MONSTER = 0, 1
+
+HEADER_FORMAT = "<4I2f8I"
+BLOCK_TYPE_FORMAT = "<BBH"
+BINDING_FORMAT = "<2I"
+SPAWN_FORMAT = "<I3f2f"
+
+
+def default_block_types():
+    types = [(KIND_EMPTY, 0, 0)] * 28
+    for t in [1] + list(range(2, 10)) + [19]:
+        types[t] = (KIND_WALL, FLAG_MERGE, t - 1)
+    for t in range(10, 18):
+        types[t] = (KIND_DOOR, FLAG_MERGE, t - 1)
+    for t in range(20, 28):
+        types[t] = (KIND_KEY, 0, t - 1)
+    return types
+
+
+def read_grid(path):
+    rows = []
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            values = [v for v in re.split(r"[,\s]+", line.strip()) if v]
+            if values:
+                rows.append([int(v) for v in values])
+    cols = max(len(r) for r in rows)
+    # Rows that are shorter than the widest one are padded with corridor cells
+    return [r + [0] * (cols - len(r)) for r in rows], cols
+
+
+def parse_floats(text, count):
+    values = [float(v) for v in text.split(",")]
+    if len(values) != count:
+        raise argparse.ArgumentTypeError("expected {} comma-separated values".format(count))
+    return values
+
+
+def align4(offset):
+    return (offset + 3) & ~3
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("grid")
+    parser.add_argument("output")
+    parser.add_argument("--cell-size", type=float, default=2.0)
+    parser.add_argument("--wall-height", type=float, default=3.0)
+    parser.add_argument("--player", default="-15.7,3.7,-5.8,17.7,-0.1", help="x,y,z,yaw,pitch")
+    parser.add_argument("--monster", default="0,3,-20", help="x,y,z")
+    args = parser.parse_args()
+
+    grid, cols = read_grid(args.grid)
+    rows = len(grid)
+
+    block_types = default_block_types()
+    for r in grid:
+        for v in r:
+            if v >= len(block_types):
+                raise SystemExit("Unknown block type {}".format(v))
+
+    bindings = [(key, key - 10) for key in range(20, 28)]
+
+    player = parse_floats(args.player, 5)
+    monster = parse_floats(args.monster, 3)
+    spawns = [(SPAWN_PLAYER, *player), (SPAWN_MONSTER, *monster, 0.0, 0.0)]
+
+    offset = struct.calcsize(HEADER_FORMAT)
+    block_types_offset = align4(offset)
+    offset = block_types_offset + len(block_types) * struct.calcsize(BLOCK_TYPE_FORMAT)
+    bindings_offset = align4(offset)
+    offset = bindings_offset + len(bindings) * struct.calcsize(BINDING_FORMAT)
+    spawns_offset = align4(offset)
+    offset = spawns_offset + len(spawns) * struct.calcsize(SPAWN_FORMAT)
+    cells_offset = align4(offset)
+
+    data = bytearray(cells_offset + rows * cols)
+    struct.pack_into(HEADER_FORMAT, data, 0, MAGIC, VERSION, cols, rows, args.cell_size, args.wall_height,
+                     len(block_types), block_types_offset, len(bindings), bindings_offset,
+                     len(spawns), spawns_offset, cells_offset, 0)
+    for i, bt in enumerate(block_types):
+        struct.pack_into(BLOCK_TYPE_FORMAT, data, block_types_offset + i * struct.calcsize(BLOCK_TYPE_FORMAT), *bt)
+    for i, b in enumerate(bindings):
+        struct.pack_into(BINDING_FORMAT, data, bindings_offset + i * struct.calcsize(BINDING_FORMAT), *b)
+    for i, s in enumerate(spawns):
+        struct.pack_into(SPAWN_FORMAT, data, spawns_offset + i * struct.calcsize(SPAWN_FORMAT), *s)
+    data[cells_offset:] = bytes(v for r in grid for v in r)
+
+    with open(args.output, "wb") as f:
+        f.write(data)
+    print("Wrote {}x{} maze to {}".format(cols, rows, args.output))
+
+
+if __name__ == "__main__":
+    main()